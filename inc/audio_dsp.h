@@ -0,0 +1,43 @@
+#ifndef AUDIO_DSP_H
+#define AUDIO_DSP_H
+
+#include <stdint.h>
+
+/**
+ * @brief Computes the sum of squares of a block of ADC samples (integer path).
+ *
+ * @param samples Pointer to the raw 12-bit ADC samples.
+ * @param count Number of samples in the block.
+ * @param offset DC offset of the signal (mid-scale of the ADC).
+ * @return The sum of the squared deviations from offset.
+ */
+uint64_t audio_block_sum_squares(const uint16_t *samples, uint32_t count, int32_t offset);
+
+/**
+ * @brief Converts a sum of squares to a sound level (integer path).
+ *
+ * @param sum_squares Sum of the squared deviations.
+ * @param count Number of samples the sum covers.
+ * @return The sound level in hundredths of dB (calibrated with MIC_DB_OFFSET).
+ */
+int32_t audio_sum_squares_to_cdB(uint64_t sum_squares, uint32_t count);
+
+/**
+ * @brief Computes the RMS value of a block of ADC samples (float reference path).
+ *
+ * @param samples Pointer to the raw 12-bit ADC samples.
+ * @param count Number of samples in the block.
+ * @param offset DC offset of the signal (mid-scale of the ADC).
+ * @return The RMS value in ADC counts.
+ */
+float audio_block_rms(const uint16_t *samples, uint32_t count, int32_t offset);
+
+/**
+ * @brief Converts an RMS value to a sound level (float reference path).
+ *
+ * @param rms RMS value in ADC counts.
+ * @return The sound level in dB (calibrated with RMS_REFERENCE and MIC_DB_OFFSET).
+ */
+float audio_rms_to_dB(float rms);
+
+#endif
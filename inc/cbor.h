@@ -0,0 +1,61 @@
+#ifndef CBOR_H
+#define CBOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CBOR_INDEFINITE_ARRAY 0x9F  // Start of an array of unknown length
+#define CBOR_BREAK 0xFF             // End of an array of unknown length
+#define CBOR_TAG_EPOCH 1            // Tag of an epoch time in seconds (RFC 8949)
+
+/**
+ * @brief Streaming CBOR (RFC 8949) encoder writing into a caller buffer.
+ *
+ * No allocation: the writer lives on the stack and only holds the buffer position.
+ * An item that does not fit is not written and the writer stops (overflow set), so a
+ * truncated output always ends on an item boundary.
+ */
+
+typedef struct {
+    uint8_t *buf;           ///< Output buffer
+    size_t size;            ///< Size of the buffer
+    size_t length;          ///< Bytes written
+    bool overflow;          ///< An item did not fit
+} cbor_writer_t;
+
+/**
+ * @brief Starts writing into a buffer.
+ *
+ * @param writer Writer to initialize.
+ * @param buf Output buffer.
+ * @param size Size of the buffer.
+ */
+void cbor_writer_init(cbor_writer_t *writer, uint8_t *buf, size_t size);
+
+/**
+ * @brief Writes an unsigned integer.
+ */
+void cbor_put_uint(cbor_writer_t *writer, uint64_t value);
+
+/**
+ * @brief Writes a signed integer.
+ */
+void cbor_put_int(cbor_writer_t *writer, int64_t value);
+
+/**
+ * @brief Writes the head of an array of count items (the items follow).
+ */
+void cbor_put_array(cbor_writer_t *writer, uint32_t count);
+
+/**
+ * @brief Writes the head of a map of count key/value pairs (the pairs follow).
+ */
+void cbor_put_map(cbor_writer_t *writer, uint32_t count);
+
+/**
+ * @brief Writes a tag (the tagged item follows).
+ */
+void cbor_put_tag(cbor_writer_t *writer, uint64_t tag);
+
+#endif
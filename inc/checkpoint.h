@@ -0,0 +1,99 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CHECKPOINT_MAGIC 0x54504B43u    // "CKPT"
+#define CHECKPOINT_SLOTS 2              // A/B copies in flash
+
+/**
+ * @brief Header of a checkpoint (in RAM and at the start of each flash copy).
+ */
+
+typedef struct {
+    uint32_t magic;             ///< CHECKPOINT_MAGIC
+    uint32_t sequence;          ///< Incremented by every write (the newest copy wins)
+    uint32_t words;             ///< Size of the payload in 32-bit words (layout check)
+    uint32_t encoded_words;     ///< Size of the encoded payload in flash, in 32-bit words
+    uint32_t crc;               ///< CRC16 of the payload
+} checkpoint_header_t;
+
+/**
+ * @brief Callback writing a block of an encoded checkpoint.
+ *
+ * @return true on success.
+ */
+typedef bool (*checkpoint_write_t)(void *ctx, const void *data, uint32_t size);
+
+/**
+ * @brief Callback reading a block of an encoded checkpoint.
+ *
+ * @return true if the whole block was read.
+ */
+typedef bool (*checkpoint_read_t)(void *ctx, void *data, uint32_t size);
+
+/**
+ * @brief Seals a payload: fills the header with its size and CRC.
+ *
+ * @param header Header to fill (the sequence is incremented).
+ * @param payload Payload (32-bit words).
+ * @param words Size of the payload in words.
+ */
+void checkpoint_seal(checkpoint_header_t *header, const uint32_t *payload, uint32_t words);
+
+/**
+ * @brief Checks that a payload matches its header.
+ *
+ * @param header Header of the payload.
+ * @param payload Payload (32-bit words).
+ * @param words Expected size of the payload in words.
+ * @return true if the magic, the size and the CRC match.
+ */
+bool checkpoint_valid(const checkpoint_header_t *header, const uint32_t *payload, uint32_t words);
+
+/**
+ * @brief Writes a sealed checkpoint: header followed by the encoded payload.
+ *
+ * @param header Sealed header (encoded_words is filled).
+ * @param payload Payload (32-bit words).
+ * @param write Write callback.
+ * @param ctx Context of the callback.
+ * @return true if every block was written.
+ */
+bool checkpoint_write(checkpoint_header_t *header, const uint32_t *payload, checkpoint_write_t write, void *ctx);
+
+/**
+ * @brief Reads the header of a checkpoint.
+ *
+ * @param header Header read.
+ * @param words Expected size of the payload in words.
+ * @param read Read callback.
+ * @param ctx Context of the callback.
+ * @return true if a header with the right magic and size was read.
+ */
+bool checkpoint_read_header(checkpoint_header_t *header, uint32_t words, checkpoint_read_t read, void *ctx);
+
+/**
+ * @brief Reads and checks the payload following a header read by checkpoint_read_header().
+ *
+ * @param header Header of the checkpoint.
+ * @param payload Buffer receiving the payload (header->words words; undefined on failure).
+ * @param read Read callback.
+ * @param ctx Context of the callback.
+ * @return true if the payload was decoded and its CRC matches.
+ */
+bool checkpoint_read_payload(const checkpoint_header_t *header, uint32_t *payload, checkpoint_read_t read, void *ctx);
+
+/**
+ * @brief Orders the flash copies newest first.
+ *
+ * @param headers Header of each slot.
+ * @param present Whether each slot holds a header with the right magic and size.
+ * @param order Slot indexes to try, newest first.
+ * @return Number of slots to try.
+ */
+uint8_t checkpoint_order(const checkpoint_header_t headers[CHECKPOINT_SLOTS], const bool present[CHECKPOINT_SLOTS],
+                         uint8_t order[CHECKPOINT_SLOTS]);
+
+#endif
@@ -11,25 +11,115 @@
 
 //MQTT configuration
 #define MQTT_TOPIC "sensor/sound/pico"
+#define MQTT_PAYLOAD_SIZE 768     // Size of a JSON payload (room for the 1/3-octave bands)
+#define MQTT_ALERT_TOPIC "sensor/sound/pico/alert" // Topic of the threshold exceedance alerts
+#ifndef MQTT_PAYLOAD_CBOR
+#define MQTT_PAYLOAD_CBOR 0                 // Encoding of the window records: 0 = JSON, 1 = CBOR (binary, see publish_key_t)
+#endif
+#define MQTT_CBOR_TOPIC "sensor/sound/pico/cbor" // Topic of the window records when they are CBOR-encoded
+#define MQTT_BATCH_MAX_RECORDS 8            // Records packed into one message (JSON array; 1 = one JSON object per message)
+#define MQTT_BATCH_MAX_BYTES 1536           // Byte budget of one message (at least MQTT_PAYLOAD_SIZE + 2; fits MQTT_OUTPUT_RINGBUF_SIZE)
+#define MQTT_BATCH_LINGER_MS 1000           // Longest wait of a queued record for others to share its message
+#define MQTT_INFLIGHT_WINDOW 4              // Record messages waiting for their PUBACK (stored records are released on PUBACK)
+#define MQTT_DRAIN_PERIOD_MS 50             // Period of the backlog drain task (at most one message of saved data per run)
+#define MQTT_PAYLOAD_PREFIX_SLOTS 8         // Sensors whose static JSON fields (id, location) are rendered once at boot
 
 #define MQTT_BROKER "test.mosquitto.org"
 
 //Sensor configuration
-//#define SAMPLE_COUNT 100   // Number of samples to collect from the microphone
 //#define DB_THRESHOLD 70    // Decibel threshold for signal processing or triggering events
-//#define OFFSET 2048       // Offset value for the ADC
-//#define RMS_REFERENCE 1.0 // Reference value for RMS calculation
-//#define MIC_PIN 28        // GPIO pin for the microphone input
-//#define ADC_CHANNEL 2     // ADC channel for the microphone input
+
+//Event detector configuration
+#define EVENT_THRESHOLD_CDB 8500            // Alert threshold (85 dB, in hundredths of dB)
+#define EVENT_HYSTERESIS_CDB 300            // The event ends below threshold - hysteresis (3 dB)
+#define EVENT_MIN_DURATION_MS 500           // Time above the threshold before an alert is raised
+#define EVENT_CAPTURE_SAMPLES 16            // Levels attached before the trigger (start alert) and after it (end alert)
+#define EVENT_ALERT_QUEUE_SIZE 4            // Alerts waiting for the MQTT publisher
+
+//Analog microphone (ADC) configuration
+#define MIC_ADC_ENABLED 0         // 1 = also capture an analog microphone on MIC_PIN (ADC + DMA), published as one more sensor
+#define MIC_SAMPLE_RATE_HZ 16000  // ADC sampling rate (16-48 kHz)
+#define MIC_BLOCK_SIZE 256        // Samples per DMA block (one RMS/dB value per block)
+#define MIC_CHANNEL_COUNT 1       // Output channels computed from the microphone (one sensor index each)
+#define MIC_CHANNEL_WEIGHTINGS { WEIGHTING_A }  // Frequency weighting of each channel: WEIGHTING_Z (none), WEIGHTING_A or WEIGHTING_C
+#define MIC_SPECTRUM_ENABLED 1    // 1 = publish the 1/3-octave band levels of the microphone with the first channel
+#define MIC_FFT_SIZE 1024         // FFT size of the band analysis (256 or 1024, a multiple of MIC_BLOCK_SIZE)
+#define OFFSET 2048       // Offset value for the ADC
+#define RMS_REFERENCE 1.0 // Reference value for RMS calculation (float path only; the integer path folds it into MIC_DB_OFFSET)
+#define MIC_DB_OFFSET 24  // Calibration offset added to the dB value
+#define MIC_PIN 28        // GPIO pin for the microphone input
+#define ADC_CHANNEL 2     // ADC channel for the microphone input
 
 #define UART_ID uart1
 #define BAUD_RATE 9600
 #define UART_TX_PIN 8
 #define UART_RX_PIN 9
+#define MODBUS_RESPONSE_TIMEOUT_MS 200  // Maximum time to wait for a Modbus response
+#define SAMPLE_PERIOD_MS 300            // Sampling period: one polling round of the Modbus bus per period
+#define SAMPLE_CLOCK_HARDWARE_ALARM 2   // Hardware alarm dedicated to the sampling clock (the SDK default pool uses alarm 3)
+#define SAMPLE_RING_SIZE 64             // Sample records queued from core 1 to core 0 (power of two)
 #define MAP_LATITUDE -3.743987 // Latitude of the microphone location-3.7439874257589585, -38.53626710073022
 #define MAP_LONGITUDE -38.536267 // Longitude of the microphone location
 #define SENSOR_ID 1        // Unique identifier for the sensor
 #define GMT_M_3 3         // GMT offset for the sensor location (e.g., GMT-3)
+
+//Noise statistics configuration
+#define NOISE_STATS_MIN_CDB 2000            // Lowest level of the percentile histogram (20 dB, in hundredths of dB)
+#define NOISE_STATS_MAX_CDB 14000           // Highest level of the percentile histogram (140 dB)
+#define NOISE_STATS_BIN_CDB 20              // Histogram resolution (0.2 dB): 600 bins, 2.4 KB per window; 5 windows per sensor (12 KB) plus their checkpoint copy: ~25 KB of SRAM per sensor
+
+//Rollup configuration
+#define ROLLUP_PUBLISH_LEVELS 0x1E          // Published windows, one bit per level: 0x01 = 1 s, 0x02 = 1 min, 0x04 = 15 min, 0x08 = 1 h, 0x10 = 24 h (with Lden)
+#define LDEN_DAY_START_HOUR 7               // Lden day period: 07:00-19:00
+#define LDEN_EVENING_START_HOUR 19          // Lden evening period: 19:00-23:00 (+5 dB)
+#define LDEN_NIGHT_START_HOUR 23            // Lden night period: 23:00-07:00 (+10 dB)
+
+//Noise dose configuration
+#define DOSE_CRITERION_CDB 8500             // Criterion level (NIOSH REL: 85 dB, OSHA PEL: 90 dB)
+#define DOSE_EXCHANGE_RATE_CDB 300          // Exchange rate (NIOSH: 3 dB, OSHA: 5 dB)
+#define DOSE_THRESHOLD_CDB 8000             // Levels below the threshold are not counted (80 dB)
+#define DOSE_CRITERION_HOURS 8              // Exposure time allowed at the criterion level (100% dose)
+#define DOSE_RESET_HOUR 0                   // Local hour at which the dose restarts (start of the day or shift)
+#define DOSE_MAX_GAP_MS 2000                // Longest time credited to one level (acquisition gaps are not counted)
+
+//Checkpoint configuration
+#define CHECKPOINT_RAM_PERIOD_MS 1000       // Period of the copy of the aggregation state in RAM kept across soft resets
+#define CHECKPOINT_FLASH_PERIOD_MS 900000   // Period of the copy in flash kept across power loss (alternates between two files)
+#define CHECKPOINT_FILE_A "ckpt_a.bin"      // Flash copies of the aggregation state
+#define CHECKPOINT_FILE_B "ckpt_b.bin"
+#define SENSOR_RAM_BUDGET_BYTES (128 * 1024) // SRAM for the sensor state and its checkpoint image (5 sensors); lwIP, cyw43 and the stacks need the rest of the 264 KB
+
+//Publish queue configuration
+#define PUBLISH_QUEUE_SIZE 16               // Window records waiting for the MQTT publisher (~110 B each)
+#define PUBLISH_QUEUE_SPILL_DEPTH 12        // Records kept in RAM while the MQTT send buffer is full; older ones go to flash
+#define PUBLISH_QUEUE_PERIOD_MS 100         // Period of the publisher task
+#define PUBLISH_QUEUE_BURST 4               // Messages (or spilled records) handled per run of the publisher (bounds the run time)
+
+//Modbus bus configuration
+#define MODBUS_BUS_MAX_DEVICES 8            // Maximum number of sensors on the RS-485 segment (the SRAM holds fewer, see SENSOR_RAM_BUDGET_BYTES)
+#define MODBUS_BUS_DEVICES { \
+    {0x01, 0x0000, 1},                      /* SM7901 at address 0x01: register 0 = dB x 10 */ \
+}                                           // Sensors polled in round-robin: {Modbus address, first register, register count}
+#define MODBUS_BUS_OFFLINE_AFTER 3          // Consecutive timeouts before a sensor is considered offline
+#define MODBUS_BUS_OFFLINE_RETRY_ROUNDS 10  // Rounds skipped before an offline sensor is polled again
+#define MODBUS_BUS_REPORT_INTERVAL_MS 60000 // Interval between two bus statistics reports
+
+//Modbus baud rate negotiation
+#define MODBUS_BAUD_NEGOTIATION 0           // 1 = switch the sensors to MODBUS_TARGET_BAUD_RATE at startup
+#define MODBUS_TARGET_BAUD_RATE 38400       // Baud rate requested from the sensors (BAUD_RATE is used as fallback)
+#define MODBUS_BAUD_CHECK_READS 5           // Check reads per sensor (and latency samples) at each baud rate
+#define SM7901_BAUD_REGISTER 0x07D1         // SM7901 holding register with the baud rate code
+
+//Scheduler configuration
+#define SCHEDULER_MAX_TASKS 8               // Maximum number of tasks per core
+#define WIFI_CHECK_PERIOD_MS 1000           // Period of the Wi-Fi connection check
+#define MQTT_CHECK_PERIOD_MS 1000           // Period of the MQTT connection check
+#define DISPLAY_UPDATE_PERIOD_MS 200        // Period of the display refresh
+
+//CRC configuration
+#define CRC16_TABLE_IN_RAM 1 // 1 = keep the CRC16 lookup tables in SRAM (no XIP cache misses), 0 = keep them in flash
+#define CRC16_SLICE_BY_4 1   // 1 = slice-by-4 CRC16 (2 KB of tables), 0 = byte-wise CRC16 (512 bytes of table)
+
 //Display configuration
 #define SDA_PIN 14      // GPIO pin for the SDA line of the I2C interface
 #define SCL_PIN 15      // GPIO pin for the SCL line of the I2C interface
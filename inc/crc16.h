@@ -0,0 +1,37 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CRC16_MODBUS_INIT 0xFFFF   // Initial value of the Modbus CRC16
+
+/**
+ * @brief Updates a Modbus CRC16 with a single byte (incremental API).
+ *
+ * @param crc Current CRC value.
+ * @param byte Next received or transmitted byte.
+ * @return The updated CRC value.
+ */
+uint16_t crc16_modbus_update(uint16_t crc, uint8_t byte);
+
+/**
+ * @brief Updates a Modbus CRC16 with a buffer of bytes.
+ *
+ * @param crc Current CRC value.
+ * @param buf Pointer to the data.
+ * @param len Number of bytes.
+ * @return The updated CRC value.
+ */
+uint16_t crc16_modbus_update_buf(uint16_t crc, const uint8_t *buf, size_t len);
+
+/**
+ * @brief Calculates the Modbus CRC16 of a complete buffer.
+ *
+ * @param buf Pointer to the data.
+ * @param len Number of bytes.
+ * @return The CRC16 checksum.
+ */
+uint16_t crc16_modbus(const uint8_t *buf, size_t len);
+
+#endif
@@ -2,7 +2,7 @@
 #define DISPLAY_H
 
 #include "ssd1306.h"  // Library for controlling the SSD1306 OLED display
-#include "inc/mic.h"       // Header file for microphone data structures
+#include "inc/live_state.h" // Header file for the live state snapshots
 
 // External declaration of the SSD1306 display instance
 extern ssd1306_t disp;
@@ -18,9 +18,9 @@ void setup_display();
 /**
  * @brief Updates the OLED display with the microphone's dB value.
  *
- * @param micdata Pointer to a micdata_t structure containing the current
- *                microphone data, including the decibel value to display.
+ * @param live Pointer to a snapshot of the live state of the microphone,
+ *             including the decibel value to display.
  */
-void update_display_db_value(micdata_t *micdata);
+void update_display_db_value(const live_sensor_t *live);
 
 #endif
\ No newline at end of file
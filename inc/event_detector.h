@@ -0,0 +1,91 @@
+#ifndef EVENT_DETECTOR_H
+#define EVENT_DETECTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/config.h"
+#include "inc/measurement.h"
+
+/**
+ * @brief Kind of alert raised by the detector.
+ */
+
+typedef enum {
+    EVENT_START,    ///< Level above the threshold for the minimum duration (samples before the trigger attached)
+    EVENT_END       ///< Level back below threshold - hysteresis (samples after the trigger attached)
+} event_kind_t;
+
+/**
+ * @brief One threshold exceedance, as reported to the callback.
+ */
+
+typedef struct {
+    uint64_t onset_us;                                  ///< First level above the threshold (us since boot)
+    uint64_t trigger_us;                                ///< Level that raised the start alert
+    uint64_t end_us;                                    ///< First level below the release level (end alert only)
+    int16_t threshold_cdB;                              ///< Threshold of the detector
+    int16_t peak_cdB;                                   ///< Highest level so far
+    uint8_t sample_count;                               ///< Number of attached samples
+    measurement_t samples[EVENT_CAPTURE_SAMPLES];       ///< Attached samples, oldest first
+} event_t;
+
+/**
+ * @brief Callback called when an alert is raised.
+ *
+ * @param kind Kind of alert.
+ * @param event Event (only valid during the call).
+ * @param arg User argument of event_detector_add().
+ */
+typedef void (*event_cb_t)(event_kind_t kind, const event_t *event, void *arg);
+
+/**
+ * @brief States of the detector.
+ */
+
+typedef enum {
+    EVENT_IDLE,         ///< Below the threshold
+    EVENT_PENDING,      ///< Above the threshold, minimum duration not reached yet
+    EVENT_ACTIVE,       ///< Start alert raised, waiting for the level to drop
+    EVENT_ENDING        ///< Level dropped, still collecting the samples after the trigger
+} event_state_t;
+
+/**
+ * @brief Threshold exceedance detector of one sensor.
+ *
+ * Keeps the last EVENT_CAPTURE_SAMPLES levels, so the start alert carries the levels
+ * that led to the trigger; the end alert carries the EVENT_CAPTURE_SAMPLES levels that
+ * followed it. No hardware dependency: time comes from the measurement timestamps.
+ */
+
+typedef struct {
+    int16_t threshold_cdB;                              ///< Trigger level
+    int16_t release_cdB;                                ///< End level (threshold - hysteresis)
+    uint32_t min_duration_us;                           ///< Time above the threshold before the start alert
+    event_state_t state;                                ///< Current state
+    measurement_t history[EVENT_CAPTURE_SAMPLES];       ///< Last levels (ring)
+    uint8_t history_head;                               ///< Next slot of the ring
+    uint8_t history_count;                              ///< Levels in the ring
+    event_t event;                                      ///< Current event
+} event_detector_t;
+
+/**
+ * @brief Initializes a detector.
+ *
+ * @param det Detector to initialize.
+ * @param threshold_cdB Trigger level, in hundredths of dB.
+ * @param hysteresis_cdB The event ends when the level drops below threshold - hysteresis.
+ * @param min_duration_us Time the level must stay above the threshold before the start alert.
+ */
+void event_detector_init(event_detector_t *det, int16_t threshold_cdB, int16_t hysteresis_cdB, uint32_t min_duration_us);
+
+/**
+ * @brief Adds one level to the detector.
+ *
+ * @param det Detector.
+ * @param sample Valid measurement of the sensor.
+ * @param cb Callback of the alerts.
+ * @param arg User argument of the callback.
+ */
+void event_detector_add(event_detector_t *det, const measurement_t *sample, event_cb_t cb, void *arg);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef FIXMATH_H
+#define FIXMATH_H
+
+#include <stdint.h>
+
+#define FIX_Q16_ONE 65536      // 1.0 in Q16.16
+
+/**
+ * @brief Computes the base-2 logarithm of an integer.
+ *
+ * @param x Value (must be non-zero).
+ * @return log2(x) in Q16.16 (0 for x == 0).
+ */
+int32_t fix_log2_q16(uint64_t x);
+
+/**
+ * @brief Converts a power ratio given as log2 (Q16.16) to centi-dB.
+ *
+ * @param log2_q16 log2 of the power ratio in Q16.16.
+ * @return 1000 * log10(ratio), i.e. 10 * log10(ratio) in hundredths of dB.
+ */
+int32_t fix_log2_q16_to_cdB(int32_t log2_q16);
+
+/**
+ * @brief Converts a power ratio in centi-dB to log2 (Q16.16).
+ *
+ * @param cdB Power ratio in hundredths of dB.
+ * @return log2 of the power ratio in Q16.16.
+ */
+int32_t fix_cdB_to_log2_q16(int32_t cdB);
+
+/**
+ * @brief Computes 2^x for a Q16.16 exponent.
+ *
+ * @param log2_q16 Exponent in Q16.16 (0 <= x < 62).
+ * @return 2^x rounded down to an integer.
+ */
+uint64_t fix_exp2_q16(int32_t log2_q16);
+
+#endif
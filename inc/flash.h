@@ -1,12 +1,25 @@
 #ifndef FLASH_H
 #define FLASH_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "inc/checkpoint.h"
+
 void init_filesystem();
 
 void initialize_file_counter();
 
-void save_payload_to_flash(const char *payload);
+bool save_payload_to_flash(const void *payload, size_t length);
+
+int flash_drain_step();
+
+void flash_delete_payloads(const int *numbers, uint8_t count);
+
+uint32_t flash_save_checkpoint(const char *name, checkpoint_header_t *header, const uint32_t *payload);
+
+int flash_probe_checkpoint(const char *const names[CHECKPOINT_SLOTS], checkpoint_header_t *header, uint32_t words);
 
-void resend_saved_data();
+int flash_load_checkpoint(const char *const names[CHECKPOINT_SLOTS], checkpoint_header_t *header, uint32_t *payload, uint32_t words);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef LIVE_STATE_H
+#define LIVE_STATE_H
+
+#include <stdint.h>
+#include "hardware/sync.h"  // Hardware spinlock serializing the writers
+#include "inc/measurement.h" // Measurement record
+#include "inc/noise_stats.h" // Window statistics summary
+
+/**
+ * @brief Live measurement state of one sensor (a plain copy, safe to use anywhere).
+ */
+
+typedef struct {
+    measurement_t last;             ///< Last valid measurement
+    noise_stats_summary_t summary;  ///< Statistics of the last closed window (hundredths of dB)
+    uint32_t window_s;              ///< Length of the last closed window, in seconds (0 before the first one)
+} live_sensor_t;
+
+/**
+ * @brief Seqlock-published live state of one sensor.
+ *
+ * The sequence is odd while a write is in progress. Readers copy the data and retry if
+ * the sequence was odd or changed, so they never block the writer; writers (from either
+ * core) are serialized by a hardware spinlock.
+ */
+
+typedef struct {
+    volatile uint32_t sequence;     ///< Incremented before and after each write
+    live_sensor_t data;             ///< Published state
+    spin_lock_t *lock;              ///< Hardware spinlock of the writers
+} live_state_t;
+
+/**
+ * @brief Initializes a live state.
+ *
+ * @param state State to initialize.
+ * @param lock Hardware spinlock of the writers (may be shared by several states).
+ */
+void live_state_init(live_state_t *state, spin_lock_t *lock);
+
+/**
+ * @brief Publishes a new live state.
+ *
+ * @param state State to write.
+ * @param data New content.
+ */
+void live_state_write(live_state_t *state, const live_sensor_t *data);
+
+/**
+ * @brief Takes a consistent copy of a live state.
+ *
+ * @param state State to read.
+ * @param data Pointer where the copy is stored.
+ * @return Number of retries needed (0 if no write overlapped the read).
+ */
+uint32_t live_state_read(const live_state_t *state, live_sensor_t *data);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef MEASUREMENT_H
+#define MEASUREMENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MEASUREMENT_FLAG_ADC 0x01       // Level of the analog microphone (not a Modbus sensor)
+#define MEASUREMENT_FLAG_INVALID 0x02   // Failed reading: the level is not valid (the bus counts the cause)
+
+#define MEASUREMENT_COORD_E6(degrees) ((int32_t)((degrees) * 1000000.0 + ((degrees) < 0 ? -0.5 : 0.5)))   // Degrees to micro-degrees (compile time)
+
+/**
+ * @brief One sound level measurement, as it flows from the acquisition to the statistics.
+ *
+ * Fixed-point only (no FPU on the RP2040). Packed to 12 bytes but kept 4-byte aligned,
+ * so the 64-bit timestamp is read with two word loads.
+ */
+
+typedef struct __attribute__((packed, aligned(4))) {
+    uint64_t timestamp_us;          ///< Acquisition time (us since boot)
+    int16_t level_cdB;              ///< Sound level in hundredths of dB
+    uint8_t sensor;                 ///< Sensor index (Modbus bus first, then the analog microphone channels)
+    uint8_t flags;                  ///< MEASUREMENT_FLAG_* bits
+} measurement_t;
+
+/**
+ * @brief Static configuration of one sensor (set once at startup).
+ */
+
+typedef struct {
+    uint8_t sensor_id;              ///< Unique identifier of the sensor
+    bool spectrum;                  ///< Publishes the 1/3-octave spectrum of the analog microphone
+    int32_t latitude_e6;            ///< Latitude of the sensor location, in micro-degrees
+    int32_t longitude_e6;           ///< Longitude of the sensor location, in micro-degrees
+    int16_t event_threshold_cdB;    ///< Alert threshold, in hundredths of dB
+    int16_t event_hysteresis_cdB;   ///< The alert ends below threshold - hysteresis
+    uint32_t event_min_duration_ms; ///< Time above the threshold before an alert is raised
+} sensor_config_t;
+
+/**
+ * @brief Formats a fixed-point value as a decimal string.
+ *
+ * @param buffer Buffer receiving the string.
+ * @param size Size of the buffer.
+ * @param value Value in units of 10^-decimals (e.g. hundredths of dB with decimals = 2).
+ * @param decimals Number of decimal places (1 to 6).
+ * @return Length of the string (as snprintf).
+ */
+int measurement_format_fixed(char *buffer, size_t size, int32_t value, uint8_t decimals);
+
+#endif
@@ -4,54 +4,105 @@
 #include "pico/stdlib.h"   // Standard library for Raspberry Pi Pico
 #include "hardware/uart.h"  // Hardware UART library for Raspberry Pi Pico
 #include "inc/config.h"
+#include "inc/modbus_rtu.h" // Modbus RTU frame receiver
+#include "inc/spectrum.h"   // 1/3-octave spectrum analyzer
+#include "inc/noise_stats.h" // Leq and percentile statistics
+#include "inc/rollup.h"      // 1 s / 1 min / 15 min / 1 h / 24 h windows
+#include "inc/measurement.h" // Fixed-point measurement record and sensor configuration
+#include "inc/event_detector.h" // Threshold exceedance alerts
+#include "inc/noise_dose.h"  // Occupational noise dose and TWA
 
 /**
  * @brief Structure to hold microphone data.
  *
- * This structure stores raw samples from the microphone and the calculated
- * decibel (dB) value.
+ * This structure stores the last measurement of one sensor and the statistics of
+ * its last closed window, all in fixed point (hundredths of dB). The static settings
+ * of the sensor (identifier, location) live in its sensor_config_t.
  */
 
 typedef struct {
-    uint8_t sensor_id;        ///< Unique identifier for the sensor
-    //uint16_t samples[SAMPLE_COUNT];  ///< Array to store raw microphone samples
-    float dB;                ///< Calculated decibel level from the samples
-    float average;                     ///< Average decibel level
-    float maxdB;                       ///< Maximum decibel level
-    float mindB;                       ///< Minimum decibel level
-    float latitude;                    ///< Latitude of the microphone location
-    float longitude;                   ///< Longitude of the microphone location
-
-    uint8_t device_address;
-    uint16_t start_address;
-    uint16_t num_registers;
-    uint8_t response[7];
-    
+    const sensor_config_t *config;     ///< Static configuration of the sensor
+    measurement_t last;                ///< Last valid measurement
+    noise_stats_summary_t summary;     ///< Statistics of the last window (mean, Leq, min, max, L10/L50/L90/L95)
+    int32_t lden_cdB;                  ///< Day-evening-night level (24 h window only)
+    uint32_t window_s;                 ///< Length of the last window, in seconds
+
+    rollup_t rollup;                   ///< Statistics windows of every length (constant size)
+    event_detector_t event;            ///< Threshold exceedance detector
+    noise_dose_t dose;                 ///< Running noise dose (saved in flash)
+    uint32_t dose_percent_c;           ///< Dose at the end of the last window, in hundredths of percent
+    int32_t twa_cdB;                   ///< TWA at the end of the last window, in hundredths of dB
+
+    uint8_t band_count;                ///< Number of 1/3-octave bands of the last window
+    int8_t first_band;                 ///< Band number of the first band (0 = 1 kHz)
+    int16_t band_cdB[SPECTRUM_MAX_BANDS]; ///< 1/3-octave band levels of the last window (Leq, hundredths of dB)
 } micdata_t;
 
 /**
  * @brief Initializes the microphone.
  *
- * This function configures the necessary hardware and settings to start
- * collecting data from the microphone.
+ * This function configures the ADC and the DMA ping-pong capture of the analog
+ * microphone (only built when MIC_ADC_ENABLED is set).
  */
-//void setup_mic();
+void setup_mic();
 
 /**
- * @brief Collects samples from the microphone.
+ * @brief Returns the last complete block of microphone samples.
  *
- * This function reads SAMPLE_COUNT values from the microphone and stores
- * them in the micdata structure for further processing.
+ * @param samples Pointer where the address of the block is stored.
+ * @param start_us Pointer where the acquisition time of the first sample is stored.
+ * @return true if a block is ready, false otherwise.
+ */
+bool mic_get_block(const uint16_t **samples, uint32_t *start_us);
+
+/**
+ * @brief Releases the block returned by mic_get_block().
  */
-//void collect_samples();
+void mic_release_block();
 
 /**
- * @brief Converts raw microphone samples to decibel (dB) values.
+ * @brief Returns the number of blocks lost because they were not processed in time.
+ */
+uint32_t mic_get_overruns();
+
+/**
+ * @brief Computes the level of every microphone output channel for one block.
  *
- * @param micdata Pointer to the micdata_t structure containing the samples.
+ * @param samples Pointer to the block of ADC samples (MIC_BLOCK_SIZE samples).
+ * @param levels_cdB Array of MIC_CHANNEL_COUNT levels, in hundredths of dB.
+ *
+ * Each channel runs its own weighting filter (MIC_CHANNEL_WEIGHTINGS) on the block
+ * before the RMS; the filter state carries over between blocks.
+ */
+void mic_block_levels(const uint16_t *samples, int32_t *levels_cdB);
+
+/**
+ * @brief Adds one block of microphone samples to the 1/3-octave band analysis.
+ *
+ * @param samples Pointer to the block of ADC samples (MIC_BLOCK_SIZE samples).
+ *
+ * Runs on core 1. An FFT of MIC_FFT_SIZE samples is computed every
+ * MIC_FFT_SIZE / MIC_BLOCK_SIZE blocks and its band energies are accumulated.
+ */
+void mic_block_spectrum(const uint16_t *samples);
+
+/**
+ * @brief Moves the band levels accumulated since the last call into micdata.
+ *
+ * @param micdata Pointer to the micdata_t structure receiving the band levels.
+ *
+ * Runs on core 0 when a window is closed; the band levels are the Leq of the window.
+ */
+void mic_spectrum_take(micdata_t *micdata);
+
+/**
+ * @brief Converts a block of raw microphone samples to a decibel (dB) value.
+ *
+ * @param samples Pointer to the block of ADC samples.
  * @param n_samples Number of samples to process for dB calculation.
+ * @return The sound level of the block in hundredths of dB.
  */
-//void digital_to_dB(micdata_t *micdata, uint8_t n_samples);
+int32_t digital_to_cdB(const uint16_t *samples, uint32_t n_samples);
 
 /**
  * @brief Calculates the average decibel level from the microphone samples.
@@ -61,14 +112,34 @@ typedef struct {
 
 void uart_modbus_config();
 
+void modbus_set_baud_rate(uint32_t baud_rate);
+
+void modbus_rx_service();
+
+absolute_time_t modbus_rx_wakeup_time(absolute_time_t fallback);
+
 uint16_t modbus_crc16(uint8_t *buf, int len);
 
+void modbus_send_frame(const uint8_t *frame, uint16_t length);
+
+bool modbus_poll_frame(uint8_t *frame, uint16_t *length, bool *crc_ok);
+
+bool modbus_transaction(const uint8_t *request, uint16_t request_length,
+                        uint8_t *frame, uint16_t *frame_length, bool *crc_ok, uint32_t *latency_us);
+
 void modbus_read_registers(uint8_t device_address, uint16_t start_address, uint16_t num_registers);
 
-bool modbus_read_response(uint8_t *response, int length);
+modbus_status_t modbus_read_response(uint8_t *response, uint16_t *length, uint8_t device_address);
 
-uint16_t parse_decibel_value(uint8_t *response);
+modbus_status_t parse_decibel_value(const uint8_t *response, modbus_status_t status, uint16_t *value);
 
 void get_media_min_max_dB(micdata_t *micdata);
 
+/**
+ * @brief Runs the threshold exceedance detector of a sensor on its last measurement.
+ *
+ * @param micdata Pointer to the micdata_t structure of the sensor.
+ */
+void detect_events(micdata_t *micdata);
+
 #endif
\ No newline at end of file
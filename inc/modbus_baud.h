@@ -0,0 +1,46 @@
+#ifndef MODBUS_BAUD_H
+#define MODBUS_BAUD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/modbus_bus.h"
+
+/**
+ * @brief Blocking Modbus link used by the baud rate negotiation.
+ *
+ * The negotiation only talks to the hardware through these callbacks, so it can be run
+ * against an emulated slave on a host.
+ */
+typedef struct {
+    /**
+     * @brief Sends a request and waits for the next frame.
+     *
+     * @return false on timeout; otherwise frame, frame_length, crc_ok and latency_us are set.
+     */
+    bool (*transact)(void *ctx, const uint8_t *request, uint16_t request_length,
+                     uint8_t *frame, uint16_t *frame_length, bool *crc_ok, uint32_t *latency_us);
+
+    /**
+     * @brief Reconfigures the UART (and the RTU timings) to a new baud rate.
+     */
+    void (*set_baud)(void *ctx, uint32_t baud_rate);
+
+    void *ctx;    ///< Argument passed to both callbacks
+} modbus_link_t;
+
+/**
+ * @brief Outcome of the baud rate negotiation.
+ */
+typedef struct {
+    uint32_t baud_rate;          ///< Baud rate in use after the negotiation
+    bool switched;               ///< true if the bus now runs at the target baud rate
+    modbus_latency_t before;     ///< Check read latency at the initial baud rate
+    modbus_latency_t after;      ///< Check read latency at the target baud rate
+} modbus_baud_result_t;
+
+int32_t sm7901_baud_code(uint32_t baud_rate);
+
+modbus_baud_result_t modbus_baud_negotiate(const modbus_link_t *link, const modbus_bus_device_cfg_t *devices,
+                                           uint8_t device_count, uint32_t current_baud, uint32_t target_baud);
+
+#endif
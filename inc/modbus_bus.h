@@ -0,0 +1,122 @@
+#ifndef MODBUS_BUS_H
+#define MODBUS_BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/config.h"
+#include "inc/modbus_rtu.h"
+
+#define MODBUS_BUS_MAX_REGISTERS 8    // Maximum number of registers read from one slave per poll
+
+/**
+ * @brief Transaction latency statistics (request start to response completion).
+ */
+typedef struct {
+    uint32_t count;       ///< Transactions measured
+    uint32_t min_us;      ///< Shortest latency
+    uint32_t max_us;      ///< Longest latency
+    uint64_t sum_us;      ///< Sum of the latencies (for the mean)
+} modbus_latency_t;
+
+/**
+ * @brief Static description of one slave on the RS-485 segment.
+ */
+typedef struct {
+    uint8_t device_address;       ///< Modbus address of the slave
+    uint16_t start_address;       ///< First holding register to read
+    uint16_t num_registers;       ///< Number of registers to read (at most MODBUS_BUS_MAX_REGISTERS)
+} modbus_bus_device_cfg_t;
+
+/**
+ * @brief Runtime state and counters of one slave.
+ */
+typedef struct {
+    modbus_bus_device_cfg_t cfg;                   ///< Slave configuration
+    uint16_t registers[MODBUS_BUS_MAX_REGISTERS];  ///< Register values of the last valid response
+    uint32_t last_request_us;                      ///< Time at which the last request was sent (sample acquisition time)
+    uint32_t last_response_us;                     ///< Time at which the last valid response was completed
+    uint32_t polls;                                ///< Requests sent to this slave
+    uint32_t responses;                            ///< Valid responses received
+    uint32_t timeouts;                             ///< Requests left without a response
+    uint32_t crc_errors;                           ///< Responses from which no valid frame could be recovered
+    uint32_t exceptions;                           ///< Exception responses (function | 0x80)
+    uint32_t resyncs;                              ///< Valid responses recovered from a corrupted frame
+    uint32_t errors;                               ///< Unexpected responses (wrong address, function or size)
+    uint8_t last_exception;                        ///< Code of the last exception response
+    modbus_status_t last_status;                   ///< Status of the last transaction
+    uint8_t consecutive_timeouts;                  ///< Timeouts since the last valid response
+    uint8_t skip_rounds;                           ///< Rounds left before an offline slave is polled again
+} modbus_bus_device_t;
+
+/**
+ * @brief Callback used to transmit a request frame.
+ */
+typedef void (*modbus_bus_send_t)(const uint8_t *frame, uint16_t length, void *arg);
+
+/**
+ * @brief Callback invoked at the end of every transaction (one measurement stream per slave).
+ *
+ * @param index Index of the slave in the bus table.
+ * @param device Slave state; the register values are only valid when status is MODBUS_STATUS_OK.
+ * @param status Result of the transaction.
+ * @param arg User-defined argument.
+ */
+typedef void (*modbus_bus_sample_cb_t)(uint8_t index, const modbus_bus_device_t *device, modbus_status_t status, void *arg);
+
+/**
+ * @brief States of the bus scheduler.
+ */
+typedef enum {
+    MODBUS_BUS_IDLE,              ///< Round finished, waiting for modbus_bus_start_round()
+    MODBUS_BUS_WAIT_RESPONSE      ///< Request sent, waiting for the response or the timeout
+} modbus_bus_state_t;
+
+/**
+ * @brief Round-robin Modbus master for several slaves sharing one UART.
+ *
+ * The scheduler has no hardware dependency: requests go out through the send callback,
+ * responses come in through modbus_bus_on_frame() and time is given by the caller.
+ * Rounds are started by the caller (e.g. on every tick of the sampling clock).
+ */
+typedef struct {
+    modbus_bus_device_t devices[MODBUS_BUS_MAX_DEVICES];   ///< Slave table
+    uint8_t device_count;                                  ///< Number of slaves in the table
+    uint8_t current;                                       ///< Slave being polled in the current round
+    modbus_bus_state_t state;                              ///< Scheduler state
+    uint32_t request_us;                                   ///< Time at which the pending request was sent
+    uint32_t response_timeout_us;                          ///< Time allowed for a response after the request
+    uint32_t rounds;                                       ///< Rounds started
+
+    modbus_latency_t latency;                              ///< Latency of the successful transactions
+
+    uint32_t rate_window_start_us;                         ///< Start of the poll rate measurement window
+    uint32_t rate_window_responses;                        ///< Valid responses in the measurement window
+
+    modbus_bus_send_t send;                                ///< Transmit callback
+    modbus_bus_sample_cb_t on_sample;                      ///< Sample callback
+    void *cb_arg;                                          ///< Argument of both callbacks
+} modbus_bus_t;
+
+void modbus_bus_init(modbus_bus_t *bus, const modbus_bus_device_cfg_t *devices, uint8_t device_count,
+                     uint32_t response_timeout_us,
+                     modbus_bus_send_t send, modbus_bus_sample_cb_t on_sample, void *cb_arg, uint32_t now_us);
+
+bool modbus_bus_start_round(modbus_bus_t *bus, uint32_t now_us);
+
+bool modbus_bus_busy(const modbus_bus_t *bus);
+
+void modbus_bus_poll(modbus_bus_t *bus, uint32_t now_us);
+
+void modbus_bus_on_frame(modbus_bus_t *bus, const uint8_t *frame, uint16_t length, bool crc_ok, uint32_t now_us);
+
+uint32_t modbus_bus_next_event_us(const modbus_bus_t *bus, uint32_t now_us);
+
+uint32_t modbus_bus_take_poll_rate(modbus_bus_t *bus, uint32_t now_us);
+
+void modbus_latency_reset(modbus_latency_t *latency);
+
+void modbus_latency_add(modbus_latency_t *latency, uint32_t latency_us);
+
+uint32_t modbus_latency_mean_us(const modbus_latency_t *latency);
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef MODBUS_RTU_H
+#define MODBUS_RTU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MODBUS_RTU_MAX_FRAME 256   // Maximum size of a Modbus RTU frame (address + PDU + CRC)
+#define MODBUS_RTU_MIN_FRAME 4     // Smallest valid frame: address + function + CRC
+#define MODBUS_RTU_READ_REQUEST_SIZE 8   // Size of a "read holding registers" request
+#define MODBUS_FC_READ_HOLDING_REGISTERS 0x03
+#define MODBUS_FC_WRITE_SINGLE_REGISTER 0x06
+#define MODBUS_RTU_WRITE_REQUEST_SIZE 8  // Size of a "write single register" request (and of its echo response)
+#define MODBUS_FC_EXCEPTION_FLAG 0x80    // Set in the function code of an exception response
+#define MODBUS_RTU_EXCEPTION_SIZE 5      // Exception response: address + function + code + CRC
+
+/**
+ * @brief Result of a Modbus transaction.
+ */
+typedef enum {
+    MODBUS_STATUS_OK = 0,          ///< Valid response, value available
+    MODBUS_STATUS_PENDING,         ///< No response received yet
+    MODBUS_STATUS_TIMEOUT,         ///< No response before the timeout
+    MODBUS_STATUS_CRC_ERROR,       ///< Response received but no valid frame could be recovered
+    MODBUS_STATUS_EXCEPTION,       ///< The slave answered with an exception response
+    MODBUS_STATUS_BAD_RESPONSE     ///< Valid CRC but unexpected address, function or size
+} modbus_status_t;
+
+/**
+ * @brief Modbus exception codes returned by a slave (function | 0x80).
+ */
+typedef enum {
+    MODBUS_EXCEPTION_ILLEGAL_FUNCTION = 0x01,
+    MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS = 0x02,
+    MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE = 0x03,
+    MODBUS_EXCEPTION_SLAVE_DEVICE_FAILURE = 0x04,
+    MODBUS_EXCEPTION_ACKNOWLEDGE = 0x05,
+    MODBUS_EXCEPTION_SLAVE_DEVICE_BUSY = 0x06
+} modbus_exception_t;
+
+/**
+ * @brief Response located inside a received frame by modbus_rtu_parse_response().
+ */
+typedef struct {
+    modbus_status_t status;        ///< Result of the parsing
+    uint16_t offset;               ///< Offset of the response inside the frame (non-zero after a resync)
+    uint16_t length;               ///< Length of the response, CRC included
+    uint8_t exception_code;        ///< Exception code when status is MODBUS_STATUS_EXCEPTION
+    bool resynced;                 ///< true if the response had to be recovered from a corrupted frame
+} modbus_rtu_response_t;
+
+/**
+ * @brief States of the Modbus RTU receive state machine.
+ */
+typedef enum {
+    MODBUS_RTU_IDLE,          ///< Bus silent for at least t3.5, waiting for the first byte of a frame
+    MODBUS_RTU_RECEIVING,     ///< Receiving the bytes of a frame
+    MODBUS_RTU_DISCARDING     ///< Frame invalidated (t1.5 violation or overflow), waiting for t3.5 of silence
+} modbus_rtu_state_t;
+
+/**
+ * @brief Callback invoked when a frame is delimited by the t3.5 inter-frame gap.
+ *
+ * @param frame Pointer to the frame bytes (address first, CRC last).
+ * @param length Number of bytes in the frame.
+ * @param crc_ok true if the CRC of the frame is valid.
+ * @param arg User-defined argument given to modbus_rtu_rx_init().
+ */
+typedef void (*modbus_rtu_frame_cb_t)(const uint8_t *frame, uint16_t length, bool crc_ok, void *arg);
+
+/**
+ * @brief Modbus RTU receiver.
+ *
+ * This structure holds the frame being assembled, the running CRC and the character
+ * timings derived from the baud rate. It has no hardware dependency: bytes and their
+ * arrival timestamps are fed by the caller, so it can run on a host as well.
+ */
+typedef struct {
+    uint8_t frame[MODBUS_RTU_MAX_FRAME];   ///< Frame being received
+    uint16_t length;                       ///< Number of bytes received in the current frame
+    uint16_t crc;                          ///< Running CRC of the current frame (0 when the frame is valid)
+    modbus_rtu_state_t state;              ///< Current receiver state
+    uint32_t last_byte_us;                 ///< Arrival time of the last byte
+    uint32_t t15_us;                       ///< Maximum silence allowed between bytes of a frame
+    uint32_t t35_us;                       ///< Silence that delimits two frames
+    modbus_rtu_frame_cb_t on_frame;        ///< Called for every delimited frame
+    void *cb_arg;                          ///< Argument passed to on_frame
+
+    uint32_t frames_ok;                    ///< Frames delivered with a valid CRC
+    uint32_t frames_bad_crc;               ///< Frames delivered with an invalid CRC
+    uint32_t frames_discarded;             ///< Frames dropped by t1.5 violation or overflow
+} modbus_rtu_rx_t;
+
+void modbus_rtu_rx_init(modbus_rtu_rx_t *rx, uint32_t baud_rate, modbus_rtu_frame_cb_t on_frame, void *cb_arg);
+
+void modbus_rtu_rx_set_baud(modbus_rtu_rx_t *rx, uint32_t baud_rate);
+
+void modbus_rtu_rx_feed(modbus_rtu_rx_t *rx, uint8_t byte, uint32_t now_us);
+
+bool modbus_rtu_rx_poll(modbus_rtu_rx_t *rx, uint32_t now_us);
+
+uint16_t modbus_rtu_build_read_request(uint8_t *frame, uint8_t device_address, uint16_t start_address, uint16_t num_registers);
+
+uint16_t modbus_rtu_build_write_register(uint8_t *frame, uint8_t device_address, uint16_t register_address, uint16_t value);
+
+uint32_t modbus_rtu_frame_time_us(uint16_t length, uint32_t baud_rate);
+
+modbus_rtu_response_t modbus_rtu_parse_response(const uint8_t *frame, uint16_t length, bool crc_ok,
+                                                uint8_t device_address, uint8_t function, uint16_t expected_length);
+
+#endif
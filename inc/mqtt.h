@@ -2,9 +2,68 @@
 #define MQTT_H
 
 #include "inc/mic.h"           // Header for microphone data structures
+#include "inc/publish_queue.h" // Queue between the aggregation and the publisher
+#include "inc/publish_tracker.h" // QoS 1 messages waiting for their PUBACK
+#include "inc/event_detector.h" // Threshold exceedance events
 #include "lwip/apps/mqtt.h"    // LWIP MQTT client library
+#include "lwip/apps/mqtt_priv.h" // MQTT client structure (TCP connection of the client)
+
+/**
+ * @brief Threshold exceedance alert waiting to be published.
+ */
+typedef struct {
+    uint64_t detected_us;               ///< Time at which the detector raised the alert (for the latency)
+    datetime_t time;                    ///< RTC time of the detection
+    const sensor_config_t *config;      ///< Static configuration of the sensor
+    event_kind_t kind;                  ///< Start or end of the event
+    event_t event;                      ///< Event with its attached levels
+} alert_record_t;
+
+/**
+ * @brief Queue of alerts, published ahead of the window records (core 0 only).
+ */
+typedef struct {
+    alert_record_t records[EVENT_ALERT_QUEUE_SIZE];   ///< Record storage
+    uint8_t head;                                     ///< Index of the oldest alert
+    uint8_t count;                                    ///< Alerts waiting
+    uint32_t raised;                                  ///< Alerts raised by the detectors
+    uint32_t sent;                                    ///< Alerts handed to the MQTT client
+    uint32_t dropped;                                 ///< Alerts lost (queue full or publish error)
+    uint32_t latency_min_us;                          ///< Shortest detection-to-publish latency
+    uint32_t latency_max_us;                          ///< Longest detection-to-publish latency
+    uint64_t latency_sum_us;                          ///< Sum of the detection-to-publish latencies (for the mean)
+} alert_queue_t;
+
+/**
+ * @brief Statistics of the record messages (window records and records resent from flash).
+ */
+typedef struct {
+    uint32_t messages;                  ///< Messages handed to the MQTT client
+    uint32_t records;                   ///< Records carried by these messages
+    uint64_t bytes;                     ///< Payload bytes of these messages
+    uint8_t max_records;                ///< Most records carried by one message
+} publish_batch_stats_t;
+
+/**
+ * @brief Statistics of the backlog drain (data saved to flash while offline).
+ */
+typedef struct {
+    uint8_t window;                     ///< Messages of saved data allowed in flight (adapted to the PUBACKs)
+    uint32_t files_sent;                ///< Saved files handed to the MQTT client
+    uint32_t files_acked;               ///< Saved files acknowledged by the broker (deleted)
+    uint32_t refused;                   ///< Drain steps refused by the MQTT client (send buffer full)
+    uint64_t active_us;                 ///< Time spent with a backlog to drain (for the throughput)
+    uint32_t live_records;              ///< Live records acknowledged during the drain
+    uint32_t live_latency_max_us;       ///< Longest queue-to-PUBACK latency of these records
+    uint64_t live_latency_sum_us;       ///< Sum of these latencies (for the mean)
+} backlog_stats_t;
 
 extern mqtt_client_t *global_mqtt_client; // Declare the global MQTT client
+extern publish_queue_t publish_queue;     // Window records waiting for the publisher
+extern alert_queue_t alert_queue;         // Alerts waiting for the publisher
+extern publish_batch_stats_t publish_batch_stats; // Batching of the record messages
+extern publish_tracker_t publish_tracker; // Record messages waiting for their PUBACK
+extern backlog_stats_t backlog_stats;     // Drain of the data saved to flash
 
 static void dns_function_callback(const char *name, const ip_addr_t *ipaddr, void *callback_arg);
 void resolve_broker_dns(ip_addr_t *broker_ip);
@@ -30,15 +89,70 @@ void mqtt_connection_cb(mqtt_client_t *client, void *arg, mqtt_connection_status
 void start_mqtt_client(void);
 
 /**
- * @brief Publishes the microphone dB value to the MQTT broker.
+ * @brief Renders the static JSON fields of the sensors (identifier and location) once.
  *
- * This function takes the decibel value from the micdata structure and sends it
- * to a predefined MQTT topic, enabling remote monitoring or data logging.
+ * The window payloads then only format their values; call after the sensor configuration is set.
  *
- * @param micdata Pointer to the micdata_t structure containing the current dB value.
+ * @param configs Static configuration of the sensors.
+ * @param count Number of sensors.
+ */
+void mqtt_payload_init(const sensor_config_t *configs, uint8_t count);
+
+/**
+ * @brief Queues the microphone window statistics for the MQTT broker.
+ *
+ * This function copies the statistics of the closed window from the micdata structure
+ * into the publish queue; mqtt_publisher_service() sends them later.
+ *
+ * @param micdata Pointer to the micdata_t structure containing the window statistics.
  */
 void publish_db_to_mqtt(micdata_t *micdata);
 
+/**
+ * @brief Queues a threshold exceedance alert for the MQTT broker.
+ *
+ * @param config Static configuration of the sensor.
+ * @param kind Start or end of the event.
+ * @param event Event with its attached levels.
+ */
+void publish_alert_to_mqtt(const sensor_config_t *config, event_kind_t kind, const event_t *event);
+
+/**
+ * @brief Publishes the queued alerts to the MQTT alert topic.
+ *
+ * This function is polled on every pass of the core 0 scheduler, so an alert is sent
+ * as soon as it is raised. Alerts wait in the queue while the broker is unreachable.
+ */
+void mqtt_alert_service(void);
+
+/**
+ * @brief Publishes a batch of records to the MQTT record topic (QoS 1).
+ *
+ * @param batch Batch of formatted records (not empty).
+ * @param files Numbers of the flash files of the records, or NULL for the publish queue records.
+ * @return Result of mqtt_publish(), or ERR_MEM if the in-flight window is full. On success
+ *         the message is tracked until its PUBACK and the batch statistics are updated.
+ */
+err_t mqtt_publish_batch(publish_batch_t *batch, const int *files);
+
+/**
+ * @brief Publishes the queued records to the MQTT broker.
+ *
+ * This function packs the queued records into batches and sends a bounded number of them. Records that cannot be sent
+ * (broker unreachable, or send buffer full for too long) are saved to flash. Queued records and
+ * saved files are only released once the broker acknowledges them (PUBACK).
+ */
+void mqtt_publisher_service(void);
+
+/**
+ * @brief Sends the next part of the data saved to flash (backlog drain).
+ *
+ * This function sends at most one message per call, only when no live record is waiting,
+ * the TCP send buffer has room and the PUBACKs of the previous messages keep coming: the
+ * number of backlog messages in flight grows by one per PUBACK and halves on a failure.
+ */
+void mqtt_backlog_service(void);
+
 /**
  * @brief Checks the MQTT connection status and attempts to reconnect if necessary.
  *
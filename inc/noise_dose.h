@@ -0,0 +1,66 @@
+#ifndef NOISE_DOSE_H
+#define NOISE_DOSE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Dose criterion (NIOSH: 85 dB / 3 dB, OSHA: 90 dB / 5 dB).
+ */
+
+typedef struct {
+    int32_t criterion_cdB;      ///< Criterion level, in hundredths of dB
+    int32_t exchange_cdB;       ///< Exchange rate, in hundredths of dB
+    int32_t threshold_cdB;      ///< Levels below the threshold are not counted
+    uint32_t criterion_s;       ///< Exposure time allowed at the criterion level (multiple of 10 s)
+    uint32_t reset_hour;        ///< Local hour at which the dose restarts
+    uint32_t max_gap_us;        ///< Longest time credited to one level
+} noise_dose_params_t;
+
+/**
+ * @brief Running noise dose of one sensor.
+ *
+ * Each level L held for dt adds dt * 2^((L - criterion) / exchange) to the weighted
+ * exposure, so the dose is weighted / criterion_s and the TWA follows from its log2.
+ * A zero-initialized structure is ready to use; everything but last_us can be saved
+ * and restored across reboots.
+ */
+
+typedef struct {
+    uint64_t weighted_ms_q12;   ///< Sum of dt (ms) * 2^((L - criterion) / exchange), Q12 (saturates)
+    uint32_t exposure_s;        ///< Time measured since the dose restarted
+    uint32_t exposure_ms;       ///< Milliseconds of exposure not yet carried into exposure_s
+    uint32_t day;               ///< Local day (from the reset hour) of the dose
+    uint64_t last_us;           ///< Time of the previous level (us since boot, 0 = none)
+} noise_dose_t;
+
+/**
+ * @brief Adds one level to the dose, in constant time.
+ *
+ * @param dose Dose to update.
+ * @param params Dose criterion.
+ * @param timestamp_us Acquisition time of the level (us since boot).
+ * @param local_us Local time of the level (us since 1970-01-01 local).
+ * @param level_cdB Sound level in hundredths of dB.
+ */
+void noise_dose_add(noise_dose_t *dose, const noise_dose_params_t *params, uint64_t timestamp_us, uint64_t local_us, int32_t level_cdB);
+
+/**
+ * @brief Returns the dose since the last restart.
+ *
+ * @param dose Dose.
+ * @param params Dose criterion.
+ * @return Dose in hundredths of percent (10000 = 100%, saturates at UINT32_MAX).
+ */
+uint32_t noise_dose_percent_c(const noise_dose_t *dose, const noise_dose_params_t *params);
+
+/**
+ * @brief Returns the time-weighted average level of the dose.
+ *
+ * @param dose Dose.
+ * @param params Dose criterion.
+ * @return TWA over the criterion time in hundredths of dB (0 if the dose is 0).
+ */
+int32_t noise_dose_twa_cdB(const noise_dose_t *dose, const noise_dose_params_t *params);
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef NOISE_STATS_H
+#define NOISE_STATS_H
+
+#include <stdint.h>
+#include "inc/config.h"
+
+#define NOISE_STATS_BINS ((NOISE_STATS_MAX_CDB - NOISE_STATS_MIN_CDB) / NOISE_STATS_BIN_CDB)
+#define NOISE_STATS_ENERGY_FRAC_BITS 8      // Fractional bits of the linear energy of one level
+#define NOISE_STATS_MAX_LEVEL_CDB 15000     // Levels are clamped to 0..150 dB (energy below 2^58)
+
+/**
+ * @brief Sum of the linear energies of a sequence of sound levels.
+ *
+ * The sum is a 64-bit mantissa with a shared exponent, so it never overflows.
+ * A zero-initialized structure is an empty sum.
+ */
+
+typedef struct {
+    uint64_t sum;                           ///< Sum of the linear energies, divided by 2^shift
+    uint8_t shift;                          ///< Exponent of the sum
+    uint32_t count;                         ///< Number of levels added
+} noise_energy_t;
+
+/**
+ * @brief Streaming statistics of a sequence of sound levels.
+ *
+ * The memory use is constant: the linear energy is kept in a noise_energy_t and the
+ * distribution in a fixed histogram of centi-dB bins. Two windows can be merged, so
+ * longer windows are built from shorter ones without the raw levels.
+ * A zero-initialized structure is an empty window.
+ */
+
+typedef struct {
+    noise_energy_t energy;                  ///< Linear energy (and number) of the levels
+    int64_t sum_cdB;                        ///< Sum of the levels (arithmetic mean)
+    int32_t min_cdB;                        ///< Lowest level added
+    int32_t max_cdB;                        ///< Highest level added
+    uint32_t histogram[NOISE_STATS_BINS];   ///< Count of levels per NOISE_STATS_BIN_CDB bin
+} noise_stats_t;
+
+/**
+ * @brief Summary of a window, all levels in hundredths of dB.
+ */
+
+typedef struct {
+    uint32_t count;     ///< Number of levels in the window
+    int32_t mean_cdB;   ///< Arithmetic mean of the levels
+    int32_t leq_cdB;    ///< Equivalent continuous level (energy mean)
+    int32_t min_cdB;    ///< Lowest level
+    int32_t max_cdB;    ///< Highest level
+    int32_t l10_cdB;    ///< Level exceeded 10% of the time
+    int32_t l50_cdB;    ///< Level exceeded 50% of the time
+    int32_t l90_cdB;    ///< Level exceeded 90% of the time
+    int32_t l95_cdB;    ///< Level exceeded 95% of the time
+} noise_stats_summary_t;
+
+/**
+ * @brief Adds the linear energy of one level to an energy sum.
+ *
+ * @param energy Energy sum to update.
+ * @param level_cdB Sound level in hundredths of dB (clamped to 0..150 dB).
+ */
+void noise_energy_add(noise_energy_t *energy, int32_t level_cdB);
+
+/**
+ * @brief Adds an energy sum to another one.
+ *
+ * @param dst Energy sum to update.
+ * @param src Energy sum to add.
+ */
+void noise_energy_merge(noise_energy_t *dst, const noise_energy_t *src);
+
+/**
+ * @brief Computes the equivalent continuous level of an energy sum.
+ *
+ * @param energy Energy sum to read.
+ * @return Leq in hundredths of dB (0 for an empty sum).
+ */
+int32_t noise_energy_leq_cdB(const noise_energy_t *energy);
+
+/**
+ * @brief Empties a statistics window.
+ *
+ * @param stats Window to reset.
+ */
+void noise_stats_reset(noise_stats_t *stats);
+
+/**
+ * @brief Adds one level to a statistics window.
+ *
+ * @param stats Window to update.
+ * @param level_cdB Sound level in hundredths of dB.
+ */
+void noise_stats_add(noise_stats_t *stats, int32_t level_cdB);
+
+/**
+ * @brief Adds a statistics window to another one (O(NOISE_STATS_BINS)).
+ *
+ * @param dst Window to update.
+ * @param src Window to add.
+ */
+void noise_stats_merge(noise_stats_t *dst, const noise_stats_t *src);
+
+/**
+ * @brief Computes the equivalent continuous level of a window.
+ *
+ * @param stats Window to read.
+ * @return Leq in hundredths of dB (0 for an empty window).
+ */
+int32_t noise_stats_leq_cdB(const noise_stats_t *stats);
+
+/**
+ * @brief Computes the summary of a window (Leq, mean, min, max, L10, L50, L90, L95).
+ *
+ * @param stats Window to read.
+ * @param summary Pointer where the summary is stored.
+ */
+void noise_stats_summarize(const noise_stats_t *stats, noise_stats_summary_t *summary);
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef PUBLISH_QUEUE_H
+#define PUBLISH_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hardware/rtc.h"   // datetime_t
+#include "inc/config.h"
+#include "inc/spectrum.h"   // SPECTRUM_MAX_BANDS
+#include "inc/measurement.h" // sensor_config_t
+
+#define PUBLISH_SCHEMA_VERSION 1   // First byte of the CBOR messages
+
+/**
+ * @brief Keys of the CBOR encoding of a window record (a map with integer keys).
+ *
+ * A CBOR message is the PUBLISH_SCHEMA_VERSION byte followed by an indefinite-length
+ * array of record maps. Levels are integers in hundredths of dB, the dose in hundredths
+ * of percent, the coordinates in micro-degrees and the time is tagged epoch seconds (UTC).
+ */
+
+typedef enum {
+    PUBLISH_KEY_ID = 0,         ///< Sensor identifier
+    PUBLISH_KEY_TIME,           ///< Closing time of the window (tag 1, UTC seconds)
+    PUBLISH_KEY_WINDOW,         ///< Length of the window, in seconds
+    PUBLISH_KEY_MEAN,           ///< Arithmetic mean of the levels
+    PUBLISH_KEY_MIN,            ///< Minimum level
+    PUBLISH_KEY_MAX,            ///< Maximum level
+    PUBLISH_KEY_LEQ,            ///< Equivalent continuous level
+    PUBLISH_KEY_L10,            ///< Level exceeded 10% of the window
+    PUBLISH_KEY_L50,            ///< Level exceeded 50% of the window
+    PUBLISH_KEY_L90,            ///< Level exceeded 90% of the window
+    PUBLISH_KEY_L95,            ///< Level exceeded 95% of the window
+    PUBLISH_KEY_LATITUDE,       ///< Latitude of the sensor
+    PUBLISH_KEY_LONGITUDE,      ///< Longitude of the sensor
+    PUBLISH_KEY_DOSE,           ///< Running noise dose
+    PUBLISH_KEY_TWA,            ///< Time-weighted average of the noise dose
+    PUBLISH_KEY_LDEN,           ///< Day-evening-night level (24 h windows only)
+    PUBLISH_KEY_BANDS,          ///< [first band number, band levels...] (spectrum only)
+} publish_key_t;
+
+/**
+ * @brief Statistics of one closed window, waiting to be published (hundredths of dB).
+ */
+
+typedef struct {
+    uint64_t queued_us;                 ///< Time at which the record was queued (for the latency)
+    datetime_t time;                    ///< RTC time at which the window was closed
+    const sensor_config_t *config;      ///< Static configuration of the sensor (identifier, location)
+    uint32_t window_s;                  ///< Length of the window, in seconds
+    int16_t mean_cdB;                   ///< Arithmetic mean of the levels
+    int16_t min_cdB;                    ///< Minimum level
+    int16_t max_cdB;                    ///< Maximum level
+    int16_t leq_cdB;                    ///< Equivalent continuous level
+    int16_t l10_cdB;                    ///< Level exceeded 10% of the window
+    int16_t l50_cdB;                    ///< Level exceeded 50% of the window
+    int16_t l90_cdB;                    ///< Level exceeded 90% of the window
+    int16_t l95_cdB;                    ///< Level exceeded 95% of the window
+    int16_t lden_cdB;                   ///< Day-evening-night level (24 h window only)
+    int16_t twa_cdB;                    ///< Time-weighted average of the running noise dose
+    uint32_t dose_percent_c;            ///< Running noise dose, in hundredths of percent
+    uint8_t band_count;                 ///< Number of 1/3-octave bands (0 = no spectrum)
+    int8_t first_band;                  ///< Band number of the first band (0 = 1 kHz)
+    int16_t band_cdB[SPECTRUM_MAX_BANDS]; ///< 1/3-octave band levels
+} publish_record_t;
+
+/**
+ * @brief How a record left the queue.
+ */
+
+typedef enum {
+    PUBLISH_SENT,       ///< Acknowledged by the broker (PUBACK)
+    PUBLISH_SPILLED,    ///< Saved to flash, resent later
+    PUBLISH_DROPPED     ///< Lost (flash unavailable)
+} publish_outcome_t;
+
+/**
+ * @brief Bounded queue of window records between the aggregation and the MQTT publisher.
+ *
+ * Both sides run on core 0 (aggregation in the sample task, publishing in the publisher
+ * task), so no lock is needed. The producer never blocks: a record that does not fit is
+ * dropped and counted.
+ */
+
+typedef struct {
+    publish_record_t records[PUBLISH_QUEUE_SIZE];   ///< Record storage
+    uint8_t head;                                   ///< Index of the oldest record
+    uint8_t count;                                  ///< Records waiting (in flight included)
+    uint8_t in_flight;                              ///< Oldest records sent and waiting for their PUBACK
+    uint8_t high_water;                             ///< Highest number of records waiting
+    uint32_t queued;                                ///< Records queued
+    uint32_t sent;                                  ///< Records acknowledged by the broker
+    uint32_t spilled;                               ///< Records saved to flash
+    uint32_t dropped;                               ///< Records lost (queue full or flash unavailable)
+    uint32_t latency_max_us;                        ///< Longest queue-to-PUBACK latency
+    uint64_t latency_sum_us;                        ///< Sum of the queue-to-PUBACK latencies (for the mean)
+} publish_queue_t;
+
+/**
+ * @brief Initializes an empty queue.
+ *
+ * @param queue Queue to initialize.
+ */
+void publish_queue_init(publish_queue_t *queue);
+
+/**
+ * @brief Reserves the slot of a new record at the end of the queue.
+ *
+ * @param queue Queue.
+ * @return Slot to fill and commit with publish_queue_commit(), or NULL if the queue is full (counted as dropped).
+ */
+publish_record_t *publish_queue_reserve(publish_queue_t *queue);
+
+/**
+ * @brief Makes the record filled after publish_queue_reserve() visible to the publisher.
+ *
+ * @param queue Queue.
+ * @param now_us Current time (start of the latency measurement).
+ */
+void publish_queue_commit(publish_queue_t *queue, uint64_t now_us);
+
+/**
+ * @brief Returns the oldest record.
+ *
+ * @param queue Queue.
+ * @return Oldest record, or NULL if the queue is empty.
+ */
+const publish_record_t *publish_queue_front(const publish_queue_t *queue);
+
+/**
+ * @brief Returns a waiting record by age.
+ *
+ * @param queue Queue.
+ * @param index Position of the record (0 = oldest).
+ * @return Record, or NULL if fewer records are waiting.
+ */
+const publish_record_t *publish_queue_at(const publish_queue_t *queue, uint8_t index);
+
+/**
+ * @brief Removes the oldest record and counts how it left the queue.
+ *
+ * @param queue Queue (not empty).
+ * @param outcome How the record left the queue.
+ * @param now_us Current time (end of the latency measurement of sent records).
+ */
+void publish_queue_pop(publish_queue_t *queue, publish_outcome_t outcome, uint64_t now_us);
+
+/**
+ * @brief Returns the mean queue-to-PUBACK latency.
+ *
+ * @param queue Queue.
+ * @return Mean latency in microseconds (0 if nothing was sent).
+ */
+uint32_t publish_queue_latency_mean_us(const publish_queue_t *queue);
+
+/**
+ * @brief Several formatted records packed into one MQTT message.
+ *
+ * With JSON records, a batch of several is sent as a JSON array, a batch of one as the
+ * object itself (the format of the unbatched messages). With CBOR records (MQTT_PAYLOAD_CBOR)
+ * the batch is always the schema version byte and an indefinite-length array.
+ */
+
+typedef struct {
+    char *payload;          ///< Buffer holding the message
+    size_t size;            ///< Size of the buffer
+    size_t length;          ///< Length of the message (including the opening of the array)
+    uint8_t records;        ///< Records in the batch
+} publish_batch_t;
+
+/**
+ * @brief Starts an empty batch.
+ *
+ * @param batch Batch to start.
+ * @param buffer Buffer receiving the message.
+ * @param size Size of the buffer (byte budget of the message).
+ */
+void publish_batch_begin(publish_batch_t *batch, char *buffer, size_t size);
+
+/**
+ * @brief Adds a formatted record to a batch.
+ *
+ * @param batch Batch.
+ * @param record Formatted record (JSON object or CBOR map).
+ * @param length Length of the record.
+ * @return false if the batch is full (MQTT_BATCH_MAX_RECORDS records or byte budget reached); the record is not added.
+ */
+bool publish_batch_add(publish_batch_t *batch, const char *record, size_t length);
+
+/**
+ * @brief Closes a batch and returns the message to send.
+ *
+ * @param batch Batch (not empty).
+ * @param length Receives the length of the message.
+ * @return Message (not NUL-terminated).
+ */
+const char *publish_batch_finish(publish_batch_t *batch, size_t *length);
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef PUBLISH_TRACKER_H
+#define PUBLISH_TRACKER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/config.h"
+
+// State of an in-flight slot
+typedef enum {
+    PUBLISH_SLOT_FREE = 0,      ///< Not in flight
+    PUBLISH_SLOT_PENDING,       ///< Waiting for the PUBACK
+    PUBLISH_SLOT_ACKED,         ///< Acknowledged by the broker
+    PUBLISH_SLOT_FAILED,        ///< Timed out, or the connection was lost
+} publish_slot_state_t;
+
+// Storage of the records carried by a message
+typedef enum {
+    PUBLISH_SOURCE_QUEUE = 0,   ///< Records at the head of the publish queue
+    PUBLISH_SOURCE_FLASH,       ///< Records saved in flash files
+} publish_source_t;
+
+/**
+ * @brief One QoS 1 message waiting for its PUBACK.
+ */
+
+typedef struct {
+    uint32_t sequence;                      ///< Identifier passed to the completion callback
+    volatile uint8_t state;                 ///< publish_slot_state_t (written by the completion callback)
+    uint8_t source;                         ///< publish_source_t
+    uint8_t records;                        ///< Records carried by the message
+    uint64_t sent_us;                       ///< Time at which the message was handed to the MQTT client
+    int files[MQTT_BATCH_MAX_RECORDS];      ///< Numbers of the flash files carried (PUBLISH_SOURCE_FLASH)
+} publish_slot_t;
+
+/**
+ * @brief Bounded window of QoS 1 messages waiting for their PUBACK, in send order.
+ *
+ * The stored records of a message are only released once the broker acknowledges it.
+ * The completion callback only writes the state of its slot; everything else runs in
+ * the publisher task.
+ */
+
+typedef struct {
+    publish_slot_t slots[MQTT_INFLIGHT_WINDOW];   ///< Slot storage
+    uint8_t head;                               ///< Index of the oldest slot
+    uint8_t count;                              ///< Messages in flight
+    uint8_t max_depth;                          ///< Most messages in flight
+    uint32_t next_sequence;                     ///< Identifier of the next message
+    uint32_t acked;                             ///< Messages acknowledged
+    uint32_t failed;                            ///< Messages timed out or lost with the connection
+    uint32_t retries;                           ///< Records sent again after a failure
+    uint32_t ack_latency_max_us;                ///< Longest send-to-PUBACK latency
+    uint64_t ack_latency_sum_us;                ///< Sum of the send-to-PUBACK latencies (for the mean)
+} publish_tracker_t;
+
+/**
+ * @brief Initializes an empty tracker.
+ *
+ * @param tracker Tracker to initialize.
+ */
+void publish_tracker_init(publish_tracker_t *tracker);
+
+/**
+ * @brief Prepares the slot of a new message.
+ *
+ * @param tracker Tracker.
+ * @param now_us Current time (start of the ack latency measurement).
+ * @return Slot to fill (source, records, files) and commit with publish_tracker_commit()
+ *         once the message is accepted by the MQTT client, or NULL if the window is full.
+ */
+publish_slot_t *publish_tracker_reserve(publish_tracker_t *tracker, uint64_t now_us);
+
+/**
+ * @brief Counts the slot prepared by publish_tracker_reserve() as in flight.
+ *
+ * @param tracker Tracker.
+ */
+void publish_tracker_commit(publish_tracker_t *tracker);
+
+/**
+ * @brief Records the completion of a message (completion callback, any context).
+ *
+ * @param tracker Tracker.
+ * @param sequence Identifier of the message.
+ * @param acked true on PUBACK, false on failure.
+ *
+ * Completions of messages no longer tracked (already failed) are ignored.
+ */
+void publish_tracker_complete(publish_tracker_t *tracker, uint32_t sequence, bool acked);
+
+/**
+ * @brief Returns the oldest message in flight.
+ *
+ * @param tracker Tracker.
+ * @return Oldest slot, or NULL if nothing is in flight.
+ */
+publish_slot_t *publish_tracker_front(publish_tracker_t *tracker);
+
+/**
+ * @brief Removes the oldest message once it is acknowledged or failed.
+ *
+ * @param tracker Tracker (oldest slot not pending).
+ * @param now_us Current time (end of the ack latency measurement).
+ */
+void publish_tracker_release(publish_tracker_t *tracker, uint64_t now_us);
+
+/**
+ * @brief Fails every message in flight (connection lost: no PUBACK will come).
+ *
+ * @param tracker Tracker.
+ */
+void publish_tracker_abandon(publish_tracker_t *tracker);
+
+/**
+ * @brief Detaches the publish queue records from every message in flight.
+ *
+ * @param tracker Tracker.
+ *
+ * Used when the queue records are sent again: a late PUBACK of these messages must not
+ * release them a second time.
+ */
+void publish_tracker_forget_queue(publish_tracker_t *tracker);
+
+/**
+ * @brief Checks whether a flash file is carried by a message in flight.
+ *
+ * @param tracker Tracker.
+ * @param file Number of the file.
+ * @return true if the file is in flight (it must not be sent again).
+ */
+bool publish_tracker_has_file(const publish_tracker_t *tracker, int file);
+
+/**
+ * @brief Counts the messages in flight carrying records of one storage.
+ *
+ * @param tracker Tracker.
+ * @param source Storage of the records (publish_source_t).
+ * @return Number of messages.
+ */
+uint8_t publish_tracker_in_flight(const publish_tracker_t *tracker, publish_source_t source);
+
+/**
+ * @brief Returns the mean send-to-PUBACK latency.
+ *
+ * @param tracker Tracker.
+ * @return Mean latency in microseconds (0 if nothing was acknowledged).
+ */
+uint32_t publish_tracker_ack_latency_mean_us(const publish_tracker_t *tracker);
+
+#endif
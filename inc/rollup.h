@@ -0,0 +1,86 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/noise_stats.h"
+
+#define ROLLUP_LEVELS 5     // 1 s, 1 min, 15 min, 1 h and 24 h windows
+
+// Index of each window level
+enum {
+    ROLLUP_1S = 0,
+    ROLLUP_1MIN,
+    ROLLUP_15MIN,
+    ROLLUP_1H,
+    ROLLUP_24H,
+};
+
+// Periods of the day-evening-night level
+typedef enum {
+    LDEN_DAY = 0,
+    LDEN_EVENING,
+    LDEN_NIGHT,
+    LDEN_PERIODS,
+} lden_period_t;
+
+/**
+ * @brief Cascade of statistics windows of increasing length.
+ *
+ * Only the 1 s level receives levels; each level is merged into the next one when
+ * it closes, so the longer windows never need the raw levels. Windows are aligned
+ * on the local clock (a 15 min window starts at :00, :15, :30 or :45).
+ * A zero-initialized structure is ready to use.
+ */
+
+typedef struct {
+    noise_stats_t stats[ROLLUP_LEVELS];     ///< Current window of each level
+    uint64_t start_us[ROLLUP_LEVELS];       ///< Start of the current window of each level (local time)
+    noise_energy_t lden[LDEN_PERIODS];      ///< Energy of each Lden period of the current day
+    bool started;                           ///< Windows are aligned (first level received)
+} rollup_t;
+
+/**
+ * @brief Callback called when a window closes.
+ *
+ * @param level Level of the window (ROLLUP_1S ... ROLLUP_24H).
+ * @param stats Statistics of the window.
+ * @param start_us Start of the window (local time).
+ * @param lden_cdB Day-evening-night level of the day (24 h level only, 0 otherwise).
+ * @param arg User argument of rollup_add().
+ */
+typedef void (*rollup_close_cb_t)(uint8_t level, const noise_stats_t *stats, uint64_t start_us, int32_t lden_cdB, void *arg);
+
+/**
+ * @brief Adds one level to the cascade, closing the windows it moves past.
+ *
+ * @param rollup Cascade to update.
+ * @param local_us Time of the level (local time, us).
+ * @param level_cdB Sound level in hundredths of dB.
+ * @param on_close Callback of each closed (non-empty) window, or NULL.
+ * @param arg User argument of the callback.
+ *
+ * A clock that goes backwards, or forwards by more than a day, restarts the windows
+ * without reporting them.
+ */
+void rollup_add(rollup_t *rollup, uint64_t local_us, int32_t level_cdB, rollup_close_cb_t on_close, void *arg);
+
+/**
+ * @brief Returns the length of the windows of a level, in seconds.
+ */
+uint32_t rollup_level_seconds(uint8_t level);
+
+/**
+ * @brief Returns the Lden period of an hour of the local day.
+ */
+lden_period_t rollup_lden_period(uint8_t hour);
+
+/**
+ * @brief Computes the day-evening-night level from the energy of each period.
+ *
+ * @param periods Energy of the day, evening and night periods.
+ * @return Lden in hundredths of dB (0 if no period has data).
+ */
+int32_t rollup_lden_cdB(const noise_energy_t *periods);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef SAMPLE_CLOCK_H
+#define SAMPLE_CLOCK_H
+
+#include "pico/stdlib.h"
+
+/**
+ * @brief Fixed-rate sampling clock.
+ *
+ * A repeating timer on a dedicated hardware alarm raises one tick per period. The tick
+ * only records its scheduled time and wakes the core; the acquisition itself runs in
+ * the main loop, which reports back when it actually happened so that the clock can
+ * measure the jitter between the schedule and the real acquisition time.
+ */
+typedef struct {
+    uint32_t period_us;                 ///< Sampling period
+    repeating_timer_t timer;            ///< Repeating timer driving the ticks
+    volatile bool tick_pending;         ///< Set by the timer, cleared by sample_clock_take_tick()
+    volatile uint64_t tick_scheduled_us;///< Scheduled time of the pending tick
+    uint64_t next_scheduled_us;         ///< Scheduled time of the next tick (written by the timer only)
+
+    uint32_t ticks;                     ///< Ticks raised by the timer
+    uint32_t missed_deadlines;          ///< Ticks lost because the previous one was not consumed or the acquisition was busy
+    uint32_t acquisitions;              ///< Acquisitions measured for the jitter statistics
+    uint32_t jitter_min_us;             ///< Smallest delay between schedule and acquisition
+    uint32_t jitter_max_us;             ///< Largest delay between schedule and acquisition
+    uint64_t jitter_sum_us;             ///< Sum of the delays (for the mean)
+} sample_clock_t;
+
+bool sample_clock_start(sample_clock_t *clock, uint32_t period_us);
+
+bool sample_clock_take_tick(sample_clock_t *clock, uint64_t *scheduled_us);
+
+void sample_clock_miss(sample_clock_t *clock);
+
+void sample_clock_record_acquisition(sample_clock_t *clock, uint64_t scheduled_us, uint64_t acquired_us);
+
+void sample_clock_reset_jitter(sample_clock_t *clock);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/config.h"
+#include "inc/measurement.h"
+
+/**
+ * @brief Single-producer/single-consumer ring of sample records.
+ *
+ * Core 1 only writes head, core 0 only writes tail; both indexes run freely and are
+ * masked on access, so no lock is needed. The producer never blocks: when the ring is
+ * full the new record is dropped and counted.
+ */
+
+typedef struct {
+    measurement_t records[SAMPLE_RING_SIZE];    ///< Record storage
+    volatile uint32_t head;                     ///< Records written (producer)
+    volatile uint32_t tail;                     ///< Records read (consumer)
+    uint32_t overflows;                         ///< Records dropped because the ring was full (producer)
+    uint32_t high_water;                        ///< Highest number of records waiting (producer)
+} sample_ring_t;
+
+/**
+ * @brief Queues one record (producer side).
+ *
+ * @param ring Ring to write.
+ * @param record Record to copy into the ring.
+ * @return true if queued, false if the ring was full (record dropped).
+ */
+bool sample_ring_push(sample_ring_t *ring, const measurement_t *record);
+
+/**
+ * @brief Takes the oldest record (consumer side).
+ *
+ * @param ring Ring to read.
+ * @param record Pointer where the record is copied.
+ * @return true if a record was taken, false if the ring was empty.
+ */
+bool sample_ring_pop(sample_ring_t *ring, measurement_t *record);
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/config.h"
+
+/**
+ * @brief Task function (runs to completion, must not block).
+ */
+typedef void (*scheduler_task_fn_t)(void *arg);
+
+/**
+ * @brief Time source of the scheduler (microseconds, monotonic).
+ */
+typedef uint64_t (*scheduler_clock_t)(void);
+
+/**
+ * @brief One task and its runtime statistics.
+ *
+ * A task with a period of 0 is polled: it runs on every scheduler pass (cheap
+ * non-blocking checks, e.g. sampling). A periodic task is released every period and
+ * must finish within its deadline after the release.
+ */
+typedef struct {
+    const char *name;             ///< Name used in the reports
+    scheduler_task_fn_t fn;       ///< Task function
+    void *arg;                    ///< Argument of the task function
+    uint32_t period_us;           ///< Release period (0 = polled)
+    uint32_t deadline_us;         ///< Relative deadline (from the release, or the runtime of a polled task; 0 = none)
+    uint8_t priority;             ///< Priority (0 = most urgent)
+    uint64_t release_us;          ///< Next release of a periodic task
+    uint32_t runs;                ///< Executions
+    uint32_t overruns;            ///< Executions that finished after the deadline
+    uint32_t skipped;             ///< Releases dropped because the task was still late
+    uint32_t max_runtime_us;      ///< Longest execution
+    uint32_t max_lateness_us;     ///< Longest delay between the release and the start
+    uint64_t total_runtime_us;    ///< Sum of the execution times (for the mean)
+} scheduler_task_t;
+
+/**
+ * @brief Cooperative run-to-completion scheduler (one per core).
+ *
+ * Tasks are kept sorted by priority. Each pass runs the ready tasks in priority order
+ * and ends after the first periodic task, so the higher-priority polled tasks (sampling)
+ * run again between two housekeeping tasks. The scheduler has no hardware dependency:
+ * time comes from the clock given to scheduler_init().
+ */
+typedef struct {
+    scheduler_task_t tasks[SCHEDULER_MAX_TASKS];  ///< Tasks, sorted by priority
+    uint8_t task_count;                           ///< Number of tasks
+    scheduler_clock_t clock;                      ///< Time source
+} scheduler_t;
+
+/**
+ * @brief Initializes a scheduler.
+ *
+ * @param sched Scheduler to initialize.
+ * @param clock Time source (e.g. time_us_64).
+ */
+void scheduler_init(scheduler_t *sched, scheduler_clock_t clock);
+
+/**
+ * @brief Adds a task.
+ *
+ * @param sched Scheduler.
+ * @param name Name used in the reports.
+ * @param fn Task function.
+ * @param arg Argument of the task function.
+ * @param period_us Release period (0 = polled on every pass).
+ * @param deadline_us Relative deadline (0 = none).
+ * @param priority Priority (0 = most urgent); tasks with the same priority run in insertion order.
+ * @return True if the task was added, false if the table is full.
+ */
+bool scheduler_add(scheduler_t *sched, const char *name, scheduler_task_fn_t fn, void *arg,
+                   uint32_t period_us, uint32_t deadline_us, uint8_t priority);
+
+/**
+ * @brief Runs one scheduler pass.
+ *
+ * @param sched Scheduler.
+ * @return True if a periodic task ran (another one may already be due).
+ */
+bool scheduler_run_once(scheduler_t *sched);
+
+/**
+ * @brief Returns the next release of a periodic task.
+ *
+ * @param sched Scheduler.
+ * @return Absolute time of the next release (UINT64_MAX if there is no periodic task).
+ */
+uint64_t scheduler_next_release_us(const scheduler_t *sched);
+
+/**
+ * @brief Clears the runtime statistics of all tasks.
+ *
+ * @param sched Scheduler.
+ */
+void scheduler_reset_stats(scheduler_t *sched);
+
+#endif
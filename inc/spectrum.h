@@ -0,0 +1,66 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <stdint.h>
+
+#define SPECTRUM_MAX_FFT 1024       // Largest FFT size (a power of 4)
+#define SPECTRUM_MAX_BANDS 31       // 1/3-octave bands from 20 Hz to 20 kHz
+#define SPECTRUM_LOWEST_BAND (-17)  // Band number of 20 Hz (band 0 is 1 kHz)
+
+/**
+ * @brief Structure of a 1/3-octave spectrum analyzer.
+ *
+ * The FFT runs in fixed point (radix-4, Q15 twiddles, block floating point between
+ * stages). The window and the twiddles are computed once by spectrum_init().
+ */
+
+typedef struct {
+    uint16_t fft_size;                              ///< FFT size (a power of 4)
+    uint8_t log2_size;                              ///< log2(fft_size)
+    uint8_t band_count;                             ///< Number of bands resolved at this rate and size
+    int8_t first_band;                              ///< Band number of the first band (0 = 1 kHz)
+    uint16_t band_first_bin[SPECTRUM_MAX_BANDS + 1];///< First FFT bin of each band (plus the end of the last one)
+    int16_t window[SPECTRUM_MAX_FFT];               ///< Hann window (Q15)
+    int16_t twiddle_cos[SPECTRUM_MAX_FFT * 3 / 4];  ///< cos(2 pi k / N) (Q15)
+    int16_t twiddle_sin[SPECTRUM_MAX_FFT * 3 / 4];  ///< sin(2 pi k / N) (Q15)
+    int32_t re[SPECTRUM_MAX_FFT];                   ///< Work buffer (real part)
+    int32_t im[SPECTRUM_MAX_FFT];                   ///< Work buffer (imaginary part)
+} spectrum_t;
+
+/**
+ * @brief Prepares the analyzer for an FFT size and a sampling rate.
+ *
+ * @param spectrum Analyzer to initialize.
+ * @param fft_size FFT size (64, 256 or 1024).
+ * @param sample_rate_hz Sampling rate of the signal.
+ */
+void spectrum_init(spectrum_t *spectrum, uint16_t fft_size, uint32_t sample_rate_hz);
+
+/**
+ * @brief Computes the band energies of one frame of ADC samples.
+ *
+ * @param spectrum Analyzer to use.
+ * @param samples Pointer to fft_size raw 12-bit ADC samples.
+ * @param offset DC offset of the signal (mid-scale of the ADC).
+ * @param band_energy Array of band_count accumulators the energies are added to.
+ */
+void spectrum_add_frame(spectrum_t *spectrum, const uint16_t *samples, int32_t offset, uint64_t *band_energy);
+
+/**
+ * @brief Converts accumulated band energies to band levels.
+ *
+ * @param spectrum Analyzer that produced the energies.
+ * @param band_energy Accumulated band energies.
+ * @param frames Number of frames accumulated.
+ * @param levels_cdB Array of band_count levels, in hundredths of dB.
+ */
+void spectrum_levels_cdB(const spectrum_t *spectrum, const uint64_t *band_energy, uint32_t frames, int32_t *levels_cdB);
+
+/**
+ * @brief Returns the nominal centre frequency of a band (e.g. 31 for 31.5 Hz).
+ *
+ * @param band Band number (0 = 1 kHz).
+ */
+uint16_t spectrum_band_nominal_hz(int8_t band);
+
+#endif
@@ -9,4 +9,21 @@ extern bool rtc_initialized; // Flag to indicate if RTC has been initialized suc
 void my_rtc_set_from_sntp(uint32_t epoch_seconds, uint32_t epoch_microseconds);
 void init_and_sync_rtc();
 
+/**
+ * @brief Converts a timer timestamp to local time.
+ *
+ * @param timestamp_us Timestamp of the microsecond timer (us since boot).
+ * @return Local time in us since 1970-01-01 00:00 local, or timestamp_us itself
+ *         while the clock has not been synchronized.
+ */
+uint64_t rtc_local_time_us(uint64_t timestamp_us);
+
+/**
+ * @brief Tells whether the local time has been synchronized.
+ *
+ * @return true once rtc_local_time_us() gives the local date, false while it still gives
+ *         the time since boot.
+ */
+bool rtc_local_time_synced(void);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef WEIGHTING_H
+#define WEIGHTING_H
+
+#include <stdint.h>
+
+#define WEIGHTING_MAX_SECTIONS 3    // A-weighting needs three biquads, C-weighting two
+#define WEIGHTING_COEF_SHIFT 28     // Coefficients in Q4.28 (|a1| < 2, gains up to 8)
+#define WEIGHTING_INPUT_SHIFT 12    // 12-bit ADC deviations are scaled to 24 bits before filtering
+
+// Frequency weightings of IEC 61672-1
+typedef enum {
+    WEIGHTING_Z = 0,    // No weighting (flat)
+    WEIGHTING_A,        // A-weighting
+    WEIGHTING_C,        // C-weighting
+} weighting_t;
+
+// One biquad section. The numerator is gain * (num[0] + num[1] z^-1 + num[2] z^-2) with
+// small integer taps, so only three 64-bit multiplications are needed per sample.
+typedef struct {
+    int32_t gain;           // Numerator gain (Q28)
+    int8_t num[3];          // Integer numerator taps
+    int32_t a1;             // Denominator coefficients (Q28, a0 = 1)
+    int32_t a2;
+    int32_t x1, x2;         // Previous inputs
+    int32_t y1, y2;         // Previous outputs
+    int32_t error;          // Truncation error fed back into the next sample
+} weighting_section_t;
+
+typedef struct {
+    weighting_t type;                                   // Weighting applied by the filter
+    uint8_t section_count;                              // Number of biquad sections in use
+    weighting_section_t sections[WEIGHTING_MAX_SECTIONS];
+} weighting_filter_t;
+
+/**
+ * @brief Designs a weighting filter for a sampling rate.
+ *
+ * @param filter Filter to initialize.
+ * @param type Frequency weighting.
+ * @param sample_rate_hz Sampling rate of the signal.
+ */
+void weighting_init(weighting_filter_t *filter, weighting_t type, uint32_t sample_rate_hz);
+
+/**
+ * @brief Clears the state of a weighting filter.
+ *
+ * @param filter Filter to reset.
+ */
+void weighting_reset(weighting_filter_t *filter);
+
+/**
+ * @brief Filters one sample.
+ *
+ * @param filter Filter to use.
+ * @param x Input sample (ADC deviation shifted left by WEIGHTING_INPUT_SHIFT).
+ * @return The weighted sample, on the same scale as the input.
+ */
+int32_t weighting_process(weighting_filter_t *filter, int32_t x);
+
+/**
+ * @brief Filters a block of ADC samples and computes the sum of squares of the output.
+ *
+ * @param filter Filter to use (its state carries over to the next block).
+ * @param samples Pointer to the raw 12-bit ADC samples.
+ * @param count Number of samples in the block.
+ * @param offset DC offset of the signal (mid-scale of the ADC).
+ * @return The sum of the squared weighted samples, in ADC counts squared.
+ */
+uint64_t weighting_block_sum_squares(weighting_filter_t *filter, const uint16_t *samples, uint32_t count, int32_t offset);
+
+/**
+ * @brief Returns the name of a weighting ("Z", "A" or "C").
+ */
+const char *weighting_name(weighting_t type);
+
+#endif
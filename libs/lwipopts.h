@@ -23,7 +23,12 @@
 #define MEM_LIBC_MALLOC             0
 #endif
 #define MEM_ALIGNMENT               4
-#define MEM_SIZE                    12000
+// lwIP heap: the MQTT client (mem_calloc'ed with its output ring buffer and request slots),
+// the TCP send buffer (each queued segment is a PBUF_RAM pbuf carrying its headers) and
+// about 3 KB for DHCP, DNS, SNTP and ICMP replies
+#define MEM_MQTT_CLIENT_SIZE        (MQTT_OUTPUT_RINGBUF_SIZE + MQTT_REQ_MAX_IN_FLIGHT * 24 + 512)
+#define MEM_TCP_SND_SIZE            (TCP_SND_BUF + TCP_SND_QUEUELEN * 96)
+#define MEM_SIZE                    (MEM_MQTT_CLIENT_SIZE + MEM_TCP_SND_SIZE + 3000)
 #define MEMP_NUM_TCP_SEG            32
 #define MEMP_NUM_ARP_QUEUE          10
 #define PBUF_POOL_SIZE              24
@@ -60,6 +65,8 @@
 #define LWIP_DHCP_DOES_ACD_CHECK    0
 #define LWIP_SNTP                   1
 #define SNTP_SERVER_DNS             1
+#define MQTT_OUTPUT_RINGBUF_SIZE    2048    // Holds one batch of records (MQTT_BATCH_MAX_BYTES) with its fixed header, topic and packet identifier
+#define MQTT_REQ_MAX_IN_FLIGHT      8       // QoS 1 publishes waiting for PUBACK: MQTT_INFLIGHT_WINDOW record messages, the rest for the alerts
 
 #ifndef NDEBUG
 #define LWIP_DEBUG                  0
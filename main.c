@@ -4,62 +4,624 @@
 #include "inc/mqtt.h"                  // Library for MQTT protocol communication
 #include "inc/timertc.h"               // Library for timer and RTC (Real-Time Clock) management
 #include "inc/flash.h"                 // Library for flash memory operations
+#include "inc/modbus_bus.h"            // Library for polling several Modbus sensors on one bus
+#include "inc/sample_clock.h"          // Library for the fixed-rate sampling clock
+#include "inc/modbus_baud.h"           // Library for the sensor baud rate negotiation
+#include "inc/sample_ring.h"           // Library for the sample queue between the cores
+#include "inc/live_state.h"            // Library for the live state snapshots shared by the cores
+#include "inc/scheduler.h"             // Library for the cooperative task scheduler
+#include "inc/checkpoint.h"            // Library for the checkpoints of the aggregation state
 #include "pico/multicore.h"            // Library for multi-core operations on Raspberry Pi Pico
 
-micdata_t micdata;                // Global variable to hold microphone data
+static const modbus_bus_device_cfg_t bus_devices[] = MODBUS_BUS_DEVICES;   // Sensors polled by core 1
+
+#define ADC_SENSOR_INDEX count_of(bus_devices)                        // Sensor index of the first analog microphone channel
+#define SENSOR_COUNT (count_of(bus_devices) + MIC_ADC_ENABLED * MIC_CHANNEL_COUNT)   // Number of measurement streams
+
+micdata_t micdata[SENSOR_COUNT];    // Microphone data, one entry per sensor (Modbus bus first, then the analog microphone channels; ~12.6 KB each)
+static sensor_config_t sensor_config[SENSOR_COUNT];                         // Static settings of each sensor (identifier, location)
+static modbus_bus_t modbus_bus;                                             // Round-robin Modbus bus scheduler
+static sample_clock_t sample_clock;                                         // Fixed-rate clock starting each polling round
+static sample_ring_t sample_ring;                                           // Sample records from core 1 to core 0 (shared SRAM)
+static live_state_t live_state[SENSOR_COUNT];                               // Seqlock snapshots of micdata, readable from any core
+static scheduler_t core0_scheduler;                                         // Tasks of core 0 (sample processing, display)
+static scheduler_t core1_scheduler;                                         // Tasks of core 1 (sampling, connectivity)
+
+/**
+ * @brief Aggregation state of one sensor kept across resets.
+ */
+
+typedef struct {
+    rollup_t rollup;            ///< Open statistics windows and Lden energies
+    noise_dose_t dose;          ///< Noise dose of the day
+} sensor_state_t;
+
+/**
+ * @brief Checkpoint of the aggregation state of every sensor.
+ */
+
+typedef struct {
+    checkpoint_header_t header;
+    sensor_state_t sensors[SENSOR_COUNT];
+} state_image_t;
+
+#define STATE_IMAGE_WORDS (SENSOR_COUNT * sizeof(sensor_state_t) / sizeof(uint32_t))   // Payload of the checkpoint, in words
+
+_Static_assert(SENSOR_COUNT * (sizeof(micdata_t) + sizeof(sensor_state_t)) <= SENSOR_RAM_BUDGET_BYTES,
+               "Too many sensors for the SRAM: each one takes ~25 KB (micdata and its checkpoint copy); "
+               "shorten MODBUS_BUS_DEVICES or raise NOISE_STATS_BIN_CDB");
+
+static state_image_t __uninitialized_ram(state_image);                      // Not cleared at boot: survives soft resets (watchdog, SYSRESETREQ); ~12 KB per sensor
+static const char *const checkpoint_files[CHECKPOINT_SLOTS] = {CHECKPOINT_FILE_A, CHECKPOINT_FILE_B};
+static uint32_t flash_sequence;                                             // Sequence of the newest flash copy
+static uint32_t flash_crc;                                                  // CRC of the newest flash copy (unchanged state is not rewritten)
+static uint32_t checkpoint_ram_max_us;                                      // Longest RAM checkpoint
+static uint32_t checkpoint_flash_max_us;                                    // Longest flash checkpoint
+static uint32_t checkpoint_flash_writes;                                    // Flash checkpoints written
+static uint32_t checkpoint_flash_bytes;                                     // Size of the last flash checkpoint
+static bool rollup_restore_pending;                                         // Restored windows kept in state_image until the local clock is synchronized
+
+/**
+ * @brief Transmit callback of the bus scheduler.
+ */
+
+static void bus_send(const uint8_t *frame, uint16_t length, void *arg){
+    (void)arg;
+    modbus_send_frame(frame, length);
+}
+
+/**
+ * @brief Sends one sample to core 0.
+ *
+ * The record goes through the sample ring; the FIFO only carries a doorbell word to wake
+ * core 0 up. Core 1 never blocks here: a full ring drops the record (counted), and a full
+ * FIFO means core 0 already has doorbells pending.
+ */
+
+static void push_sample(uint8_t index, int16_t level_cdB, uint32_t acquired_us, uint8_t flags){
+    uint64_t now_us = time_us_64();
+    measurement_t record = {
+        .timestamp_us = now_us - (uint32_t)((uint32_t)now_us - acquired_us),   // Extend the acquisition time to 64 bits
+        .level_cdB = level_cdB,
+        .sensor = index,
+        .flags = flags,
+    };
+
+    if (sample_ring_push(&sample_ring, &record) && multicore_fifo_wready()) {
+        multicore_fifo_push_blocking(0);                                      // Doorbell (does not block: there is room)
+    }
+}
+
+/**
+ * @brief Sample callback of the bus scheduler.
+ *
+ * The first register of each sensor holds the decibel value (dB x 10); the acquisition
+ * time is the moment the sensor was asked.
+ */
+
+static void bus_sample(uint8_t index, const modbus_bus_device_t *device, modbus_status_t status, void *arg){
+    (void)arg;
+
+    if (status != MODBUS_STATUS_OK) {
+        push_sample(index, 0, device->last_request_us, MEASUREMENT_FLAG_INVALID); // Failures go too (the bus counts the cause)
+        return;
+    }
+
+    uint16_t value = device->registers[0];                                     // dB x 10
+    push_sample(index, (value > INT16_MAX / 10) ? INT16_MAX : (int16_t)(value * 10), device->last_request_us, 0);
+}
+
+#if MODBUS_BAUD_NEGOTIATION
+
+/**
+ * @brief Transaction callback of the baud rate negotiation link.
+ */
+
+static bool link_transact(void *ctx, const uint8_t *request, uint16_t request_length,
+                          uint8_t *frame, uint16_t *frame_length, bool *crc_ok, uint32_t *latency_us){
+    (void)ctx;
+    return modbus_transaction(request, request_length, frame, frame_length, crc_ok, latency_us);
+}
+
+/**
+ * @brief Baud rate callback of the baud rate negotiation link.
+ */
+
+static void link_set_baud(void *ctx, uint32_t baud_rate){
+    (void)ctx;
+    modbus_set_baud_rate(baud_rate);
+}
+
+/**
+ * @brief Switches the sensors to MODBUS_TARGET_BAUD_RATE and reports the latency gain.
+ */
+
+static void negotiate_baud_rate(){
+    const modbus_link_t link = {
+        .transact = link_transact,
+        .set_baud = link_set_baud,
+        .ctx = NULL,
+    };
+
+    modbus_baud_result_t result = modbus_baud_negotiate(&link, bus_devices, count_of(bus_devices),
+                                                        BAUD_RATE, MODBUS_TARGET_BAUD_RATE);
+
+    printf("Modbus: %lu baud (%s). Latencia media %lu us a %lu baud, %lu us a %lu baud\n",
+           (unsigned long)result.baud_rate, result.switched ? "negociado" : "padrao",
+           (unsigned long)modbus_latency_mean_us(&result.before), (unsigned long)BAUD_RATE,
+           (unsigned long)modbus_latency_mean_us(&result.after), (unsigned long)MODBUS_TARGET_BAUD_RATE);
+}
+
+#endif
+
+/**
+ * @brief Publishes the live state of a sensor from its micdata entry (core 0).
+ *
+ * @param index Index of the sensor.
+ */
+
+static void publish_live_state(uint8_t index){
+    const micdata_t *sensor = &micdata[index];
+    live_sensor_t live = {
+        .last = sensor->last,
+        .summary = sensor->summary,
+        .window_s = sensor->window_s,
+    };
+
+    live_state_write(&live_state[index], &live);
+}
+
+/**
+ * @brief Prints and clears the task statistics of a scheduler.
+ *
+ * @param core Name of the core.
+ * @param sched Scheduler of that core (only called from that core).
+ */
+
+static void report_scheduler_statistics(const char *core, scheduler_t *sched){
+    for (uint8_t i = 0; i < sched->task_count; i++) {
+        const scheduler_task_t *task = &sched->tasks[i];
+        printf("Tarefa %s/%s: %lu execucoes, tempo med/max %lu/%lu us, atraso max %lu us, %lu prazos perdidos, %lu periodos pulados\n",
+               core, task->name, (unsigned long)task->runs,
+               (unsigned long)(task->runs ? task->total_runtime_us / task->runs : 0),
+               (unsigned long)task->max_runtime_us, (unsigned long)task->max_lateness_us,
+               (unsigned long)task->overruns, (unsigned long)task->skipped);
+    }
+    scheduler_reset_stats(sched);
+}
+
+/**
+ * @brief Prints the statistics of the sampling clock, of the Modbus bus, of the core 1 tasks and the live levels.
+ */
+
+static void report_sampling_statistics(void *arg){
+    uint32_t rate = modbus_bus_take_poll_rate(&modbus_bus, time_us_32());
+
+    if (sample_clock.acquisitions > 0) {
+        printf("Amostragem: periodo %lu us, %lu prazos perdidos, jitter min/med/max %lu/%lu/%lu us\n",
+               (unsigned long)sample_clock.period_us, (unsigned long)sample_clock.missed_deadlines,
+               (unsigned long)sample_clock.jitter_min_us,
+               (unsigned long)(sample_clock.jitter_sum_us / sample_clock.acquisitions),
+               (unsigned long)sample_clock.jitter_max_us);
+    }
+    sample_clock_reset_jitter(&sample_clock);
+
+    printf("Fila de amostras: %lu descartadas, ocupacao maxima %lu/%d\n",
+           (unsigned long)sample_ring.overflows, (unsigned long)sample_ring.high_water, SAMPLE_RING_SIZE);
+
+    printf("Barramento Modbus: %lu.%02lu leituras/s, %lu rodadas, latencia min/med/max %lu/%lu/%lu us\n",
+           (unsigned long)(rate / 100), (unsigned long)(rate % 100), (unsigned long)modbus_bus.rounds,
+           (unsigned long)(modbus_bus.latency.count ? modbus_bus.latency.min_us : 0),
+           (unsigned long)modbus_latency_mean_us(&modbus_bus.latency), (unsigned long)modbus_bus.latency.max_us);
+    modbus_latency_reset(&modbus_bus.latency);
+
+    for (uint8_t i = 0; i < modbus_bus.device_count; i++) {
+        const modbus_bus_device_t *dev = &modbus_bus.devices[i];
+        printf("  Sensor 0x%02X: %lu leituras, %lu respostas, %lu timeouts, %lu erros de CRC, %lu ressincronizacoes, %lu excecoes (ultima 0x%02X), %lu erros\n",
+               dev->cfg.device_address, (unsigned long)dev->polls, (unsigned long)dev->responses,
+               (unsigned long)dev->timeouts, (unsigned long)dev->crc_errors, (unsigned long)dev->resyncs,
+               (unsigned long)dev->exceptions, dev->last_exception, (unsigned long)dev->errors);
+    }
+
+    report_scheduler_statistics("core1", &core1_scheduler);
+
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        live_sensor_t live;
+        live_state_read(&live_state[i], &live);                                 // Torn-free copy, never blocks core 0
+        char level[12];
+        char leq[12];
+        measurement_format_fixed(level, sizeof(level), live.last.level_cdB, 2);
+        measurement_format_fixed(leq, sizeof(leq), live.summary.leq_cdB, 2);
+        printf("  Nivel %u: %s dB, Leq %s dB (janela de %lu s)\n",
+               i, level, leq, (unsigned long)live.window_s);
+    }
+}
+
+/**
+ * @brief Sampling task of core 1 (polled on every pass): starts the polling rounds and handles the Modbus frames.
+ */
+
+static void sampling_task(void *arg){
+    uint64_t scheduled_us;
+    if (sample_clock_take_tick(&sample_clock, &scheduled_us)) {                                         // Start the round as close to the tick as possible
+        uint64_t now_us = time_us_64();
+
+        if (modbus_bus_start_round(&modbus_bus, (uint32_t)now_us)) {
+            sample_clock_record_acquisition(&sample_clock, scheduled_us, now_us);
+        } else {
+            sample_clock_miss(&sample_clock);                                                           // Previous round still running: deadline missed
+        }
+    }
+
+    uint8_t frame[MODBUS_RTU_MAX_FRAME];
+    uint16_t frame_length;
+    bool frame_crc_ok;
+    if (modbus_poll_frame(frame, &frame_length, &frame_crc_ok)) {                                       // Non-blocking: true once a frame was delimited
+        modbus_bus_on_frame(&modbus_bus, frame, frame_length, frame_crc_ok, time_us_32());              // Parse the response and poll the next sensor right away
+    }
+
+    modbus_bus_poll(&modbus_bus, time_us_32());                                                         // Handle response timeouts
+}
+
+#if MIC_ADC_ENABLED
+/**
+ * @brief Microphone task of core 1 (polled on every pass): one weighted level per channel and DMA block.
+ */
+
+static void mic_task(void *arg){
+    const uint16_t *block;
+    uint32_t block_start_us;
+    if (!mic_get_block(&block, &block_start_us)) {
+        return;
+    }
+
+    int32_t levels_cdB[MIC_CHANNEL_COUNT];
+    mic_block_levels(block, levels_cdB);
+
+    for (uint8_t ch = 0; ch < MIC_CHANNEL_COUNT; ch++) {
+        push_sample(ADC_SENSOR_INDEX + ch, (int16_t)levels_cdB[ch], block_start_us, MEASUREMENT_FLAG_ADC);  // Full hundredth of dB resolution
+    }
+
+#if MIC_SPECTRUM_ENABLED
+    mic_block_spectrum(block);                                                                          // 1/3-octave bands (one FFT every few blocks)
+#endif
+    mic_release_block();
+}
+#endif
+
+/**
+ * @brief Wi-Fi connection check task of core 1.
+ */
+
+static void wifi_task(void *arg){
+    check_wifi_connection();
+}
+
+/**
+ * @brief MQTT connection check task of core 1.
+ */
+
+static void mqtt_task(void *arg){
+    check_mqtt_connection();
+}
 
 void core1_entry(){
 
+    uart_modbus_config();                                                                               // Configure UART for Modbus communication (RX IRQ runs on core 1)
+
+#if MODBUS_BAUD_NEGOTIATION
+    negotiate_baud_rate();                                                                              // Switch the sensors to a faster baud rate, falling back to BAUD_RATE
+#endif
+
+    modbus_bus_init(&modbus_bus, bus_devices, count_of(bus_devices),
+                    MODBUS_RESPONSE_TIMEOUT_MS * 1000,
+                    bus_send, bus_sample, NULL, time_us_32());                                          // Poll every configured sensor in round-robin
+
+    sample_clock_start(&sample_clock, SAMPLE_PERIOD_MS * 1000);                                         // One polling round per sampling period (alarm IRQ on core 1)
+
+#if MIC_ADC_ENABLED
+    setup_mic();                                                                                        // Continuous ADC capture of the analog microphone (DMA IRQ on core 1)
+#endif
+
+    // Sampling always comes first: it runs again between two housekeeping tasks
+    scheduler_init(&core1_scheduler, time_us_64);
+    scheduler_add(&core1_scheduler, "amostragem", sampling_task, NULL, 0, SAMPLE_PERIOD_MS * 1000, 0);
+#if MIC_ADC_ENABLED
+    scheduler_add(&core1_scheduler, "microfone", mic_task, NULL, 0, 0, 1);
+#endif
+    scheduler_add(&core1_scheduler, "wifi", wifi_task, NULL, WIFI_CHECK_PERIOD_MS * 1000, WIFI_CHECK_PERIOD_MS * 1000, 2);
+    scheduler_add(&core1_scheduler, "mqtt", mqtt_task, NULL, MQTT_CHECK_PERIOD_MS * 1000, MQTT_CHECK_PERIOD_MS * 1000, 3);
+    scheduler_add(&core1_scheduler, "relatorio", report_sampling_statistics, NULL, MODBUS_BUS_REPORT_INTERVAL_MS * 1000, 0, 4);
+
     while(true){
 
-        check_wifi_connection();                                                                        // Check the Wi-Fi connection status
-        check_mqtt_connection();                                                                        // Check the MQTT connection status
+        while (scheduler_run_once(&core1_scheduler)) {                                                  // Run every due task
+        }
+
+        // Sleep until the next byte (UART IRQ wakes the core), the next tick (alarm IRQ), the next DMA block or the next scheduled event
+        absolute_time_t next_event = make_timeout_time_us(modbus_bus_next_event_us(&modbus_bus, time_us_32()));
+        absolute_time_t next_release = from_us_since_boot(scheduler_next_release_us(&core1_scheduler));
+        if (absolute_time_diff_us(next_release, next_event) > 0) {
+            next_event = next_release;
+        }
+        best_effort_wfe_or_timeout(modbus_rx_wakeup_time(next_event));
+
+    }
+}
+
+/**
+ * @brief Sample processing task of core 0 (polled on every pass): drains the sample ring.
+ */
+
+static void samples_task(void *arg){
+    while (multicore_fifo_rvalid()) {
+        multicore_fifo_pop_blocking();                      // Clear the doorbells: the ring is drained below
+    }
+
+    if (rollup_restore_pending && rtc_local_time_synced()) {
+        for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+            micdata[i].rollup = state_image.sensors[i].rollup;  // Windows aligned on the local clock: continued from here
+        }
+        rollup_restore_pending = false;
+    }
+
+    measurement_t record;
+    while (sample_ring_pop(&sample_ring, &record)) {
+
+        if (record.sensor >= SENSOR_COUNT || (record.flags & MEASUREMENT_FLAG_INVALID)) {
+            continue;                                       // Failed readings are counted by the bus on core 1
+        }
+
+        micdata_t *sensor = &micdata[record.sensor];
+        sensor->last = record;                              // Level and acquisition time, unchanged fixed-point record
+
+        get_media_min_max_dB(sensor);                       // Calculate the average dB value, max dB, and min dB. MQTT Publish function it's called here.
+        detect_events(sensor);                              // Threshold exceedance alerts, raised on this very sample
+        publish_live_state(record.sensor);                  // Snapshot for the readers (display, statistics report)
+    }
+}
+
+/**
+ * @brief Display refresh task of core 0.
+ */
+
+static void display_task(void *arg){
+    live_sensor_t live;
+    live_state_read(&live_state[0], &live);
+    update_display_db_value(&live);                         // Update dB value on the display (first sensor)
+}
+
+/**
+ * @brief MQTT alert task of core 0 (polled on every pass): sends the queued alerts.
+ */
+
+static void alert_task(void *arg){
+    mqtt_alert_service();
+}
+
+/**
+ * @brief MQTT publisher task of core 0: drains the publish queue.
+ */
+
+static void publisher_task(void *arg){
+    mqtt_publisher_service();
+}
+
+/**
+ * @brief Backlog drain task of core 0: resends the data saved to flash, a little per run.
+ */
+
+static void backlog_task(void *arg){
+    mqtt_backlog_service();
+}
+
+/**
+ * @brief Copies the aggregation state of every sensor into the checkpoint image and seals it.
+ *
+ * Restored windows that still wait for the local clock stay in the image as they are.
+ */
 
-        modbus_read_registers(micdata.device_address, micdata.start_address, micdata.num_registers);    // Read Modbus registers from the microphone
+static void capture_state(){
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        if (!rollup_restore_pending) {
+            state_image.sensors[i].rollup = micdata[i].rollup;
+        }
+        state_image.sensors[i].dose = micdata[i].dose;
+    }
+    checkpoint_seal(&state_image.header, (const uint32_t *)state_image.sensors, STATE_IMAGE_WORDS);
+}
+
+/**
+ * @brief Restores the aggregation state saved before the last reset.
+ *
+ * The RAM image is used after a soft reset; after a power loss (RAM content invalid)
+ * the newest valid flash copy is used instead. The windows are aligned on the local
+ * clock, which may not be synchronized yet: they are only taken by samples_task() once it
+ * is, and the levels before go to windows on the time since boot, which the first
+ * synchronization restarts.
+ */
+
+static void restore_state(){
+    uint64_t start_us = time_us_64();
+    const char *source = "RAM";
+    checkpoint_header_t header;
+
+    int slot = flash_probe_checkpoint(checkpoint_files, &header, STATE_IMAGE_WORDS);   // The next flash write goes to the other copy
+    flash_sequence = (slot < 0) ? 0 : header.sequence;
+    flash_crc = (slot < 0) ? UINT32_MAX : header.crc;             // Out of the CRC16 range: always written
 
-        uint16_t decibel_value = parse_decibel_value(micdata.response);                                    // Parse the response to get the decibel value
+    if (!checkpoint_valid(&state_image.header, (const uint32_t *)state_image.sensors, STATE_IMAGE_WORDS)) {
+        source = "flash";
+        if (flash_load_checkpoint(checkpoint_files, &state_image.header, (uint32_t *)state_image.sensors, STATE_IMAGE_WORDS) < 0) {
+            state_image.header = (checkpoint_header_t){0};
+            printf("Nenhum checkpoint valido: agregacao reiniciada\n");
+            return;
+        }
+        flash_sequence = state_image.header.sequence;   // The next write replaces the newer copy if it was bad
+        flash_crc = state_image.header.crc;
+    }
 
-        multicore_fifo_push_blocking(decibel_value);                                               // Push the converted value to the FIFO for core 0 to process
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        micdata[i].dose = state_image.sensors[i].dose;
+        micdata[i].dose.last_us = 0;                    // Timer restarted: no previous level
+    }
+    rollup_restore_pending = true;
 
-        sleep_ms(300);                                                                                  // Sleep for 300 milliseconds before the next iteration
+    printf("Checkpoint %lu restaurado da %s em %lu us\n", (unsigned long)state_image.header.sequence, source,
+           (unsigned long)(time_us_64() - start_us));
+}
 
+/**
+ * @brief RAM checkpoint task of core 0: keeps the image that survives soft resets up to date.
+ */
+
+static void checkpoint_ram_task(void *arg){
+    uint64_t start_us = time_us_64();
+    capture_state();
+    uint32_t elapsed_us = (uint32_t)(time_us_64() - start_us);
+    if (elapsed_us > checkpoint_ram_max_us) {
+        checkpoint_ram_max_us = elapsed_us;
     }
 }
 
+/**
+ * @brief Flash checkpoint task of core 0: writes the image to the older of the two flash copies.
+ *
+ * Wear is bounded by the period, by skipping unchanged state and by the run-length coding
+ * of the (mostly empty) histograms; LittleFS spreads the writes over the blocks.
+ */
+
+static void checkpoint_flash_task(void *arg){
+    uint64_t start_us = time_us_64();
+    capture_state();
+    if (state_image.header.crc == flash_crc) {
+        return;
+    }
+
+    checkpoint_header_t header = state_image.header;
+    header.sequence = flash_sequence + 1;
+    uint32_t bytes = flash_save_checkpoint(checkpoint_files[header.sequence % CHECKPOINT_SLOTS], &header,
+                                           (const uint32_t *)state_image.sensors);
+    if (bytes == 0) {
+        return;
+    }
+
+    flash_sequence = header.sequence;
+    flash_crc = header.crc;
+    checkpoint_flash_writes++;
+    checkpoint_flash_bytes = bytes;
+
+    uint32_t elapsed_us = (uint32_t)(time_us_64() - start_us);
+    if (elapsed_us > checkpoint_flash_max_us) {
+        checkpoint_flash_max_us = elapsed_us;
+    }
+}
+
+/**
+ * @brief Task, publish queue and alert statistics report of core 0.
+ */
+
+static void core0_report_task(void *arg){
+    report_scheduler_statistics("core0", &core0_scheduler);
+
+    printf("Fila de publicacao: %u/%d registros, ocupacao maxima %u, %lu enfileirados, %lu confirmados, %lu salvos em flash, %lu descartados, latencia med/max %lu/%lu us\n",
+           publish_queue.count, PUBLISH_QUEUE_SIZE, publish_queue.high_water,
+           (unsigned long)publish_queue.queued, (unsigned long)publish_queue.sent,
+           (unsigned long)publish_queue.spilled, (unsigned long)publish_queue.dropped,
+           (unsigned long)publish_queue_latency_mean_us(&publish_queue), (unsigned long)publish_queue.latency_max_us);
+
+    printf("Alertas: %lu detectados, %lu enviados, %lu descartados, latencia deteccao-publicacao min/med/max %lu/%lu/%lu us\n",
+           (unsigned long)alert_queue.raised, (unsigned long)alert_queue.sent, (unsigned long)alert_queue.dropped,
+           (unsigned long)alert_queue.latency_min_us,
+           (unsigned long)(alert_queue.sent ? alert_queue.latency_sum_us / alert_queue.sent : 0),
+           (unsigned long)alert_queue.latency_max_us);
+
+    static uint32_t last_messages;                          // Messages at the previous report (for the rate)
+    static uint64_t last_report_us;
+    uint64_t now_us = time_us_64();
+    uint32_t messages = publish_batch_stats.messages - last_messages;
+    uint32_t rate_c = last_report_us ? (uint32_t)(messages * 100000000ull / (now_us - last_report_us)) : 0;
+    last_messages = publish_batch_stats.messages;
+    last_report_us = now_us;
+
+    printf("Mensagens MQTT: %lu enviadas, %lu.%02lu mensagens/s, %lu registros (max %u por mensagem), %lu bytes/registro\n",
+           (unsigned long)publish_batch_stats.messages, (unsigned long)(rate_c / 100), (unsigned long)(rate_c % 100),
+           (unsigned long)publish_batch_stats.records, publish_batch_stats.max_records,
+           (unsigned long)(publish_batch_stats.records ? publish_batch_stats.bytes / publish_batch_stats.records : 0));
+
+    printf("PUBACK: %u/%d mensagens em voo (max %u), %lu confirmadas, %lu falhas, %lu registros reenviados, latencia med/max %lu/%lu us\n",
+           publish_tracker.count, MQTT_INFLIGHT_WINDOW, publish_tracker.max_depth,
+           (unsigned long)publish_tracker.acked, (unsigned long)publish_tracker.failed, (unsigned long)publish_tracker.retries,
+           (unsigned long)publish_tracker_ack_latency_mean_us(&publish_tracker), (unsigned long)publish_tracker.ack_latency_max_us);
+
+    uint32_t drain_rate_c = backlog_stats.active_us ? (uint32_t)(backlog_stats.files_acked * 100000000ull / backlog_stats.active_us) : 0;
+    printf("Backlog: janela %u, %lu arquivos enviados, %lu confirmados (%lu.%02lu arquivos/s), %lu recusas, latencia dos dados ao vivo med/max %lu/%lu us\n",
+           backlog_stats.window, (unsigned long)backlog_stats.files_sent, (unsigned long)backlog_stats.files_acked,
+           (unsigned long)(drain_rate_c / 100), (unsigned long)(drain_rate_c % 100), (unsigned long)backlog_stats.refused,
+           (unsigned long)(backlog_stats.live_records ? backlog_stats.live_latency_sum_us / backlog_stats.live_records : 0),
+           (unsigned long)backlog_stats.live_latency_max_us);
+
+    printf("Checkpoint: RAM max %lu us, flash %lu gravacoes de %lu bytes, max %lu us\n",
+           (unsigned long)checkpoint_ram_max_us, (unsigned long)checkpoint_flash_writes,
+           (unsigned long)checkpoint_flash_bytes, (unsigned long)checkpoint_flash_max_us);
+}
+
 //Main function of the program
 int main()
 {
     stdio_init_all();                // Initialize standard serial communication
     init_filesystem();               // Initialize the filesystem for data storage
     setup_display();                 // Initialize the OLED display
-    uart_modbus_config();            // Configure UART for Modbus communication
     wifi_init();                     // Initialize the Wi-Fi module
     start_mqtt_client();             // Start the MQTT client for remote communication
     init_and_sync_rtc();             // Configure the date and time settings
 
-    micdata.device_address = 0x01;      // SM7901 Microphone Modbus address
-    micdata.start_address = 0x0000;    // Start address for Modbus registers
-    micdata.num_registers = 1;         // Number of registers to read
-    micdata.sensor_id = SENSOR_ID;      // Set the sensor ID for the microphone
-    micdata.latitude = MAP_LATITUDE;    // Set the latitude of the microphone
-    micdata.longitude = MAP_LONGITUDE;  // Set the longitude of the microphone
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        sensor_config[i].sensor_id = SENSOR_ID + i;                    // Set the sensor ID of each microphone
+        sensor_config[i].latitude_e6 = MEASUREMENT_COORD_E6(MAP_LATITUDE);   // Set the latitude of the microphone
+        sensor_config[i].longitude_e6 = MEASUREMENT_COORD_E6(MAP_LONGITUDE); // Set the longitude of the microphone
+        sensor_config[i].event_threshold_cdB = EVENT_THRESHOLD_CDB;    // Alert threshold of the microphone
+        sensor_config[i].event_hysteresis_cdB = EVENT_HYSTERESIS_CDB;
+        sensor_config[i].event_min_duration_ms = EVENT_MIN_DURATION_MS;
+        micdata[i].config = &sensor_config[i];
+        event_detector_init(&micdata[i].event, sensor_config[i].event_threshold_cdB,
+                            sensor_config[i].event_hysteresis_cdB, sensor_config[i].event_min_duration_ms * 1000);
+    }
+    mqtt_payload_init(sensor_config, SENSOR_COUNT);  // Static JSON fields (identifier, location) of each sensor
+
+    restore_state();                     // Open windows and noise dose accumulated before the last reset
+
+#if MIC_ADC_ENABLED && MIC_SPECTRUM_ENABLED
+    sensor_config[ADC_SENSOR_INDEX].spectrum = true;   // The first microphone channel carries the 1/3-octave bands
+#endif
+
+    spin_lock_t *live_lock = spin_lock_init(spin_lock_claim_unused(true));
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        live_state_init(&live_state[i], live_lock);  // All sensors share one writer spinlock
+    }
 
     multicore_launch_core1(core1_entry); // Launch core 1 for multi-core processing
 
+    scheduler_init(&core0_scheduler, time_us_64);
+    scheduler_add(&core0_scheduler, "amostras", samples_task, NULL, 0, 0, 0);
+    scheduler_add(&core0_scheduler, "alertas", alert_task, NULL, 0, 0, 1);
+    scheduler_add(&core0_scheduler, "publicacao", publisher_task, NULL, PUBLISH_QUEUE_PERIOD_MS * 1000, PUBLISH_QUEUE_PERIOD_MS * 1000, 2);
+    scheduler_add(&core0_scheduler, "backlog", backlog_task, NULL, MQTT_DRAIN_PERIOD_MS * 1000, 0, 3);
+    scheduler_add(&core0_scheduler, "display", display_task, NULL, DISPLAY_UPDATE_PERIOD_MS * 1000, DISPLAY_UPDATE_PERIOD_MS * 1000, 4);
+    scheduler_add(&core0_scheduler, "ckpt_ram", checkpoint_ram_task, NULL, CHECKPOINT_RAM_PERIOD_MS * 1000, 0, 5);
+    scheduler_add(&core0_scheduler, "ckpt_flash", checkpoint_flash_task, NULL, CHECKPOINT_FLASH_PERIOD_MS * 1000, 0, 6);
+    scheduler_add(&core0_scheduler, "relatorio", core0_report_task, NULL, MODBUS_BUS_REPORT_INTERVAL_MS * 1000, 0, 7);
+
     // Main loop of the program
     while (true) {
 
         // CHECK CORE 1 LOGIC IF YOU NEED TO UNDERSTAND HOW IT WORKS
 
-        uint16_t decibel_value = multicore_fifo_pop_blocking(); // Pop the decibel value from the FIFO
-
-        micdata.dB = decibel_value / 10.0F;                      // Convert the decibel value to float and store it in micdata
+        while (scheduler_run_once(&core0_scheduler)) {          // Run every due task
+        }
 
-        get_media_min_max_dB(&micdata);                         // Calculate the average dB value, max dB, and min dB. MQTT Publish function it's called here.
-
-        update_display_db_value(&micdata);                      // Update dB value on the display
-        
+        best_effort_wfe_or_timeout(from_us_since_boot(scheduler_next_release_us(&core0_scheduler)));  // The doorbell push (SEV) wakes the core up
     }
 
     return 0; // Only for compilation purposes
-}
\ No newline at end of file
+}
@@ -0,0 +1,114 @@
+#include <math.h>         // Math library for square root and logarithm functions
+#include "inc/audio_dsp.h"
+#include "inc/fixmath.h"
+#include "inc/config.h"
+
+#define AUDIO_SUMSQ_CHUNK 512   // Samples accumulated in 32 bits before folding into 64 bits (512 * 2048^2 = 2^31)
+
+/**
+ * @brief Computes the sum of squares of a block of ADC samples.
+ *
+ * @param samples Pointer to the raw 12-bit ADC samples.
+ * @param count Number of samples in the block.
+ * @param offset DC offset of the signal (mid-scale of the ADC).
+ *
+ * A 12-bit deviation squared fits in 22 bits, so chunks of AUDIO_SUMSQ_CHUNK samples are
+ * accumulated with cheap 32-bit additions and only folded into the 64-bit total once
+ * per chunk (64-bit arithmetic is emulated on the Cortex-M0+).
+ *
+ * @return The sum of the squared deviations from offset.
+ */
+
+uint64_t audio_block_sum_squares(const uint16_t *samples, uint32_t count, int32_t offset){
+    uint64_t total = 0;
+
+    while (count > 0) {
+        uint32_t chunk = (count < AUDIO_SUMSQ_CHUNK) ? count : AUDIO_SUMSQ_CHUNK;
+        uint32_t partial = 0;
+
+        for (uint32_t i = 0; i < chunk; i++) {
+            int32_t value = (int32_t)samples[i] - offset;
+            partial += (uint32_t)(value * value);
+        }
+
+        total += partial;
+        samples += chunk;
+        count -= chunk;
+    }
+
+    return total;
+}
+
+/**
+ * @brief Converts a sum of squares to a sound level in centi-dB.
+ *
+ * @param sum_squares Sum of the squared deviations.
+ * @param count Number of samples the sum covers.
+ *
+ * 20 * log10(rms) = 10 * log10(sum_squares / count), computed as a difference of two
+ * fixed-point log2 values, so neither the division, the square root nor the logarithm
+ * needs floating point. RMS_REFERENCE is taken as 1.0 here: fold any other reference
+ * into MIC_DB_OFFSET. A silent block is clamped to an RMS of one count.
+ *
+ * @return The sound level in hundredths of dB.
+ */
+
+int32_t audio_sum_squares_to_cdB(uint64_t sum_squares, uint32_t count){
+    if (count == 0) {
+        return 0;
+    }
+
+    if (sum_squares < count) {
+        sum_squares = count; // Mean square below one count
+    }
+
+    int32_t log2_mean_square = fix_log2_q16(sum_squares) - fix_log2_q16(count);
+    return fix_log2_q16_to_cdB(log2_mean_square) + (int32_t)(MIC_DB_OFFSET * 100);
+}
+
+/**
+ * @brief Computes the RMS value of a block of ADC samples.
+ *
+ * @param samples Pointer to the raw 12-bit ADC samples.
+ * @param count Number of samples in the block.
+ * @param offset DC offset of the signal (mid-scale of the ADC).
+ *
+ * This is the original floating-point kernel, kept as a reference for the integer path
+ * (soft-float sqrt and log10 are slow on the RP2040, which has no FPU).
+ *
+ * @return The RMS value in ADC counts.
+ */
+
+float audio_block_rms(const uint16_t *samples, uint32_t count, int32_t offset){
+    if (count == 0) {
+        return 0.0F;
+    }
+
+    float sum = 0.0F; // Variable to store the sum of squared differences
+
+    // Compute the sum of squared differences from the offset
+    for (uint32_t i = 0; i < count; i++) {
+        float value = (float)((int32_t)samples[i] - offset); // Calculate the difference from the offset
+        sum += value * value;                                // Add the squared difference to the sum
+    }
+
+    return sqrtf(sum / count);
+}
+
+/**
+ * @brief Converts an RMS value to a sound level in dB.
+ *
+ * @param rms RMS value in ADC counts.
+ *
+ * A silent block (rms of zero) is clamped to one count to avoid log10(0).
+ *
+ * @return The sound level in dB.
+ */
+
+float audio_rms_to_dB(float rms){
+    if (rms < 1.0F) {
+        rms = 1.0F;
+    }
+
+    return 20.0F * log10f(rms / RMS_REFERENCE) + MIC_DB_OFFSET;
+}
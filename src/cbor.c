@@ -0,0 +1,109 @@
+#include "inc/cbor.h"
+
+// Major types of the initial byte
+#define CBOR_MAJOR_UINT 0
+#define CBOR_MAJOR_NEGINT 1
+#define CBOR_MAJOR_ARRAY 4
+#define CBOR_MAJOR_MAP 5
+#define CBOR_MAJOR_TAG 6
+
+/**
+ * @brief Starts writing into a buffer.
+ *
+ * @param writer Writer to initialize.
+ * @param buf Output buffer.
+ * @param size Size of the buffer.
+ */
+
+void cbor_writer_init(cbor_writer_t *writer, uint8_t *buf, size_t size){
+    writer->buf = buf;
+    writer->size = size;
+    writer->length = 0;
+    writer->overflow = false;
+}
+
+/**
+ * @brief Writes the head of an item: major type and argument, in the shortest form.
+ *
+ * @param writer Writer.
+ * @param major Major type.
+ * @param value Argument (value, length or tag).
+ */
+
+static void put_head(cbor_writer_t *writer, uint8_t major, uint64_t value){
+    uint8_t extra;
+    uint8_t info;
+
+    if (value < 24) {
+        extra = 0;
+        info = (uint8_t)value;
+    } else if (value <= UINT8_MAX) {
+        extra = 1;
+        info = 24;
+    } else if (value <= UINT16_MAX) {
+        extra = 2;
+        info = 25;
+    } else if (value <= UINT32_MAX) {
+        extra = 4;
+        info = 26;
+    } else {
+        extra = 8;
+        info = 27;
+    }
+
+    if (writer->overflow || writer->size - writer->length < 1u + extra) {
+        writer->overflow = true;
+        return;
+    }
+
+    uint8_t *out = writer->buf + writer->length;
+    out[0] = (uint8_t)(major << 5) | info;
+    for (uint8_t i = 0; i < extra; i++) {
+        out[1 + i] = (uint8_t)(value >> (8 * (extra - 1 - i)));    // Big-endian
+    }
+    writer->length += 1u + extra;
+}
+
+/**
+ * @brief Writes an unsigned integer.
+ */
+
+void cbor_put_uint(cbor_writer_t *writer, uint64_t value){
+    put_head(writer, CBOR_MAJOR_UINT, value);
+}
+
+/**
+ * @brief Writes a signed integer.
+ */
+
+void cbor_put_int(cbor_writer_t *writer, int64_t value){
+    if (value < 0) {
+        put_head(writer, CBOR_MAJOR_NEGINT, (uint64_t)(-1 - value));   // -1 - n, without overflow at INT64_MIN
+    } else {
+        put_head(writer, CBOR_MAJOR_UINT, (uint64_t)value);
+    }
+}
+
+/**
+ * @brief Writes the head of an array of count items (the items follow).
+ */
+
+void cbor_put_array(cbor_writer_t *writer, uint32_t count){
+    put_head(writer, CBOR_MAJOR_ARRAY, count);
+}
+
+/**
+ * @brief Writes the head of a map of count key/value pairs (the pairs follow).
+ */
+
+void cbor_put_map(cbor_writer_t *writer, uint32_t count){
+    put_head(writer, CBOR_MAJOR_MAP, count);
+}
+
+/**
+ * @brief Writes a tag (the tagged item follows).
+ */
+
+void cbor_put_tag(cbor_writer_t *writer, uint64_t tag){
+    put_head(writer, CBOR_MAJOR_TAG, tag);
+}
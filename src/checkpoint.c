@@ -0,0 +1,206 @@
+#include "inc/checkpoint.h"
+#include "inc/crc16.h"
+
+#define CHECKPOINT_CHUNK_WORDS 32   // Words buffered per read or write call
+
+/**
+ * @brief Seals a payload: fills the header with its size and CRC.
+ *
+ * @param header Header to fill (the sequence is incremented).
+ * @param payload Payload (32-bit words).
+ * @param words Size of the payload in words.
+ */
+
+void checkpoint_seal(checkpoint_header_t *header, const uint32_t *payload, uint32_t words){
+    header->magic = CHECKPOINT_MAGIC;
+    header->sequence++;
+    header->words = words;
+    header->encoded_words = 0;
+    header->crc = crc16_modbus((const uint8_t *)payload, words * sizeof(uint32_t));
+}
+
+/**
+ * @brief Checks that a payload matches its header.
+ *
+ * @param header Header of the payload.
+ * @param payload Payload (32-bit words).
+ * @param words Expected size of the payload in words.
+ * @return true if the magic, the size and the CRC match.
+ */
+
+bool checkpoint_valid(const checkpoint_header_t *header, const uint32_t *payload, uint32_t words){
+    return header->magic == CHECKPOINT_MAGIC && header->words == words &&
+           header->crc == crc16_modbus((const uint8_t *)payload, words * sizeof(uint32_t));
+}
+
+/**
+ * @brief Counts the words of the encoded payload.
+ *
+ * @param payload Payload (32-bit words).
+ * @param words Size of the payload in words.
+ * @return Size of the encoded payload in words.
+ */
+
+static uint32_t encoded_size(const uint32_t *payload, uint32_t words){
+    uint32_t size = 0;
+
+    for (uint32_t i = 0; i < words; ) {
+        if (payload[i] != 0) {
+            size++;
+            i++;
+            continue;
+        }
+        while (i < words && payload[i] == 0) {
+            i++;
+        }
+        size += 2;
+    }
+
+    return size;
+}
+
+/**
+ * @brief Writes a sealed checkpoint: header followed by the encoded payload.
+ *
+ * @param header Sealed header (encoded_words is filled).
+ * @param payload Payload (32-bit words).
+ * @param write Write callback.
+ * @param ctx Context of the callback.
+ * @return true if every block was written.
+ *
+ * Runs of zero words (mostly empty histogram bins) are written as a 0 marker followed
+ * by the length of the run; other words are written as they are. This keeps the flash
+ * copy a fraction of the RAM image, and the flash wear with it.
+ */
+
+bool checkpoint_write(checkpoint_header_t *header, const uint32_t *payload, checkpoint_write_t write, void *ctx){
+    uint32_t chunk[CHECKPOINT_CHUNK_WORDS];
+    uint32_t used = 0;
+
+    header->encoded_words = encoded_size(payload, header->words);
+    if (!write(ctx, header, sizeof(*header))) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header->words; ) {
+        if (used + 2 > CHECKPOINT_CHUNK_WORDS) {
+            if (!write(ctx, chunk, used * sizeof(uint32_t))) {
+                return false;
+            }
+            used = 0;
+        }
+
+        if (payload[i] != 0) {
+            chunk[used++] = payload[i++];
+            continue;
+        }
+
+        uint32_t run = 0;
+        while (i < header->words && payload[i] == 0) {
+            run++;
+            i++;
+        }
+        chunk[used++] = 0;
+        chunk[used++] = run;
+    }
+
+    return used == 0 || write(ctx, chunk, used * sizeof(uint32_t));
+}
+
+/**
+ * @brief Reads the header of a checkpoint.
+ *
+ * @param header Header read.
+ * @param words Expected size of the payload in words.
+ * @param read Read callback.
+ * @param ctx Context of the callback.
+ * @return true if a header with the right magic and size was read.
+ */
+
+bool checkpoint_read_header(checkpoint_header_t *header, uint32_t words, checkpoint_read_t read, void *ctx){
+    return read(ctx, header, sizeof(*header)) && header->magic == CHECKPOINT_MAGIC &&
+           header->words == words && header->encoded_words <= 2 * words;
+}
+
+/**
+ * @brief Reads and checks the payload following a header read by checkpoint_read_header().
+ *
+ * @param header Header of the checkpoint.
+ * @param payload Buffer receiving the payload (header->words words; undefined on failure).
+ * @param read Read callback.
+ * @param ctx Context of the callback.
+ * @return true if the payload was decoded and its CRC matches.
+ *
+ * A copy cut short by a reset during the write, or damaged in flash, fails the size or
+ * CRC check, so the caller can fall back to the other copy.
+ */
+
+bool checkpoint_read_payload(const checkpoint_header_t *header, uint32_t *payload, checkpoint_read_t read, void *ctx){
+    uint32_t chunk[CHECKPOINT_CHUNK_WORDS];
+    uint32_t remaining = header->encoded_words;
+    uint32_t used = 0;
+    uint32_t length = 0;
+    uint32_t out = 0;
+    bool run_pending = false;
+
+    while (remaining > 0 || used < length) {
+        if (used == length) {
+            length = (remaining < CHECKPOINT_CHUNK_WORDS) ? remaining : CHECKPOINT_CHUNK_WORDS;
+            if (!read(ctx, chunk, length * sizeof(uint32_t))) {
+                return false;
+            }
+            remaining -= length;
+            used = 0;
+        }
+
+        uint32_t word = chunk[used++];
+
+        if (run_pending) {                      // Length of a run of zeros
+            if (word == 0 || word > header->words - out) {
+                return false;
+            }
+            for (uint32_t i = 0; i < word; i++) {
+                payload[out++] = 0;
+            }
+            run_pending = false;
+        } else if (word == 0) {
+            run_pending = true;
+        } else {
+            if (out >= header->words) {
+                return false;
+            }
+            payload[out++] = word;
+        }
+    }
+
+    return !run_pending && out == header->words && checkpoint_valid(header, payload, header->words);
+}
+
+/**
+ * @brief Orders the flash copies newest first.
+ *
+ * @param headers Header of each slot.
+ * @param present Whether each slot holds a header with the right magic and size.
+ * @param order Slot indexes to try, newest first.
+ * @return Number of slots to try.
+ */
+
+uint8_t checkpoint_order(const checkpoint_header_t headers[CHECKPOINT_SLOTS], const bool present[CHECKPOINT_SLOTS],
+                         uint8_t order[CHECKPOINT_SLOTS]){
+    uint8_t count = 0;
+
+    for (uint8_t slot = 0; slot < CHECKPOINT_SLOTS; slot++) {
+        if (!present[slot]) {
+            continue;
+        }
+
+        uint8_t pos = count++;
+        while (pos > 0 && (int32_t)(headers[slot].sequence - headers[order[pos - 1]].sequence) > 0) {
+            order[pos] = order[pos - 1];            // Sequence comparison survives the wrap-around
+            pos--;
+        }
+        order[pos] = slot;
+    }
+
+    return count;
+}
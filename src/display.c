@@ -35,27 +35,28 @@ void setup_display()
 /**
  * @brief Updates the display with the decibel (dB) level captured by the microphone.
  *
- * @param micdata Pointer to the micdata_t structure containing the dB value to be displayed.
+ * @param live Pointer to the live state snapshot containing the dB value to be displayed.
  *
  * If dB value is different of last dB value, the dB value is formatted as a string and displayed on the screen. After updating,
  * the area where the information was written is cleared to prevent text overlapping.
  */
 
-void update_display_db_value(micdata_t *micdata)
+void update_display_db_value(const live_sensor_t *live)
 {
     char buffer[16]; // Buffer to store the string to be displayed
-    static float last_db = 0.0; // Variable to store the last dB value displayed
+    static int16_t last_cdB = 0; // Variable to store the last dB value displayed (hundredths of dB)
 
     // Check if the dB value has changed
-    if (micdata->dB != last_db)
+    if (live->last.level_cdB != last_cdB)
     {
-        sprintf(buffer, "dB: %.2f", micdata->dB);    // Format the dB value as a string
+        int len = snprintf(buffer, sizeof(buffer), "dB: ");                                 // Format the dB value as a string
+        measurement_format_fixed(buffer + len, sizeof(buffer) - len, live->last.level_cdB, 2);
 
         ssd1306_clear_area(&disp, 0, 0, 128, 28);    // Clear the area where the dB value was written
         ssd1306_draw_string(&disp, 0, 0, 2, buffer); // Display the dB value on the screen
         ssd1306_show(&disp);                         // Update the screen to show content
 
-        last_db = micdata->dB;                     // Update the last dB value displayed
+        last_cdB = live->last.level_cdB;             // Update the last dB value displayed
     }
     
     else
@@ -0,0 +1,117 @@
+#include <string.h>
+#include "inc/event_detector.h"
+
+/**
+ * @brief Initializes a detector.
+ *
+ * @param det Detector to initialize.
+ * @param threshold_cdB Trigger level, in hundredths of dB.
+ * @param hysteresis_cdB The event ends when the level drops below threshold - hysteresis.
+ * @param min_duration_us Time the level must stay above the threshold before the start alert.
+ */
+
+void event_detector_init(event_detector_t *det, int16_t threshold_cdB, int16_t hysteresis_cdB, uint32_t min_duration_us){
+    memset(det, 0, sizeof(*det));
+    det->threshold_cdB = threshold_cdB;
+    det->release_cdB = threshold_cdB - hysteresis_cdB;
+    det->min_duration_us = min_duration_us;
+    det->state = EVENT_IDLE;
+}
+
+/**
+ * @brief Copies the level history into the event, oldest first.
+ *
+ * @param det Detector.
+ */
+
+static void capture_history(event_detector_t *det){
+    uint8_t first = (det->history_head + EVENT_CAPTURE_SAMPLES - det->history_count) % EVENT_CAPTURE_SAMPLES;
+
+    for (uint8_t i = 0; i < det->history_count; i++) {
+        det->event.samples[i] = det->history[(first + i) % EVENT_CAPTURE_SAMPLES];
+    }
+    det->event.sample_count = det->history_count;
+}
+
+/**
+ * @brief Adds one level to the detector.
+ *
+ * @param det Detector.
+ * @param sample Valid measurement of the sensor.
+ * @param cb Callback of the alerts.
+ * @param arg User argument of the callback.
+ *
+ * A start alert is raised once the level has stayed at or above the threshold for the
+ * minimum duration (at once if it is 0). The end alert is raised once the level has
+ * dropped below the release level and EVENT_CAPTURE_SAMPLES levels were collected after
+ * the trigger; a new event can only start after it.
+ */
+
+void event_detector_add(event_detector_t *det, const measurement_t *sample, event_cb_t cb, void *arg){
+    int16_t level = sample->level_cdB;
+
+    if (det->state == EVENT_ACTIVE || det->state == EVENT_ENDING) {
+        if (det->event.sample_count < EVENT_CAPTURE_SAMPLES) {
+            det->event.samples[det->event.sample_count++] = *sample;   // Levels after the trigger
+        }
+    }
+
+    det->history[det->history_head] = *sample;
+    det->history_head = (det->history_head + 1) % EVENT_CAPTURE_SAMPLES;
+    if (det->history_count < EVENT_CAPTURE_SAMPLES) {
+        det->history_count++;
+    }
+
+    switch (det->state) {
+    case EVENT_IDLE:
+        if (level < det->threshold_cdB) {
+            break;
+        }
+        det->event.onset_us = sample->timestamp_us;
+        det->event.peak_cdB = level;
+        det->state = EVENT_PENDING;
+        // The minimum duration may be 0
+        // fall through
+
+    case EVENT_PENDING:
+        if (level < det->threshold_cdB) {
+            det->state = EVENT_IDLE;                    // Too short: no alert
+            break;
+        }
+        if (level > det->event.peak_cdB) {
+            det->event.peak_cdB = level;
+        }
+        if (sample->timestamp_us - det->event.onset_us < det->min_duration_us) {
+            break;
+        }
+
+        det->event.trigger_us = sample->timestamp_us;
+        det->event.end_us = 0;
+        det->event.threshold_cdB = det->threshold_cdB;
+        capture_history(det);                           // Levels up to the trigger
+        cb(EVENT_START, &det->event, arg);
+
+        det->event.sample_count = 0;                    // Now collects the levels after the trigger
+        det->state = EVENT_ACTIVE;
+        break;
+
+    case EVENT_ACTIVE:
+        if (level > det->event.peak_cdB) {
+            det->event.peak_cdB = level;
+        }
+        if (level >= det->release_cdB) {
+            break;
+        }
+        det->event.end_us = sample->timestamp_us;
+        det->state = EVENT_ENDING;
+        // The levels after the trigger may already be collected
+        // fall through
+
+    case EVENT_ENDING:
+        if (det->event.sample_count == EVENT_CAPTURE_SAMPLES) {
+            cb(EVENT_END, &det->event, arg);
+            det->state = EVENT_IDLE;
+        }
+        break;
+    }
+}
@@ -0,0 +1,173 @@
+#include "inc/fixmath.h"
+
+/**
+ * @brief log2(1 + i / 256) in Q16.16 for i = 0..255.
+ *
+ * The mantissa of the argument selects an entry and the next 16 bits interpolate
+ * linearly between two entries (maximum error about 2.5e-5 in log2, below 0.01 centi-dB).
+ */
+
+static const uint16_t log2_lut[256] = {
+        0,   369,   736,  1102,  1466,  1829,  2190,  2551,
+     2909,  3267,  3623,  3978,  4331,  4683,  5034,  5384,
+     5732,  6079,  6425,  6769,  7112,  7454,  7795,  8134,
+     8473,  8810,  9146,  9480,  9814, 10146, 10477, 10807,
+    11136, 11464, 11791, 12116, 12440, 12764, 13086, 13407,
+    13727, 14046, 14363, 14680, 14996, 15310, 15624, 15937,
+    16248, 16559, 16868, 17177, 17484, 17791, 18096, 18401,
+    18704, 19007, 19308, 19609, 19909, 20207, 20505, 20802,
+    21098, 21393, 21687, 21980, 22272, 22564, 22854, 23144,
+    23433, 23720, 24007, 24293, 24579, 24863, 25146, 25429,
+    25711, 25992, 26272, 26551, 26830, 27108, 27384, 27660,
+    27936, 28210, 28484, 28757, 29029, 29300, 29571, 29840,
+    30109, 30378, 30645, 30912, 31178, 31443, 31707, 31971,
+    32234, 32496, 32758, 33019, 33279, 33538, 33797, 34055,
+    34312, 34569, 34825, 35080, 35334, 35588, 35841, 36094,
+    36346, 36597, 36847, 37097, 37346, 37595, 37842, 38090,
+    38336, 38582, 38827, 39072, 39316, 39559, 39802, 40044,
+    40286, 40527, 40767, 41006, 41246, 41484, 41722, 41959,
+    42196, 42432, 42667, 42902, 43137, 43370, 43603, 43836,
+    44068, 44300, 44530, 44761, 44990, 45220, 45448, 45676,
+    45904, 46131, 46357, 46583, 46809, 47034, 47258, 47482,
+    47705, 47928, 48150, 48372, 48593, 48813, 49034, 49253,
+    49472, 49691, 49909, 50127, 50344, 50560, 50776, 50992,
+    51207, 51422, 51636, 51850, 52063, 52276, 52488, 52700,
+    52911, 53122, 53332, 53542, 53751, 53960, 54169, 54377,
+    54584, 54791, 54998, 55204, 55410, 55615, 55820, 56025,
+    56229, 56432, 56635, 56838, 57040, 57242, 57443, 57644,
+    57845, 58045, 58245, 58444, 58643, 58841, 59039, 59237,
+    59434, 59631, 59827, 60023, 60219, 60414, 60609, 60803,
+    60997, 61190, 61384, 61576, 61769, 61961, 62152, 62343,
+    62534, 62725, 62915, 63104, 63294, 63483, 63671, 63859,
+    64047, 64234, 64421, 64608, 64794, 64980, 65166, 65351,
+};
+
+/**
+ * @brief 2^(i / 256) - 1 in Q16 for i = 0..255 (used by fix_exp2_q16).
+ */
+
+static const uint16_t exp2_lut[256] = {
+        0,   178,   356,   535,   714,   893,  1073,  1254,
+     1435,  1617,  1799,  1981,  2164,  2348,  2532,  2716,
+     2902,  3087,  3273,  3460,  3647,  3834,  4022,  4211,
+     4400,  4590,  4780,  4971,  5162,  5353,  5546,  5738,
+     5932,  6125,  6320,  6514,  6710,  6906,  7102,  7299,
+     7496,  7694,  7893,  8092,  8292,  8492,  8693,  8894,
+     9096,  9298,  9501,  9704,  9908, 10113, 10318, 10524,
+    10730, 10937, 11144, 11352, 11560, 11769, 11979, 12189,
+    12400, 12611, 12823, 13036, 13249, 13462, 13676, 13891,
+    14106, 14322, 14539, 14756, 14974, 15192, 15411, 15630,
+    15850, 16071, 16292, 16514, 16737, 16960, 17183, 17408,
+    17633, 17858, 18084, 18311, 18538, 18766, 18995, 19224,
+    19454, 19684, 19915, 20147, 20379, 20612, 20846, 21080,
+    21315, 21550, 21786, 22023, 22260, 22498, 22737, 22977,
+    23216, 23457, 23698, 23940, 24183, 24426, 24670, 24915,
+    25160, 25406, 25652, 25900, 26148, 26396, 26645, 26895,
+    27146, 27397, 27649, 27902, 28155, 28409, 28664, 28919,
+    29175, 29432, 29690, 29948, 30207, 30466, 30727, 30988,
+    31249, 31512, 31775, 32039, 32303, 32568, 32834, 33101,
+    33369, 33637, 33906, 34175, 34446, 34717, 34988, 35261,
+    35534, 35808, 36083, 36359, 36635, 36912, 37190, 37468,
+    37747, 38028, 38308, 38590, 38872, 39155, 39439, 39724,
+    40009, 40295, 40582, 40870, 41158, 41448, 41738, 42029,
+    42320, 42613, 42906, 43200, 43495, 43790, 44087, 44384,
+    44682, 44981, 45280, 45581, 45882, 46184, 46487, 46791,
+    47095, 47401, 47707, 48014, 48322, 48631, 48940, 49251,
+    49562, 49874, 50187, 50500, 50815, 51131, 51447, 51764,
+    52082, 52401, 52721, 53041, 53363, 53685, 54008, 54333,
+    54658, 54983, 55310, 55638, 55966, 56296, 56626, 56957,
+    57289, 57622, 57956, 58291, 58627, 58964, 59301, 59640,
+    59979, 60319, 60661, 61003, 61346, 61690, 62035, 62381,
+    62727, 63075, 63424, 63774, 64124, 64476, 64828, 65182,
+};
+
+/**
+ * @brief Computes the base-2 logarithm of an integer in Q16.16.
+ *
+ * @param x Value (must be non-zero).
+ *
+ * The integer part comes from the position of the most significant bit (CLZ) and
+ * the fractional part from the lookup table. No floating point is involved.
+ *
+ * @return log2(x) in Q16.16, 0 for x == 0.
+ */
+
+int32_t fix_log2_q16(uint64_t x){
+    if (x == 0) {
+        return 0;
+    }
+
+    int msb = 63 - __builtin_clzll(x);
+    uint64_t mantissa = x << (63 - msb);             // Normalized: bit 63 set
+
+    uint32_t index = (uint32_t)(mantissa >> 55) & 0xFF;     // 8 bits after the leading one
+    uint32_t frac = (uint32_t)(mantissa >> 39) & 0xFFFF;    // Next 16 bits for interpolation
+
+    uint32_t low = log2_lut[index];
+    uint32_t high = (index == 255) ? FIX_Q16_ONE : log2_lut[index + 1];
+
+    return (msb << 16) + (int32_t)(low + (((high - low) * frac) >> 16));
+}
+
+/**
+ * @brief Converts a power ratio given as log2 (Q16.16) to centi-dB.
+ *
+ * @param log2_q16 log2 of the power ratio in Q16.16.
+ *
+ * 10 * log10(r) = 10 * log10(2) * log2(r); in hundredths of dB the scale is
+ * 1000 * log10(2) = 301.03, applied here as 19728302 / 2^32 on the Q16 input.
+ *
+ * @return The power ratio in hundredths of dB (rounded).
+ */
+
+int32_t fix_log2_q16_to_cdB(int32_t log2_q16){
+    int64_t scaled = (int64_t)log2_q16 * 19728302;          // 301.02999566 * 2^16
+    return (int32_t)((scaled + ((int64_t)1 << 31)) >> 32);
+}
+
+/**
+ * @brief Converts a power ratio in centi-dB to log2 (Q16.16).
+ *
+ * @param cdB Power ratio in hundredths of dB.
+ *
+ * Inverse of fix_log2_q16_to_cdB(): log2(r) = cdB / 301.03, applied as
+ * 14267573 / 2^16 (65536 / 301.03 in Q16).
+ *
+ * @return log2 of the power ratio in Q16.16.
+ */
+
+int32_t fix_cdB_to_log2_q16(int32_t cdB){
+    int64_t scaled = (int64_t)cdB * 14267573;
+    return (int32_t)((scaled + (1 << 15)) >> 16);
+}
+
+/**
+ * @brief Computes 2^x for a Q16.16 exponent.
+ *
+ * @param log2_q16 Exponent in Q16.16, from 0 up to (but not including) 62.
+ *
+ * The fractional part goes through the lookup table (with linear interpolation,
+ * maximum relative error about 1e-4, i.e. 0.0004 dB), the integer part is a shift.
+ *
+ * @return 2^x rounded down to an integer (0 for negative exponents).
+ */
+
+uint64_t fix_exp2_q16(int32_t log2_q16){
+    if (log2_q16 < 0) {
+        return 0;
+    }
+
+    uint32_t integer = (uint32_t)log2_q16 >> 16;
+    uint32_t index = ((uint32_t)log2_q16 >> 8) & 0xFF;
+    uint32_t frac = (uint32_t)log2_q16 & 0xFF;
+
+    uint32_t low = exp2_lut[index];
+    uint32_t high = (index == 255) ? FIX_Q16_ONE : exp2_lut[index + 1];
+    uint64_t mantissa = FIX_Q16_ONE + low + (((high - low) * frac) >> 8);   // 2^fraction in Q16
+
+    if (integer >= 16) {
+        return mantissa << (integer - 16);
+    }
+
+    return mantissa >> (16 - integer);
+}
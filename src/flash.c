@@ -13,6 +13,12 @@ static lfs_t lfs; // LittleFS instance
 static struct lfs_config *lfs_cfg_ptr = NULL; // Pointer to the LittleFS configuration
 static int file_counter = 0; // Counter for the number of files saved
 
+#if MQTT_PAYLOAD_CBOR
+#define PAYLOAD_FILE_NAME "data_%d.cbor" // Saved payloads (CBOR records)
+#else
+#define PAYLOAD_FILE_NAME "data_%d.json" // Saved payloads (JSON records)
+#endif
+
 /**
  * @brief Initialize the LittleFS filesystem.
  * This function sets up the filesystem, mounts it, and initializes the file counter.
@@ -64,7 +70,7 @@ void init_filesystem()
 
 /**
  * @brief Initialize the file counter by scanning the filesystem for existing files.
- * This function looks for files named "data_X.json" and sets the file_counter to the next available number.
+ * This function looks for files named "data_X.json" (or "data_X.cbor") and sets the file_counter to the next available number.
  */
 
 void initialize_file_counter()
@@ -108,18 +114,20 @@ void initialize_file_counter()
  * writes the payload to it, and increments the file_counter.
  * If the filesystem is not mounted, it will print an error message.
  *
- * @param payload The data to be saved in JSON format.
+ * @param payload The data to be saved (a JSON or CBOR record).
+ * @param length Length of the data, in bytes.
+ * @return true if the payload was saved, false otherwise.
  */
 
-void save_payload_to_flash(const char *payload)
+bool save_payload_to_flash(const void *payload, size_t length)
 {
     if(rtc_initialized == false) {
         printf("RTC não inicializado. Não é possível salvar dados.\n");
-        return;
+        return false;
     }
     
     char filename[32];
-    snprintf(filename, sizeof(filename), "data_%d.json", file_counter++);
+    snprintf(filename, sizeof(filename), PAYLOAD_FILE_NAME, file_counter++);
 
     printf("Conexão offline. Salvando dados em: %s\n", filename);
 
@@ -129,65 +137,284 @@ void save_payload_to_flash(const char *payload)
     if (err)
     {
         printf("Erro ao abrir arquivo %s para escrita.\n", filename);
-        return;
+        return false;
     }
 
-    if (lfs_file_write(&lfs, &file, payload, strlen(payload)) < 0)
+    bool saved = true;
+    if (lfs_file_write(&lfs, &file, payload, length) < 0)
     {
         printf("Erro ao escrever no arquivo %s.\n", filename);
+        saved = false;
     }
 
     lfs_file_close(&lfs, &file);
+    return saved;
 }
 
 /**
- * @brief Resend saved data from the LittleFS filesystem.
- * This function checks for files in the filesystem, reads their contents,
- * and attempts to publish them via MQTT. If successful, it deletes the file.
- * If it encounters an error while publishing, it stops processing further files.
+ * @brief Delete saved payloads once the broker has acknowledged them.
+ *
+ * @param numbers Number of each file.
+ * @param count Number of files.
  */
 
-void resend_saved_data() {
-    printf("Verificando dados salvos para reenviar...\n");
-
-    lfs_dir_t dir;
-    struct lfs_info info;
+void flash_delete_payloads(const int *numbers, uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++) {
+        char filename[32];
+        snprintf(filename, sizeof(filename), PAYLOAD_FILE_NAME, numbers[i]);
+        lfs_remove(&lfs, filename);
+    }
 
-    lfs_dir_open(&lfs, &dir, "/");
+    printf("Lote de %u arquivos confirmado pelo broker. Deletado.\n", count);
+}
 
-    char read_buffer[256];
+/**
+ * @brief Send the next batch of saved data (one step of the backlog drain).
+ * This function walks the LittleFS directory incrementally: the directory stays open
+ * between calls and each call packs the next saved files into one message (see
+ * publish_batch_t). The files are deleted once the broker acknowledges the message;
+ * files already in flight are skipped. A walk that sent files is followed by another
+ * one, so files skipped in between (in flight, then failed) are found again.
+ *
+ * @return Number of files sent, 0 if no file is left to send, or -1 if the message was
+ *         refused (the files are read again on the next call).
+ */
 
-    while (lfs_dir_read(&lfs, &dir, &info) > 0) {
+int flash_drain_step() {
+    static lfs_dir_t dir;
+    static bool dir_open = false;
+    static uint32_t walk_sent = 0;                      // Files sent during the current walk
+    static char batch_payload[MQTT_BATCH_MAX_BYTES];    // Static: too large for the stack
+    static char file_buffer[MQTT_PAYLOAD_SIZE];         // Last file read (kept when it did not fit the batch)
+    static lfs_ssize_t carry_size = 0;
+    static int carry_num;
+    int numbers[MQTT_BATCH_MAX_RECORDS];
+    publish_batch_t batch;
+    struct lfs_info info;
 
-        if (info.name[0] == '.') {
-            continue;
+    if (!dir_open) {
+        if (lfs_dir_open(&lfs, &dir, "/") < 0) {
+            return 0;
         }
+        dir_open = true;
+        walk_sent = 0;
+        carry_size = 0;
+    }
 
-        printf("Reenviando arquivo: %s\n", info.name);
+    publish_batch_begin(&batch, batch_payload, sizeof(batch_payload));
 
-        lfs_file_t file;
-        lfs_file_open(&lfs, &file, info.name, LFS_O_RDONLY);
+    if (carry_size > 0 && !publish_tracker_has_file(&publish_tracker, carry_num)) {
+        publish_batch_add(&batch, file_buffer, carry_size);
+        numbers[0] = carry_num;
+    }
+    carry_size = 0;
 
-        lfs_ssize_t size = lfs_file_read(&lfs, &file, read_buffer, sizeof(read_buffer) - 1);
-        lfs_file_close(&lfs, &file);
+    for (uint8_t walk = 0; walk < 2; walk++) {
 
-        if (size > 0) {
-            read_buffer[size] = '\0';
+        while (batch.records < MQTT_BATCH_MAX_RECORDS && lfs_dir_read(&lfs, &dir, &info) > 0) {
 
-            err_t err = mqtt_publish(global_mqtt_client, MQTT_TOPIC, read_buffer, size, 1, 0, NULL, NULL);
+            int num;
+            char filename[32];
+            if (info.type != LFS_TYPE_REG || sscanf(info.name, "data_%d", &num) != 1) {
+                continue; // Only the saved payloads (state files stay)
+            }
 
-            if (err == ERR_OK) {
-                printf("Arquivo %s reenviado com sucesso. Deletando...\n", info.name);
+            snprintf(filename, sizeof(filename), PAYLOAD_FILE_NAME, num);
+            if (strcmp(info.name, filename) != 0 || publish_tracker_has_file(&publish_tracker, num)) {
+                continue; // Payload of the other encoding (not for this topic), or waiting for its PUBACK
+            }
 
-                lfs_remove(&lfs, info.name);
-            } else {
-                printf("Falha ao reenviar %s. Interrompendo para tentar mais tarde.\n", info.name);
+            lfs_file_t file;
+            if (lfs_file_open(&lfs, &file, info.name, LFS_O_RDONLY) < 0) {
+                continue;
+            }
+            lfs_ssize_t size = lfs_file_read(&lfs, &file, file_buffer, sizeof(file_buffer));
+            lfs_file_close(&lfs, &file);
+
+            if (size <= 0) {
+                continue;
+            }
 
+            if (!publish_batch_add(&batch, file_buffer, size)) {
+                carry_size = size; // Batch full: this file starts the next one
+                carry_num = num;
                 break;
             }
+            numbers[batch.records - 1] = num;
         }
+
+        if (batch.records > 0 || walk_sent == 0) {
+            break; // Files to send, or a whole walk without any file to send: done
+        }
+        lfs_dir_rewind(&lfs, &dir);
+        walk_sent = 0;
+    }
+
+    if (batch.records == 0) {
+        lfs_dir_close(&lfs, &dir);
+        dir_open = false;
+        return 0;
+    }
+
+    if (mqtt_publish_batch(&batch, numbers) != ERR_OK) {
+        lfs_dir_rewind(&lfs, &dir); // Read the files again on the next call
+        carry_size = 0;
+        walk_sent = 0;
+        return -1;
+    }
+
+    walk_sent += batch.records;
+    return batch.records;
+}
+
+/**
+ * @brief LittleFS write callback of checkpoint_write().
+ */
+
+static bool checkpoint_file_write(void *ctx, const void *data, uint32_t size)
+{
+    return lfs_file_write(&lfs, (lfs_file_t *)ctx, data, size) == (lfs_ssize_t)size;
+}
+
+/**
+ * @brief LittleFS read callback of checkpoint_read_header() and checkpoint_read_payload().
+ */
+
+static bool checkpoint_file_read(void *ctx, void *data, uint32_t size)
+{
+    return lfs_file_read(&lfs, (lfs_file_t *)ctx, data, size) == (lfs_ssize_t)size;
+}
+
+/**
+ * @brief Save a checkpoint to a file of the LittleFS filesystem.
+ * The file is replaced as a whole; LittleFS only commits it on close, so a reset during
+ * the write leaves the previous content.
+ *
+ * @param name Name of the file.
+ * @param header Sealed header of the checkpoint.
+ * @param payload Payload of the checkpoint.
+ * @return Number of bytes written, or 0 on failure.
+ */
+
+uint32_t flash_save_checkpoint(const char *name, checkpoint_header_t *header, const uint32_t *payload)
+{
+    lfs_file_t file;
+
+    if (lfs_file_open(&lfs, &file, name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) < 0)
+    {
+        printf("Erro ao abrir arquivo %s para escrita.\n", name);
+        return 0;
     }
 
-    lfs_dir_close(&lfs, &dir);
-    printf("Verificação de dados salvos concluída.\n");
-}
\ No newline at end of file
+    bool saved = checkpoint_write(header, payload, checkpoint_file_write, &file);
+
+    if (lfs_file_close(&lfs, &file) < 0 || !saved)
+    {
+        return 0;
+    }
+
+    return sizeof(*header) + header->encoded_words * sizeof(uint32_t);
+}
+
+/**
+ * @brief Read the header of a checkpoint file.
+ *
+ * @param name Name of the file.
+ * @param header Header read.
+ * @param words Expected size of the payload in words.
+ * @return true if the file holds a checkpoint of the expected size.
+ */
+
+static bool read_checkpoint_header(const char *name, checkpoint_header_t *header, uint32_t words)
+{
+    lfs_file_t file;
+
+    if (lfs_file_open(&lfs, &file, name, LFS_O_RDONLY) < 0)
+    {
+        return false;
+    }
+
+    bool present = checkpoint_read_header(header, words, checkpoint_file_read, &file);
+
+    lfs_file_close(&lfs, &file);
+    return present;
+}
+
+/**
+ * @brief Find the newest checkpoint among the A/B copies, reading only the headers.
+ *
+ * @param names Name of the file of each copy.
+ * @param header Header of the newest copy.
+ * @param words Size of the payload in words.
+ * @return Index of the newest copy, or -1 if there is none.
+ */
+
+int flash_probe_checkpoint(const char *const names[CHECKPOINT_SLOTS], checkpoint_header_t *header, uint32_t words)
+{
+    checkpoint_header_t headers[CHECKPOINT_SLOTS];
+    bool present[CHECKPOINT_SLOTS];
+    uint8_t order[CHECKPOINT_SLOTS];
+
+    for (uint8_t slot = 0; slot < CHECKPOINT_SLOTS; slot++)
+    {
+        present[slot] = read_checkpoint_header(names[slot], &headers[slot], words);
+    }
+
+    if (checkpoint_order(headers, present, order) == 0)
+    {
+        return -1;
+    }
+
+    *header = headers[order[0]];
+    return order[0];
+}
+
+/**
+ * @brief Load the newest valid checkpoint among the A/B copies saved by flash_save_checkpoint().
+ * A copy that fails its CRC (cut short or damaged) is skipped in favour of the other one.
+ *
+ * @param names Name of the file of each copy.
+ * @param header Header of the loaded checkpoint.
+ * @param payload Buffer receiving the payload (undefined if no copy is valid).
+ * @param words Size of the payload in words.
+ * @return Index of the loaded copy, or -1 if no copy is valid.
+ */
+
+int flash_load_checkpoint(const char *const names[CHECKPOINT_SLOTS], checkpoint_header_t *header, uint32_t *payload, uint32_t words)
+{
+    checkpoint_header_t headers[CHECKPOINT_SLOTS];
+    bool present[CHECKPOINT_SLOTS];
+    uint8_t order[CHECKPOINT_SLOTS];
+
+    for (uint8_t slot = 0; slot < CHECKPOINT_SLOTS; slot++)
+    {
+        present[slot] = read_checkpoint_header(names[slot], &headers[slot], words);
+    }
+
+    uint8_t count = checkpoint_order(headers, present, order);
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        lfs_file_t file;
+
+        if (lfs_file_open(&lfs, &file, names[order[i]], LFS_O_RDONLY) < 0)
+        {
+            continue;
+        }
+
+        bool loaded = checkpoint_read_header(header, words, checkpoint_file_read, &file) &&
+                      checkpoint_read_payload(header, payload, checkpoint_file_read, &file);
+
+        lfs_file_close(&lfs, &file);
+
+        if (loaded)
+        {
+            return order[i];
+        }
+
+        printf("Checkpoint %s invalido, tentando a outra copia.\n", names[order[i]]);
+    }
+
+    return -1;
+}
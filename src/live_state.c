@@ -0,0 +1,67 @@
+#include <stdbool.h>
+#include <string.h>           // memset for the initial state
+#include "inc/live_state.h"
+
+/**
+ * @brief Initializes a live state.
+ *
+ * @param state State to initialize.
+ * @param lock Hardware spinlock of the writers (may be shared by several states).
+ */
+
+void live_state_init(live_state_t *state, spin_lock_t *lock){
+    memset(&state->data, 0, sizeof(state->data));
+    state->sequence = 0;
+    state->lock = lock;
+}
+
+/**
+ * @brief Publishes a new live state.
+ *
+ * @param state State to write.
+ * @param data New content.
+ *
+ * The spinlock also disables the interrupts of the writing core, so a reader running
+ * in an interrupt handler of that core can never spin on a write it interrupted.
+ * The write itself is a copy of a few dozen bytes.
+ */
+
+void live_state_write(live_state_t *state, const live_sensor_t *data){
+    uint32_t irq_state = spin_lock_blocking(state->lock);
+
+    state->sequence++;                  // Odd: write in progress
+    __mem_fence_release();
+    state->data = *data;
+    __mem_fence_release();
+    state->sequence++;                  // Even: stable
+
+    spin_unlock(state->lock, irq_state);
+}
+
+/**
+ * @brief Takes a consistent copy of a live state.
+ *
+ * @param state State to read.
+ * @param data Pointer where the copy is stored.
+ * @return Number of retries needed (0 if no write overlapped the read).
+ */
+
+uint32_t live_state_read(const live_state_t *state, live_sensor_t *data){
+    uint32_t retries = 0;
+
+    while (true) {
+        uint32_t before = state->sequence;
+        __mem_fence_acquire();          // Sequence read before the data
+
+        if ((before & 1) == 0) {
+            *data = state->data;
+            __mem_fence_acquire();      // Data read before the sequence is checked again
+
+            if (state->sequence == before) {
+                return retries;
+            }
+        }
+
+        retries++;
+    }
+}
@@ -0,0 +1,47 @@
+#include <string.h>
+#include "inc/measurement.h"
+
+/**
+ * @brief Formats a fixed-point value as a decimal string.
+ *
+ * @param buffer Buffer receiving the string.
+ * @param size Size of the buffer.
+ * @param value Value in units of 10^-decimals (e.g. hundredths of dB with decimals = 2).
+ * @param decimals Number of decimal places (1 to 6).
+ * @return Length of the string (as snprintf).
+ *
+ * The digits are emitted with integer division only (no printf, no soft-float); the output
+ * and the truncation match snprintf("%s%lu.%0*lu").
+ */
+
+int measurement_format_fixed(char *buffer, size_t size, int32_t value, uint8_t decimals){
+    static const uint32_t scale[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+    uint32_t magnitude = (value < 0) ? (uint32_t)0 - (uint32_t)value : (uint32_t)value;
+    uint32_t integer = magnitude / scale[decimals];
+    uint32_t fraction = magnitude % scale[decimals];
+    char text[16];                                  // "-2147483.648" at most
+    size_t start = sizeof(text);
+
+    for (uint8_t i = 0; i < decimals; i++) {        // Digits are emitted from the right
+        text[--start] = (char)('0' + fraction % 10);
+        fraction /= 10;
+    }
+    text[--start] = '.';
+    do {
+        text[--start] = (char)('0' + integer % 10);
+        integer /= 10;
+    } while (integer > 0);
+    if (value < 0) {
+        text[--start] = '-';
+    }
+
+    size_t length = sizeof(text) - start;
+
+    if (size > 0) {
+        size_t copied = (length < size) ? length : size - 1;
+        memcpy(buffer, text + start, copied);
+        buffer[copied] = '\0';
+    }
+
+    return (int)length;
+}
@@ -1,72 +1,387 @@
-//#include <math.h>         // Math library for square root and logarithm functions
 #include <stdio.h>        // Standard library for Raspberry Pi Pico
-//#include "hardware/adc.h" // Hardware ADC library for Raspberry Pi Pico
+#include <string.h>       // memcpy for the received frames
+#include "hardware/adc.h" // Hardware ADC library for Raspberry Pi Pico
+#include "hardware/dma.h" // DMA transfers of the ADC samples
 #include "inc/mic.h"      // Library for microphone data collection
+#include "inc/crc16.h"    // Table-driven Modbus CRC16
+#include "inc/audio_dsp.h" // Block RMS and dB kernels
+#include "inc/weighting.h" // A/C frequency-weighting filters
+#include "hardware/sync.h" // Hardware spinlock shared by both cores
+#include "hardware/irq.h" // Interrupt handling for the UART RX IRQ
 #include "inc/mqtt.h"
+#include "inc/timertc.h" // Local time of the acquisitions
 #include "inc/config.h"   // Configuration library for constants and settings
 
+#if MIC_ADC_ENABLED
+
+static uint16_t mic_buffers[2][MIC_BLOCK_SIZE];     // Ping-pong sample buffers filled by DMA
+static int mic_dma_channels[2];                     // DMA channel writing each buffer
+static volatile int8_t mic_ready_block = -1;        // Buffer holding the last complete block (-1 if none)
+static volatile uint32_t mic_block_end_us = 0;      // Completion time of the last block
+static volatile uint32_t mic_block_overruns = 0;    // Blocks completed before the previous one was released
+static weighting_filter_t mic_channel_filters[MIC_CHANNEL_COUNT];  // Weighting filter of each output channel
+
+#if MIC_SPECTRUM_ENABLED
+
+#if MIC_FFT_SIZE % MIC_BLOCK_SIZE != 0 || MIC_FFT_SIZE > SPECTRUM_MAX_FFT
+#error "MIC_FFT_SIZE must be a multiple of MIC_BLOCK_SIZE and at most SPECTRUM_MAX_FFT"
+#endif
+
+static spectrum_t mic_spectrum;                                 // FFT tables and work buffers (core 1)
+static uint16_t mic_fft_frame[MIC_FFT_SIZE];                    // Samples of the FFT frame being assembled
+static uint32_t mic_fft_fill = 0;                               // Samples already in mic_fft_frame
+static uint64_t mic_band_energy[SPECTRUM_MAX_BANDS];            // Band energies since the last window (shared, under mic_spectrum_lock)
+static uint32_t mic_band_frames = 0;                            // FFT frames in mic_band_energy (shared, under mic_spectrum_lock)
+static spin_lock_t *mic_spectrum_lock;                          // Hardware spinlock between core 1 (adds) and core 0 (takes)
+
+#endif
+
+/**
+ * @brief DMA completion interrupt handler of the microphone capture.
+ *
+ * When one buffer is full, the DMA has already chained to the other one, so sampling
+ * never stops. The full buffer is re-armed (write address and count) for its next
+ * turn and handed over to the block processing.
+ */
+
+static void on_mic_dma_complete(){
+    for (int i = 0; i < 2; i++) {
+        uint32_t mask = 1u << mic_dma_channels[i];
+
+        if (dma_hw->ints1 & mask) {
+            dma_hw->ints1 = mask; // Acknowledge the interrupt
+
+            dma_channel_set_write_addr(mic_dma_channels[i], mic_buffers[i], false);
+            dma_channel_set_trans_count(mic_dma_channels[i], MIC_BLOCK_SIZE, false);
+
+            if (mic_ready_block >= 0) {
+                mic_block_overruns++; // The previous block was not processed in time
+            }
+            mic_ready_block = i;
+            mic_block_end_us = time_us_32();
+        }
+    }
+}
+
+/**
+ * @brief Configures one channel of the DMA ping-pong pair.
+ *
+ * @param index Index of the channel (0 or 1); each channel chains to the other one.
+ */
+
+static void mic_dma_channel_setup(int index){
+    dma_channel_config config = dma_channel_get_default_config(mic_dma_channels[index]);
+
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_16);               // 16-bit ADC results
+    channel_config_set_read_increment(&config, false);                         // Always read the ADC FIFO
+    channel_config_set_write_increment(&config, true);                         // Fill the buffer
+    channel_config_set_dreq(&config, DREQ_ADC);                                // Paced by the ADC
+    channel_config_set_chain_to(&config, mic_dma_channels[index ^ 1]);         // Ping-pong
+
+    dma_channel_configure(mic_dma_channels[index], &config, mic_buffers[index], &adc_hw->fifo, MIC_BLOCK_SIZE, false);
+    dma_channel_set_irq1_enabled(mic_dma_channels[index], true);
+}
+
 /**
- * @brief Initializes the ADC for microphone input.
+ * @brief Initializes the continuous ADC capture of the analog microphone.
  *
- * This function initializes the ADC module, configures the GPIO pin
- * for the microphone input, and selects the appropriate ADC channel.
+ * This function initializes the ADC module, configures the GPIO pin for the microphone
+ * input and selects the ADC channel. The ADC runs free at MIC_SAMPLE_RATE_HZ and two
+ * chained DMA channels move the samples into ping-pong buffers, so no CPU time is spent
+ * on the transfer. The DMA interrupt is enabled on the calling core. The weighting filter
+ * of each output channel and the 1/3-octave analyzer are prepared here for MIC_SAMPLE_RATE_HZ.
  */
 
-/*void setup_mic()
+void setup_mic()
 {
+    static const weighting_t weightings[MIC_CHANNEL_COUNT] = MIC_CHANNEL_WEIGHTINGS;
+    for (int i = 0; i < MIC_CHANNEL_COUNT; i++) {
+        weighting_init(&mic_channel_filters[i], weightings[i], MIC_SAMPLE_RATE_HZ);   // Filter design (once, before the capture starts)
+        printf("Microfone: canal %d com ponderacao %s\n", i, weighting_name(weightings[i]));
+    }
+
+#if MIC_SPECTRUM_ENABLED
+    spectrum_init(&mic_spectrum, MIC_FFT_SIZE, MIC_SAMPLE_RATE_HZ);
+    mic_spectrum_lock = spin_lock_init(spin_lock_claim_unused(true));
+    printf("Microfone: %d bandas de 1/3 de oitava a partir de %u Hz\n", mic_spectrum.band_count,
+           spectrum_band_nominal_hz(mic_spectrum.first_band));
+#endif
+
     adc_init();                    // Initialize the ADC module
     adc_gpio_init(MIC_PIN);        // Configure the microphone pin for ADC
     adc_select_input(ADC_CHANNEL); // Select ADC channel 2 for input
-}*/
+
+    adc_fifo_setup(true, true, 1, false, false);                 // FIFO on, DREQ on every sample, 12-bit results
+    adc_set_clkdiv(48000000.0F / MIC_SAMPLE_RATE_HZ - 1.0F);    // 48 MHz ADC clock, one conversion per period
+
+    mic_dma_channels[0] = dma_claim_unused_channel(true);
+    mic_dma_channels[1] = dma_claim_unused_channel(true);
+    mic_dma_channel_setup(0);
+    mic_dma_channel_setup(1);
+
+    irq_set_exclusive_handler(DMA_IRQ_1, on_mic_dma_complete);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    dma_channel_start(mic_dma_channels[0]);
+    adc_run(true);                 // Start free-running conversions
+}
+
+/**
+ * @brief Returns the last complete block of microphone samples.
+ *
+ * @param samples Pointer where the address of the block is stored.
+ * @param start_us Pointer where the acquisition time of the first sample is stored.
+ *
+ * The block stays valid until mic_release_block() is called or until the DMA wraps
+ * around to it (one block period later).
+ *
+ * @return true if a block is ready, false otherwise.
+ */
+
+bool mic_get_block(const uint16_t **samples, uint32_t *start_us){
+    int8_t block = mic_ready_block;
+
+    if (block < 0) {
+        return false;
+    }
+
+    *samples = mic_buffers[block];
+    *start_us = mic_block_end_us - (uint32_t)((uint64_t)MIC_BLOCK_SIZE * 1000000 / MIC_SAMPLE_RATE_HZ);
+    return true;
+}
+
+/**
+ * @brief Releases the block returned by mic_get_block().
+ */
+
+void mic_release_block()
+{
+    mic_ready_block = -1;
+}
+
+/**
+ * @brief Returns the number of blocks lost because they were not processed in time.
+ */
+
+uint32_t mic_get_overruns()
+{
+    return mic_block_overruns;
+}
 
 /**
- * @brief Collects microphone samples and stores them in the micdata structure.
+ * @brief Computes the level of every microphone output channel for one block.
  *
- * This function reads ADC values and stores them in the micdata.samples array.
- * A small delay is added between each sample to control the sampling rate.
+ * @param samples Pointer to the block of ADC samples (MIC_BLOCK_SIZE samples).
+ * @param levels_cdB Array of MIC_CHANNEL_COUNT levels, in hundredths of dB.
+ *
+ * The weighting sits between the capture and the RMS: each channel filters the raw
+ * block with its own filter and the sum of squares of the output gives the level.
+ */
+
+void mic_block_levels(const uint16_t *samples, int32_t *levels_cdB)
+{
+    for (int i = 0; i < MIC_CHANNEL_COUNT; i++) {
+        uint64_t sum_squares = weighting_block_sum_squares(&mic_channel_filters[i], samples, MIC_BLOCK_SIZE, OFFSET);
+        levels_cdB[i] = audio_sum_squares_to_cdB(sum_squares, MIC_BLOCK_SIZE);
+    }
+}
+
+#if MIC_SPECTRUM_ENABLED
+
+/**
+ * @brief Adds one block of microphone samples to the 1/3-octave band analysis.
+ *
+ * @param samples Pointer to the block of ADC samples (MIC_BLOCK_SIZE samples).
+ *
+ * The FFT runs outside the lock; only the accumulation of the band energies
+ * (a few dozen additions) is done while holding it.
+ */
+
+void mic_block_spectrum(const uint16_t *samples)
+{
+    memcpy(&mic_fft_frame[mic_fft_fill], samples, MIC_BLOCK_SIZE * sizeof(uint16_t));
+    mic_fft_fill += MIC_BLOCK_SIZE;
+
+    if (mic_fft_fill < MIC_FFT_SIZE) {
+        return;
+    }
+    mic_fft_fill = 0;
+
+    uint64_t energy[SPECTRUM_MAX_BANDS] = {0};
+    spectrum_add_frame(&mic_spectrum, mic_fft_frame, OFFSET, energy);
+
+    uint32_t irq_state = spin_lock_blocking(mic_spectrum_lock);
+    for (uint8_t b = 0; b < mic_spectrum.band_count; b++) {
+        uint64_t sum = mic_band_energy[b] + energy[b];
+        mic_band_energy[b] = (sum < energy[b]) ? UINT64_MAX : sum;   // Saturate
+    }
+    mic_band_frames++;
+    spin_unlock(mic_spectrum_lock, irq_state);
+}
+
+/**
+ * @brief Moves the band levels accumulated since the last call into micdata.
+ *
+ * @param micdata Pointer to the micdata_t structure receiving the band levels.
  */
 
-/*void collect_samples()
+void mic_spectrum_take(micdata_t *micdata)
 {
-    // Read SAMPLE_COUNT samples from the ADC
-    for (int i = 0; i < SAMPLE_COUNT; i++)
-    {
-        micdata.samples[i] = adc_read(); // Read ADC value and store it
-        sleep_us(100);                   // Delay for sampling rate control
+    uint64_t energy[SPECTRUM_MAX_BANDS];
+    int32_t levels_cdB[SPECTRUM_MAX_BANDS];
+
+    uint32_t irq_state = spin_lock_blocking(mic_spectrum_lock);
+    memcpy(energy, mic_band_energy, sizeof(energy));
+    memset(mic_band_energy, 0, sizeof(mic_band_energy));
+    uint32_t frames = mic_band_frames;
+    mic_band_frames = 0;
+    spin_unlock(mic_spectrum_lock, irq_state);
+
+    if (frames == 0) {
+        micdata->band_count = 0; // No complete FFT frame in this window
+        return;
     }
-}*/
+
+    spectrum_levels_cdB(&mic_spectrum, energy, frames, levels_cdB);
+
+    micdata->band_count = mic_spectrum.band_count;
+    micdata->first_band = mic_spectrum.first_band;
+    for (uint8_t b = 0; b < mic_spectrum.band_count; b++) {
+        micdata->band_cdB[b] = (int16_t)levels_cdB[b];
+    }
+}
+
+#endif
+
+#endif
 
 /**
  * @brief Converts digital ADC values to decibels (dB).
  *
- * @param micdata Pointer to the microphone data structure containing samples.
+ * @param samples Pointer to the block of ADC samples.
  * @param n_samples Number of samples to process.
- * @return nothing
+ * @return The sound level of the block in hundredths of dB.
  *
- * This function computes the Root Mean Square (RMS) value of the sampled data,
- * applies a logarithmic transformation, and store in dB variable the result in decibels.
+ * This function computes the mean square of the sampled data with integer arithmetic
+ * and applies a fixed-point logarithm (see audio_dsp.c); no floating point is used.
  */
 
-/*void digital_to_dB(micdata_t *micdata, uint8_t n_samples)
+int32_t digital_to_cdB(const uint16_t *samples, uint32_t n_samples)
 {
+    return audio_sum_squares_to_cdB(audio_block_sum_squares(samples, n_samples, OFFSET), n_samples);
+}
+
+#define MODBUS_RX_RING_SIZE 256 // Size of the UART RX ring buffer (must be a power of two)
+#define MODBUS_UART_FIFO_DEPTH 32 // Depth of the RP2040 UART TX and RX FIFOs
+
+static uint8_t rx_ring_data[MODBUS_RX_RING_SIZE];   // Received bytes
+static uint32_t rx_ring_time[MODBUS_RX_RING_SIZE];  // Arrival time of each received byte (us)
+static volatile uint16_t rx_ring_head = 0;          // Written by the UART IRQ
+static volatile uint16_t rx_ring_tail = 0;          // Written by modbus_rx_service()
+static volatile uint32_t rx_ring_overflows = 0;     // Bytes dropped because the ring was full
+static uint32_t rx_last_arrival_us = 0;             // Arrival time given to the last received byte (UART IRQ only)
+static bool rx_line_idle = false;                   // The last batch came with the RX timeout (UART IRQ only)
+static volatile uint32_t rx_char_us;                // Duration of one character at the current baud rate
+static volatile uint32_t rx_idle_us;                // Silence before the RX timeout interrupt (32 bit periods)
+
+static modbus_rtu_rx_t modbus_rx;                   // Modbus RTU frame state machine
+static uint8_t rx_frame[MODBUS_RTU_MAX_FRAME];      // Last frame delimited by the state machine
+static uint16_t rx_frame_length = 0;                // Length of the last frame
+static bool rx_frame_crc_ok = false;                // CRC result of the last frame
+static bool rx_frame_pending = false;               // true while rx_frame has not been consumed
+
+/**
+ * @brief UART RX interrupt handler.
+ *
+ * This function moves every received byte into the RX ring buffer together with its
+ * arrival time, which the frame state machine needs to detect the inter-frame gap.
+ *
+ * The RX FIFO is on, so the interrupt comes once several bytes are waiting (FIFO level)
+ * or once the line has been silent for 32 bit periods (RX timeout), and the arrival times
+ * are rebuilt: the bytes of a batch are one character time apart and the last one arrived
+ * just now (FIFO level) or 32 bit periods ago (RX timeout). A gap of t3.5 or more before
+ * the batch is a frame gap and is kept as measured. A shorter one cannot be told from the
+ * IRQ latency, so only what the hardware proves is kept: 32 bit periods after an RX
+ * timeout (a t1.5 violation), one character time otherwise. A gap shorter than the RX
+ * timeout right after a FIFO-level drain is therefore not detected; the CRC still is.
+ * The previous arrival time is itself late by the previous IRQ latency, so a batch anchored
+ * to it is shifted back to end at now at the latest.
+ */
+
+static void on_modbus_uart_rx(){
+    uint32_t now = time_us_32();
+    bool line_idle = uart_get_hw(UART_ID)->mis & UART_UARTMIS_RTMIS_BITS; // RX timeout interrupt
+    uint8_t bytes[MODBUS_UART_FIFO_DEPTH];
+    uint8_t count = 0;
+
+    while (count < MODBUS_UART_FIFO_DEPTH && uart_is_readable(UART_ID)) {
+        bytes[count++] = uart_getc(UART_ID);
+    }
+
+    if (count == 0) {
+        return;
+    }
 
-    float sum = 0.0; // Variable to store the sum of squared differences
+    uint32_t last_us = line_idle ? now - rx_idle_us : now;
+    uint32_t first_us = last_us - (uint32_t)(count - 1) * rx_char_us;
 
-    // Compute the sum of squared differences from the offset
-    for (int i = 0; i < n_samples; i++)
-    {
-        float value = micdata->samples[i] - OFFSET; // Calculate the difference from the offset
-        sum += value * value;                       // Add the squared difference to the sum
+    if ((int32_t)(first_us - rx_last_arrival_us) < (int32_t)modbus_rx.t35_us) {
+        first_us = rx_last_arrival_us + (rx_line_idle ? rx_idle_us : rx_char_us); // Not a frame gap
     }
 
-    // Calculate the RMS value
-    float rms = sqrt(sum / n_samples);
+    uint32_t rebuilt_last_us = first_us + (uint32_t)(count - 1) * rx_char_us;
+    if ((int32_t)(rebuilt_last_us - now) > 0) {
+        first_us -= rebuilt_last_us - now;  // Anchored to a late estimate: no byte arrives after now
+    }
+    rx_line_idle = line_idle;
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint16_t next = (rx_ring_head + 1) & (MODBUS_RX_RING_SIZE - 1);
 
-    // Convert RMS value to decibels (dB)
-    micdata->dB = 20 * log10(rms / RMS_REFERENCE) + 24;
+        rx_last_arrival_us = first_us + (uint32_t)i * rx_char_us;
+
+        if (next == rx_ring_tail) {
+            rx_ring_overflows++; // Ring full, drop the byte
+            continue;
+        }
+
+        rx_ring_data[rx_ring_head] = bytes[i];
+        rx_ring_time[rx_ring_head] = rx_last_arrival_us;
+        rx_ring_head = next;
+    }
+}
 
+/**
+ * @brief Sets the character timings of the RX timestamps for a baud rate.
+ *
+ * @param baud_rate UART baud rate.
+ */
 
-}*/
+static void modbus_uart_set_timings(uint32_t baud_rate){
+    rx_char_us = 10 * 1000000UL / baud_rate;    // 8N1: 10 bits per character
+    rx_idle_us = 32 * 1000000UL / baud_rate;    // Silence that raises the RX timeout interrupt
+}
+
+/**
+ * @brief Frame callback of the Modbus RTU state machine.
+ *
+ * @param frame Pointer to the delimited frame.
+ * @param length Length of the frame.
+ * @param crc_ok true if the frame CRC is valid.
+ * @param arg Unused.
+ *
+ * Frames are kept until modbus_poll_frame() consumes them. Frames with an invalid CRC
+ * are kept as well: the response parser may still recover a valid response from them.
+ */
+
+static void on_modbus_frame(const uint8_t *frame, uint16_t length, bool crc_ok, void *arg){
+    (void)arg;
+
+    memcpy(rx_frame, frame, length);
+    rx_frame_length = length;
+    rx_frame_crc_ok = crc_ok;
+    rx_frame_pending = true;
+}
 
 /**
  * @brief Configures the UART for Modbus communication.
@@ -74,6 +389,11 @@
  * This function initializes the UART interface with the specified baud rate,
  * sets the TX and RX pins to their respective UART functions, and configures the
  * UART format to 8 data bits, 1 stop bit, and no parity.
+ *
+ * It also enables the UART RX interrupt that feeds the RX ring buffer. Both FIFOs stay
+ * on: a request frame (8 bytes) fits the 32-byte TX FIFO, so sending it does not wait
+ * for the wire, and the RX side interrupts once per few bytes or after an idle line
+ * instead of once per byte. The interrupt is enabled on the core that calls this function.
  */
 
 void uart_modbus_config(){
@@ -81,6 +401,81 @@ void uart_modbus_config(){
     gpio_set_function(UART_TX_PIN, GPIO_FUNC_UART); // Set TX pin function to UART
     gpio_set_function(UART_RX_PIN, GPIO_FUNC_UART); // Set RX pin function to UART
     uart_set_format(UART_ID, 8, 1, UART_PARITY_NONE); // Set UART format: 8 data bits, 1 stop bit, no parity
+    uart_set_fifo_enabled(UART_ID, true); // Requests leave without busy-waiting; RX interrupts per batch of bytes
+
+    modbus_uart_set_timings(BAUD_RATE);
+    modbus_rtu_rx_init(&modbus_rx, BAUD_RATE, on_modbus_frame, NULL);
+
+    int uart_irq = (UART_ID == uart0) ? UART0_IRQ : UART1_IRQ;
+    irq_set_exclusive_handler(uart_irq, on_modbus_uart_rx);
+    irq_set_enabled(uart_irq, true);
+    uart_set_irq_enables(UART_ID, true, false); // RX interrupts only (FIFO level and RX timeout)
+}
+
+/**
+ * @brief Changes the baud rate of the Modbus UART.
+ *
+ * @param baud_rate New baud rate.
+ *
+ * The inter-frame timings of the RTU state machine follow the new rate.
+ */
+
+void modbus_set_baud_rate(uint32_t baud_rate){
+    uart_tx_wait_blocking(UART_ID); // Let the last request leave at the old rate
+    uart_set_baudrate(UART_ID, baud_rate);
+    modbus_uart_set_timings(baud_rate);
+    modbus_rtu_rx_set_baud(&modbus_rx, baud_rate);
+}
+
+/**
+ * @brief Drains the UART RX ring buffer into the Modbus RTU state machine.
+ *
+ * This function feeds every buffered byte to the frame state machine and then checks
+ * the bus silence, so that a frame is completed as soon as the t3.5 gap has elapsed.
+ * Bytes still waiting in the RX FIFO (up to 32 bit periods, until the RX timeout
+ * interrupt) belong to the frame, so the silence is only checked once the FIFO and the
+ * ring are empty. It never blocks and must be called periodically by the Modbus owner core.
+ */
+
+void modbus_rx_service(){
+    while (rx_ring_tail != rx_ring_head) {
+        uint16_t tail = rx_ring_tail;
+        modbus_rtu_rx_feed(&modbus_rx, rx_ring_data[tail], rx_ring_time[tail]);
+        rx_ring_tail = (tail + 1) & (MODBUS_RX_RING_SIZE - 1);
+    }
+
+    if (uart_is_readable(UART_ID) || rx_ring_tail != rx_ring_head) {
+        return; // Bytes not delivered yet (FIFO first: the IRQ moves them to the ring)
+    }
+
+    modbus_rtu_rx_poll(&modbus_rx, time_us_32());
+}
+
+/**
+ * @brief Returns the time at which the RX state machine needs to run again.
+ *
+ * @param fallback Time returned when no frame is being received.
+ *
+ * While a frame is being received, it is delimited t3.5 after its last byte and no
+ * interrupt signals that moment, so the caller must wake up to run modbus_rx_service().
+ *
+ * @return The earliest of the frame end time and fallback.
+ */
+
+absolute_time_t modbus_rx_wakeup_time(absolute_time_t fallback){
+    if (modbus_rx.state == MODBUS_RTU_IDLE && rx_ring_tail == rx_ring_head) {
+        return fallback;
+    }
+
+    if (uart_is_readable(UART_ID)) {
+        return fallback; // Bytes in the RX FIFO: the RX timeout interrupt wakes the core
+    }
+
+    int32_t elapsed = (int32_t)(time_us_32() - modbus_rx.last_byte_us);
+    uint32_t remaining = (elapsed < (int32_t)modbus_rx.t35_us) ? (uint32_t)((int32_t)modbus_rx.t35_us - elapsed) : 0;
+    absolute_time_t frame_end = make_timeout_time_us(remaining);
+
+    return (absolute_time_diff_us(frame_end, fallback) > 0) ? frame_end : fallback;
 }
 
 /**
@@ -90,21 +485,63 @@ void uart_modbus_config(){
  * @param len Length of the buffer.
  * 
  * This function computes the CRC16 checksum for the provided buffer using the Modbus CRC algorithm.
+ * It is a thin wrapper around the table-driven engine in crc16.c.
  */
 
 uint16_t modbus_crc16(uint8_t *buf, int len){
-    uint16_t crc = 0xFFFF;
-    for (int pos = 0; pos < len; pos++) {
-        crc ^= (uint16_t)buf[pos];
-        for (int i = 8; i != 0; i--) {
-            if ((crc & 0x0001) != 0) {
-                crc >>= 1;
-                crc ^= 0xA001;
-            } else
-                crc >>= 1;
+    return crc16_modbus(buf, (size_t)len); // Table-driven CRC (see src/crc16.c)
+}
+
+/**
+ * @brief Sends a complete Modbus frame over UART.
+ *
+ * @param frame Pointer to the frame, CRC included.
+ * @param length Length of the frame.
+ *
+ * Any frame received before the request and not consumed yet is discarded, so that
+ * the next frame returned by modbus_poll_frame() is the answer to this request. Frames up
+ * to MODBUS_UART_FIFO_DEPTH bytes (every request sent here) only fill the TX FIFO and
+ * return at once; a longer frame would wait for the wire for the bytes beyond it.
+ */
+
+void modbus_send_frame(const uint8_t *frame, uint16_t length){
+    rx_frame_pending = false; // Discard any stale frame before a new transaction
+
+    uart_write_blocking(UART_ID, frame, length);
+}
+
+/**
+ * @brief Sends a request and waits for the next frame (blocking).
+ *
+ * @param request Pointer to the request frame.
+ * @param request_length Length of the request.
+ * @param frame Buffer of at least MODBUS_RTU_MAX_FRAME bytes for the response.
+ * @param frame_length Pointer where the response length is stored.
+ * @param crc_ok Pointer where the CRC result is stored.
+ * @param latency_us Pointer where the time from request start to response completion is stored.
+ *
+ * This function is meant for startup procedures only (e.g. baud rate negotiation); the
+ * sampling path uses the non-blocking bus scheduler.
+ *
+ * @return true if a frame was received before MODBUS_RESPONSE_TIMEOUT_MS, false otherwise.
+ */
+
+bool modbus_transaction(const uint8_t *request, uint16_t request_length,
+                        uint8_t *frame, uint16_t *frame_length, bool *crc_ok, uint32_t *latency_us){
+    uint32_t start = time_us_32();
+    absolute_time_t deadline = make_timeout_time_ms(MODBUS_RESPONSE_TIMEOUT_MS);
+
+    modbus_send_frame(request, request_length);
+
+    while (!time_reached(deadline)) {
+        if (modbus_poll_frame(frame, frame_length, crc_ok)) {
+            *latency_us = time_us_32() - start;
+            return true;
         }
+        best_effort_wfe_or_timeout(modbus_rx_wakeup_time(deadline));
     }
-    return crc;
+
+    return false;
 }
 
 /**
@@ -118,108 +555,193 @@ uint16_t modbus_crc16(uint8_t *buf, int len){
  */
 
 void modbus_read_registers(uint8_t device_address, uint16_t start_address, uint16_t num_registers){
-    uint8_t request[8];
-    request[0] = device_address;
-    request[1] = 0x03; // Function code for reading holding registers
-    request[2] = (start_address >> 8) & 0xFF;
-    request[3] = start_address & 0xFF;
-    request[4] = (num_registers >> 8) & 0xFF;
-    request[5] = num_registers & 0xFF;
-    uint16_t crc = modbus_crc16(request, 6);
-    request[6] = crc & 0xFF;
-    request[7] = (crc >> 8) & 0xFF;
+    uint8_t request[MODBUS_RTU_READ_REQUEST_SIZE];
+    uint16_t length = modbus_rtu_build_read_request(request, device_address, start_address, num_registers);
+
+    modbus_send_frame(request, length);
+}
+
+/**
+ * @brief Returns the last frame delimited by the RTU state machine.
+ *
+ * @param frame Buffer of at least MODBUS_RTU_MAX_FRAME bytes (may alias the internal buffer).
+ * @param length Pointer where the frame length is stored.
+ * @param crc_ok Pointer where the CRC result of the whole frame is stored.
+ *
+ * This function does not block: it services the RX ring buffer first and returns
+ * false if no new frame was completed since the last call.
+ *
+ * @return true if a frame was copied, false otherwise.
+ */
 
-    uart_write_blocking(UART_ID, request, 8);
+bool modbus_poll_frame(uint8_t *frame, uint16_t *length, bool *crc_ok){
+    modbus_rx_service();
+
+    if (!rx_frame_pending) {
+        return false;
+    }
+
+    rx_frame_pending = false;
+
+    if (frame != rx_frame) {
+        memcpy(frame, rx_frame, rx_frame_length);
+    }
+    *length = rx_frame_length;
+    *crc_ok = rx_frame_crc_ok;
+    return true;
 }
 
 /**
  * @brief Reads the Modbus response from the microphone sensor.
  * 
  * @param response Pointer to the buffer where the response will be stored.
- * @param length Length of the expected response.
+ * @param length Pointer to the buffer size; updated with the length of the response.
+ * @param device_address The Modbus address the request was sent to.
  * 
- * This function reads the Modbus response from the UART interface.
- * It waits for the specified length of bytes and verifies the CRC of the response.
+ * This function does not block: it services the RX ring buffer and parses the frame
+ * completed by the RTU state machine, if any. The response is recovered even if stray
+ * bytes were glued to it, and exception responses are decoded.
  * 
- * @return true if the response is valid and CRC matches, false otherwise.
+ * @return MODBUS_STATUS_PENDING while no frame is available, the parsing status otherwise.
  */
 
-bool modbus_read_response(uint8_t *response, int length){
-    int bytes_read = 0;
-    absolute_time_t timeout = make_timeout_time_ms(1000); // Set a timeout of 1000 ms
+modbus_status_t modbus_read_response(uint8_t *response, uint16_t *length, uint8_t device_address){
+    uint16_t frame_length;
+    bool crc_ok;
 
-    while (bytes_read < length && absolute_time_diff_us(get_absolute_time(), timeout) > 0) {
-        if (uart_is_readable(UART_ID)) {
-            response[bytes_read++] = uart_getc(UART_ID);
-        }
+    if (!modbus_poll_frame(rx_frame, &frame_length, &crc_ok)) {
+        return MODBUS_STATUS_PENDING; // No complete frame yet
     }
 
-    if (bytes_read != length) {
-        return false; // Timeout or not enough bytes read
+    modbus_rtu_response_t parsed = modbus_rtu_parse_response(rx_frame, frame_length, crc_ok, device_address,
+                                                             MODBUS_FC_READ_HOLDING_REGISTERS, *length);
+    if (parsed.status == MODBUS_STATUS_OK || parsed.status == MODBUS_STATUS_EXCEPTION) {
+        memcpy(response, rx_frame + parsed.offset, parsed.length);
+        *length = parsed.length;
     }
 
-    //CRC verification
-    uint16_t received_crc = (response[length - 1] << 8) | response[length - 2];
-    uint16_t calculated_crc = modbus_crc16(response, length - 2);
-    return received_crc == calculated_crc;
+    return parsed.status;
 }
 
-uint16_t parse_decibel_value(uint8_t *response){
-    if (modbus_read_response(response, 7)) {
-            uint16_t raw_value = (response[3] << 8) | response[4];
-            return raw_value; // return the raw value directly
-    } else {
-        printf("Erro na leitura do sensor.\n");
+/**
+ * @brief Extracts the decibel value from a Modbus response.
+ *
+ * @param response Pointer to a response returned by modbus_read_response().
+ * @param status Status returned by modbus_read_response().
+ * @param value Pointer where the raw register value (dB x 10) is stored.
+ *
+ * @return MODBUS_STATUS_OK if value was written, the failure status otherwise.
+ */
+
+modbus_status_t parse_decibel_value(const uint8_t *response, modbus_status_t status, uint16_t *value){
+    if (status != MODBUS_STATUS_OK) {
+        printf("Erro na leitura do sensor: %d.\n", status);
+        return status;
+    }
+
+    if (response[2] != 2) {
+        return MODBUS_STATUS_BAD_RESPONSE; // One register (2 bytes) expected
     }
+
+    *value = (response[3] << 8) | response[4];
+    return MODBUS_STATUS_OK;
 }
 
+// Occupational noise dose criterion (NIOSH or OSHA, see config.h)
+static const noise_dose_params_t dose_params = {
+    .criterion_cdB = DOSE_CRITERION_CDB,
+    .exchange_cdB = DOSE_EXCHANGE_RATE_CDB,
+    .threshold_cdB = DOSE_THRESHOLD_CDB,
+    .criterion_s = DOSE_CRITERION_HOURS * 3600,
+    .reset_hour = DOSE_RESET_HOUR,
+    .max_gap_us = DOSE_MAX_GAP_MS * 1000,
+};
+
 /**
- * @brief Calculates the average, maximum, and minimum dB values over a 60-second interval.
+ * @brief Handles a closed statistics window of one sensor.
+ *
+ * @param level Level of the window (ROLLUP_1S ... ROLLUP_24H).
+ * @param stats Statistics of the window.
+ * @param start_us Start of the window (local time).
+ * @param lden_cdB Day-evening-night level (24 h window only).
+ * @param arg Pointer to the micdata_t structure of the sensor.
+ *
+ * The windows selected by ROLLUP_PUBLISH_LEVELS are summarized into micdata and
+ * published. The 1/3-octave bands are taken with the 1 min window.
+ */
+
+static void on_window_closed(uint8_t level, const noise_stats_t *stats, uint64_t start_us, int32_t lden_cdB, void *arg){
+    micdata_t *micdata = (micdata_t *)arg;
+    (void)start_us;
+
+#if MIC_ADC_ENABLED && MIC_SPECTRUM_ENABLED
+    if (micdata->config->spectrum && level == ROLLUP_1MIN) {
+        mic_spectrum_take(micdata);                       // Band levels of the same minute
+    }
+#endif
+
+    if (!(ROLLUP_PUBLISH_LEVELS & (1u << level))) {
+        micdata->band_count = 0;
+        return;
+    }
+
+    noise_stats_summarize(stats, &micdata->summary);
+    micdata->lden_cdB = lden_cdB;
+    micdata->dose_percent_c = noise_dose_percent_c(&micdata->dose, &dose_params);
+    micdata->twa_cdB = noise_dose_twa_cdB(&micdata->dose, &dose_params);
+    micdata->window_s = rollup_level_seconds(level);
+
+    publish_db_to_mqtt(micdata);                          // Queue the dB values for the MQTT publisher
+    micdata->band_count = 0;                              // The bands belong to the 1 min window only
+}
+
+/**
+ * @brief Calculates the average, maximum, and minimum dB values over each statistics window.
  * 
  * @param micdata Pointer to the microphone data structure containing the current dB value.
  * 
- * This function maintains a rolling average of the dB values collected over the last 60 seconds.
- * It also tracks the maximum and minimum dB values during this period. Every 60 seconds
- * it calculates the average dB, updates the max and min dB values, and publishes them to the MQTT broker.
+ * This function adds the dB value to the 1 s window of the sensor; the longer windows
+ * (1 min, 15 min, 1 h, 24 h) are built by merging the shorter ones (see rollup.c), so no
+ * raw value is kept. The window state lives in the micdata structure, so every sensor of
+ * the bus has its own windows, and its size does not depend on the sampling rate. When a
+ * window closes, the average dB, the Leq, the max and min dB values, the L10/L50/L90/L95
+ * exceedance levels (and the Lden for the day) are published to the MQTT broker, with the
+ * running noise dose and TWA of the sensor.
  */
 
 void get_media_min_max_dB(micdata_t *micdata){
-    
-    uint64_t current_time = time_us_64();
-    static uint64_t last_attempt_time = 0;
-    static float sum = 0.0;
-    static uint8_t count = 0;
-    static float max_dB = 0.0;
-    static float min_dB = 0.0;
-
-    // Update max and min dB values
-    if (count == 0) {
-        max_dB = micdata->dB;
-        min_dB = micdata->dB;
-    } else {
-        if (micdata->dB > max_dB) max_dB = micdata->dB;
-        if (micdata->dB < min_dB) min_dB = micdata->dB;
-    }
 
-    sum += micdata->dB;
-    count++;
+    uint64_t local_time = rtc_local_time_us(micdata->last.timestamp_us);   // Windows are based on acquisition time, aligned on the local clock
 
-    if (current_time - last_attempt_time >= 60000000) {
+    noise_dose_add(&micdata->dose, &dose_params, micdata->last.timestamp_us, local_time, micdata->last.level_cdB);   // Running dose, read when a window closes
+    rollup_add(&micdata->rollup, local_time, micdata->last.level_cdB, on_window_closed, micdata);   // Levels are kept in hundredths of dB
+}
 
-        // Calculate the average dB value over the last 60 seconds
-        if (count > 0) {
-            micdata->average = sum / count;
-            micdata->maxdB = max_dB;
-            micdata->mindB = min_dB;
-            
-            publish_db_to_mqtt(micdata);                          // Publish the dB values to the MQTT broker
-        }
+/**
+ * @brief Callback of the threshold exceedance detector: queues the alert for the MQTT publisher.
+ *
+ * @param kind Start or end of the event.
+ * @param event Event with its attached levels.
+ * @param arg Pointer to the micdata_t structure of the sensor.
+ */
 
-        // Reset the values for the next interval
-        last_attempt_time = current_time;
-        sum = 0.0;
-        count = 0;
-        max_dB = 0.0;
-        min_dB = 0.0;
-    }
-}
\ No newline at end of file
+static void on_event(event_kind_t kind, const event_t *event, void *arg){
+    micdata_t *micdata = (micdata_t *)arg;
+
+    publish_alert_to_mqtt(micdata->config, kind, event);
+}
+
+/**
+ * @brief Runs the threshold exceedance detector of a sensor on its last measurement.
+ *
+ * @param micdata Pointer to the micdata_t structure of the sensor.
+ *
+ * Runs for every measurement, so an alert leaves the device right after the level
+ * has stayed above the threshold for the minimum duration, instead of at the end of
+ * the statistics window.
+ */
+
+void detect_events(micdata_t *micdata){
+
+    event_detector_add(&micdata->event, &micdata->last, on_event, micdata);
+}
@@ -0,0 +1,189 @@
+#include "inc/modbus_baud.h"
+#include "inc/modbus_rtu.h"
+#include "inc/config.h"
+
+/**
+ * @brief Returns the SM7901 register code of a baud rate.
+ *
+ * @param baud_rate Baud rate in bits per second.
+ *
+ * The code table follows the SM7901 register map (SM7901_BAUD_REGISTER).
+ *
+ * @return The code to write, or -1 if the sensor does not support the baud rate.
+ */
+
+int32_t sm7901_baud_code(uint32_t baud_rate){
+    static const uint32_t rates[] = {2400, 4800, 9600, 19200, 38400, 57600, 115200, 1200};
+
+    for (int32_t code = 0; code < (int32_t)(sizeof(rates) / sizeof(rates[0])); code++) {
+        if (rates[code] == baud_rate) {
+            return code;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Reads the configured registers of every slave a few times.
+ *
+ * @param link Modbus link.
+ * @param devices Table of slaves.
+ * @param device_count Number of slaves.
+ * @param latency Statistics updated with the latency of every successful read.
+ *
+ * @return true if every slave answered at least once with a valid response.
+ */
+
+static bool modbus_baud_check(const modbus_link_t *link, const modbus_bus_device_cfg_t *devices,
+                              uint8_t device_count, modbus_latency_t *latency){
+    uint8_t request[MODBUS_RTU_READ_REQUEST_SIZE];
+    uint8_t frame[MODBUS_RTU_MAX_FRAME];
+
+    for (uint8_t i = 0; i < device_count; i++) {
+        uint16_t expected = 5 + 2 * devices[i].num_registers;
+        uint16_t length = modbus_rtu_build_read_request(request, devices[i].device_address,
+                                                        devices[i].start_address, devices[i].num_registers);
+        bool answered = false;
+
+        for (uint8_t attempt = 0; attempt < MODBUS_BAUD_CHECK_READS; attempt++) {
+            uint16_t frame_length;
+            bool crc_ok;
+            uint32_t latency_us;
+
+            if (!link->transact(link->ctx, request, length, frame, &frame_length, &crc_ok, &latency_us)) {
+                continue; // Timeout
+            }
+
+            modbus_rtu_response_t parsed = modbus_rtu_parse_response(frame, frame_length, crc_ok, devices[i].device_address,
+                                                                     MODBUS_FC_READ_HOLDING_REGISTERS, expected);
+            if (parsed.status == MODBUS_STATUS_OK) {
+                modbus_latency_add(latency, latency_us);
+                answered = true;
+            }
+        }
+
+        if (!answered) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Writes the baud rate register of one slave.
+ *
+ * @param link Modbus link.
+ * @param device_address Address of the slave.
+ * @param code Baud rate code (see sm7901_baud_code()).
+ *
+ * @return true if the slave echoed the request.
+ */
+
+static bool modbus_baud_write_code(const modbus_link_t *link, uint8_t device_address, uint16_t code){
+    uint8_t request[MODBUS_RTU_WRITE_REQUEST_SIZE];
+    uint8_t frame[MODBUS_RTU_MAX_FRAME];
+    uint16_t frame_length;
+    bool crc_ok;
+    uint32_t latency_us;
+
+    uint16_t length = modbus_rtu_build_write_register(request, device_address, SM7901_BAUD_REGISTER, code);
+
+    if (!link->transact(link->ctx, request, length, frame, &frame_length, &crc_ok, &latency_us)) {
+        return false;
+    }
+
+    modbus_rtu_response_t parsed = modbus_rtu_parse_response(frame, frame_length, crc_ok, device_address,
+                                                             MODBUS_FC_WRITE_SINGLE_REGISTER, MODBUS_RTU_WRITE_REQUEST_SIZE);
+    if (parsed.status != MODBUS_STATUS_OK) {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < MODBUS_RTU_WRITE_REQUEST_SIZE; i++) {
+        if (frame[parsed.offset + i] != request[i]) {
+            return false; // A write response is an exact echo of the request
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Moves every slave of the bus to a higher baud rate.
+ *
+ * @param link Modbus link, currently configured at any baud rate.
+ * @param devices Table of slaves (they must all end up at the same rate).
+ * @param device_count Number of slaves.
+ * @param current_baud Baud rate the slaves are expected to use.
+ * @param target_baud Baud rate to switch to.
+ *
+ * The slaves are first checked at current_baud. If none of them answers, they may
+ * already run at target_baud (e.g. a previous negotiation took effect after a power
+ * cycle), so target_baud is checked too. Otherwise the baud rate register of every
+ * slave is written, the UART is switched and the check read is repeated. If a write or
+ * the check read fails, the old code is written back to the slaves already written (at
+ * both rates, since some sensors only apply the new rate after a power cycle) and the
+ * UART returns to current_baud.
+ *
+ * @return The outcome, including the check read latency at each rate.
+ */
+
+modbus_baud_result_t modbus_baud_negotiate(const modbus_link_t *link, const modbus_bus_device_cfg_t *devices,
+                                           uint8_t device_count, uint32_t current_baud, uint32_t target_baud){
+    modbus_baud_result_t result;
+    result.baud_rate = current_baud;
+    result.switched = false;
+    modbus_latency_reset(&result.before);
+    modbus_latency_reset(&result.after);
+
+    int32_t current_code = sm7901_baud_code(current_baud);
+    int32_t target_code = sm7901_baud_code(target_baud);
+
+    if (device_count == 0 || target_baud == current_baud || current_code < 0 || target_code < 0) {
+        return result;
+    }
+
+    link->set_baud(link->ctx, current_baud);
+
+    if (!modbus_baud_check(link, devices, device_count, &result.before)) {
+        link->set_baud(link->ctx, target_baud);
+
+        if (modbus_baud_check(link, devices, device_count, &result.after)) {
+            result.baud_rate = target_baud; // Already switched on a previous boot
+            result.switched = true;
+        } else {
+            link->set_baud(link->ctx, current_baud);
+        }
+        return result;
+    }
+
+    uint8_t written = 0;
+    while (written < device_count && modbus_baud_write_code(link, devices[written].device_address, target_code)) {
+        written++;
+    }
+
+    if (written == device_count) {
+        link->set_baud(link->ctx, target_baud);
+
+        if (modbus_baud_check(link, devices, device_count, &result.after)) {
+            result.baud_rate = target_baud;
+            result.switched = true;
+            return result;
+        }
+    } else {
+        written++; // The failed write may have been applied with its echo lost
+        link->set_baud(link->ctx, target_baud);
+    }
+
+    // Failure: restore the old code on the slaves that already switched
+    for (uint8_t i = 0; i < written; i++) {
+        modbus_baud_write_code(link, devices[i].device_address, current_code);
+    }
+    link->set_baud(link->ctx, current_baud);
+
+    // Restore the old code at the old rate (sensors that apply a new rate only after a power cycle)
+    for (uint8_t i = 0; i < written; i++) {
+        modbus_baud_write_code(link, devices[i].device_address, current_code);
+    }
+
+    return result;
+}
@@ -0,0 +1,327 @@
+#include "inc/modbus_bus.h"
+
+/**
+ * @brief Initializes the bus scheduler.
+ *
+ * @param bus Pointer to the scheduler.
+ * @param devices Table of slaves to poll.
+ * @param device_count Number of slaves in the table (clamped to MODBUS_BUS_MAX_DEVICES).
+ * @param response_timeout_us Time allowed for each slave to answer.
+ * @param send Callback used to transmit the requests.
+ * @param on_sample Callback invoked once per completed transaction with its status.
+ * @param cb_arg User-defined argument passed to both callbacks.
+ * @param now_us Current time in microseconds.
+ */
+
+void modbus_bus_init(modbus_bus_t *bus, const modbus_bus_device_cfg_t *devices, uint8_t device_count,
+                     uint32_t response_timeout_us,
+                     modbus_bus_send_t send, modbus_bus_sample_cb_t on_sample, void *cb_arg, uint32_t now_us){
+
+    if (device_count > MODBUS_BUS_MAX_DEVICES) {
+        device_count = MODBUS_BUS_MAX_DEVICES;
+    }
+
+    for (uint8_t i = 0; i < device_count; i++) {
+        modbus_bus_device_t *dev = &bus->devices[i];
+
+        dev->cfg = devices[i];
+        if (dev->cfg.num_registers > MODBUS_BUS_MAX_REGISTERS) {
+            dev->cfg.num_registers = MODBUS_BUS_MAX_REGISTERS;
+        }
+        for (uint8_t r = 0; r < MODBUS_BUS_MAX_REGISTERS; r++) {
+            dev->registers[r] = 0;
+        }
+        dev->last_request_us = 0;
+        dev->last_response_us = 0;
+        dev->polls = 0;
+        dev->responses = 0;
+        dev->timeouts = 0;
+        dev->crc_errors = 0;
+        dev->exceptions = 0;
+        dev->resyncs = 0;
+        dev->errors = 0;
+        dev->last_exception = 0;
+        dev->last_status = MODBUS_STATUS_PENDING;
+        dev->consecutive_timeouts = 0;
+        dev->skip_rounds = 0;
+    }
+
+    bus->device_count = device_count;
+    bus->current = 0;
+    bus->state = MODBUS_BUS_IDLE;
+    bus->request_us = now_us;
+    bus->response_timeout_us = response_timeout_us;
+    bus->rounds = 0;
+    modbus_latency_reset(&bus->latency);
+    bus->rate_window_start_us = now_us;
+    bus->rate_window_responses = 0;
+    bus->send = send;
+    bus->on_sample = on_sample;
+    bus->cb_arg = cb_arg;
+}
+
+/**
+ * @brief Sends the request of the next slave due in the current round.
+ *
+ * @param bus Pointer to the scheduler.
+ * @param now_us Current time in microseconds.
+ *
+ * Offline slaves (too many consecutive timeouts) are skipped for a few rounds so that
+ * a dead sensor does not cost a full response timeout in every round. When no slave is
+ * left, the round ends and the scheduler goes back to idle.
+ */
+
+static void modbus_bus_send_next(modbus_bus_t *bus, uint32_t now_us){
+    while (bus->current < bus->device_count) {
+        modbus_bus_device_t *dev = &bus->devices[bus->current];
+
+        if (dev->skip_rounds > 0) {
+            dev->skip_rounds--;
+            bus->current++;
+            continue;
+        }
+
+        uint8_t request[MODBUS_RTU_READ_REQUEST_SIZE];
+        uint16_t length = modbus_rtu_build_read_request(request, dev->cfg.device_address,
+                                                        dev->cfg.start_address, dev->cfg.num_registers);
+        dev->polls++;
+        dev->last_request_us = now_us;
+        bus->send(request, length, bus->cb_arg);
+        bus->request_us = now_us;
+        bus->state = MODBUS_BUS_WAIT_RESPONSE;
+        return;
+    }
+
+    bus->state = MODBUS_BUS_IDLE; // Round complete
+}
+
+/**
+ * @brief Ends the pending transaction and polls the next slave.
+ *
+ * @param bus Pointer to the scheduler.
+ * @param status Result of the transaction.
+ * @param now_us Current time in microseconds.
+ */
+
+static void modbus_bus_complete(modbus_bus_t *bus, modbus_status_t status, uint32_t now_us){
+    modbus_bus_device_t *dev = &bus->devices[bus->current];
+
+    dev->last_status = status;
+
+    if (bus->on_sample) {
+        bus->on_sample(bus->current, dev, status, bus->cb_arg);
+    }
+
+    bus->current++;
+    modbus_bus_send_next(bus, now_us);
+}
+
+/**
+ * @brief Starts a new polling round.
+ *
+ * @param bus Pointer to the scheduler.
+ * @param now_us Current time in microseconds.
+ *
+ * The first slave of the table is polled right away and the others follow as soon as
+ * each response (or timeout) completes.
+ *
+ * @return true if the round was started, false if the previous round is still running.
+ */
+
+bool modbus_bus_start_round(modbus_bus_t *bus, uint32_t now_us){
+    if (bus->state != MODBUS_BUS_IDLE || bus->device_count == 0) {
+        return false;
+    }
+
+    bus->rounds++;
+    bus->current = 0;
+    modbus_bus_send_next(bus, now_us);
+    return true;
+}
+
+/**
+ * @brief Tells whether a round is still running.
+ *
+ * @param bus Pointer to the scheduler.
+ *
+ * @return true while a request is waiting for its response.
+ */
+
+bool modbus_bus_busy(const modbus_bus_t *bus){
+    return bus->state != MODBUS_BUS_IDLE;
+}
+
+/**
+ * @brief Runs the time-driven part of the scheduler.
+ *
+ * @param bus Pointer to the scheduler.
+ * @param now_us Current time in microseconds.
+ *
+ * This function handles response timeouts. It never blocks and must be called
+ * whenever modbus_bus_next_event_us() is reached.
+ */
+
+void modbus_bus_poll(modbus_bus_t *bus, uint32_t now_us){
+    if (bus->state != MODBUS_BUS_WAIT_RESPONSE) {
+        return;
+    }
+
+    if (now_us - bus->request_us < bus->response_timeout_us) {
+        return;
+    }
+
+    modbus_bus_device_t *dev = &bus->devices[bus->current];
+    dev->timeouts++;
+    if (dev->consecutive_timeouts < UINT8_MAX) {
+        dev->consecutive_timeouts++;
+    }
+    if (dev->consecutive_timeouts >= MODBUS_BUS_OFFLINE_AFTER) {
+        dev->skip_rounds = MODBUS_BUS_OFFLINE_RETRY_ROUNDS; // Back off from an unresponsive slave
+    }
+
+    modbus_bus_complete(bus, MODBUS_STATUS_TIMEOUT, now_us);
+}
+
+/**
+ * @brief Handles a frame delimited by the RTU receiver.
+ *
+ * @param bus Pointer to the scheduler.
+ * @param frame Pointer to the frame.
+ * @param length Length of the frame.
+ * @param crc_ok CRC result of the whole frame.
+ * @param now_us Completion time of the frame.
+ *
+ * The response to the pending request is located in the frame (resynchronizing on the
+ * address and function code if stray bytes corrupted it) and reported through the
+ * sample callback with its status. The next slave is polled right away, without waiting
+ * for a fixed delay: the RTU receiver only delivers a frame after the t3.5 silence.
+ */
+
+void modbus_bus_on_frame(modbus_bus_t *bus, const uint8_t *frame, uint16_t length, bool crc_ok, uint32_t now_us){
+    if (bus->state != MODBUS_BUS_WAIT_RESPONSE) {
+        return; // Unsolicited frame
+    }
+
+    modbus_bus_device_t *dev = &bus->devices[bus->current];
+    uint16_t expected = 5 + 2 * dev->cfg.num_registers;
+
+    modbus_rtu_response_t parsed = modbus_rtu_parse_response(frame, length, crc_ok, dev->cfg.device_address,
+                                                             MODBUS_FC_READ_HOLDING_REGISTERS, expected);
+    const uint8_t *response = frame + parsed.offset;
+
+    if (parsed.status == MODBUS_STATUS_OK && response[2] != 2 * dev->cfg.num_registers) {
+        parsed.status = MODBUS_STATUS_BAD_RESPONSE; // Wrong byte count
+    }
+
+    if (parsed.resynced) {
+        dev->resyncs++;
+    }
+
+    switch (parsed.status) {
+    case MODBUS_STATUS_OK:
+        for (uint16_t r = 0; r < dev->cfg.num_registers; r++) {
+            dev->registers[r] = (response[3 + 2 * r] << 8) | response[4 + 2 * r];
+        }
+        dev->last_response_us = now_us;
+        dev->responses++;
+        modbus_latency_add(&bus->latency, now_us - bus->request_us);
+        dev->consecutive_timeouts = 0;
+        bus->rate_window_responses++;
+        break;
+
+    case MODBUS_STATUS_EXCEPTION:
+        dev->exceptions++;
+        dev->last_exception = parsed.exception_code;
+        dev->consecutive_timeouts = 0; // The slave is alive
+        break;
+
+    case MODBUS_STATUS_CRC_ERROR:
+        dev->crc_errors++;
+        break;
+
+    default:
+        dev->errors++;
+        break;
+    }
+
+    modbus_bus_complete(bus, parsed.status, now_us);
+}
+
+/**
+ * @brief Returns the next time at which modbus_bus_poll() has work to do.
+ *
+ * @param bus Pointer to the scheduler.
+ * @param now_us Current time in microseconds.
+ *
+ * @return Microseconds until the response timeout (0 if already due, UINT32_MAX if idle).
+ */
+
+uint32_t modbus_bus_next_event_us(const modbus_bus_t *bus, uint32_t now_us){
+    if (bus->state != MODBUS_BUS_WAIT_RESPONSE) {
+        return UINT32_MAX; // Nothing to do until the next round is started
+    }
+
+    int32_t remaining = (int32_t)(bus->request_us + bus->response_timeout_us - now_us);
+    return (remaining > 0) ? (uint32_t)remaining : 0;
+}
+
+/**
+ * @brief Returns the achieved poll rate and starts a new measurement window.
+ *
+ * @param bus Pointer to the scheduler.
+ * @param now_us Current time in microseconds.
+ *
+ * @return Valid responses per second since the previous call, in hundredths.
+ */
+
+uint32_t modbus_bus_take_poll_rate(modbus_bus_t *bus, uint32_t now_us){
+    uint32_t elapsed = now_us - bus->rate_window_start_us;
+    uint32_t rate = 0;
+
+    if (elapsed > 0) {
+        rate = (uint32_t)(((uint64_t)bus->rate_window_responses * 100000000ULL) / elapsed);
+    }
+
+    bus->rate_window_start_us = now_us;
+    bus->rate_window_responses = 0;
+    return rate;
+}
+
+/**
+ * @brief Clears latency statistics.
+ *
+ * @param latency Pointer to the statistics.
+ */
+
+void modbus_latency_reset(modbus_latency_t *latency){
+    latency->count = 0;
+    latency->min_us = UINT32_MAX;
+    latency->max_us = 0;
+    latency->sum_us = 0;
+}
+
+/**
+ * @brief Adds one transaction to latency statistics.
+ *
+ * @param latency Pointer to the statistics.
+ * @param latency_us Latency of the transaction in microseconds.
+ */
+
+void modbus_latency_add(modbus_latency_t *latency, uint32_t latency_us){
+    if (latency_us < latency->min_us) latency->min_us = latency_us;
+    if (latency_us > latency->max_us) latency->max_us = latency_us;
+    latency->sum_us += latency_us;
+    latency->count++;
+}
+
+/**
+ * @brief Returns the mean latency.
+ *
+ * @param latency Pointer to the statistics.
+ *
+ * @return The mean latency in microseconds, 0 if nothing was measured.
+ */
+
+uint32_t modbus_latency_mean_us(const modbus_latency_t *latency){
+    return latency->count ? (uint32_t)(latency->sum_us / latency->count) : 0;
+}
@@ -0,0 +1,282 @@
+#include "inc/modbus_rtu.h"
+#include "inc/crc16.h"
+
+/**
+ * @brief Computes the t1.5 and t3.5 character timings for a baud rate.
+ *
+ * @param rx Pointer to the receiver.
+ * @param baud_rate UART baud rate.
+ *
+ * One RTU character is 11 bits long. Above 19200 baud the Modbus specification
+ * fixes the timings to 750 us and 1750 us.
+ */
+
+void modbus_rtu_rx_set_baud(modbus_rtu_rx_t *rx, uint32_t baud_rate){
+    if (baud_rate > 19200) {
+        rx->t15_us = 750;
+        rx->t35_us = 1750;
+    } else {
+        rx->t15_us = (15 * 11 * 1000000UL) / (10 * baud_rate);
+        rx->t35_us = (35 * 11 * 1000000UL) / (10 * baud_rate);
+    }
+}
+
+/**
+ * @brief Initializes the Modbus RTU receiver.
+ *
+ * @param rx Pointer to the receiver.
+ * @param baud_rate UART baud rate, used to derive the inter-character timings.
+ * @param on_frame Callback invoked for each delimited frame (can be NULL).
+ * @param cb_arg User-defined argument passed to the callback.
+ */
+
+void modbus_rtu_rx_init(modbus_rtu_rx_t *rx, uint32_t baud_rate, modbus_rtu_frame_cb_t on_frame, void *cb_arg){
+    rx->length = 0;
+    rx->crc = CRC16_MODBUS_INIT;
+    rx->state = MODBUS_RTU_IDLE;
+    rx->last_byte_us = 0;
+    rx->on_frame = on_frame;
+    rx->cb_arg = cb_arg;
+    rx->frames_ok = 0;
+    rx->frames_bad_crc = 0;
+    rx->frames_discarded = 0;
+    modbus_rtu_rx_set_baud(rx, baud_rate);
+}
+
+/**
+ * @brief Closes the current frame and hands it to the callback.
+ *
+ * @param rx Pointer to the receiver.
+ *
+ * The CRC is validated by the running CRC: computing the CRC over a frame that
+ * includes its own CRC bytes yields zero.
+ */
+
+static void modbus_rtu_rx_end_frame(modbus_rtu_rx_t *rx){
+    if (rx->state == MODBUS_RTU_RECEIVING && rx->length >= MODBUS_RTU_MIN_FRAME) {
+        bool crc_ok = (rx->crc == 0);
+
+        if (crc_ok) {
+            rx->frames_ok++;
+        } else {
+            rx->frames_bad_crc++;
+        }
+
+        if (rx->on_frame) {
+            rx->on_frame(rx->frame, rx->length, crc_ok, rx->cb_arg);
+        }
+    } else if (rx->state != MODBUS_RTU_IDLE) {
+        rx->frames_discarded++; // Runt frame or frame invalidated while receiving
+    }
+
+    rx->length = 0;
+    rx->crc = CRC16_MODBUS_INIT;
+    rx->state = MODBUS_RTU_IDLE;
+}
+
+/**
+ * @brief Feeds one received byte into the state machine.
+ *
+ * @param rx Pointer to the receiver.
+ * @param byte Received byte.
+ * @param now_us Arrival time of the byte in microseconds (wrap-around safe).
+ *
+ * A silence of t3.5 or more before the byte closes the previous frame. A silence
+ * between t1.5 and t3.5 inside a frame invalidates it, as required by the spec.
+ */
+
+void modbus_rtu_rx_feed(modbus_rtu_rx_t *rx, uint8_t byte, uint32_t now_us){
+    uint32_t silence = now_us - rx->last_byte_us;
+    rx->last_byte_us = now_us;
+
+    if (rx->state != MODBUS_RTU_IDLE && silence >= rx->t35_us) {
+        modbus_rtu_rx_end_frame(rx); // The gap was missed by modbus_rtu_rx_poll()
+    }
+
+    switch (rx->state) {
+    case MODBUS_RTU_IDLE:
+        rx->state = MODBUS_RTU_RECEIVING;
+        rx->length = 0;
+        rx->crc = CRC16_MODBUS_INIT;
+        // fall through
+
+    case MODBUS_RTU_RECEIVING:
+        if (rx->length > 0 && silence > rx->t15_us) {
+            rx->state = MODBUS_RTU_DISCARDING; // Inter-character timeout inside the frame
+            break;
+        }
+        if (rx->length >= MODBUS_RTU_MAX_FRAME) {
+            rx->state = MODBUS_RTU_DISCARDING; // Frame too long
+            break;
+        }
+        rx->frame[rx->length++] = byte;
+        rx->crc = crc16_modbus_update(rx->crc, byte);
+        break;
+
+    case MODBUS_RTU_DISCARDING:
+        break;
+    }
+}
+
+/**
+ * @brief Checks the bus silence and closes the current frame after t3.5.
+ *
+ * @param rx Pointer to the receiver.
+ * @param now_us Current time in microseconds.
+ *
+ * This function must be called periodically (e.g. after draining the RX ring).
+ *
+ * @return true if a frame was closed during this call.
+ */
+
+bool modbus_rtu_rx_poll(modbus_rtu_rx_t *rx, uint32_t now_us){
+    if (rx->state == MODBUS_RTU_IDLE) {
+        return false;
+    }
+
+    if ((int32_t)(now_us - rx->last_byte_us) < (int32_t)rx->t35_us) {
+        return false;                       // Also when the last byte is timestamped after now_us
+    }
+
+    bool delivered = (rx->state == MODBUS_RTU_RECEIVING && rx->length >= MODBUS_RTU_MIN_FRAME);
+    modbus_rtu_rx_end_frame(rx);
+    return delivered;
+}
+
+/**
+ * @brief Builds a "read holding registers" (0x03) request frame.
+ *
+ * @param frame Buffer of at least MODBUS_RTU_READ_REQUEST_SIZE bytes.
+ * @param device_address The Modbus address of the slave.
+ * @param start_address The starting address of the registers to read.
+ * @param num_registers The number of registers to read.
+ *
+ * @return The length of the frame, CRC included.
+ */
+
+uint16_t modbus_rtu_build_read_request(uint8_t *frame, uint8_t device_address, uint16_t start_address, uint16_t num_registers){
+    frame[0] = device_address;
+    frame[1] = MODBUS_FC_READ_HOLDING_REGISTERS;
+    frame[2] = (start_address >> 8) & 0xFF;
+    frame[3] = start_address & 0xFF;
+    frame[4] = (num_registers >> 8) & 0xFF;
+    frame[5] = num_registers & 0xFF;
+
+    uint16_t crc = crc16_modbus(frame, 6);
+    frame[6] = crc & 0xFF;
+    frame[7] = (crc >> 8) & 0xFF;
+
+    return MODBUS_RTU_READ_REQUEST_SIZE;
+}
+
+/**
+ * @brief Builds a "write single register" (0x06) request frame.
+ *
+ * @param frame Buffer of at least MODBUS_RTU_WRITE_REQUEST_SIZE bytes.
+ * @param device_address The Modbus address of the slave.
+ * @param register_address The address of the register to write.
+ * @param value The value to write.
+ *
+ * The slave answers with an exact echo of the request.
+ *
+ * @return The length of the frame, CRC included.
+ */
+
+uint16_t modbus_rtu_build_write_register(uint8_t *frame, uint8_t device_address, uint16_t register_address, uint16_t value){
+    frame[0] = device_address;
+    frame[1] = MODBUS_FC_WRITE_SINGLE_REGISTER;
+    frame[2] = (register_address >> 8) & 0xFF;
+    frame[3] = register_address & 0xFF;
+    frame[4] = (value >> 8) & 0xFF;
+    frame[5] = value & 0xFF;
+
+    uint16_t crc = crc16_modbus(frame, 6);
+    frame[6] = crc & 0xFF;
+    frame[7] = (crc >> 8) & 0xFF;
+
+    return MODBUS_RTU_WRITE_REQUEST_SIZE;
+}
+
+/**
+ * @brief Computes the time a frame takes on the wire.
+ *
+ * @param length Frame length in bytes.
+ * @param baud_rate UART baud rate.
+ *
+ * @return The transmission time in microseconds (11 bits per RTU character).
+ */
+
+uint32_t modbus_rtu_frame_time_us(uint16_t length, uint32_t baud_rate){
+    return (uint32_t)(((uint64_t)length * 11 * 1000000UL) / baud_rate);
+}
+
+/**
+ * @brief Locates and checks the response to a request inside a delimited frame.
+ *
+ * @param frame Pointer to the frame delimited by the receiver.
+ * @param length Length of the frame.
+ * @param crc_ok CRC result given by the receiver for the whole frame.
+ * @param device_address Address the request was sent to.
+ * @param function Function code of the request.
+ * @param expected_length Length of a normal response, CRC included.
+ *
+ * When the frame as a whole is not a valid response (stray bytes glued to the
+ * response, line noise before it), the frame is scanned for the first offset that
+ * starts with the expected address and function code (or function | 0x80) and whose
+ * CRC is valid over the expected length. Exception responses are decoded.
+ *
+ * @return The located response and its status.
+ */
+
+modbus_rtu_response_t modbus_rtu_parse_response(const uint8_t *frame, uint16_t length, bool crc_ok,
+                                                uint8_t device_address, uint8_t function, uint16_t expected_length){
+    modbus_rtu_response_t response = {
+        .status = crc_ok ? MODBUS_STATUS_BAD_RESPONSE : MODBUS_STATUS_CRC_ERROR,
+        .offset = 0,
+        .length = length,
+        .exception_code = 0,
+        .resynced = false,
+    };
+
+    for (uint16_t offset = 0; offset + MODBUS_RTU_EXCEPTION_SIZE <= length; offset++) {
+        const uint8_t *candidate = frame + offset;
+        uint16_t candidate_length;
+
+        if (candidate[0] != device_address) {
+            continue;
+        }
+
+        if (candidate[1] == function) {
+            candidate_length = expected_length;
+        } else if (candidate[1] == (function | MODBUS_FC_EXCEPTION_FLAG)) {
+            candidate_length = MODBUS_RTU_EXCEPTION_SIZE;
+        } else {
+            continue;
+        }
+
+        if (offset + candidate_length > length) {
+            continue;
+        }
+
+        // Whole frame already checked by the receiver; sub-frames need their own CRC
+        bool candidate_crc_ok = (offset == 0 && candidate_length == length) ? crc_ok
+                              : (crc16_modbus(candidate, candidate_length) == 0);
+        if (!candidate_crc_ok) {
+            continue;
+        }
+
+        response.offset = offset;
+        response.length = candidate_length;
+        response.resynced = (offset != 0 || candidate_length != length);
+
+        if (candidate[1] & MODBUS_FC_EXCEPTION_FLAG) {
+            response.status = MODBUS_STATUS_EXCEPTION;
+            response.exception_code = candidate[2];
+        } else {
+            response.status = MODBUS_STATUS_OK;
+        }
+        return response;
+    }
+
+    return response;
+}
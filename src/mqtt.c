@@ -4,7 +4,11 @@
 #include "inc/config.h"
 #include "inc/timertc.h"
 #include "inc/flash.h"
+#include "inc/cbor.h"
 #include "lwip/dns.h"
+#include "lwip/altcp.h"
+#include <stdarg.h>
+#include <string.h>
 
 // Structure to store the MQTT client information
 const struct mqtt_connect_client_info_t client_info = {
@@ -18,6 +22,35 @@ const struct mqtt_connect_client_info_t client_info = {
 mqtt_client_t *global_mqtt_client = NULL;
 ip_addr_t broker_ip; // Global variable to store the broker IP address
 
+publish_queue_t publish_queue; // Window records waiting for the publisher
+alert_queue_t alert_queue;     // Alerts waiting for the publisher
+publish_batch_stats_t publish_batch_stats; // Batching of the record messages
+publish_tracker_t publish_tracker;         // Record messages waiting for their PUBACK
+backlog_stats_t backlog_stats;             // Drain of the data saved to flash
+
+static volatile uint32_t connection_epoch;  // Incremented by every connection event (lost PUBACKs)
+static volatile bool backlog_pending;       // Saved data waiting to be sent
+
+#if MQTT_INFLIGHT_WINDOW < 2
+#error "MQTT_INFLIGHT_WINDOW must keep one message for the live records"
+#endif
+
+#if MQTT_BATCH_MAX_BYTES < MQTT_PAYLOAD_SIZE + 2
+#error "MQTT_BATCH_MAX_BYTES must hold at least one record"
+#endif
+
+#if MQTT_OUTPUT_RINGBUF_SIZE < MQTT_BATCH_MAX_BYTES + 64
+#error "MQTT_OUTPUT_RINGBUF_SIZE (lwipopts.h) must hold a whole batch with its header and topic"
+#endif
+
+#if TCP_SND_BUF < MQTT_BATCH_MAX_BYTES
+#error "TCP_SND_BUF (lwipopts.h) must reach MQTT_BATCH_MAX_BYTES, or the backlog drain never starts"
+#endif
+
+#if MQTT_REQ_MAX_IN_FLIGHT <= MQTT_INFLIGHT_WINDOW
+#error "MQTT_REQ_MAX_IN_FLIGHT (lwipopts.h) must leave request slots for the alerts"
+#endif
+
 static void dns_function_callback(const char *name, const ip_addr_t *ipaddr, void *callback_arg){
 
     LWIP_UNUSED_ARG(name);
@@ -57,20 +90,22 @@ void resolve_broker_dns(ip_addr_t *broker_ip) {
  * This function is called when an MQTT connection attempt is completed.
  * It prints whether the connection was successful or failed.
  *
- * It also tries to reconnect if the connection failed.
+ * It runs in the lwIP context, so it only flags the events: the publisher task fails
+ * the messages of the previous connection and the backlog task resends the saved data.
  *
  */
 
 // Callback function for MQTT connection events
 void mqtt_connection_cb(mqtt_client_t *client, void *arg, mqtt_connection_status_t status)
 {
+    connection_epoch++; // The PUBACKs of the previous connection will not come
 
     // Check if the connection was successful
     if (status == MQTT_CONNECT_ACCEPTED)
     {
         printf("Conexão MQTT bem-sucedida!\n"); // Debug message
 
-        resend_saved_data(); // Resend any saved data from flash storage
+        backlog_pending = true; // Resend any saved data from flash storage (backlog task)
     }
     else
     {
@@ -81,13 +116,16 @@ void mqtt_connection_cb(mqtt_client_t *client, void *arg, mqtt_connection_status
 /**
  * @brief Initializes and starts the MQTT client.
  *
- * This function creates a new MQTT client, assigns a broker IP,
+ * This function empties the publish queue, creates a new MQTT client, assigns a broker IP,
  * and attempts to establish a connection.
  *
  */
 
 void start_mqtt_client(void)
 {
+    publish_queue_init(&publish_queue); // Empty publish queue
+    publish_tracker_init(&publish_tracker); // Nothing in flight
+    backlog_stats.window = 1;               // Backlog drain starts with one message in flight
 
     global_mqtt_client = mqtt_client_new(); // Create a new MQTT client
 
@@ -103,48 +141,853 @@ void start_mqtt_client(void)
 }
 
 /**
- * @brief Publishes sound level data to an MQTT topic.
+ * @brief Appends formatted text to a payload.
+ *
+ * @param payload Buffer holding the payload.
+ * @param size Size of the buffer.
+ * @param len Pointer to the current length, advanced by the text written.
+ * @param format printf format of the text.
  *
- * @param micdata Pointer to a micdata_t structure containing the sound level data and other metadata.
+ * Nothing is written once the buffer is full; the payload is then truncated.
+ */
+
+static void payload_append(char *payload, size_t size, size_t *len, const char *format, ...) {
+
+    if (*len >= size) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(payload + *len, size - *len, format, args);
+    va_end(args);
+
+    if (written > 0) {
+        *len += (size_t)written;
+    }
+}
+
+/**
+ * @brief Appends a fixed-point value to a payload.
  *
- * This function checks if the MQTT client/Wi-Fi is connected, formats the information into a JSON payload and
- * attempts to publish it to the MQTT topic.
+ * @param payload Buffer holding the payload.
+ * @param size Size of the buffer.
+ * @param len Pointer to the current length, advanced by the text written.
+ * @param value Value in units of 10^-decimals.
+ * @param decimals Number of decimal places.
+ */
+
+static void payload_append_fixed(char *payload, size_t size, size_t *len, int32_t value, uint8_t decimals) {
+
+    if (*len >= size) {
+        return;
+    }
+
+    int written = measurement_format_fixed(payload + *len, size - *len, value, decimals);
+
+    if (written > 0) {
+        *len += (size_t)written;
+    }
+}
+
+/**
+ * @brief Appends text to a payload.
  *
- * If the data is published successfully, it displays a debug message.
- * If there is an error, it displays an error message.
+ * @param payload Buffer holding the payload.
+ * @param size Size of the buffer.
+ * @param len Pointer to the current length, advanced by the length of the text.
+ * @param text Text to append.
+ * @param length Length of the text.
  *
+ * Truncates like payload_append(): the length keeps counting past a full buffer.
  */
 
-// Função de publicação MODIFICADA
-void publish_db_to_mqtt(micdata_t *micdata) {
+static void payload_put(char *payload, size_t size, size_t *len, const char *text, size_t length) {
 
-    char payload[256];
-    char timestamp[32];
+    if (*len >= size) {
+        return;
+    }
+
+    size_t copied = (length < size - *len) ? length : size - *len - 1;
+    memcpy(payload + *len, text, copied);
+    payload[*len + copied] = '\0';
+    *len += length;
+}
+
+/**
+ * @brief Appends a string to a payload.
+ *
+ * @param payload Buffer holding the payload.
+ * @param size Size of the buffer.
+ * @param len Pointer to the current length, advanced by the text written.
+ * @param text Null-terminated string to append.
+ */
+
+static void payload_put_string(char *payload, size_t size, size_t *len, const char *text) {
+    payload_put(payload, size, len, text, strlen(text));
+}
+
+/**
+ * @brief Writes an unsigned integer in decimal, zero-padded to a minimum width.
+ *
+ * @param text Buffer receiving the digits (at least 10 characters, not terminated).
+ * @param value Value to write.
+ * @param width Minimum number of digits.
+ * @return Number of digits written.
+ */
+
+static size_t format_uint(char *text, uint32_t value, uint8_t width) {
+
+    char digits[10];
+    size_t count = 0;
+
+    do {                                                    // Digits are emitted from the right
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0 || count < width);
+
+    for (size_t i = 0; i < count; i++) {
+        text[i] = digits[count - 1 - i];
+    }
+
+    return count;
+}
+
+/**
+ * @brief Appends an unsigned integer to a payload.
+ *
+ * @param payload Buffer holding the payload.
+ * @param size Size of the buffer.
+ * @param len Pointer to the current length, advanced by the text written.
+ * @param value Value to append.
+ */
+
+static void payload_put_uint(char *payload, size_t size, size_t *len, uint32_t value) {
+
+    char text[10];
+
+    payload_put(payload, size, len, text, format_uint(text, value, 1));
+}
+
+/**
+ * @brief Converts an RTC time (UTC) to epoch seconds.
+ *
+ * @param time RTC time.
+ * @return Seconds since 1970-01-01 00:00 UTC.
+ */
+
+static uint32_t datetime_epoch(const datetime_t *time) {
+
+    int32_t year = time->year - (time->month <= 2);         // Days from the civil date, years starting in March
+    int32_t era = (year >= 0 ? year : year - 399) / 400;
+    uint32_t year_of_era = (uint32_t)(year - era * 400);
+    uint32_t day_of_year = (153 * (time->month + (time->month > 2 ? -3 : 9)) + 2) / 5 + time->day - 1;
+    uint32_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    int32_t days = era * 146097 + (int32_t)day_of_era - 719468;
+
+    return (uint32_t)days * 86400u + time->hour * 3600u + time->min * 60u + time->sec;
+}
+
+/**
+ * @brief Converts an RTC time (UTC) to the local time of the sensor (GMT_M_3).
+ *
+ * @param time RTC time.
+ * @param local Local time, with the date rolled back past midnight.
+ *
+ * An RTC that was never set (before 1971) is left as read.
+ */
+
+static void datetime_local(const datetime_t *time, datetime_t *local) {
+
+    *local = *time;
+
+    if (time->year <= 1970) {
+        return;
+    }
+
+    uint32_t seconds = datetime_epoch(time) - GMT_M_3 * 3600u;
+    uint32_t days = seconds / 86400;
+    uint32_t day_seconds = seconds % 86400;
+
+    uint32_t shifted = days + 719468;                       // Civil date from the days, years starting in March
+    uint32_t era = shifted / 146097;
+    uint32_t day_of_era = shifted - era * 146097;
+    uint32_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    uint32_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    uint32_t month_index = (5 * day_of_year + 2) / 153;
+    uint32_t month = month_index < 10 ? month_index + 3 : month_index - 9;
+
+    local->year = (int16_t)(year_of_era + era * 400 + (month <= 2));
+    local->month = (int8_t)month;
+    local->day = (int8_t)(day_of_year - (153 * month_index + 2) / 5 + 1);
+    local->dotw = (int8_t)((days + 4) % 7);                 // 1970-01-01 was a Thursday
+    local->hour = (int8_t)(day_seconds / 3600);
+    local->min = (int8_t)(day_seconds / 60 % 60);
+    local->sec = (int8_t)(day_seconds % 60);
+}
+
+/**
+ * @brief Formats an RTC time as the local timestamp of the payloads.
+ *
+ * @param time RTC time (UTC).
+ * @param timestamp Buffer receiving the null-terminated timestamp (32 characters).
+ * @return Length of the timestamp ("YYYY-MM-DD HH:MM:SS"), without the terminator.
+ */
+
+static size_t format_timestamp(const datetime_t *time, char *timestamp) {
+
+    const char separators[] = { '-', '-', ' ', ':', ':', '\0' };
     datetime_t now;
+    size_t len = 0;
+
+    datetime_local(time, &now);
+
+    const int32_t fields[] = { now.year, now.month, now.day, now.hour, now.min, now.sec };
+
+    for (uint8_t i = 0; i < count_of(fields); i++) {
+        len += format_uint(timestamp + len, fields[i] < 0 ? 0 : (uint32_t)fields[i], i == 0 ? 4 : 2);
+        timestamp[len++] = separators[i];
+    }
+
+    return len - 1;
+}
+
+/**
+ * @brief Static fields of the JSON payload of one sensor, rendered once.
+ */
+
+typedef struct {
+    const sensor_config_t *config;  ///< Sensor of the fields
+    uint8_t head_length;
+    uint8_t location_length;
+    char head[24];                  ///< {"id":"<id>", "window":
+    char location[72];              ///< , "latitude":<lat>, "longitude":<lon>, "dose":"
+} payload_prefix_t;
+
+static payload_prefix_t payload_prefix[MQTT_PAYLOAD_PREFIX_SLOTS];
+static uint8_t payload_prefix_count;
+
+/**
+ * @brief Renders the static fields of the JSON payload of a sensor.
+ *
+ * @param config Static configuration of the sensor.
+ * @param prefix Receives the rendered fields.
+ */
+
+static void payload_prefix_render(const sensor_config_t *config, payload_prefix_t *prefix) {
+
+    size_t len = 0;
+
+    prefix->config = config;
+
+    payload_append(prefix->head, sizeof(prefix->head), &len, "{\"id\":\"%d\", \"window\":", config->sensor_id);
+    prefix->head_length = (uint8_t)len;
+
+    len = 0;
+    payload_append(prefix->location, sizeof(prefix->location), &len, ", \"latitude\":");
+    payload_append_fixed(prefix->location, sizeof(prefix->location), &len, config->latitude_e6, 6);
+    payload_append(prefix->location, sizeof(prefix->location), &len, ", \"longitude\":");
+    payload_append_fixed(prefix->location, sizeof(prefix->location), &len, config->longitude_e6, 6);
+    payload_append(prefix->location, sizeof(prefix->location), &len, ", \"dose\":\"");
+    prefix->location_length = (uint8_t)len;
+}
+
+/**
+ * @brief Renders the static JSON fields of the sensors (identifier and location) once.
+ *
+ * @param configs Static configuration of the sensors.
+ * @param count Number of sensors (up to MQTT_PAYLOAD_PREFIX_SLOTS are kept).
+ */
+
+void mqtt_payload_init(const sensor_config_t *configs, uint8_t count) {
+
+    payload_prefix_count = (count < MQTT_PAYLOAD_PREFIX_SLOTS) ? count : MQTT_PAYLOAD_PREFIX_SLOTS;
+
+    for (uint8_t i = 0; i < payload_prefix_count; i++) {
+        payload_prefix_render(&configs[i], &payload_prefix[i]);
+    }
+}
+
+/**
+ * @brief Formats a window record as a JSON payload.
+ *
+ * @param record Record to format.
+ * @param payload Buffer receiving the payload.
+ * @param size Size of the buffer.
+ * @return Length of the payload.
+ *
+ * The static fields of the sensor are copied from payload_prefix (rendered at boot) and
+ * the values are emitted with integer arithmetic: no printf and no soft-float.
+ */
+
+static size_t format_payload(const publish_record_t *record, char *payload, size_t size) {
+
+    static const char *const level_keys[] = { ", \"avgdB\":\"", ", \"mindB\":\"", ", \"maxdB\":\"", ", \"leq\":\"",
+                                              ", \"l10\":\"", ", \"l50\":\"", ", \"l90\":\"", ", \"l95\":\"" };
+    const int16_t levels[] = { record->mean_cdB, record->min_cdB, record->max_cdB, record->leq_cdB,
+                               record->l10_cdB, record->l50_cdB, record->l90_cdB, record->l95_cdB };
+    const payload_prefix_t *prefix = NULL;
+    payload_prefix_t rendered;
+    char timestamp[32];
+    size_t len = 0;
+
+    for (uint8_t i = 0; i < payload_prefix_count; i++) {
+        if (payload_prefix[i].config == record->config) {
+            prefix = &payload_prefix[i];
+            break;
+        }
+    }
+
+    if (prefix == NULL) {                                   // Sensor not rendered at boot
+        payload_prefix_render(record->config, &rendered);
+        prefix = &rendered;
+    }
+
+    payload_put(payload, size, &len, prefix->head, prefix->head_length);
+    payload_put_uint(payload, size, &len, record->window_s);
+
+    for (uint8_t i = 0; i < count_of(level_keys); i++) {
+        payload_put_string(payload, size, &len, level_keys[i]);
+        payload_append_fixed(payload, size, &len, levels[i], 2);
+        payload_put(payload, size, &len, "\"", 1);
+    }
+
+    payload_put(payload, size, &len, prefix->location, prefix->location_length);
+    payload_append_fixed(payload, size, &len, (int32_t)(record->dose_percent_c > INT32_MAX ? INT32_MAX : record->dose_percent_c), 2);
+    payload_put_string(payload, size, &len, "\", \"twa\":\"");
+    payload_append_fixed(payload, size, &len, record->twa_cdB, 2);
+    payload_put(payload, size, &len, "\"", 1);
+
+    if (record->window_s == 24 * 60 * 60) {
+        payload_put_string(payload, size, &len, ", \"lden\":\"");
+        payload_append_fixed(payload, size, &len, record->lden_cdB, 2);
+        payload_put(payload, size, &len, "\"", 1);
+    }
+
+    if (record->band_count > 0) {
+        // 1/3-octave band levels keyed by nominal centre frequency, e.g. "bands":{"1000":52.10, ...}
+        payload_put_string(payload, size, &len, ", \"bands\":{");
+        for (uint8_t b = 0; b < record->band_count; b++) {
+            payload_put_string(payload, size, &len, b ? ",\"" : "\"");
+            payload_put_uint(payload, size, &len, spectrum_band_nominal_hz(record->first_band + b));
+            payload_put(payload, size, &len, "\":", 2);
+            payload_append_fixed(payload, size, &len, record->band_cdB[b], 2);
+        }
+        payload_put(payload, size, &len, "}", 1);
+    }
+
+    payload_put_string(payload, size, &len, ", \"timestamp\":\"");
+    payload_put(payload, size, &len, timestamp, format_timestamp(&record->time, timestamp));
+    payload_put(payload, size, &len, "\"}", 2);
+
+    return (len < size) ? len : size - 1;                   // Truncated payload
+}
+
+#if MQTT_PAYLOAD_CBOR
+
+/**
+ * @brief Encodes a window record as a CBOR map (keys of publish_key_t).
+ *
+ * @param record Record to encode.
+ * @param payload Buffer receiving the encoded record.
+ * @param size Size of the buffer.
+ * @return Length of the encoded record.
+ *
+ * The encoder writes straight into the buffer: no allocation, no text formatting.
+ */
+
+static size_t encode_payload_cbor(const publish_record_t *record, char *payload, size_t size) {
+
+    const int16_t levels[] = { record->mean_cdB, record->min_cdB, record->max_cdB, record->leq_cdB,
+                               record->l10_cdB, record->l50_cdB, record->l90_cdB, record->l95_cdB };
+    bool lden = record->window_s == 24 * 60 * 60;
+    cbor_writer_t writer;
+
+    cbor_writer_init(&writer, (uint8_t *)payload, size);
+    cbor_put_map(&writer, PUBLISH_KEY_LDEN + lden + (record->band_count > 0));   // Keys before PUBLISH_KEY_LDEN are always present
+
+    cbor_put_uint(&writer, PUBLISH_KEY_ID);
+    cbor_put_uint(&writer, record->config->sensor_id);
+    cbor_put_uint(&writer, PUBLISH_KEY_TIME);
+    cbor_put_tag(&writer, CBOR_TAG_EPOCH);
+    cbor_put_uint(&writer, datetime_epoch(&record->time));
+    cbor_put_uint(&writer, PUBLISH_KEY_WINDOW);
+    cbor_put_uint(&writer, record->window_s);
+
+    for (uint8_t i = 0; i < count_of(levels); i++) {
+        cbor_put_uint(&writer, PUBLISH_KEY_MEAN + i);
+        cbor_put_int(&writer, levels[i]);
+    }
+
+    cbor_put_uint(&writer, PUBLISH_KEY_LATITUDE);
+    cbor_put_int(&writer, record->config->latitude_e6);
+    cbor_put_uint(&writer, PUBLISH_KEY_LONGITUDE);
+    cbor_put_int(&writer, record->config->longitude_e6);
+    cbor_put_uint(&writer, PUBLISH_KEY_DOSE);
+    cbor_put_uint(&writer, record->dose_percent_c);
+    cbor_put_uint(&writer, PUBLISH_KEY_TWA);
+    cbor_put_int(&writer, record->twa_cdB);
+
+    if (lden) {
+        cbor_put_uint(&writer, PUBLISH_KEY_LDEN);
+        cbor_put_int(&writer, record->lden_cdB);
+    }
+
+    if (record->band_count > 0) {
+        cbor_put_uint(&writer, PUBLISH_KEY_BANDS);
+        cbor_put_array(&writer, 1u + record->band_count);
+        cbor_put_int(&writer, record->first_band);
+        for (uint8_t b = 0; b < record->band_count; b++) {
+            cbor_put_int(&writer, record->band_cdB[b]);
+        }
+    }
+
+    return writer.length;
+}
+
+#endif
+
+/**
+ * @brief Formats a window record in the configured encoding (MQTT_PAYLOAD_CBOR).
+ *
+ * @param record Record to format.
+ * @param payload Buffer receiving the record.
+ * @param size Size of the buffer.
+ * @return Length of the record.
+ */
+
+static size_t format_record(const publish_record_t *record, char *payload, size_t size) {
+#if MQTT_PAYLOAD_CBOR
+    return encode_payload_cbor(record, payload, size);
+#else
+    return format_payload(record, payload, size);
+#endif
+}
+
+/**
+ * @brief Formats an alert as a JSON payload.
+ *
+ * @param alert Alert to format.
+ * @param payload Buffer receiving the payload.
+ * @param size Size of the buffer.
+ *
+ * The attached levels are [offset from the trigger in ms, level] pairs: the levels up
+ * to the trigger for a start alert, the levels after it for an end alert.
+ */
+
+static void format_alert_payload(const alert_record_t *alert, char *payload, size_t size) {
+
+    const event_t *event = &alert->event;
+    char timestamp[32];
+    size_t len = 0;
+
+    format_timestamp(&alert->time, timestamp);
+
+    payload_append(payload, size, &len, "{\"id\":\"%d\", \"event\":\"%s\", \"threshold\":\"",
+                   alert->config->sensor_id, alert->kind == EVENT_START ? "start" : "end");
+    payload_append_fixed(payload, size, &len, event->threshold_cdB, 2);
+    payload_append(payload, size, &len, "\", \"peak\":\"");
+    payload_append_fixed(payload, size, &len, event->peak_cdB, 2);
+    payload_append(payload, size, &len, "\", \"onset_ms\":%ld", (long)((int64_t)(event->onset_us - event->trigger_us) / 1000));
+
+    if (alert->kind == EVENT_END) {
+        payload_append(payload, size, &len, ", \"duration_ms\":%lu", (unsigned long)((event->end_us - event->onset_us) / 1000));
+    }
+
+    payload_append(payload, size, &len, ", \"samples\":[");
+    for (uint8_t i = 0; i < event->sample_count; i++) {
+        const measurement_t *sample = &event->samples[i];
+        payload_append(payload, size, &len, "%s[%ld,", i ? "," : "", (long)((int64_t)(sample->timestamp_us - event->trigger_us) / 1000));
+        payload_append_fixed(payload, size, &len, sample->level_cdB, 2);
+        payload_append(payload, size, &len, "]");
+    }
+
+    payload_append(payload, size, &len, "], \"latitude\":");
+    payload_append_fixed(payload, size, &len, alert->config->latitude_e6, 6);
+    payload_append(payload, size, &len, ", \"longitude\":");
+    payload_append_fixed(payload, size, &len, alert->config->longitude_e6, 6);
+    payload_append(payload, size, &len, ", \"timestamp\":\"%s\"}", timestamp);
+}
+
+/**
+ * @brief Queues a threshold exceedance alert for the MQTT broker.
+ *
+ * @param config Static configuration of the sensor.
+ * @param kind Start or end of the event.
+ * @param event Event with its attached levels.
+ *
+ * If the queue is full the alert is dropped and counted.
+ */
+
+void publish_alert_to_mqtt(const sensor_config_t *config, event_kind_t kind, const event_t *event) {
+
+    alert_queue.raised++;
+
+    if (alert_queue.count >= EVENT_ALERT_QUEUE_SIZE) {
+        alert_queue.dropped++;
+        return;
+    }
+
+    alert_record_t *alert = &alert_queue.records[(alert_queue.head + alert_queue.count) % EVENT_ALERT_QUEUE_SIZE];
+    alert->detected_us = time_us_64();
+    rtc_get_datetime(&alert->time);
+    alert->config = config;
+    alert->kind = kind;
+    alert->event = *event;
+    alert_queue.count++;
+}
+
+/**
+ * @brief Publishes the queued alerts to the MQTT alert topic.
+ *
+ * Alerts stay queued while the broker is unreachable or the lwIP send buffer is full;
+ * other publish errors drop the alert (counted). The detection-to-publish latency is
+ * measured when the MQTT client accepts the alert.
+ */
+
+void mqtt_alert_service(void) {
+
+    char payload[MQTT_PAYLOAD_SIZE];
 
-    rtc_get_datetime(&now);
+    while (alert_queue.count > 0) {
 
-    snprintf(timestamp, sizeof(timestamp), "%04d-%02d-%02d %02d:%02d:%02d",
-             now.year, now.month, now.day, now.hour-=GMT_M_3, now.min, now.sec);
+        if (!(global_mqtt_client && mqtt_client_is_connected(global_mqtt_client) && is_wifi_connected())) {
+            return;
+        }
+
+        const alert_record_t *alert = &alert_queue.records[alert_queue.head];
+        format_alert_payload(alert, payload, sizeof(payload));
 
-    // >>> CRIA O PAYLOAD ANTES DE VERIFICAR A CONEXÃO <<<
-    snprintf(payload, sizeof(payload),
-             "{\"id\":\"%d\", \"avgdB\":\"%.2f\", \"mindB\": \"%.2f\", \"maxdB\": \"%.2f\", \"latitude\":%.6f, \"longitude\":%.6f, \"timestamp\":\"%s\"}",
-             micdata->sensor_id, micdata->average, micdata->mindB, micdata->maxdB, micdata->latitude, micdata->longitude, timestamp);
+        cyw43_arch_lwip_begin();
+        err_t err = mqtt_publish(global_mqtt_client, MQTT_ALERT_TOPIC, payload, strlen(payload), 1, 0, NULL, NULL);
+        cyw43_arch_lwip_end();
 
-    // Verifica se está conectado
-    if (global_mqtt_client && mqtt_client_is_connected(global_mqtt_client) && is_wifi_connected()) {
-        err_t err = mqtt_publish(global_mqtt_client, MQTT_TOPIC, payload, strlen(payload), 1, 0, NULL, NULL); // QoS 1 para maior garantia
+        if (err == ERR_MEM) {
+            return;                                         // Send buffer full: retry on the next pass
+        }
 
         if (err == ERR_OK) {
-            printf("Dados enviados via MQTT: %s\n", payload);
+            uint32_t latency = (uint32_t)(time_us_64() - alert->detected_us);
+            if (alert_queue.sent == 0 || latency < alert_queue.latency_min_us) {
+                alert_queue.latency_min_us = latency;
+            }
+            if (latency > alert_queue.latency_max_us) {
+                alert_queue.latency_max_us = latency;
+            }
+            alert_queue.latency_sum_us += latency;
+            alert_queue.sent++;
+            printf("Alerta enviado via MQTT: %s\n", payload);
         } else {
+            alert_queue.dropped++;
+            printf("Erro ao publicar alerta via MQTT: %d\n", err);
+        }
+
+        alert_queue.head = (alert_queue.head + 1) % EVENT_ALERT_QUEUE_SIZE;
+        alert_queue.count--;
+    }
+}
+
+/**
+ * @brief Queues the statistics of a closed window for the MQTT publisher.
+ *
+ * @param micdata Pointer to a micdata_t structure containing the window statistics and the sensor configuration.
+ *
+ * Only copies the values into the publish queue: the JSON formatting, the MQTT publish
+ * and the flash writes happen later in mqtt_publisher_service(), outside the aggregation.
+ * If the queue is full the record is dropped and counted.
+ */
+
+void publish_db_to_mqtt(micdata_t *micdata) {
+
+    publish_record_t *record = publish_queue_reserve(&publish_queue);
+    if (!record) {
+        return;
+    }
+
+    rtc_get_datetime(&record->time);
+    record->config = micdata->config;
+    record->window_s = micdata->window_s;
+    record->mean_cdB = (int16_t)micdata->summary.mean_cdB;
+    record->min_cdB = (int16_t)micdata->summary.min_cdB;
+    record->max_cdB = (int16_t)micdata->summary.max_cdB;
+    record->leq_cdB = (int16_t)micdata->summary.leq_cdB;
+    record->l10_cdB = (int16_t)micdata->summary.l10_cdB;
+    record->l50_cdB = (int16_t)micdata->summary.l50_cdB;
+    record->l90_cdB = (int16_t)micdata->summary.l90_cdB;
+    record->l95_cdB = (int16_t)micdata->summary.l95_cdB;
+    record->lden_cdB = (int16_t)micdata->lden_cdB;
+    record->twa_cdB = (int16_t)micdata->twa_cdB;
+    record->dose_percent_c = micdata->dose_percent_c;
+    record->band_count = micdata->config->spectrum ? micdata->band_count : 0;
+    record->first_band = micdata->first_band;
+    for (uint8_t b = 0; b < record->band_count; b++) {
+        record->band_cdB[b] = micdata->band_cdB[b];
+    }
+
+    publish_queue_commit(&publish_queue, time_us_64());
+}
+
+/**
+ * @brief Completion callback of the record messages (lwIP context).
+ *
+ * @param arg Sequence of the message in the tracker.
+ * @param result ERR_OK on PUBACK, ERR_TIMEOUT if the broker did not answer.
+ */
+
+static void publish_complete_cb(void *arg, err_t result) {
+    publish_tracker_complete(&publish_tracker, (uint32_t)(uintptr_t)arg, result == ERR_OK);
+}
+
+/**
+ * @brief Fails the messages of the previous connections (their PUBACKs will not come).
+ *
+ * Called before a record message is sent, under the lwIP lock, so that a message of the
+ * new connection is never failed with the old ones.
+ */
+
+static void publish_tracker_sync_connection(void) {
+
+    static uint32_t epoch;
+
+    if (epoch != connection_epoch) {
+        epoch = connection_epoch;
+        publish_tracker_abandon(&publish_tracker);
+        backlog_stats.window = 1;                           // New connection: probe again
+    }
+}
+
+/**
+ * @brief Publishes a batch of records to the MQTT record topic (QoS 1).
+ *
+ * @param batch Batch of formatted records (not empty).
+ * @param files Numbers of the flash files of the records, or NULL for the publish queue records.
+ * @return Result of mqtt_publish(), or ERR_MEM if the in-flight window is full. On success
+ *         the message is tracked until its PUBACK and the batch statistics are updated.
+ */
+
+err_t mqtt_publish_batch(publish_batch_t *batch, const int *files) {
+
+    size_t length;
+    const char *payload = publish_batch_finish(batch, &length);
+
+    cyw43_arch_lwip_begin();                                // No completion before the slot is committed
+    publish_tracker_sync_connection();
+
+    publish_slot_t *slot = publish_tracker_reserve(&publish_tracker, time_us_64());
+    if (!slot) {
+        cyw43_arch_lwip_end();
+        return ERR_MEM;                                     // Window full: retry after the next PUBACK
+    }
+
+    slot->source = files ? PUBLISH_SOURCE_FLASH : PUBLISH_SOURCE_QUEUE;
+    slot->records = batch->records;
+    for (uint8_t f = 0; files && f < batch->records; f++) {
+        slot->files[f] = files[f];
+    }
+
+    err_t err = mqtt_publish(global_mqtt_client, MQTT_PAYLOAD_CBOR ? MQTT_CBOR_TOPIC : MQTT_TOPIC,
+                             payload, length, 1, 0, publish_complete_cb, (void *)(uintptr_t)slot->sequence); // QoS 1 para maior garantia
+
+    if (err == ERR_OK) {
+        publish_tracker_commit(&publish_tracker);
+        publish_batch_stats.messages++;
+        publish_batch_stats.records += batch->records;
+        publish_batch_stats.bytes += length;
+        if (batch->records > publish_batch_stats.max_records) {
+            publish_batch_stats.max_records = batch->records;
+        }
+    }
+
+    cyw43_arch_lwip_end();
+    return err;
+}
+
+/**
+ * @brief Releases the stored records of the acknowledged messages.
+ *
+ * @param connected The broker is reachable.
+ *
+ * Acknowledged queue records are popped and acknowledged flash files deleted. When a
+ * message fails (timeout, or the connection was lost: lwIP drops the pending PUBACKs
+ * without a callback) the queue records in flight are sent again; failed flash files
+ * stay and are resent by the next pass over the saved data.
+ */
+
+static void publish_tracker_service(bool connected) {
+
+    if (!connected) {
+        publish_tracker_abandon(&publish_tracker);
+        backlog_stats.window = 1;
+    }
+    publish_tracker_sync_connection();
+
+    uint64_t now_us = time_us_64();
+    publish_slot_t *slot;
+
+    while ((slot = publish_tracker_front(&publish_tracker)) && slot->state != PUBLISH_SLOT_PENDING) {
+
+        if (slot->state == PUBLISH_SLOT_ACKED && slot->source == PUBLISH_SOURCE_FLASH) {
+            flash_delete_payloads(slot->files, slot->records);
+            backlog_stats.files_acked += slot->records;
+            if (backlog_stats.window < MQTT_INFLIGHT_WINDOW - 1) {
+                backlog_stats.window++;                     // PUBACKs keep coming: one more message in flight
+            }
+        } else if (slot->state == PUBLISH_SLOT_ACKED) {
+            for (uint8_t n = 0; n < slot->records; n++) {
+                if (backlog_pending) {                      // Latency of the live data during the drain
+                    uint32_t latency = (uint32_t)(now_us - publish_queue_front(&publish_queue)->queued_us);
+                    backlog_stats.live_records++;
+                    backlog_stats.live_latency_sum_us += latency;
+                    if (latency > backlog_stats.live_latency_max_us) {
+                        backlog_stats.live_latency_max_us = latency;
+                    }
+                }
+                publish_queue_pop(&publish_queue, PUBLISH_SENT, now_us);
+            }
+            publish_queue.in_flight -= slot->records;
+        } else if (slot->source == PUBLISH_SOURCE_FLASH) {
+            backlog_pending = true;                         // The files stay: send them again
+            backlog_stats.window = (backlog_stats.window > 1) ? backlog_stats.window / 2 : 1;
+        } else if (slot->records > 0) {
+            printf("Mensagem MQTT sem PUBACK: reenviando %u registros.\n", publish_queue.in_flight);
+            publish_tracker_forget_queue(&publish_tracker);
+            publish_queue.in_flight = 0;
+        }
+
+        publish_tracker_release(&publish_tracker, now_us);
+    }
+}
+
+/**
+ * @brief Sends the queued records that are not in flight yet.
+ *
+ * @param connected The broker is reachable.
+ *
+ * Packs the oldest unsent records into one message, up to MQTT_BATCH_MAX_RECORDS records
+ * or MQTT_BATCH_MAX_BYTES bytes. A smaller batch is only sent once its oldest record has
+ * waited MQTT_BATCH_LINGER_MS. Handles at most PUBLISH_QUEUE_BURST messages per call.
+ * While the broker is unreachable the records are spilled to flash (resent after the next
+ * connection). When the lwIP send buffer or the in-flight window is full (ERR_MEM) the
+ * records stay queued and are retried on the next call, except the oldest ones beyond
+ * PUBLISH_QUEUE_SPILL_DEPTH, which are spilled to flash once nothing is in flight.
+ */
+
+static void publish_queue_service(bool connected) {
+
+    static char batch_payload[MQTT_BATCH_MAX_BYTES];    // Static: too large for the stack of core 0
+    char payload[MQTT_PAYLOAD_SIZE];
+
+    for (uint8_t i = 0; i < PUBLISH_QUEUE_BURST; i++) {
+
+        const publish_record_t *record = publish_queue_at(&publish_queue, publish_queue.in_flight);
+        if (!record) {
+            return;
+        }
+
+        if (connected) {
+
+            uint8_t unsent = publish_queue.count - publish_queue.in_flight;
+            if (unsent < MQTT_BATCH_MAX_RECORDS &&
+                time_us_64() - record->queued_us < MQTT_BATCH_LINGER_MS * 1000ull) {
+                return;                                     // Let more records join the message
+            }
+
+            publish_batch_t batch;
+            publish_batch_begin(&batch, batch_payload, sizeof(batch_payload));
+            for (uint8_t n = 0; n < unsent; n++) {
+                size_t length = format_record(publish_queue_at(&publish_queue, publish_queue.in_flight + n), payload, sizeof(payload));
+                if (!publish_batch_add(&batch, payload, length)) {
+                    break;
+                }
+            }
+
+            err_t err = mqtt_publish_batch(&batch, NULL);
+
+            if (err == ERR_OK) {
+                printf("Lote de %u registros enviado via MQTT\n", batch.records);
+                publish_queue.in_flight += batch.records;   // Popped on PUBACK
+                continue;
+            }
+
+            if (err == ERR_MEM && (publish_queue.count <= PUBLISH_QUEUE_SPILL_DEPTH || publish_queue.in_flight > 0)) {
+                return;                                     // Send buffer or window full: keep the records queued and retry later
+            }
+
             printf("Erro ao publicar via MQTT: %d. Salvando em flash.\n", err);
-            save_payload_to_flash(payload); // Salva se a publicação falhar
         }
+
+        if (publish_queue.in_flight > 0) {
+            return;                                         // Only the oldest record can be spilled
+        }
+
+        size_t length = format_record(record, payload, sizeof(payload));
+        bool spilled = save_payload_to_flash(payload, length);
+        backlog_pending |= spilled;
+        publish_queue_pop(&publish_queue, spilled ? PUBLISH_SPILLED : PUBLISH_DROPPED, time_us_64());
+    }
+}
+
+/**
+ * @brief Publisher stage (core 0): PUBACK tracking, then the queued records.
+ */
+
+void mqtt_publisher_service(void) {
+
+    bool connected = global_mqtt_client && mqtt_client_is_connected(global_mqtt_client) && is_wifi_connected();
+
+    publish_tracker_service(connected);
+    publish_queue_service(connected);
+}
+
+/**
+ * @brief Sends the next part of the data saved to flash (backlog drain).
+ *
+ * At most one message per call, and only when no live record is waiting: live data goes
+ * first. The rate follows the broker: the number of backlog messages in flight grows by
+ * one per PUBACK and halves on a failure or when the MQTT client refuses a message; one
+ * slot of the in-flight window stays free for the live records. A message is only built
+ * when the TCP send buffer can take it.
+ */
+
+void mqtt_backlog_service(void) {
+
+    static uint64_t last_us;
+    uint64_t now_us = time_us_64();
+    bool connected = global_mqtt_client && mqtt_client_is_connected(global_mqtt_client) && is_wifi_connected();
+
+    if (backlog_pending && connected && last_us) {
+        backlog_stats.active_us += now_us - last_us;
+    }
+    last_us = now_us;
+
+    if (!connected || !backlog_pending) {
+        return;
+    }
+
+    if (publish_queue.count > publish_queue.in_flight ||
+        publish_tracker.count >= MQTT_INFLIGHT_WINDOW - 1 ||
+        publish_tracker_in_flight(&publish_tracker, PUBLISH_SOURCE_FLASH) >= backlog_stats.window) {
+        return;                                             // Live records first, then wait for PUBACKs
+    }
+
+    cyw43_arch_lwip_begin();
+    uint16_t send_buffer = global_mqtt_client->conn ? altcp_sndbuf(global_mqtt_client->conn) : 0;
+    cyw43_arch_lwip_end();
+
+    if (send_buffer < MQTT_BATCH_MAX_BYTES) {
+        return;                                             // Earlier messages still fill the TCP send buffer
+    }
+
+    int sent = flash_drain_step();
+
+    if (sent > 0) {
+        backlog_stats.files_sent += sent;
+    } else if (sent == 0) {
+        backlog_pending = false;                            // Nothing left to send
+        printf("Dados salvos reenviados.\n");
     } else {
-        // >>> SE ESTIVER OFFLINE, CHAMA A FUNÇÃO PARA SALVAR <<<
-        save_payload_to_flash(payload);
+        backlog_stats.refused++;
+        backlog_stats.window = (backlog_stats.window > 1) ? backlog_stats.window / 2 : 1;
     }
 }
 
@@ -0,0 +1,101 @@
+#include "inc/noise_dose.h"
+#include "inc/fixmath.h"
+
+#define DOSE_WEIGHT_BITS 12         // Fractional bits of the exposure weights
+#define DOSE_MAX_EXPONENT 40        // Weight bound: 2^40 * max gap (ms) cannot overflow one addition
+#define DAY_US (24ULL * 3600 * 1000000)
+
+/**
+ * @brief Adds one level to the dose, in constant time.
+ *
+ * @param dose Dose to update.
+ * @param params Dose criterion.
+ * @param timestamp_us Acquisition time of the level (us since boot).
+ * @param local_us Local time of the level (us since 1970-01-01 local).
+ * @param level_cdB Sound level in hundredths of dB.
+ *
+ * The level is held from the previous level of the sensor to this one, at most
+ * max_gap_us. The dose restarts when the local day (counted from the reset hour) moves
+ * forward; a day that goes back (clock not synchronized yet after a reboot) keeps the
+ * restored dose.
+ */
+
+void noise_dose_add(noise_dose_t *dose, const noise_dose_params_t *params, uint64_t timestamp_us, uint64_t local_us, int32_t level_cdB){
+    uint64_t reset_us = (uint64_t)params->reset_hour * 3600 * 1000000;
+    uint32_t day = (local_us >= reset_us) ? (uint32_t)((local_us - reset_us) / DAY_US) : 0;
+
+    if (day > dose->day) {
+        dose->weighted_ms_q12 = 0;
+        dose->exposure_s = 0;
+        dose->exposure_ms = 0;
+        dose->day = day;
+    }
+
+    uint64_t last_us = dose->last_us;
+    dose->last_us = timestamp_us;
+    if (last_us == 0 || timestamp_us <= last_us) {
+        return;                                             // First level: no duration yet
+    }
+
+    uint64_t dt_us = timestamp_us - last_us;
+    if (dt_us > params->max_gap_us) {
+        dt_us = params->max_gap_us;
+    }
+    uint32_t dt_ms = (uint32_t)((dt_us + 500) / 1000);
+
+    dose->exposure_ms += dt_ms;
+    dose->exposure_s += dose->exposure_ms / 1000;
+    dose->exposure_ms %= 1000;
+
+    if (level_cdB < params->threshold_cdB) {
+        return;
+    }
+
+    // 2^((L - criterion) / exchange) in Q12 (0 far below the criterion, bounded far above it)
+    int32_t exponent_q16 = (int32_t)((int64_t)(level_cdB - params->criterion_cdB) * FIX_Q16_ONE / params->exchange_cdB)
+                           + (DOSE_WEIGHT_BITS << 16);
+    if (exponent_q16 > (DOSE_MAX_EXPONENT << 16)) {
+        exponent_q16 = DOSE_MAX_EXPONENT << 16;
+    }
+    uint64_t weight = fix_exp2_q16(exponent_q16);
+    uint64_t add = weight * dt_ms;
+
+    dose->weighted_ms_q12 = (dose->weighted_ms_q12 + add < add) ? UINT64_MAX : dose->weighted_ms_q12 + add;
+}
+
+/**
+ * @brief Returns the dose since the last restart.
+ *
+ * @param dose Dose.
+ * @param params Dose criterion.
+ * @return Dose in hundredths of percent (10000 = 100%, saturates at UINT32_MAX).
+ */
+
+uint32_t noise_dose_percent_c(const noise_dose_t *dose, const noise_dose_params_t *params){
+    // 10000 * weighted / (criterion_s * 1000 * 2^12) = weighted / (criterion_s / 10 * 2^12)
+    uint64_t divisor = ((uint64_t)params->criterion_s / 10) << DOSE_WEIGHT_BITS;
+    uint64_t percent = dose->weighted_ms_q12 / divisor;
+
+    return (percent > UINT32_MAX) ? UINT32_MAX : (uint32_t)percent;
+}
+
+/**
+ * @brief Returns the time-weighted average level of the dose.
+ *
+ * @param dose Dose.
+ * @param params Dose criterion.
+ * @return TWA over the criterion time in hundredths of dB (0 if the dose is 0).
+ *
+ * TWA = criterion + exchange * log2(dose / 100%).
+ */
+
+int32_t noise_dose_twa_cdB(const noise_dose_t *dose, const noise_dose_params_t *params){
+    if (dose->weighted_ms_q12 == 0) {
+        return 0;
+    }
+
+    uint64_t full_dose = ((uint64_t)params->criterion_s * 1000) << DOSE_WEIGHT_BITS;
+    int64_t log2_ratio_q16 = (int64_t)fix_log2_q16(dose->weighted_ms_q12) - fix_log2_q16(full_dose);
+
+    return params->criterion_cdB + (int32_t)((params->exchange_cdB * log2_ratio_q16) / FIX_Q16_ONE);
+}
@@ -0,0 +1,225 @@
+#include <string.h>           // memset for the statistics window
+#include "inc/noise_stats.h"
+#include "inc/fixmath.h"
+
+#define NOISE_STATS_ENERGY_LIMIT ((uint64_t)1 << 62)   // Normalize the energy sum above this value
+
+/**
+ * @brief Clamps a level to the range handled by the statistics.
+ */
+
+static int32_t noise_level_clamp(int32_t level_cdB){
+    if (level_cdB < 0) {
+        return 0;
+    }
+    if (level_cdB > NOISE_STATS_MAX_LEVEL_CDB) {
+        return NOISE_STATS_MAX_LEVEL_CDB;
+    }
+    return level_cdB;
+}
+
+/**
+ * @brief Halves the energy sum until it is below NOISE_STATS_ENERGY_LIMIT.
+ */
+
+static void noise_energy_normalize(noise_energy_t *energy){
+    while (energy->sum >= NOISE_STATS_ENERGY_LIMIT) {
+        energy->sum >>= 1;
+        energy->shift++;
+    }
+}
+
+/**
+ * @brief Adds the linear energy of one level to an energy sum.
+ *
+ * @param energy Energy sum to update.
+ * @param level_cdB Sound level in hundredths of dB (clamped to 0..150 dB).
+ *
+ * The level is converted to a linear energy, 10^(L/10) * 2^NOISE_STATS_ENERGY_FRAC_BITS,
+ * with the fixed-point exp2 (below 2^58 for levels up to 150 dB). The sum keeps a shared
+ * exponent: when it gets close to 2^64 it is halved and the exponent incremented, so it
+ * never overflows and keeps at least 60 significant bits.
+ */
+
+void noise_energy_add(noise_energy_t *energy, int32_t level_cdB){
+    uint64_t value = fix_exp2_q16(fix_cdB_to_log2_q16(noise_level_clamp(level_cdB)) + NOISE_STATS_ENERGY_FRAC_BITS * FIX_Q16_ONE);
+
+    energy->sum += value >> energy->shift;
+    energy->count++;
+    noise_energy_normalize(energy);
+}
+
+/**
+ * @brief Adds an energy sum to another one.
+ *
+ * @param dst Energy sum to update.
+ * @param src Energy sum to add.
+ *
+ * Both sums are brought to the larger exponent before the addition.
+ */
+
+void noise_energy_merge(noise_energy_t *dst, const noise_energy_t *src){
+    uint64_t addend = src->sum;
+
+    if (src->shift > dst->shift) {
+        uint8_t diff = src->shift - dst->shift;
+        dst->sum = (diff < 64) ? (dst->sum >> diff) : 0;
+        dst->shift = src->shift;
+    } else {
+        uint8_t diff = dst->shift - src->shift;
+        addend = (diff < 64) ? (addend >> diff) : 0;
+    }
+
+    dst->sum += addend;                             // Both are below 2^62: no overflow
+    dst->count += src->count;
+    noise_energy_normalize(dst);
+}
+
+/**
+ * @brief Computes the equivalent continuous level of an energy sum.
+ *
+ * @param energy Energy sum to read.
+ *
+ * Leq = 10 * log10(sum of energies / count), computed on log2 values.
+ *
+ * @return Leq in hundredths of dB (0 for an empty sum).
+ */
+
+int32_t noise_energy_leq_cdB(const noise_energy_t *energy){
+    if (energy->count == 0 || energy->sum == 0) {
+        return 0;
+    }
+
+    int32_t log2_mean = fix_log2_q16(energy->sum)
+                      + (energy->shift - NOISE_STATS_ENERGY_FRAC_BITS) * FIX_Q16_ONE
+                      - fix_log2_q16(energy->count);
+
+    return fix_log2_q16_to_cdB(log2_mean);
+}
+
+/**
+ * @brief Empties a statistics window.
+ *
+ * @param stats Window to reset.
+ */
+
+void noise_stats_reset(noise_stats_t *stats){
+    memset(stats, 0, sizeof(*stats));
+}
+
+/**
+ * @brief Adds one level to a statistics window.
+ *
+ * @param stats Window to update.
+ * @param level_cdB Sound level in hundredths of dB.
+ */
+
+void noise_stats_add(noise_stats_t *stats, int32_t level_cdB){
+    level_cdB = noise_level_clamp(level_cdB);
+
+    if (stats->energy.count == 0 || level_cdB < stats->min_cdB) {
+        stats->min_cdB = level_cdB;
+    }
+    if (stats->energy.count == 0 || level_cdB > stats->max_cdB) {
+        stats->max_cdB = level_cdB;
+    }
+    stats->sum_cdB += level_cdB;
+    noise_energy_add(&stats->energy, level_cdB);
+
+    int32_t bin = (level_cdB - NOISE_STATS_MIN_CDB) / NOISE_STATS_BIN_CDB;
+    if (bin < 0) {
+        bin = 0;                                    // Below the histogram: counted in the first bin
+    } else if (bin >= NOISE_STATS_BINS) {
+        bin = NOISE_STATS_BINS - 1;                 // Above the histogram: counted in the last bin
+    }
+    stats->histogram[bin]++;
+}
+
+/**
+ * @brief Adds a statistics window to another one (O(NOISE_STATS_BINS)).
+ *
+ * @param dst Window to update.
+ * @param src Window to add.
+ *
+ * The result is the window that would have been obtained by adding the levels of
+ * both windows to one (up to the rounding of the energy sum).
+ */
+
+void noise_stats_merge(noise_stats_t *dst, const noise_stats_t *src){
+    if (src->energy.count == 0) {
+        return;
+    }
+
+    if (dst->energy.count == 0 || src->min_cdB < dst->min_cdB) {
+        dst->min_cdB = src->min_cdB;
+    }
+    if (dst->energy.count == 0 || src->max_cdB > dst->max_cdB) {
+        dst->max_cdB = src->max_cdB;
+    }
+    dst->sum_cdB += src->sum_cdB;
+    noise_energy_merge(&dst->energy, &src->energy);
+
+    for (uint32_t bin = 0; bin < NOISE_STATS_BINS; bin++) {
+        dst->histogram[bin] += src->histogram[bin];
+    }
+}
+
+/**
+ * @brief Computes the equivalent continuous level of a window.
+ *
+ * @param stats Window to read.
+ * @return Leq in hundredths of dB (0 for an empty window).
+ */
+
+int32_t noise_stats_leq_cdB(const noise_stats_t *stats){
+    return noise_energy_leq_cdB(&stats->energy);
+}
+
+/**
+ * @brief Computes the summary of a window (Leq, mean, min, max, L10, L50, L90, L95).
+ *
+ * @param stats Window to read.
+ * @param summary Pointer where the summary is stored.
+ *
+ * The exceedance levels come out of a single walk of the histogram from the top bin
+ * down, O(NOISE_STATS_BINS) whatever the number of levels. Inside a bin the level is
+ * interpolated linearly and the result is kept within the observed min and max.
+ */
+
+void noise_stats_summarize(const noise_stats_t *stats, noise_stats_summary_t *summary){
+    static const uint8_t exceeded_percent[4] = { 10, 50, 90, 95 };
+    int32_t *levels[4] = { &summary->l10_cdB, &summary->l50_cdB, &summary->l90_cdB, &summary->l95_cdB };
+
+    memset(summary, 0, sizeof(*summary));
+    uint32_t count = stats->energy.count;
+    summary->count = count;
+
+    if (count == 0) {
+        return;
+    }
+
+    summary->mean_cdB = (int32_t)(stats->sum_cdB / count);
+    summary->leq_cdB = noise_stats_leq_cdB(stats);
+    summary->min_cdB = stats->min_cdB;
+    summary->max_cdB = stats->max_cdB;
+
+    uint8_t next = 0;
+    uint64_t above = 0;                                         // Levels in the bins above the current one
+
+    for (int32_t bin = NOISE_STATS_BINS - 1; bin >= 0 && next < 4; bin--) {
+        uint32_t in_bin = stats->histogram[bin];
+        int32_t upper = NOISE_STATS_MIN_CDB + (bin + 1) * NOISE_STATS_BIN_CDB;
+
+        // Ln is reached once n% of the levels are at or above it (compared times 100)
+        while (next < 4 && (above + in_bin) * 100 >= (uint64_t)exceeded_percent[next] * count) {
+            uint64_t needed = (uint64_t)exceeded_percent[next] * count - above * 100;   // Share of this bin, times 100
+            int32_t level = upper - (int32_t)((needed * NOISE_STATS_BIN_CDB) / ((uint64_t)in_bin * 100));
+
+            if (level > stats->max_cdB) level = stats->max_cdB;
+            if (level < stats->min_cdB) level = stats->min_cdB;
+            *levels[next++] = level;
+        }
+
+        above += in_bin;
+    }
+}
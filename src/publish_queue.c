@@ -0,0 +1,194 @@
+#include <string.h>
+#include "inc/publish_queue.h"
+#include "inc/cbor.h"
+
+/**
+ * @brief Initializes an empty queue.
+ *
+ * @param queue Queue to initialize.
+ */
+
+void publish_queue_init(publish_queue_t *queue){
+    queue->head = 0;
+    queue->count = 0;
+    queue->in_flight = 0;
+    queue->high_water = 0;
+    queue->queued = 0;
+    queue->sent = 0;
+    queue->spilled = 0;
+    queue->dropped = 0;
+    queue->latency_max_us = 0;
+    queue->latency_sum_us = 0;
+}
+
+/**
+ * @brief Reserves the slot of a new record at the end of the queue.
+ *
+ * @param queue Queue.
+ * @return Slot to fill and commit with publish_queue_commit(), or NULL if the queue is full (counted as dropped).
+ *
+ * The record is built in place, so no record-sized copy goes through the stack.
+ */
+
+publish_record_t *publish_queue_reserve(publish_queue_t *queue){
+    if (queue->count >= PUBLISH_QUEUE_SIZE) {
+        queue->dropped++;
+        return NULL;
+    }
+
+    return &queue->records[(queue->head + queue->count) % PUBLISH_QUEUE_SIZE];
+}
+
+/**
+ * @brief Makes the record filled after publish_queue_reserve() visible to the publisher.
+ *
+ * @param queue Queue.
+ * @param now_us Current time (start of the latency measurement).
+ */
+
+void publish_queue_commit(publish_queue_t *queue, uint64_t now_us){
+    queue->records[(queue->head + queue->count) % PUBLISH_QUEUE_SIZE].queued_us = now_us;
+    queue->count++;
+    queue->queued++;
+
+    if (queue->count > queue->high_water) {
+        queue->high_water = queue->count;
+    }
+}
+
+/**
+ * @brief Returns the oldest record.
+ *
+ * @param queue Queue.
+ * @return Oldest record, or NULL if the queue is empty.
+ */
+
+const publish_record_t *publish_queue_front(const publish_queue_t *queue){
+    return queue->count ? &queue->records[queue->head] : NULL;
+}
+
+/**
+ * @brief Returns a waiting record by age.
+ *
+ * @param queue Queue.
+ * @param index Position of the record (0 = oldest).
+ * @return Record, or NULL if fewer records are waiting.
+ */
+
+const publish_record_t *publish_queue_at(const publish_queue_t *queue, uint8_t index){
+    return (index < queue->count) ? &queue->records[(queue->head + index) % PUBLISH_QUEUE_SIZE] : NULL;
+}
+
+/**
+ * @brief Removes the oldest record and counts how it left the queue.
+ *
+ * @param queue Queue (not empty).
+ * @param outcome How the record left the queue.
+ * @param now_us Current time (end of the latency measurement of sent records).
+ */
+
+void publish_queue_pop(publish_queue_t *queue, publish_outcome_t outcome, uint64_t now_us){
+    const publish_record_t *record = &queue->records[queue->head];
+
+    switch (outcome) {
+    case PUBLISH_SENT: {
+        uint32_t latency = (uint32_t)(now_us - record->queued_us);
+        queue->sent++;
+        queue->latency_sum_us += latency;
+        if (latency > queue->latency_max_us) {
+            queue->latency_max_us = latency;
+        }
+        break;
+    }
+    case PUBLISH_SPILLED:
+        queue->spilled++;
+        break;
+    case PUBLISH_DROPPED:
+        queue->dropped++;
+        break;
+    }
+
+    queue->head = (queue->head + 1) % PUBLISH_QUEUE_SIZE;
+    queue->count--;
+}
+
+/**
+ * @brief Returns the mean queue-to-PUBACK latency.
+ *
+ * @param queue Queue.
+ * @return Mean latency in microseconds (0 if nothing was sent).
+ */
+
+uint32_t publish_queue_latency_mean_us(const publish_queue_t *queue){
+    return queue->sent ? (uint32_t)(queue->latency_sum_us / queue->sent) : 0;
+}
+
+/**
+ * @brief Starts an empty batch.
+ *
+ * @param batch Batch to start.
+ * @param buffer Buffer receiving the message.
+ * @param size Size of the buffer (byte budget of the message).
+ */
+
+void publish_batch_begin(publish_batch_t *batch, char *buffer, size_t size){
+    batch->payload = buffer;
+    batch->size = size;
+    batch->records = 0;
+#if MQTT_PAYLOAD_CBOR
+    batch->payload[0] = PUBLISH_SCHEMA_VERSION;
+    batch->payload[1] = (char)CBOR_INDEFINITE_ARRAY;
+    batch->length = 2;
+#else
+    batch->payload[0] = '[';
+    batch->length = 1;
+#endif
+}
+
+/**
+ * @brief Adds a formatted record to a batch.
+ *
+ * @param batch Batch.
+ * @param record Formatted record (JSON object or CBOR map).
+ * @param length Length of the record.
+ * @return false if the batch is full (MQTT_BATCH_MAX_RECORDS records or byte budget reached); the record is not added.
+ */
+
+bool publish_batch_add(publish_batch_t *batch, const char *record, size_t length){
+    size_t separator = (batch->records && !MQTT_PAYLOAD_CBOR) ? 1 : 0;   // CBOR items follow each other
+
+    if (batch->records >= MQTT_BATCH_MAX_RECORDS || batch->length + separator + length + 1 > batch->size) {
+        return false;                               // One byte stays free for the end of the array
+    }
+
+    if (separator) {
+        batch->payload[batch->length++] = ',';
+    }
+    memcpy(batch->payload + batch->length, record, length);
+    batch->length += length;
+    batch->records++;
+    return true;
+}
+
+/**
+ * @brief Closes a batch and returns the message to send.
+ *
+ * @param batch Batch (not empty).
+ * @param length Receives the length of the message.
+ * @return Message (not NUL-terminated).
+ */
+
+const char *publish_batch_finish(publish_batch_t *batch, size_t *length){
+#if MQTT_PAYLOAD_CBOR
+    batch->payload[batch->length] = (char)CBOR_BREAK;
+#else
+    if (batch->records == 1) {
+        *length = batch->length - 1;                // A single record goes without the array
+        return batch->payload + 1;
+    }
+
+    batch->payload[batch->length] = ']';
+#endif
+    *length = batch->length + 1;
+    return batch->payload;
+}
@@ -0,0 +1,207 @@
+#include <stddef.h>
+#include "inc/publish_tracker.h"
+
+/**
+ * @brief Initializes an empty tracker.
+ *
+ * @param tracker Tracker to initialize.
+ */
+
+void publish_tracker_init(publish_tracker_t *tracker){
+    tracker->head = 0;
+    tracker->count = 0;
+    tracker->max_depth = 0;
+    tracker->next_sequence = 0;
+    tracker->acked = 0;
+    tracker->failed = 0;
+    tracker->retries = 0;
+    tracker->ack_latency_max_us = 0;
+    tracker->ack_latency_sum_us = 0;
+
+    for (uint8_t i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+        tracker->slots[i].state = PUBLISH_SLOT_FREE;
+    }
+}
+
+/**
+ * @brief Prepares the slot of a new message.
+ *
+ * @param tracker Tracker.
+ * @param now_us Current time (start of the ack latency measurement).
+ * @return Slot to fill (source, records, files) and commit with publish_tracker_commit()
+ *         once the message is accepted by the MQTT client, or NULL if the window is full.
+ */
+
+publish_slot_t *publish_tracker_reserve(publish_tracker_t *tracker, uint64_t now_us){
+    if (tracker->count >= MQTT_INFLIGHT_WINDOW) {
+        return NULL;
+    }
+
+    publish_slot_t *slot = &tracker->slots[(tracker->head + tracker->count) % MQTT_INFLIGHT_WINDOW];
+    slot->sequence = tracker->next_sequence;
+    slot->state = PUBLISH_SLOT_PENDING;
+    slot->records = 0;
+    slot->sent_us = now_us;
+    return slot;
+}
+
+/**
+ * @brief Counts the slot prepared by publish_tracker_reserve() as in flight.
+ *
+ * @param tracker Tracker.
+ */
+
+void publish_tracker_commit(publish_tracker_t *tracker){
+    tracker->next_sequence++;
+    tracker->count++;
+
+    if (tracker->count > tracker->max_depth) {
+        tracker->max_depth = tracker->count;
+    }
+}
+
+/**
+ * @brief Records the completion of a message (completion callback, any context).
+ *
+ * @param tracker Tracker.
+ * @param sequence Identifier of the message.
+ * @param acked true on PUBACK, false on failure.
+ *
+ * Completions of messages no longer tracked (already failed) are ignored.
+ */
+
+void publish_tracker_complete(publish_tracker_t *tracker, uint32_t sequence, bool acked){
+    for (uint8_t i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+        publish_slot_t *slot = &tracker->slots[i];
+        if (slot->sequence == sequence && slot->state == PUBLISH_SLOT_PENDING) {
+            slot->state = acked ? PUBLISH_SLOT_ACKED : PUBLISH_SLOT_FAILED;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Returns the oldest message in flight.
+ *
+ * @param tracker Tracker.
+ * @return Oldest slot, or NULL if nothing is in flight.
+ */
+
+publish_slot_t *publish_tracker_front(publish_tracker_t *tracker){
+    return tracker->count ? &tracker->slots[tracker->head] : NULL;
+}
+
+/**
+ * @brief Removes the oldest message once it is acknowledged or failed.
+ *
+ * @param tracker Tracker (oldest slot not pending).
+ * @param now_us Current time (end of the ack latency measurement).
+ */
+
+void publish_tracker_release(publish_tracker_t *tracker, uint64_t now_us){
+    publish_slot_t *slot = &tracker->slots[tracker->head];
+
+    if (slot->state == PUBLISH_SLOT_ACKED) {
+        uint32_t latency = (uint32_t)(now_us - slot->sent_us);
+        tracker->acked++;
+        tracker->ack_latency_sum_us += latency;
+        if (latency > tracker->ack_latency_max_us) {
+            tracker->ack_latency_max_us = latency;
+        }
+    } else {
+        tracker->failed++;
+    }
+
+    slot->state = PUBLISH_SLOT_FREE;            // A late completion finds no pending slot
+    tracker->head = (tracker->head + 1) % MQTT_INFLIGHT_WINDOW;
+    tracker->count--;
+}
+
+/**
+ * @brief Fails every message in flight (connection lost: no PUBACK will come).
+ *
+ * @param tracker Tracker.
+ */
+
+void publish_tracker_abandon(publish_tracker_t *tracker){
+    for (uint8_t i = 0; i < tracker->count; i++) {
+        publish_slot_t *slot = &tracker->slots[(tracker->head + i) % MQTT_INFLIGHT_WINDOW];
+        if (slot->state == PUBLISH_SLOT_PENDING) {
+            slot->state = PUBLISH_SLOT_FAILED;
+        }
+    }
+}
+
+/**
+ * @brief Detaches the publish queue records from every message in flight.
+ *
+ * @param tracker Tracker.
+ *
+ * Used when the queue records are sent again: a late PUBACK of these messages must not
+ * release them a second time.
+ */
+
+void publish_tracker_forget_queue(publish_tracker_t *tracker){
+    for (uint8_t i = 0; i < tracker->count; i++) {
+        publish_slot_t *slot = &tracker->slots[(tracker->head + i) % MQTT_INFLIGHT_WINDOW];
+        if (slot->source == PUBLISH_SOURCE_QUEUE) {
+            tracker->retries += slot->records;
+            slot->records = 0;
+        }
+    }
+}
+
+/**
+ * @brief Checks whether a flash file is carried by a message in flight.
+ *
+ * @param tracker Tracker.
+ * @param file Number of the file.
+ * @return true if the file is in flight (it must not be sent again).
+ */
+
+bool publish_tracker_has_file(const publish_tracker_t *tracker, int file){
+    for (uint8_t i = 0; i < tracker->count; i++) {
+        const publish_slot_t *slot = &tracker->slots[(tracker->head + i) % MQTT_INFLIGHT_WINDOW];
+        if (slot->source != PUBLISH_SOURCE_FLASH) {
+            continue;
+        }
+        for (uint8_t f = 0; f < slot->records; f++) {
+            if (slot->files[f] == file) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Counts the messages in flight carrying records of one storage.
+ *
+ * @param tracker Tracker.
+ * @param source Storage of the records (publish_source_t).
+ * @return Number of messages.
+ */
+
+uint8_t publish_tracker_in_flight(const publish_tracker_t *tracker, publish_source_t source){
+    uint8_t count = 0;
+
+    for (uint8_t i = 0; i < tracker->count; i++) {
+        if (tracker->slots[(tracker->head + i) % MQTT_INFLIGHT_WINDOW].source == source) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Returns the mean send-to-PUBACK latency.
+ *
+ * @param tracker Tracker.
+ * @return Mean latency in microseconds (0 if nothing was acknowledged).
+ */
+
+uint32_t publish_tracker_ack_latency_mean_us(const publish_tracker_t *tracker){
+    return tracker->acked ? (uint32_t)(tracker->ack_latency_sum_us / tracker->acked) : 0;
+}
@@ -0,0 +1,152 @@
+#include <string.h>           // memset for the cascade
+#include "inc/rollup.h"
+#include "inc/fixmath.h"
+#include "inc/config.h"
+
+#define ROLLUP_US_PER_HOUR 3600000000ULL
+#define ROLLUP_US_PER_DAY (24 * ROLLUP_US_PER_HOUR)
+
+static const uint32_t level_seconds[ROLLUP_LEVELS] = { 1, 60, 15 * 60, 60 * 60, 24 * 60 * 60 };
+
+/**
+ * @brief Returns the length of the windows of a level, in seconds.
+ */
+
+uint32_t rollup_level_seconds(uint8_t level){
+    return (level < ROLLUP_LEVELS) ? level_seconds[level] : 0;
+}
+
+/**
+ * @brief Returns the Lden period of an hour of the local day.
+ */
+
+lden_period_t rollup_lden_period(uint8_t hour){
+    if (hour >= LDEN_DAY_START_HOUR && hour < LDEN_EVENING_START_HOUR) {
+        return LDEN_DAY;
+    }
+    if (hour >= LDEN_EVENING_START_HOUR && hour < LDEN_NIGHT_START_HOUR) {
+        return LDEN_EVENING;
+    }
+    return LDEN_NIGHT;
+}
+
+/**
+ * @brief Computes the day-evening-night level from the energy of each period.
+ *
+ * @param periods Energy of the day, evening and night periods.
+ *
+ * Lden = 10 log10((Hd 10^(Ld/10) + He 10^((Le+5)/10) + Hn 10^((Ln+10)/10)) / 24) with
+ * Hd/He/Hn the length of each period (12/4/8 h by default). Periods without data are left
+ * out and the weights renormalized, so a partial day still gives a level. The terms are
+ * scaled to the loudest one before the exp2, so the sum stays in 64 bits.
+ *
+ * @return Lden in hundredths of dB (0 if no period has data).
+ */
+
+int32_t rollup_lden_cdB(const noise_energy_t *periods){
+    static const uint8_t penalty_dB[LDEN_PERIODS] = { 0, 5, 10 };
+    const uint8_t hours[LDEN_PERIODS] = {
+        LDEN_EVENING_START_HOUR - LDEN_DAY_START_HOUR,
+        LDEN_NIGHT_START_HOUR - LDEN_EVENING_START_HOUR,
+        24 - LDEN_NIGHT_START_HOUR + LDEN_DAY_START_HOUR,
+    };
+
+    int32_t term[LDEN_PERIODS];
+    int32_t loudest = INT32_MIN;
+    uint32_t total_hours = 0;
+
+    for (int p = 0; p < LDEN_PERIODS; p++) {
+        if (periods[p].count == 0) {
+            continue;
+        }
+        term[p] = noise_energy_leq_cdB(&periods[p]) + penalty_dB[p] * 100;
+        if (term[p] > loudest) {
+            loudest = term[p];
+        }
+        total_hours += hours[p];
+    }
+
+    if (total_hours == 0) {
+        return 0;
+    }
+
+    uint64_t sum = 0;                                   // Sum of H * 10^((term - loudest)/10), Q16
+    for (int p = 0; p < LDEN_PERIODS; p++) {
+        if (periods[p].count > 0) {
+            sum += hours[p] * fix_exp2_q16(fix_cdB_to_log2_q16(term[p] - loudest) + 16 * FIX_Q16_ONE);
+        }
+    }
+
+    return loudest + fix_log2_q16_to_cdB(fix_log2_q16(sum) - 16 * FIX_Q16_ONE - fix_log2_q16(total_hours));
+}
+
+/**
+ * @brief Starts the windows of every level at the current time.
+ */
+
+static void rollup_restart(rollup_t *rollup, uint64_t local_us){
+    memset(rollup, 0, sizeof(*rollup));
+
+    for (uint8_t i = 0; i < ROLLUP_LEVELS; i++) {
+        uint64_t length_us = (uint64_t)level_seconds[i] * 1000000;
+        rollup->start_us[i] = local_us - local_us % length_us;
+    }
+    rollup->started = true;
+}
+
+/**
+ * @brief Adds one level to the cascade, closing the windows it moves past.
+ *
+ * @param rollup Cascade to update.
+ * @param local_us Time of the level (local time, us).
+ * @param level_cdB Sound level in hundredths of dB.
+ * @param on_close Callback of each closed (non-empty) window, or NULL.
+ * @param arg User argument of the callback.
+ *
+ * The levels are checked from the shortest up: a window that closes is reported, merged
+ * into the next level (O(NOISE_STATS_BINS)) and restarted. The boundaries are nested, so
+ * the first level that stays open ends the check. Closing an hour also adds its energy
+ * to the Lden period of its start hour; closing a day reports the Lden and clears them.
+ * If the clock goes backwards, or forwards by more than the longest window (the first
+ * clock synchronization moves it from the time since boot to the date), the windows
+ * restart without being reported: their levels were not taken at the new times.
+ */
+
+void rollup_add(rollup_t *rollup, uint64_t local_us, int32_t level_cdB, rollup_close_cb_t on_close, void *arg){
+    if (!rollup->started || local_us < rollup->start_us[ROLLUP_1S] ||
+        local_us - rollup->start_us[ROLLUP_1S] > ROLLUP_US_PER_DAY) {
+        rollup_restart(rollup, local_us);
+    }
+
+    for (uint8_t i = 0; i < ROLLUP_LEVELS; i++) {
+        uint64_t length_us = (uint64_t)level_seconds[i] * 1000000;
+
+        if (local_us < rollup->start_us[i] + length_us) {
+            break;                                      // Still open: the longer levels are too
+        }
+
+        noise_stats_t *stats = &rollup->stats[i];
+        int32_t lden_cdB = 0;
+
+        if (i == ROLLUP_1H) {
+            uint8_t hour = (uint8_t)((rollup->start_us[i] / ROLLUP_US_PER_HOUR) % 24);
+            noise_energy_merge(&rollup->lden[rollup_lden_period(hour)], &stats->energy);
+        } else if (i == ROLLUP_24H) {
+            lden_cdB = rollup_lden_cdB(rollup->lden);
+            memset(rollup->lden, 0, sizeof(rollup->lden));
+        }
+
+        if (on_close && stats->energy.count > 0) {
+            on_close(i, stats, rollup->start_us[i], lden_cdB, arg);
+        }
+
+        if (i + 1 < ROLLUP_LEVELS) {
+            noise_stats_merge(&rollup->stats[i + 1], stats);
+        }
+
+        noise_stats_reset(stats);
+        rollup->start_us[i] = local_us - local_us % length_us;
+    }
+
+    noise_stats_add(&rollup->stats[ROLLUP_1S], level_cdB);
+}
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include "inc/sample_clock.h"
+#include "inc/config.h"
+#include "hardware/sync.h"
+
+/**
+ * @brief Repeating timer callback, runs in interrupt context.
+ *
+ * @param rt Repeating timer (user_data points to the clock).
+ *
+ * A tick that is still pending when the next one fires counts as a missed deadline.
+ *
+ * @return true to keep the timer running.
+ */
+
+static bool sample_clock_timer_cb(repeating_timer_t *rt){
+    sample_clock_t *clock = (sample_clock_t *)rt->user_data;
+
+    if (clock->tick_pending) {
+        clock->missed_deadlines++; // The main loop did not consume the previous tick in time
+    }
+
+    clock->tick_scheduled_us = clock->next_scheduled_us;
+    clock->tick_pending = true;
+    clock->next_scheduled_us += clock->period_us;
+    clock->ticks++;
+
+    __sev(); // Wake the core if it is waiting in best_effort_wfe_or_timeout()
+    return true;
+}
+
+/**
+ * @brief Starts the sampling clock.
+ *
+ * @param clock Pointer to the clock.
+ * @param period_us Sampling period in microseconds.
+ *
+ * The clock uses its own alarm pool on SAMPLE_CLOCK_HARDWARE_ALARM, so the tick interrupt
+ * runs on the calling core. A negative delay makes the timer fixed-rate: each tick is
+ * scheduled relative to the previous scheduled time, not to the end of its callback.
+ *
+ * @return true if the timer was started, false otherwise.
+ */
+
+bool sample_clock_start(sample_clock_t *clock, uint32_t period_us){
+    static alarm_pool_t *pool = NULL;
+
+    if (!pool) {
+        pool = alarm_pool_create(SAMPLE_CLOCK_HARDWARE_ALARM, 2);
+    }
+
+    clock->period_us = period_us;
+    clock->tick_pending = false;
+    clock->ticks = 0;
+    clock->missed_deadlines = 0;
+    sample_clock_reset_jitter(clock);
+
+    clock->next_scheduled_us = time_us_64() + period_us;
+
+    if (!alarm_pool_add_repeating_timer_us(pool, -(int64_t)period_us, sample_clock_timer_cb, clock, &clock->timer)) {
+        printf("Erro ao iniciar o relógio de amostragem.\n");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Consumes the pending tick, if any.
+ *
+ * @param clock Pointer to the clock.
+ * @param scheduled_us Pointer where the scheduled time of the tick is stored.
+ *
+ * @return true if a tick was pending.
+ */
+
+bool sample_clock_take_tick(sample_clock_t *clock, uint64_t *scheduled_us){
+    uint32_t irq_status = save_and_disable_interrupts(); // The 64-bit time is written by the timer IRQ
+
+    bool pending = clock->tick_pending;
+    if (pending) {
+        *scheduled_us = clock->tick_scheduled_us;
+        clock->tick_pending = false;
+    }
+
+    restore_interrupts(irq_status);
+    return pending;
+}
+
+/**
+ * @brief Counts a tick that could not start an acquisition (previous one still running).
+ *
+ * @param clock Pointer to the clock.
+ */
+
+void sample_clock_miss(sample_clock_t *clock){
+    uint32_t irq_status = save_and_disable_interrupts();
+    clock->missed_deadlines++;
+    restore_interrupts(irq_status);
+}
+
+/**
+ * @brief Records when the acquisition of a tick actually started.
+ *
+ * @param clock Pointer to the clock.
+ * @param scheduled_us Scheduled time of the tick.
+ * @param acquired_us Time at which the acquisition started.
+ */
+
+void sample_clock_record_acquisition(sample_clock_t *clock, uint64_t scheduled_us, uint64_t acquired_us){
+    uint32_t delay = (acquired_us > scheduled_us) ? (uint32_t)(acquired_us - scheduled_us) : 0;
+
+    if (delay < clock->jitter_min_us) clock->jitter_min_us = delay;
+    if (delay > clock->jitter_max_us) clock->jitter_max_us = delay;
+    clock->jitter_sum_us += delay;
+    clock->acquisitions++;
+}
+
+/**
+ * @brief Resets the jitter statistics (e.g. after each report).
+ *
+ * @param clock Pointer to the clock.
+ */
+
+void sample_clock_reset_jitter(sample_clock_t *clock){
+    clock->acquisitions = 0;
+    clock->jitter_min_us = UINT32_MAX;
+    clock->jitter_max_us = 0;
+    clock->jitter_sum_us = 0;
+}
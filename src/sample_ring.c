@@ -0,0 +1,67 @@
+#include "inc/sample_ring.h"
+#include "hardware/sync.h"    // Memory barriers between the cores
+
+#if (SAMPLE_RING_SIZE & (SAMPLE_RING_SIZE - 1)) != 0
+#error "SAMPLE_RING_SIZE must be a power of two"
+#endif
+
+/**
+ * @brief Queues one record (producer side).
+ *
+ * @param ring Ring to write.
+ * @param record Record to copy into the ring.
+ *
+ * The record is written before head is advanced, with a release barrier in between,
+ * so the consumer never sees a partially written record. Runs in constant time and
+ * never waits for the consumer.
+ *
+ * @return true if queued, false if the ring was full (record dropped).
+ */
+
+bool sample_ring_push(sample_ring_t *ring, const measurement_t *record){
+    uint32_t head = ring->head;
+    uint32_t used = head - ring->tail;
+
+    if (used >= SAMPLE_RING_SIZE) {
+        ring->overflows++;
+        return false;
+    }
+    __mem_fence_acquire();              // Tail read before the slot is overwritten
+
+    ring->records[head & (SAMPLE_RING_SIZE - 1)] = *record;
+    __mem_fence_release();              // Record visible before the new head
+    ring->head = head + 1;
+
+    if (used + 1 > ring->high_water) {
+        ring->high_water = used + 1;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Takes the oldest record (consumer side).
+ *
+ * @param ring Ring to read.
+ * @param record Pointer where the record is copied.
+ *
+ * The acquire barrier after reading head keeps the record read from being done
+ * before it; the release barrier keeps it from being done after tail frees the slot.
+ *
+ * @return true if a record was taken, false if the ring was empty.
+ */
+
+bool sample_ring_pop(sample_ring_t *ring, measurement_t *record){
+    uint32_t tail = ring->tail;
+
+    if (tail == ring->head) {
+        return false;
+    }
+    __mem_fence_acquire();              // Head read before the record
+
+    *record = ring->records[tail & (SAMPLE_RING_SIZE - 1)];
+    __mem_fence_release();              // Record read before the slot is given back
+    ring->tail = tail + 1;
+
+    return true;
+}
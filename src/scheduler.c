@@ -0,0 +1,168 @@
+#include "inc/scheduler.h"
+
+/**
+ * @brief Initializes a scheduler.
+ *
+ * @param sched Scheduler to initialize.
+ * @param clock Time source (e.g. time_us_64).
+ */
+
+void scheduler_init(scheduler_t *sched, scheduler_clock_t clock){
+    sched->task_count = 0;
+    sched->clock = clock;
+}
+
+/**
+ * @brief Adds a task.
+ *
+ * @param sched Scheduler.
+ * @param name Name used in the reports.
+ * @param fn Task function.
+ * @param arg Argument of the task function.
+ * @param period_us Release period (0 = polled on every pass).
+ * @param deadline_us Relative deadline (0 = none).
+ * @param priority Priority (0 = most urgent); tasks with the same priority run in insertion order.
+ * @return True if the task was added, false if the table is full.
+ *
+ * The first release of a periodic task is one period after it is added.
+ */
+
+bool scheduler_add(scheduler_t *sched, const char *name, scheduler_task_fn_t fn, void *arg,
+                   uint32_t period_us, uint32_t deadline_us, uint8_t priority){
+    if (sched->task_count >= SCHEDULER_MAX_TASKS) {
+        return false;
+    }
+
+    uint8_t pos = sched->task_count;
+    while (pos > 0 && sched->tasks[pos - 1].priority > priority) {   // Insertion sort by priority
+        sched->tasks[pos] = sched->tasks[pos - 1];
+        pos--;
+    }
+
+    scheduler_task_t *task = &sched->tasks[pos];
+    task->name = name;
+    task->fn = fn;
+    task->arg = arg;
+    task->period_us = period_us;
+    task->deadline_us = deadline_us;
+    task->priority = priority;
+    task->release_us = sched->clock() + period_us;
+    task->runs = 0;
+    task->overruns = 0;
+    task->skipped = 0;
+    task->max_runtime_us = 0;
+    task->max_lateness_us = 0;
+    task->total_runtime_us = 0;
+    sched->task_count++;
+
+    return true;
+}
+
+/**
+ * @brief Runs a task and updates its statistics.
+ *
+ * @param sched Scheduler.
+ * @param task Task to run.
+ * @param now_us Start time.
+ * @param deadline_at Absolute deadline (0 = none).
+ */
+
+static void run_task(scheduler_t *sched, scheduler_task_t *task, uint64_t now_us, uint64_t deadline_at){
+    task->fn(task->arg);
+
+    uint64_t end_us = sched->clock();
+    uint32_t runtime = (uint32_t)(end_us - now_us);
+
+    task->runs++;
+    task->total_runtime_us += runtime;
+    if (runtime > task->max_runtime_us) {
+        task->max_runtime_us = runtime;
+    }
+    if (deadline_at != 0 && end_us > deadline_at) {
+        task->overruns++;
+    }
+}
+
+/**
+ * @brief Runs one scheduler pass.
+ *
+ * @param sched Scheduler.
+ * @return True if a periodic task ran (another one may already be due).
+ *
+ * Ready tasks run in priority order. The pass ends after the first periodic task, so
+ * the caller loops while this returns true and the polled tasks of higher priority run
+ * between two periodic tasks. Releases missed while a task was late are dropped (counted
+ * as skipped) instead of running the task several times in a row.
+ */
+
+bool scheduler_run_once(scheduler_t *sched){
+    for (uint8_t i = 0; i < sched->task_count; i++) {
+        scheduler_task_t *task = &sched->tasks[i];
+        uint64_t now_us = sched->clock();
+
+        if (task->period_us == 0) {
+            run_task(sched, task, now_us, task->deadline_us ? now_us + task->deadline_us : 0);
+            continue;
+        }
+
+        if (now_us < task->release_us) {
+            continue;                                       // Not released yet
+        }
+
+        uint64_t release_us = task->release_us;
+        uint32_t lateness = (uint32_t)(now_us - release_us);
+        if (lateness > task->max_lateness_us) {
+            task->max_lateness_us = lateness;
+        }
+
+        task->release_us += task->period_us;
+        if (task->release_us <= now_us) {                   // Whole periods missed: resynchronize
+            uint64_t missed = (now_us - task->release_us) / task->period_us + 1;
+            task->skipped += (uint32_t)missed;
+            task->release_us += missed * task->period_us;
+        }
+
+        run_task(sched, task, now_us, task->deadline_us ? release_us + task->deadline_us : 0);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Returns the next release of a periodic task.
+ *
+ * @param sched Scheduler.
+ * @return Absolute time of the next release (UINT64_MAX if there is no periodic task).
+ */
+
+uint64_t scheduler_next_release_us(const scheduler_t *sched){
+    uint64_t next = UINT64_MAX;
+
+    for (uint8_t i = 0; i < sched->task_count; i++) {
+        const scheduler_task_t *task = &sched->tasks[i];
+        if (task->period_us != 0 && task->release_us < next) {
+            next = task->release_us;
+        }
+    }
+
+    return next;
+}
+
+/**
+ * @brief Clears the runtime statistics of all tasks.
+ *
+ * @param sched Scheduler.
+ */
+
+void scheduler_reset_stats(scheduler_t *sched){
+    for (uint8_t i = 0; i < sched->task_count; i++) {
+        scheduler_task_t *task = &sched->tasks[i];
+        task->runs = 0;
+        task->overruns = 0;
+        task->skipped = 0;
+        task->max_runtime_us = 0;
+        task->max_lateness_us = 0;
+        task->total_runtime_us = 0;
+    }
+}
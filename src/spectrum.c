@@ -0,0 +1,247 @@
+#include <math.h>             // Math library for the window, twiddles and band edges (computed once, at initialization)
+#include <string.h>           // memset for the analyzer
+#include "inc/spectrum.h"
+#include "inc/fixmath.h"
+#include "inc/config.h"
+
+#define SPECTRUM_DATA_LIMIT (1 << 13)   // Stage inputs stay below 2^13, so Q15 products fit in 32 bits and outputs below 2^16
+#define SPECTRUM_INPUT_EXPONENT (-3)    // (sample * Q15 window) >> 12 is the windowed sample times 2^3
+
+// Nominal centre frequencies of the bands from 20 Hz to 20 kHz (IEC 61260), rounded down to whole Hz
+static const uint16_t band_nominal_hz[SPECTRUM_MAX_BANDS] = {
+    20, 25, 31, 40, 50, 63, 80, 100, 125, 160, 200, 250, 315, 400, 500, 630,
+    800, 1000, 1250, 1600, 2000, 2500, 3150, 4000, 5000, 6300, 8000, 10000, 12500, 16000, 20000,
+};
+
+/**
+ * @brief Reverses the base-4 digits of an index (radix-4 input ordering).
+ */
+
+static uint16_t digit_reverse4(uint16_t index, uint8_t log2_size){
+    uint16_t reversed = 0;
+
+    for (uint8_t i = 0; i < log2_size; i += 2) {
+        reversed = (reversed << 2) | (index & 3);
+        index >>= 2;
+    }
+
+    return reversed;
+}
+
+/**
+ * @brief Prepares the analyzer for an FFT size and a sampling rate.
+ *
+ * @param spectrum Analyzer to initialize.
+ * @param fft_size FFT size (64, 256 or 1024).
+ * @param sample_rate_hz Sampling rate of the signal.
+ *
+ * Only the bands at least one FFT bin wide and below Nyquist are kept: with 1024 points
+ * at 16 kHz that is 80 Hz to 6.3 kHz, at 48 kHz 250 Hz to 20 kHz.
+ */
+
+void spectrum_init(spectrum_t *spectrum, uint16_t fft_size, uint32_t sample_rate_hz){
+    memset(spectrum, 0, sizeof(*spectrum));
+
+    spectrum->fft_size = fft_size;
+    while ((1u << spectrum->log2_size) < fft_size) {
+        spectrum->log2_size++;
+    }
+
+    for (uint16_t n = 0; n < fft_size; n++) {
+        spectrum->window[n] = (int16_t)lround(32767.0 * 0.5 * (1.0 - cos(2.0 * M_PI * n / fft_size)));   // Periodic Hann
+    }
+
+    for (uint16_t k = 0; k < fft_size * 3 / 4; k++) {
+        spectrum->twiddle_cos[k] = (int16_t)lround(32767.0 * cos(2.0 * M_PI * k / fft_size));
+        spectrum->twiddle_sin[k] = (int16_t)lround(32767.0 * sin(2.0 * M_PI * k / fft_size));
+    }
+
+    double bin_hz = (double)sample_rate_hz / fft_size;
+    double upper = 0.0;
+
+    for (int band = SPECTRUM_LOWEST_BAND; band < SPECTRUM_LOWEST_BAND + SPECTRUM_MAX_BANDS; band++) {
+        double centre = 1000.0 * pow(2.0, band / 3.0);
+        double lower = centre * pow(2.0, -1.0 / 6.0);
+
+        upper = centre * pow(2.0, 1.0 / 6.0);
+
+        if (upper - lower < bin_hz) {
+            continue;                                   // Narrower than one bin: not resolved
+        }
+        if (upper > sample_rate_hz / 2.0) {
+            break;                                      // Above Nyquist
+        }
+
+        if (spectrum->band_count == 0) {
+            spectrum->first_band = (int8_t)band;
+        }
+        spectrum->band_first_bin[spectrum->band_count++] = (uint16_t)ceil(lower / bin_hz);
+        spectrum->band_first_bin[spectrum->band_count] = (uint16_t)ceil(upper / bin_hz);
+    }
+}
+
+/**
+ * @brief Shifts the work buffers down so the next stage cannot overflow.
+ *
+ * @return The number of bits shifted (added to the block exponent).
+ */
+
+static int spectrum_normalize(spectrum_t *spectrum){
+    uint32_t max = 0;
+
+    for (uint16_t n = 0; n < spectrum->fft_size; n++) {
+        uint32_t r = (uint32_t)(spectrum->re[n] < 0 ? -spectrum->re[n] : spectrum->re[n]);
+        uint32_t i = (uint32_t)(spectrum->im[n] < 0 ? -spectrum->im[n] : spectrum->im[n]);
+        max |= r | i;                                   // Only the highest set bit matters
+    }
+
+    int shift = 0;
+    while ((max >> shift) >= SPECTRUM_DATA_LIMIT) {
+        shift++;
+    }
+
+    if (shift > 0) {
+        for (uint16_t n = 0; n < spectrum->fft_size; n++) {
+            spectrum->re[n] >>= shift;
+            spectrum->im[n] >>= shift;
+        }
+    }
+
+    return shift;
+}
+
+/**
+ * @brief Runs the radix-4 decimation-in-time FFT on the work buffers.
+ *
+ * @return The block exponent of the result (true value = data * 2^exponent).
+ */
+
+static int spectrum_fft(spectrum_t *spectrum){
+    const uint16_t n = spectrum->fft_size;
+    int exponent = SPECTRUM_INPUT_EXPONENT;
+
+    for (uint16_t span = 1; span < n; span *= 4) {
+        uint16_t step = n / (4 * span);                 // Twiddle stride of this stage
+
+        exponent += spectrum_normalize(spectrum);
+
+        for (uint16_t group = 0; group < n; group += 4 * span) {
+            for (uint16_t j = 0; j < span; j++) {
+                int32_t *re = spectrum->re + group + j;
+                int32_t *im = spectrum->im + group + j;
+
+                int32_t ar = re[0], ai = im[0];
+                int32_t br = re[span], bi = im[span];
+                int32_t cr = re[2 * span], ci = im[2 * span];
+                int32_t dr = re[3 * span], di = im[3 * span];
+
+                if (j != 0) {
+                    // Multiply by W^k = cos - i sin for k = j, 2j and 3j (in units of the stride)
+                    uint16_t k = j * step;
+                    int32_t c = spectrum->twiddle_cos[k], s = spectrum->twiddle_sin[k];
+                    int32_t t = (br * c + bi * s) >> 15;
+                    bi = (bi * c - br * s) >> 15;
+                    br = t;
+
+                    c = spectrum->twiddle_cos[2 * k];
+                    s = spectrum->twiddle_sin[2 * k];
+                    t = (cr * c + ci * s) >> 15;
+                    ci = (ci * c - cr * s) >> 15;
+                    cr = t;
+
+                    c = spectrum->twiddle_cos[3 * k];
+                    s = spectrum->twiddle_sin[3 * k];
+                    t = (dr * c + di * s) >> 15;
+                    di = (di * c - dr * s) >> 15;
+                    dr = t;
+                }
+
+                re[0] = ar + br + cr + dr;                  // X0 = a + b + c + d
+                im[0] = ai + bi + ci + di;
+                re[span] = ar + bi - cr - di;               // X1 = a - jb - c + jd
+                im[span] = ai - br - ci + dr;
+                re[2 * span] = ar - br + cr - dr;           // X2 = a - b + c - d
+                im[2 * span] = ai - bi + ci - di;
+                re[3 * span] = ar - bi - cr + di;           // X3 = a + jb - c - jd
+                im[3 * span] = ai + br - ci - dr;
+            }
+        }
+    }
+
+    return exponent;
+}
+
+/**
+ * @brief Computes the band energies of one frame of ADC samples.
+ *
+ * @param spectrum Analyzer to use.
+ * @param samples Pointer to fft_size raw 12-bit ADC samples.
+ * @param offset DC offset of the signal (mid-scale of the ADC).
+ * @param band_energy Array of band_count accumulators the energies are added to.
+ *
+ * The energies are in units of 2^-6 counts squared (one-sided, Hann-windowed power).
+ * Cost on the Cortex-M0+: about 160k cycles for 1024 points (1.3 ms at 125 MHz),
+ * i.e. about 2% of one core at 16 kHz and 6% at 48 kHz.
+ */
+
+void spectrum_add_frame(spectrum_t *spectrum, const uint16_t *samples, int32_t offset, uint64_t *band_energy){
+    for (uint16_t n = 0; n < spectrum->fft_size; n++) {
+        uint16_t target = digit_reverse4(n, spectrum->log2_size);
+        spectrum->re[target] = (((int32_t)samples[n] - offset) * spectrum->window[n]) >> 12;
+        spectrum->im[target] = 0;
+    }
+
+    int shift = 2 * (spectrum_fft(spectrum) - SPECTRUM_INPUT_EXPONENT);   // Back to a fixed scale
+
+    for (uint8_t b = 0; b < spectrum->band_count; b++) {
+        uint64_t energy = 0;
+
+        for (uint16_t k = spectrum->band_first_bin[b]; k < spectrum->band_first_bin[b + 1]; k++) {
+            uint32_t r = (uint32_t)(spectrum->re[k] < 0 ? -spectrum->re[k] : spectrum->re[k]);
+            uint32_t i = (uint32_t)(spectrum->im[k] < 0 ? -spectrum->im[k] : spectrum->im[k]);
+            energy += (uint64_t)(r * r) + (i * i);
+        }
+
+        energy <<= shift;
+        band_energy[b] = (band_energy[b] + energy < band_energy[b]) ? UINT64_MAX : band_energy[b] + energy;   // Saturate
+    }
+}
+
+/**
+ * @brief Converts accumulated band energies to band levels.
+ *
+ * @param spectrum Analyzer that produced the energies.
+ * @param band_energy Accumulated band energies.
+ * @param frames Number of frames accumulated.
+ * @param levels_cdB Array of band_count levels, in hundredths of dB.
+ *
+ * With a Hann window (sum of w^2 = 3N/8), the mean square of the signal in a band is
+ * 2 * E * 2^-6 / (3/8 * N^2 * frames) = E / (4 * 3 * N^2 * frames), which is on the same
+ * scale as the broadband level (audio_sum_squares_to_cdB).
+ */
+
+void spectrum_levels_cdB(const spectrum_t *spectrum, const uint64_t *band_energy, uint32_t frames, int32_t *levels_cdB){
+    int32_t log2_scale = fix_log2_q16((uint64_t)3 * (frames ? frames : 1))
+                       + (2 + 2 * spectrum->log2_size) * FIX_Q16_ONE;
+
+    for (uint8_t b = 0; b < spectrum->band_count; b++) {
+        uint64_t energy = band_energy[b] ? band_energy[b] : 1;
+        levels_cdB[b] = fix_log2_q16_to_cdB(fix_log2_q16(energy) - log2_scale) + (int32_t)(MIC_DB_OFFSET * 100);
+    }
+}
+
+/**
+ * @brief Returns the nominal centre frequency of a band (e.g. 31 for 31.5 Hz).
+ *
+ * @param band Band number (0 = 1 kHz).
+ */
+
+uint16_t spectrum_band_nominal_hz(int8_t band){
+    int index = band - SPECTRUM_LOWEST_BAND;
+
+    if (index < 0 || index >= SPECTRUM_MAX_BANDS) {
+        return 0;
+    }
+
+    return band_nominal_hz[index];
+}
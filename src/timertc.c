@@ -9,6 +9,8 @@
 static volatile bool sntp_config_pending = true; // Flag to indicate if SNTP configuration is still pending
 static volatile bool sntp_dns_successful = false; // Flag to indicate if SNTP DNS resolution was successful
 bool rtc_initialized = false; // Flag to indicate if RTC has been initialized successfully
+static volatile int64_t local_time_offset_us = 0; // Local time minus timer time (0 until the first SNTP synchronization)
+static volatile bool local_time_synced = false; // Flag to indicate if local_time_offset_us has been set by SNTP
 
 /**
  * @brief Sets the RTC time from SNTP epoch seconds and microseconds.
@@ -27,6 +29,10 @@ void my_rtc_set_from_sntp(uint32_t epoch_seconds, uint32_t epoch_microseconds)
     printf("my_rtc_set_from_sntp: Chamada com epoch %u s, %u us\n",
            (unsigned int)epoch_seconds, (unsigned int)epoch_microseconds);
 
+    // Offset between the local time (GMT-3) and the microsecond timer, for the statistics windows
+    local_time_offset_us = ((int64_t)epoch_seconds - GMT_M_3 * 3600) * 1000000 + epoch_microseconds - (int64_t)time_us_64();
+    local_time_synced = true;
+
     datetime_t dt = {0};
     time_t secs_for_gmtime = epoch_seconds;
 
@@ -68,6 +74,41 @@ void my_rtc_set_from_sntp(uint32_t epoch_seconds, uint32_t epoch_microseconds)
     }
 }
 
+/**
+ * @brief Converts a timer timestamp to local time.
+ *
+ * @param timestamp_us Timestamp of the microsecond timer (us since boot).
+ *
+ * The offset is written by the SNTP callback and read from the main loop, so it is
+ * read until two reads agree (a 64-bit value is not written atomically).
+ *
+ * @return Local time in us since 1970-01-01 00:00 local, or timestamp_us itself
+ *         while the clock has not been synchronized.
+ */
+
+uint64_t rtc_local_time_us(uint64_t timestamp_us)
+{
+    int64_t offset;
+
+    do {
+        offset = local_time_offset_us;
+    } while (offset != local_time_offset_us);
+
+    return timestamp_us + offset;
+}
+
+/**
+ * @brief Tells whether the local time has been synchronized.
+ *
+ * @return true once rtc_local_time_us() gives the local date, false while it still gives
+ *         the time since boot.
+ */
+
+bool rtc_local_time_synced(void)
+{
+    return local_time_synced;
+}
+
 /**
  * @brief Callback function for DNS resolution of SNTP server.
  *
@@ -0,0 +1,279 @@
+#include <math.h>             // Math library for the filter design (runs once, at initialization)
+#include <stdbool.h>
+#include <string.h>           // memset for the filter state
+#include "inc/weighting.h"
+#include "inc/audio_dsp.h"
+
+// Pole frequencies of the analog weighting curves (IEC 61672-1, Annex E)
+#define WEIGHTING_F1_HZ 20.598997
+#define WEIGHTING_F2_HZ 107.65265
+#define WEIGHTING_F3_HZ 737.86223
+#define WEIGHTING_F4_HZ 12194.217
+#define WEIGHTING_REFERENCE_HZ 1000.0   // The weightings are 0 dB at 1 kHz
+#define WEIGHTING_MATCHED_MIN_RATIO 2.25   // Sampling rate / F4 from which the F4 pair is magnitude-matched
+#define WEIGHTING_ZERO_STEPS 64         // Resolution of the zero of the magnitude-matched F4 pair
+
+// First-order factor of the digital filter: integer numerator taps and real denominator
+typedef struct {
+    int8_t num[2];
+    double den[2];
+} weighting_factor_t;
+
+/**
+ * @brief Maps the analog factor s / (s + w) with the bilinear transform.
+ */
+
+static weighting_factor_t factor_high_pass(double pole_hz, double sample_rate){
+    double c = 2.0 * sample_rate;
+    double w = 2.0 * M_PI * pole_hz;
+    weighting_factor_t factor = { { 1, -1 }, { c + w, w - c } };   // Zero at DC
+    return factor;
+}
+
+/**
+ * @brief Maps the analog factor 1 / (s + w) with the bilinear transform.
+ */
+
+static weighting_factor_t factor_low_pass(double pole_hz, double sample_rate){
+    double c = 2.0 * sample_rate;
+    double w = 2.0 * M_PI * pole_hz;
+    weighting_factor_t factor = { { 1, 1 }, { c + w, w - c } };    // Zero at Nyquist
+    return factor;
+}
+
+/**
+ * @brief Maps the analog factor 1 / (s + w) with the matched-z transform.
+ */
+
+static weighting_factor_t factor_low_pass_matched(double pole_hz, double sample_rate){
+    weighting_factor_t factor = { { 1, 0 }, { 1.0, -exp(-2.0 * M_PI * pole_hz / sample_rate) } };
+    return factor;
+}
+
+/**
+ * @brief Maps the analog double pole 1 / (s + w)^2 by matching its magnitude.
+ *
+ * Both poles go through the matched-z transform and the numerator b0 + b1 z^-1 is chosen
+ * so that the magnitude equals the analog one at DC and at the pole frequency (M. Vicanek,
+ * "Matched Second Order Digital Filters", 2016). Unlike the bilinear transform, this puts no
+ * zero at Nyquist, so the response does not droop near fs/2. The zero is rounded to
+ * 1/WEIGHTING_ZERO_STEPS so the numerator keeps small integer taps.
+ *
+ * @return false if the pole is too close to Nyquist for the magnitude to be matched.
+ */
+
+static bool factor_low_pass_pair_matched(double pole_hz, double sample_rate, weighting_factor_t *f, weighting_factor_t *g){
+    double w0 = 2.0 * M_PI * pole_hz / sample_rate;
+    double p = exp(-w0);
+    double a1 = -2.0 * p;
+    double a2 = p * p;
+
+    double A0 = (1.0 + a1 + a2) * (1.0 + a1 + a2);
+    double A1 = (1.0 - a1 + a2) * (1.0 - a1 + a2);
+    double A2 = -4.0 * a2;
+    double phi1 = sin(w0 / 2.0) * sin(w0 / 2.0);
+    double phi0 = 1.0 - phi1;
+    double phi2 = 4.0 * phi0 * phi1;
+
+    double R1 = (A0 * phi0 + A1 * phi1 + A2 * phi2) * 0.25;   // |H|^2 = Q^2 = 1/4 at the pole frequency
+    double B1 = (R1 - A0 * phi0) / phi1;
+    if (sample_rate < WEIGHTING_MATCHED_MIN_RATIO * pole_hz || B1 < 0.0) {
+        return false;
+    }
+
+    double b0 = (sqrt(A0) + sqrt(B1)) / 2.0;
+    double b1 = sqrt(A0) - b0;
+
+    f->num[0] = WEIGHTING_ZERO_STEPS;
+    f->num[1] = (int8_t)lround(WEIGHTING_ZERO_STEPS * b1 / b0);
+    f->den[0] = 1.0;
+    f->den[1] = -p;
+    *g = factor_low_pass_matched(pole_hz, sample_rate);
+    return true;
+}
+
+/**
+ * @brief Computes the magnitude of a second-order polynomial in z^-1 on the unit circle.
+ */
+
+static double poly_magnitude(double p0, double p1, double p2, double omega){
+    double re = p0 + p1 * cos(omega) + p2 * cos(2.0 * omega);
+    double im = p1 * sin(omega) + p2 * sin(2.0 * omega);
+    return sqrt(re * re + im * im);
+}
+
+/**
+ * @brief Builds one biquad section from two first-order factors.
+ *
+ * The section is scaled to unity gain at 1 kHz, so every weighting ends up at 0 dB there
+ * and no section has a large gain that would eat into the fixed-point headroom.
+ */
+
+static void weighting_design_section(weighting_section_t *section, weighting_factor_t f, weighting_factor_t g, double sample_rate){
+    int num[3] = { f.num[0] * g.num[0], f.num[0] * g.num[1] + f.num[1] * g.num[0], f.num[1] * g.num[1] };
+    double a0 = f.den[0] * g.den[0];
+    double a1 = (f.den[0] * g.den[1] + f.den[1] * g.den[0]) / a0;
+    double a2 = (f.den[1] * g.den[1]) / a0;
+
+    double omega = 2.0 * M_PI * WEIGHTING_REFERENCE_HZ / sample_rate;
+    double gain = poly_magnitude(1.0, a1, a2, omega) / poly_magnitude(num[0], num[1], num[2], omega);
+    double one = (double)(1 << WEIGHTING_COEF_SHIFT);
+
+    memset(section, 0, sizeof(*section));
+    for (int i = 0; i < 3; i++) {
+        section->num[i] = (int8_t)num[i];
+    }
+    section->gain = (int32_t)lround(gain * one);
+    section->a1 = (int32_t)lround(a1 * one);
+    section->a2 = (int32_t)lround(a2 * one);
+}
+
+/**
+ * @brief Designs a weighting filter for a sampling rate.
+ *
+ * @param filter Filter to initialize.
+ * @param type Frequency weighting.
+ * @param sample_rate_hz Sampling rate of the signal.
+ *
+ * The analog curves are split into second-order sections (A: s^2/(s+w1)^2, s^2/((s+w2)(s+w3))
+ * and 1/(s+w4)^2; C: the first and the last one). The low-frequency poles use the bilinear
+ * transform. The 12.2 kHz pole pair is magnitude-matched from fs = 2.25 * 12.2 kHz on (at
+ * 48 kHz: within 0.05 dB of the analog curve up to 12.5 kHz and 0.2 dB at 16 kHz; from 32 kHz:
+ * within 0.3 dB below 0.4 fs). At lower rates the pair is too close to Nyquist, so one pole is
+ * mapped with the bilinear transform and the other with the matched-z transform, whose errors
+ * partly cancel (within 0.25 dB up to fs/4). The design uses double precision once; the
+ * filter itself runs in fixed point.
+ */
+
+void weighting_init(weighting_filter_t *filter, weighting_t type, uint32_t sample_rate_hz){
+    double fs = (double)sample_rate_hz;
+
+    memset(filter, 0, sizeof(*filter));
+    filter->type = type;
+
+    if (type == WEIGHTING_Z) {
+        return;
+    }
+
+    weighting_design_section(&filter->sections[filter->section_count++],
+                             factor_high_pass(WEIGHTING_F1_HZ, fs), factor_high_pass(WEIGHTING_F1_HZ, fs), fs);
+
+    if (type == WEIGHTING_A) {
+        weighting_design_section(&filter->sections[filter->section_count++],
+                                 factor_high_pass(WEIGHTING_F2_HZ, fs), factor_high_pass(WEIGHTING_F3_HZ, fs), fs);
+    }
+
+    weighting_factor_t f, g;
+    if (!factor_low_pass_pair_matched(WEIGHTING_F4_HZ, fs, &f, &g)) {
+        f = factor_low_pass(WEIGHTING_F4_HZ, fs);
+        g = factor_low_pass_matched(WEIGHTING_F4_HZ, fs);
+    }
+    weighting_design_section(&filter->sections[filter->section_count++], f, g, fs);
+}
+
+/**
+ * @brief Clears the state of a weighting filter.
+ *
+ * @param filter Filter to reset.
+ */
+
+void weighting_reset(weighting_filter_t *filter){
+    for (uint8_t i = 0; i < filter->section_count; i++) {
+        weighting_section_t *s = &filter->sections[i];
+        s->x1 = s->x2 = s->y1 = s->y2 = s->error = 0;
+    }
+}
+
+/**
+ * @brief Runs one biquad section (direct form I with first-order error feedback).
+ *
+ * The numerator taps are small integers (0, +-1, +-2), so it costs three 32x32->64 bit
+ * multiplications per sample. The truncation remainder of the output is added back to the
+ * next sample, which keeps the quantization noise of the near-DC poles out of the band.
+ */
+
+static inline int32_t weighting_section_process(weighting_section_t *s, int32_t x){
+    int32_t v = s->num[0] * x + s->num[1] * s->x1 + s->num[2] * s->x2;
+
+    int64_t acc = (int64_t)s->gain * v
+                - (int64_t)s->a1 * s->y1
+                - (int64_t)s->a2 * s->y2
+                + s->error;
+
+    int32_t y = (int32_t)(acc >> WEIGHTING_COEF_SHIFT);
+    s->error = (int32_t)(acc - ((int64_t)y << WEIGHTING_COEF_SHIFT));
+
+    s->x2 = s->x1;
+    s->x1 = x;
+    s->y2 = s->y1;
+    s->y1 = y;
+    return y;
+}
+
+/**
+ * @brief Filters one sample.
+ *
+ * @param filter Filter to use.
+ * @param x Input sample (ADC deviation shifted left by WEIGHTING_INPUT_SHIFT).
+ * @return The weighted sample, on the same scale as the input.
+ */
+
+int32_t weighting_process(weighting_filter_t *filter, int32_t x){
+    for (uint8_t i = 0; i < filter->section_count; i++) {
+        x = weighting_section_process(&filter->sections[i], x);
+    }
+
+    return x;
+}
+
+/**
+ * @brief Filters a block of ADC samples and computes the sum of squares of the output.
+ *
+ * @param filter Filter to use (its state carries over to the next block).
+ * @param samples Pointer to the raw 12-bit ADC samples.
+ * @param count Number of samples in the block.
+ * @param offset DC offset of the signal (mid-scale of the ADC).
+ *
+ * The output is squared with 4 fractional bits (a 32-bit multiplication), which keeps the
+ * resolution of quiet signals without 64-bit products. Cost on the Cortex-M0+: about
+ * 3 x 3 emulated 64-bit multiplications per sample for A-weighting (roughly 300 cycles),
+ * i.e. about 12% of one core at 48 kHz and 125 MHz; C-weighting costs two thirds of that.
+ *
+ * @return The sum of the squared weighted samples, in ADC counts squared.
+ */
+
+uint64_t weighting_block_sum_squares(weighting_filter_t *filter, const uint16_t *samples, uint32_t count, int32_t offset){
+    if (filter->section_count == 0) {
+        return audio_block_sum_squares(samples, count, offset);    // Z-weighting: no filter
+    }
+
+    uint64_t total = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t y = weighting_process(filter, ((int32_t)samples[i] - offset) << WEIGHTING_INPUT_SHIFT);
+        int32_t v = y >> (WEIGHTING_INPUT_SHIFT - 4);             // ADC counts with 4 fractional bits
+
+        uint32_t magnitude = (uint32_t)(v < 0 ? -v : v);
+        if (magnitude > 0xFFFF) {
+            magnitude = 0xFFFF;                                      // Clipped (above full scale)
+        }
+        total += magnitude * magnitude;
+    }
+
+    return total >> 8;
+}
+
+/**
+ * @brief Returns the name of a weighting ("Z", "A" or "C").
+ */
+
+const char *weighting_name(weighting_t type){
+    switch (type) {
+    case WEIGHTING_A:
+        return "A";
+    case WEIGHTING_C:
+        return "C";
+    default:
+        return "Z";
+    }
+}
@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <string.h>
+#include "fake_broker.h"
+#include "inc/display.h"
+#include "inc/timertc.h"
+#include "inc/wifi.h"
+#include "lwip/altcp.h"
+#include "lwip/apps/mqtt_priv.h"
+#include "lwip/dns.h"
+
+// A published message stays in the TCP send buffer until its PUBACK (the broker has then
+// acknowledged its segments too); what does not fit waits in the output ring buffer of
+// the client.
+
+static fake_broker_message_t messages[FAKE_BROKER_MAX_MESSAGES];
+static uint32_t message_count;
+static uint32_t first_pending;          // Oldest message that may still wait for its PUBACK
+static uint32_t connection;             // Connections accepted since the reset
+static bool connected;
+static uint32_t lock_depth;
+static mqtt_client_t client;
+static uint8_t connection_pcb;          // Stands for the TCP connection of the client
+static mqtt_connection_cb_t connection_cb;
+static void *connection_arg;
+
+uint64_t fake_now_us;
+datetime_t fake_rtc;
+bool fake_wifi_up;
+bool fake_broker_online;
+uint32_t fake_broker_unlocked;
+
+bool rtc_initialized;
+ssd1306_t disp;
+
+void fake_broker_reset(void) {
+    memset(messages, 0, sizeof(messages));
+    message_count = 0;
+    first_pending = 0;
+    connection = 0;
+    connected = false;
+    lock_depth = 0;
+    client.conn = NULL;
+    connection_cb = NULL;
+    fake_rtc = (datetime_t){ .year = 2025, .month = 6, .day = 2, .dotw = 1, .hour = 15 };
+    fake_wifi_up = true;
+    fake_broker_online = true;
+    fake_broker_unlocked = 0;
+    rtc_initialized = true;
+}
+
+static uint32_t outstanding_bytes(uint32_t *requests) {
+    uint32_t bytes = 0;
+
+    *requests = 0;
+    for (uint32_t i = first_pending; i < message_count; i++) {
+        if (messages[i].pending) {
+            bytes += messages[i].length + strlen(messages[i].topic) + 6;   // Fixed header, topic length, packet id
+            (*requests)++;
+        }
+    }
+    return bytes;
+}
+
+static uint32_t complete(uint32_t count, err_t result) {
+    uint32_t done = 0;
+
+    for (uint32_t i = first_pending; i < message_count && done < count; i++) {
+        if (messages[i].pending) {
+            messages[i].pending = false;
+            done++;
+            if (messages[i].cb) {
+                messages[i].cb(messages[i].arg, result);
+            }
+        }
+    }
+    while (first_pending < message_count && !messages[first_pending].pending) {
+        first_pending++;
+    }
+    return done;
+}
+
+void fake_broker_disconnect(void) {
+    for (uint32_t i = first_pending; i < message_count; i++) {
+        messages[i].pending = false;        // Freed by lwIP without a callback
+    }
+    first_pending = message_count;
+    client.conn = NULL;
+
+    if (connected) {
+        connected = false;
+        if (connection_cb) {
+            connection_cb(&client, connection_arg, MQTT_CONNECT_DISCONNECTED);
+        }
+    }
+}
+
+uint32_t fake_broker_ack(uint32_t count) {
+    return complete(count, ERR_OK);
+}
+
+uint32_t fake_broker_timeout(uint32_t count) {
+    return complete(count, ERR_TIMEOUT);
+}
+
+uint32_t fake_broker_pending(void) {
+    uint32_t requests;
+    outstanding_bytes(&requests);
+    return requests;
+}
+
+uint32_t fake_broker_count(void) {
+    return message_count;
+}
+
+const fake_broker_message_t *fake_broker_message(uint32_t index) {
+    return (index < message_count) ? &messages[index] : NULL;
+}
+
+mqtt_client_t *mqtt_client_new(void) {
+    return &client;
+}
+
+err_t mqtt_client_connect(mqtt_client_t *mqtt_client, const ip_addr_t *ipaddr, uint16_t port, mqtt_connection_cb_t cb,
+                          void *arg, const struct mqtt_connect_client_info_t *client_info) {
+    (void)ipaddr;
+    (void)port;
+    (void)client_info;
+
+    if (connected) {
+        return ERR_ISCONN;
+    }
+
+    connection_cb = cb;
+    connection_arg = arg;
+    if (!fake_wifi_up || !fake_broker_online) {
+        cb(mqtt_client, arg, MQTT_CONNECT_DISCONNECTED);
+        return ERR_OK;
+    }
+
+    connected = true;
+    connection++;
+    mqtt_client->conn = (struct altcp_pcb *)&connection_pcb;
+    cb(mqtt_client, arg, MQTT_CONNECT_ACCEPTED);
+    return ERR_OK;
+}
+
+uint8_t mqtt_client_is_connected(mqtt_client_t *mqtt_client) {
+    (void)mqtt_client;
+    return connected;
+}
+
+err_t mqtt_publish(mqtt_client_t *mqtt_client, const char *topic, const void *payload, uint16_t payload_length,
+                   uint8_t qos, uint8_t retain, mqtt_request_cb_t cb, void *arg) {
+    (void)mqtt_client;
+    (void)retain;
+    uint32_t requests;
+    uint32_t bytes = outstanding_bytes(&requests);
+
+    if (lock_depth == 0) {
+        fake_broker_unlocked++;
+    }
+    if (!connected) {
+        return ERR_CONN;
+    }
+    if (requests >= MQTT_REQ_MAX_IN_FLIGHT ||
+        bytes + payload_length + strlen(topic) + 6 > TCP_SND_BUF + MQTT_OUTPUT_RINGBUF_SIZE) {
+        return ERR_MEM;
+    }
+    if (message_count >= FAKE_BROKER_MAX_MESSAGES || payload_length > sizeof(messages[0].payload)) {
+        fprintf(stderr, "fake_broker: mensagem %u (%u bytes) fora da capacidade do teste\n", message_count, payload_length);
+        return ERR_MEM;
+    }
+
+    fake_broker_message_t *message = &messages[message_count++];
+    strncpy(message->topic, topic, sizeof(message->topic) - 1);
+    memcpy(message->payload, payload, payload_length);
+    message->length = payload_length;
+    message->sent_us = fake_now_us;
+    message->connection = connection;
+    message->pending = qos > 0;
+    message->cb = cb;
+    message->arg = arg;
+    return ERR_OK;
+}
+
+uint16_t altcp_sndbuf(struct altcp_pcb *conn) {
+    uint32_t requests;
+    uint32_t bytes = outstanding_bytes(&requests);
+
+    if (lock_depth == 0) {
+        fake_broker_unlocked++;
+    }
+    return (conn && bytes < TCP_SND_BUF) ? (uint16_t)(TCP_SND_BUF - bytes) : 0;
+}
+
+void dns_setserver(uint8_t numdns, const ip_addr_t *dnsserver) {
+    (void)numdns;
+    (void)dnsserver;
+}
+
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg) {
+    ip_addr_t resolved = { 0x0100007F };
+
+    *addr = resolved;
+    found(hostname, &resolved, callback_arg);   // Answered right away (from the cache)
+    return ERR_INPROGRESS;
+}
+
+char *ipaddr_ntoa(const ip_addr_t *addr) {
+    static char text[16];
+
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", (unsigned)(addr->addr & 0xFF), (unsigned)(addr->addr >> 8 & 0xFF),
+             (unsigned)(addr->addr >> 16 & 0xFF), (unsigned)(addr->addr >> 24));
+    return text;
+}
+
+int ipaddr_aton(const char *cp, ip_addr_t *addr) {
+    unsigned a, b, c, d;
+
+    if (sscanf(cp, "%u.%u.%u.%u", &a, &b, &c, &d) != 4) {
+        return 0;
+    }
+    addr->addr = a | b << 8 | c << 16 | (uint32_t)d << 24;
+    return 1;
+}
+
+void cyw43_arch_lwip_begin(void) {
+    lock_depth++;
+}
+
+void cyw43_arch_lwip_end(void) {
+    lock_depth--;
+}
+
+bool is_wifi_connected() {
+    return fake_wifi_up;
+}
+
+uint64_t time_us_64(void) {
+    return fake_now_us;
+}
+
+void sleep_ms(uint32_t ms) {
+    fake_now_us += ms * 1000ULL;
+}
+
+bool rtc_get_datetime(datetime_t *t) {
+    *t = fake_rtc;
+    return true;
+}
+
+void ssd1306_clear_area(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    (void)p;
+    (void)x;
+    (void)y;
+    (void)width;
+    (void)height;
+}
+
+void ssd1306_draw_string(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const char *s) {
+    (void)p;
+    (void)x;
+    (void)y;
+    (void)scale;
+    (void)s;
+}
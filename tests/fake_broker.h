@@ -0,0 +1,80 @@
+#ifndef FAKE_BROKER_H
+#define FAKE_BROKER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/config.h"
+#include "hardware/rtc.h"
+#include "lwip/apps/mqtt.h"
+
+// Host stand-in of the lwIP MQTT client talking to a local broker, and of the board
+// services src/mqtt.c calls (clock, RTC, Wi-Fi, display). As with lwIP, a QoS 1 message
+// holds a request slot and its bytes in the TCP send buffer until its PUBACK, and a lost
+// connection drops the pending requests without calling their callbacks.
+
+#define FAKE_BROKER_MAX_MESSAGES 512
+
+/**
+ * @brief Message received by the broker.
+ */
+
+typedef struct {
+    char topic[32];
+    uint8_t payload[MQTT_BATCH_MAX_BYTES];
+    uint16_t length;
+    uint64_t sent_us;           ///< Virtual time of the publish
+    uint32_t connection;        ///< Connection that carried it (1 for the first one)
+    bool pending;               ///< Waiting for its PUBACK
+    mqtt_request_cb_t cb;
+    void *arg;
+} fake_broker_message_t;
+
+/**
+ * @brief Empties the broker, disconnects the client and resets the counters.
+ *
+ * The broker then accepts connections, the Wi-Fi is up and the RTC is set. The clock
+ * keeps running (the firmware never sees the time go back).
+ */
+void fake_broker_reset(void);
+
+/**
+ * @brief Drops the connection: the pending PUBACKs never come and the client is told.
+ */
+void fake_broker_disconnect(void);
+
+/**
+ * @brief Acknowledges the oldest pending messages (PUBACK, callback with ERR_OK).
+ *
+ * @return Number of messages acknowledged (up to count).
+ */
+uint32_t fake_broker_ack(uint32_t count);
+
+/**
+ * @brief Lets the oldest pending messages time out (callback with ERR_TIMEOUT).
+ *
+ * @return Number of messages failed (up to count).
+ */
+uint32_t fake_broker_timeout(uint32_t count);
+
+/**
+ * @brief Returns the number of messages waiting for their PUBACK.
+ */
+uint32_t fake_broker_pending(void);
+
+/**
+ * @brief Returns the number of messages received since the reset.
+ */
+uint32_t fake_broker_count(void);
+
+/**
+ * @brief Returns a message received since the reset (0 is the first one).
+ */
+const fake_broker_message_t *fake_broker_message(uint32_t index);
+
+extern uint64_t fake_now_us;                // Virtual clock returned by time_us_64()
+extern datetime_t fake_rtc;                 // Time returned by rtc_get_datetime()
+extern bool fake_wifi_up;                   // Returned by is_wifi_connected()
+extern bool fake_broker_online;             // The broker accepts new connections
+extern uint32_t fake_broker_unlocked;       // lwIP calls made outside cyw43_arch_lwip_begin/end
+
+#endif
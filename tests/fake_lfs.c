@@ -0,0 +1,285 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lfs.h"
+#include "pico_lfs.h"
+#include "fake_lfs.h"
+
+/**
+ * @brief Committed files of the filesystem.
+ */
+
+static struct {
+    bool used;
+    char name[LFS_NAME_MAX + 1];
+    uint8_t *data;
+    uint32_t size;
+} files[FAKE_LFS_MAX_FILES];
+
+static struct pico_lfs_context context;
+static uint32_t crash_countdown;        // Write calls left before the power loss (0 = none armed)
+static fake_lfs_crash_t crash_mode;
+static bool powered_off;
+
+uint32_t fake_lfs_bytes_written;
+uint32_t fake_lfs_commits;
+
+static int find_file(const char *name) {
+    for (int i = 0; i < FAKE_LFS_MAX_FILES; i++) {
+        if (files[i].used && strcmp(files[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int new_file(const char *name) {
+    for (int i = 0; i < FAKE_LFS_MAX_FILES; i++) {
+        if (!files[i].used) {
+            files[i].used = true;
+            strncpy(files[i].name, name, LFS_NAME_MAX);
+            files[i].name[LFS_NAME_MAX] = '\0';
+            files[i].data = NULL;
+            files[i].size = 0;
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void commit(int index, uint8_t *data, uint32_t size) {
+    free(files[index].data);
+    files[index].data = data;
+    files[index].size = size;
+    fake_lfs_bytes_written += size;
+    fake_lfs_commits++;
+}
+
+void fake_lfs_reset(void) {
+    for (int i = 0; i < FAKE_LFS_MAX_FILES; i++) {
+        free(files[i].data);
+        files[i].used = false;
+        files[i].data = NULL;
+    }
+    crash_countdown = 0;
+    powered_off = false;
+    fake_lfs_bytes_written = 0;
+    fake_lfs_commits = 0;
+}
+
+bool fake_lfs_create(const char *name, const void *data, uint32_t size) {
+    int index = find_file(name);
+    if (index < 0 && (index = new_file(name)) < 0) {
+        return false;
+    }
+
+    uint8_t *copy = malloc(size ? size : 1);
+    memcpy(copy, data, size);
+    commit(index, copy, size);
+    return true;
+}
+
+int32_t fake_lfs_size(const char *name) {
+    int index = find_file(name);
+    return (index < 0) ? -1 : (int32_t)files[index].size;
+}
+
+uint32_t fake_lfs_count(const char *suffix) {
+    size_t suffix_length = strlen(suffix);
+    uint32_t count = 0;
+
+    for (int i = 0; i < FAKE_LFS_MAX_FILES; i++) {
+        size_t length = strlen(files[i].name);
+        if (files[i].used && length >= suffix_length && strcmp(files[i].name + length - suffix_length, suffix) == 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool fake_lfs_flip_bit(const char *name, uint32_t bit) {
+    int index = find_file(name);
+    if (index < 0 || bit / 8 >= files[index].size) {
+        return false;
+    }
+    files[index].data[bit / 8] ^= (uint8_t)(1u << (bit % 8));
+    return true;
+}
+
+void fake_lfs_crash_after_writes(uint32_t writes, fake_lfs_crash_t mode) {
+    crash_countdown = writes + 1;
+    crash_mode = mode;
+}
+
+void fake_lfs_power_on(void) {
+    crash_countdown = 0;
+    powered_off = false;
+}
+
+struct lfs_config *pico_lfs_init(uint32_t offset, uint32_t size) {
+    (void)offset;
+    context.cfg.block_size = 4096;
+    context.cfg.block_count = size / 4096;
+    return &context.cfg;
+}
+
+int lfs_format(lfs_t *lfs, const struct lfs_config *config) {
+    (void)lfs;
+    (void)config;
+    fake_lfs_reset();
+    return LFS_ERR_OK;
+}
+
+int lfs_mount(lfs_t *lfs, const struct lfs_config *config) {
+    (void)config;
+    lfs->mounted = 1;
+    return LFS_ERR_OK;
+}
+
+int lfs_remove(lfs_t *lfs, const char *path) {
+    (void)lfs;
+    int index = find_file(path);
+
+    if (powered_off) {
+        return LFS_ERR_IO;
+    }
+    if (index < 0) {
+        return LFS_ERR_NOENT;
+    }
+    free(files[index].data);
+    files[index].used = false;
+    files[index].data = NULL;
+    return LFS_ERR_OK;
+}
+
+int lfs_file_open(lfs_t *lfs, lfs_file_t *file, const char *path, int flags) {
+    (void)lfs;
+    int index = find_file(path);
+
+    if (powered_off) {
+        return LFS_ERR_IO;
+    }
+    if (index < 0) {
+        if (!(flags & LFS_O_CREAT) || (index = new_file(path)) < 0) {
+            return (flags & LFS_O_CREAT) ? LFS_ERR_NOSPC : LFS_ERR_NOENT;
+        }
+        fake_lfs_commits++;                         // The empty file is created right away
+    }
+
+    file->file = index;
+    file->flags = flags;
+    file->data = NULL;
+    file->size = 0;
+    file->position = 0;
+
+    if ((flags & LFS_O_WRONLY) && !(flags & LFS_O_TRUNC) && files[index].size > 0) {
+        file->data = malloc(files[index].size);
+        memcpy(file->data, files[index].data, files[index].size);
+        file->size = files[index].size;
+    }
+    return LFS_ERR_OK;
+}
+
+int lfs_file_close(lfs_t *lfs, lfs_file_t *file) {
+    (void)lfs;
+
+    if (!(file->flags & LFS_O_WRONLY)) {
+        return powered_off ? LFS_ERR_IO : LFS_ERR_OK;
+    }
+    if (powered_off && crash_mode == FAKE_LFS_CRASH_ATOMIC) {
+        free(file->data);                           // Never committed: the previous content stays
+        return LFS_ERR_IO;
+    }
+
+    commit(file->file, file->data ? file->data : malloc(1), file->size);
+    return powered_off ? LFS_ERR_IO : LFS_ERR_OK;
+}
+
+lfs_ssize_t lfs_file_read(lfs_t *lfs, lfs_file_t *file, void *buffer, lfs_size_t size) {
+    (void)lfs;
+
+    if (powered_off) {
+        return LFS_ERR_IO;
+    }
+
+    uint32_t available = files[file->file].size - file->position;
+    if (size > available) {
+        size = available;
+    }
+    memcpy(buffer, files[file->file].data + file->position, size);
+    file->position += size;
+    return (lfs_ssize_t)size;
+}
+
+lfs_ssize_t lfs_file_write(lfs_t *lfs, lfs_file_t *file, const void *buffer, lfs_size_t size) {
+    (void)lfs;
+
+    if (powered_off) {
+        return LFS_ERR_IO;
+    }
+
+    lfs_size_t written = size;
+    if (crash_countdown > 0 && --crash_countdown == 0) {
+        powered_off = true;
+        written = size / 2;                         // Cut in the middle of the write
+    }
+
+    if (file->position + written > file->size) {
+        file->data = realloc(file->data, file->position + written);
+        file->size = file->position + written;
+    }
+    memcpy(file->data + file->position, buffer, written);
+    file->position += written;
+
+    return powered_off ? LFS_ERR_IO : (lfs_ssize_t)size;
+}
+
+int lfs_dir_open(lfs_t *lfs, lfs_dir_t *dir, const char *path) {
+    (void)path;
+    return powered_off ? LFS_ERR_IO : lfs_dir_rewind(lfs, dir);
+}
+
+int lfs_dir_close(lfs_t *lfs, lfs_dir_t *dir) {
+    (void)lfs;
+    (void)dir;
+    return LFS_ERR_OK;
+}
+
+int lfs_dir_read(lfs_t *lfs, lfs_dir_t *dir, struct lfs_info *info) {
+    (void)lfs;
+
+    if (powered_off) {
+        return LFS_ERR_IO;
+    }
+    if (dir->position < 2) {
+        info->type = LFS_TYPE_DIR;
+        info->size = 0;
+        strcpy(info->name, dir->position == 0 ? "." : "..");
+        dir->position++;
+        return 1;
+    }
+
+    int next = -1;
+    for (int i = 0; i < FAKE_LFS_MAX_FILES; i++) {
+        if (files[i].used && strcmp(files[i].name, dir->last) > 0 &&
+            (next < 0 || strcmp(files[i].name, files[next].name) < 0)) {
+            next = i;
+        }
+    }
+    if (next < 0) {
+        return 0;
+    }
+
+    info->type = LFS_TYPE_REG;
+    info->size = files[next].size;
+    strcpy(info->name, files[next].name);
+    strcpy(dir->last, files[next].name);
+    dir->position++;
+    return 1;
+}
+
+int lfs_dir_rewind(lfs_t *lfs, lfs_dir_t *dir) {
+    (void)lfs;
+    dir->position = 0;
+    dir->last[0] = '\0';
+    return LFS_ERR_OK;
+}
@@ -0,0 +1,64 @@
+#ifndef FAKE_LFS_H
+#define FAKE_LFS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// In-memory LittleFS for the host tests. As on LittleFS, a file written is only
+// committed when it is closed, and the directory lists "." and ".." then the files
+// sorted by name.
+
+#define FAKE_LFS_MAX_FILES 256
+
+/**
+ * @brief What a power loss during a write leaves in the file.
+ */
+
+typedef enum {
+    FAKE_LFS_CRASH_ATOMIC,      ///< The previous content (copy-on-write commit of LittleFS)
+    FAKE_LFS_CRASH_TORN,        ///< The bytes written up to the crash (filesystem without atomic commit)
+} fake_lfs_crash_t;
+
+/**
+ * @brief Empties the filesystem and clears the fault injection and the counters.
+ */
+void fake_lfs_reset(void);
+
+/**
+ * @brief Creates (or replaces) a committed file.
+ */
+bool fake_lfs_create(const char *name, const void *data, uint32_t size);
+
+/**
+ * @brief Returns the size of a committed file, or -1 if it does not exist.
+ */
+int32_t fake_lfs_size(const char *name);
+
+/**
+ * @brief Counts the committed files whose name ends with suffix.
+ */
+uint32_t fake_lfs_count(const char *suffix);
+
+/**
+ * @brief Inverts one bit of a committed file (flash damage).
+ */
+bool fake_lfs_flip_bit(const char *name, uint32_t bit);
+
+/**
+ * @brief Cuts the power after the given number of further write calls.
+ *
+ * The write that reaches the count and everything after it fail, until
+ * fake_lfs_power_on(); the file being written is left as given by mode.
+ */
+void fake_lfs_crash_after_writes(uint32_t writes, fake_lfs_crash_t mode);
+
+/**
+ * @brief Restores the power after a crash (the filesystem is mounted again).
+ */
+void fake_lfs_power_on(void);
+
+extern uint32_t fake_lfs_bytes_written;     // Bytes committed since the reset (flash wear)
+extern uint32_t fake_lfs_commits;           // Files committed since the reset
+
+#endif
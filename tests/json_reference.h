@@ -0,0 +1,81 @@
+#ifndef JSON_REFERENCE_H
+#define JSON_REFERENCE_H
+
+// The JSON record formatter of the firmware before the static prefix and the integer
+// digit emission: every field through vsnprintf, the levels through snprintf("%lu.%0*lu").
+// Reference of the payload tests; include it after src/mqtt.c (it uses its helpers).
+
+static void reference_append_fixed(char *payload, size_t size, size_t *len, int32_t value, uint8_t decimals) {
+    static const uint32_t scale[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+    uint32_t magnitude = (value < 0) ? (uint32_t)0 - (uint32_t)value : (uint32_t)value;
+
+    if (*len >= size) {
+        return;
+    }
+
+    int written = snprintf(payload + *len, size - *len, "%s%lu.%0*lu", (value < 0) ? "-" : "",
+                           (unsigned long)(magnitude / scale[decimals]), decimals,
+                           (unsigned long)(magnitude % scale[decimals]));
+    if (written > 0) {
+        *len += (size_t)written;
+    }
+}
+
+// Hour shifted in place, as the old formatter did: wrong between 00:00 and 02:59 UTC
+static void reference_format_timestamp(const datetime_t *time, char *timestamp, size_t size) {
+    datetime_t now = *time;
+
+    snprintf(timestamp, size, "%04d-%02d-%02d %02d:%02d:%02d",
+             now.year, now.month, now.day, now.hour -= GMT_M_3, now.min, now.sec);
+}
+
+static size_t reference_format_payload(const publish_record_t *record, char *payload, size_t size) {
+    static const char *const level_keys[] = { "avgdB", "mindB", "maxdB", "leq", "l10", "l50", "l90", "l95" };
+    const int16_t levels[] = { record->mean_cdB, record->min_cdB, record->max_cdB, record->leq_cdB,
+                               record->l10_cdB, record->l50_cdB, record->l90_cdB, record->l95_cdB };
+    char timestamp[32];
+    size_t len = 0;
+
+    reference_format_timestamp(&record->time, timestamp, sizeof(timestamp));
+
+    payload_append(payload, size, &len, "{\"id\":\"%d\", \"window\":%lu",
+                   record->config->sensor_id, (unsigned long)record->window_s);
+
+    for (uint8_t i = 0; i < count_of(level_keys); i++) {
+        payload_append(payload, size, &len, ", \"%s\":\"", level_keys[i]);
+        reference_append_fixed(payload, size, &len, levels[i], 2);
+        payload_append(payload, size, &len, "\"");
+    }
+
+    payload_append(payload, size, &len, ", \"latitude\":");
+    reference_append_fixed(payload, size, &len, record->config->latitude_e6, 6);
+    payload_append(payload, size, &len, ", \"longitude\":");
+    reference_append_fixed(payload, size, &len, record->config->longitude_e6, 6);
+
+    payload_append(payload, size, &len, ", \"dose\":\"");
+    reference_append_fixed(payload, size, &len, (int32_t)(record->dose_percent_c > INT32_MAX ? INT32_MAX : record->dose_percent_c), 2);
+    payload_append(payload, size, &len, "\", \"twa\":\"");
+    reference_append_fixed(payload, size, &len, record->twa_cdB, 2);
+    payload_append(payload, size, &len, "\"");
+
+    if (record->window_s == 24 * 60 * 60) {
+        payload_append(payload, size, &len, ", \"lden\":\"");
+        reference_append_fixed(payload, size, &len, record->lden_cdB, 2);
+        payload_append(payload, size, &len, "\"");
+    }
+
+    if (record->band_count > 0) {
+        payload_append(payload, size, &len, ", \"bands\":{");
+        for (uint8_t b = 0; b < record->band_count; b++) {
+            payload_append(payload, size, &len, "%s\"%u\":", b ? "," : "", spectrum_band_nominal_hz(record->first_band + b));
+            reference_append_fixed(payload, size, &len, record->band_cdB[b], 2);
+        }
+        payload_append(payload, size, &len, "}");
+    }
+
+    payload_append(payload, size, &len, ", \"timestamp\":\"%s\"}", timestamp);
+
+    return (len < size) ? len : size - 1;
+}
+
+#endif
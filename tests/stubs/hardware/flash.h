@@ -0,0 +1,12 @@
+#ifndef HOST_HARDWARE_FLASH_H
+#define HOST_HARDWARE_FLASH_H
+
+// Host stand-in for the Pico SDK hardware/flash.h: the flash is only reached through
+// LittleFS (tests/fake_lfs.c).
+
+#include "pico/stdlib.h"
+
+#define FLASH_SECTOR_SIZE 4096
+#define FLASH_PAGE_SIZE 256
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef HOST_HARDWARE_I2C_H
+#define HOST_HARDWARE_I2C_H
+
+// Host stand-in for the Pico SDK hardware/i2c.h (only the types reach the modules under test).
+
+#include "pico/stdlib.h"
+
+typedef struct i2c_inst i2c_inst_t;
+
+#endif
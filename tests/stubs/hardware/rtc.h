@@ -0,0 +1,21 @@
+#ifndef HOST_HARDWARE_RTC_H
+#define HOST_HARDWARE_RTC_H
+
+// Host stand-in for the Pico SDK hardware/rtc.h (only the date type is used).
+
+#include "pico/stdlib.h"
+
+typedef struct {
+    int16_t year;
+    int8_t month;
+    int8_t day;
+    int8_t dotw;
+    int8_t hour;
+    int8_t min;
+    int8_t sec;
+} datetime_t;
+
+bool rtc_get_datetime(datetime_t *t);
+bool rtc_set_datetime(const datetime_t *t);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef HOST_HARDWARE_SYNC_H
+#define HOST_HARDWARE_SYNC_H
+
+// Host stand-in for the Pico SDK hardware/sync.h: the two cores become two threads,
+// the barriers become C11 fences and the hardware spinlock a test-and-set flag.
+
+#include <stdint.h>
+
+typedef volatile uint32_t spin_lock_t;
+
+static inline void __mem_fence_acquire(void) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
+static inline void __mem_fence_release(void) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline uint32_t spin_lock_blocking(spin_lock_t *lock) {
+    while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+    }
+    return 0;   // No interrupts to restore on the host
+}
+
+static inline void spin_unlock(spin_lock_t *lock, uint32_t saved_irq) {
+    (void)saved_irq;
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef HOST_HARDWARE_UART_H
+#define HOST_HARDWARE_UART_H
+
+// Host stand-in for the Pico SDK hardware/uart.h (only the types reach the modules under test).
+
+#include "pico/stdlib.h"
+
+typedef struct uart_inst uart_inst_t;
+
+#endif
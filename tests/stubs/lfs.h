@@ -0,0 +1,79 @@
+#ifndef HOST_LFS_H
+#define HOST_LFS_H
+
+// Host stand-in for the LittleFS API used by the firmware. The implementation is the
+// in-memory filesystem of tests/fake_lfs.c.
+
+#include <stdint.h>
+
+#define LFS_NAME_MAX 255
+
+typedef int32_t lfs_ssize_t;
+typedef uint32_t lfs_size_t;
+
+enum lfs_error {
+    LFS_ERR_OK = 0,
+    LFS_ERR_IO = -5,
+    LFS_ERR_NOENT = -2,
+    LFS_ERR_NOSPC = -28,
+    LFS_ERR_INVAL = -22,
+};
+
+enum lfs_type {
+    LFS_TYPE_REG = 0x001,
+    LFS_TYPE_DIR = 0x002,
+};
+
+enum lfs_open_flags {
+    LFS_O_RDONLY = 1,
+    LFS_O_WRONLY = 2,
+    LFS_O_RDWR = 3,
+    LFS_O_CREAT = 0x0100,
+    LFS_O_EXCL = 0x0200,
+    LFS_O_TRUNC = 0x0400,
+    LFS_O_APPEND = 0x0800,
+};
+
+struct lfs_config {
+    lfs_size_t block_size;
+    lfs_size_t block_count;
+};
+
+struct lfs_info {
+    uint8_t type;
+    lfs_size_t size;
+    char name[LFS_NAME_MAX + 1];
+};
+
+typedef struct {
+    int mounted;
+} lfs_t;
+
+typedef struct {
+    int position;                   // Entries already returned ("." and ".." first)
+    char last[LFS_NAME_MAX + 1];    // Name of the last file returned (the walk survives removals)
+} lfs_dir_t;
+
+typedef struct {
+    int file;                       // Index of the file in the filesystem
+    int flags;
+    uint8_t *data;                  // Content being written (committed on close, as LittleFS does)
+    lfs_size_t size;
+    lfs_size_t position;
+} lfs_file_t;
+
+int lfs_format(lfs_t *lfs, const struct lfs_config *config);
+int lfs_mount(lfs_t *lfs, const struct lfs_config *config);
+int lfs_remove(lfs_t *lfs, const char *path);
+
+int lfs_file_open(lfs_t *lfs, lfs_file_t *file, const char *path, int flags);
+int lfs_file_close(lfs_t *lfs, lfs_file_t *file);
+lfs_ssize_t lfs_file_read(lfs_t *lfs, lfs_file_t *file, void *buffer, lfs_size_t size);
+lfs_ssize_t lfs_file_write(lfs_t *lfs, lfs_file_t *file, const void *buffer, lfs_size_t size);
+
+int lfs_dir_open(lfs_t *lfs, lfs_dir_t *dir, const char *path);
+int lfs_dir_close(lfs_t *lfs, lfs_dir_t *dir);
+int lfs_dir_read(lfs_t *lfs, lfs_dir_t *dir, struct lfs_info *info);
+int lfs_dir_rewind(lfs_t *lfs, lfs_dir_t *dir);
+
+#endif
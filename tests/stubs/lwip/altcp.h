@@ -0,0 +1,12 @@
+#ifndef HOST_LWIP_ALTCP_H
+#define HOST_LWIP_ALTCP_H
+
+// Host stand-in for lwIP lwip/altcp.h (only the send buffer query is used).
+
+#include <stdint.h>
+
+struct altcp_pcb;
+
+uint16_t altcp_sndbuf(struct altcp_pcb *conn);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef HOST_LWIP_APPS_MQTT_H
+#define HOST_LWIP_APPS_MQTT_H
+
+// Host stand-in for the lwIP MQTT client API. The tests that drive the publisher
+// implement these functions with a simulated broker.
+
+#include <stdint.h>
+#include "lwipopts.h"                 // As lwip/opt.h: the lwIP and MQTT client settings of the firmware
+#include "lwip/err.h"
+#include "lwip/ip_addr.h"
+
+typedef struct mqtt_client_s mqtt_client_t;
+
+typedef enum {
+    MQTT_CONNECT_ACCEPTED = 0,
+    MQTT_CONNECT_DISCONNECTED = 256,
+} mqtt_connection_status_t;
+
+typedef void (*mqtt_connection_cb_t)(mqtt_client_t *client, void *arg, mqtt_connection_status_t status);
+typedef void (*mqtt_request_cb_t)(void *arg, err_t err);
+
+struct mqtt_connect_client_info_t {
+    const char *client_id;
+    const char *client_user;
+    const char *client_pass;
+    uint16_t keep_alive;
+};
+
+#define MQTT_PORT 1883
+
+mqtt_client_t *mqtt_client_new(void);
+err_t mqtt_client_connect(mqtt_client_t *client, const ip_addr_t *ipaddr, uint16_t port, mqtt_connection_cb_t cb,
+                          void *arg, const struct mqtt_connect_client_info_t *client_info);
+uint8_t mqtt_client_is_connected(mqtt_client_t *client);
+err_t mqtt_publish(mqtt_client_t *client, const char *topic, const void *payload, uint16_t payload_length,
+                   uint8_t qos, uint8_t retain, mqtt_request_cb_t cb, void *arg);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef HOST_LWIP_APPS_MQTT_PRIV_H
+#define HOST_LWIP_APPS_MQTT_PRIV_H
+
+// Host stand-in for lwIP lwip/apps/mqtt_priv.h (the TCP connection of the client).
+
+#include "lwip/apps/mqtt.h"
+
+struct altcp_pcb;
+
+struct mqtt_client_s {
+    struct altcp_pcb *conn;
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef HOST_LWIP_ERR_H
+#define HOST_LWIP_ERR_H
+
+// Host stand-in for lwIP lwip/err.h.
+
+typedef signed char err_t;
+
+#define ERR_OK 0
+#define ERR_MEM -1
+#define ERR_BUF -2
+#define ERR_TIMEOUT -3
+#define ERR_INPROGRESS -5
+#define ERR_ISCONN -10
+#define ERR_CONN -11
+
+#define LWIP_UNUSED_ARG(x) (void)x
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef HOST_LWIP_IP_ADDR_H
+#define HOST_LWIP_IP_ADDR_H
+
+// Host stand-in for lwIP lwip/ip_addr.h (IPv4 only).
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t addr;
+} ip_addr_t;
+
+#define ip_addr_copy(dest, src) ((dest) = (src))
+
+char *ipaddr_ntoa(const ip_addr_t *addr);
+int ipaddr_aton(const char *cp, ip_addr_t *addr);
+
+#endif
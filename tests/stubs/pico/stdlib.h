@@ -0,0 +1,24 @@
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+// Host stand-in for the Pico SDK pico/stdlib.h: the C library and the board constants
+// the firmware modules under test rely on.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+// Time since boot, provided by each test (usually a virtual clock)
+uint64_t time_us_64(void);
+void sleep_ms(uint32_t ms);
+
+#endif
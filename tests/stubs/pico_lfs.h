@@ -0,0 +1,15 @@
+#ifndef HOST_PICO_LFS_H
+#define HOST_PICO_LFS_H
+
+// Host stand-in for the pico_lfs flash driver of LittleFS (see tests/fake_lfs.c).
+
+#include "lfs.h"
+
+struct pico_lfs_context {
+    struct lfs_config cfg;          // First member: the context is used as the configuration
+    int multicore_lockout_enabled;
+};
+
+struct lfs_config *pico_lfs_init(uint32_t offset, uint32_t size);
+
+#endif
@@ -0,0 +1,91 @@
+#include <math.h>
+#include <stdlib.h>
+#include "test_common.h"
+#include "inc/audio_dsp.h"
+#include "inc/config.h"
+
+#define ADC_MID 2048        // Mid-scale of the 12-bit ADC
+#define BENCH_BLOCKS 64     // Blocks per benchmark run
+
+static uint16_t samples[BENCH_BLOCKS * MIC_BLOCK_SIZE];
+
+/**
+ * @brief Straightforward 64-bit sum of squares (reference of the chunked kernel).
+ */
+
+static uint64_t reference_sum_squares(const uint16_t *x, uint32_t count, int32_t offset) {
+    uint64_t total = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        int64_t value = (int64_t)x[i] - offset;
+        total += (uint64_t)(value * value);
+    }
+    return total;
+}
+
+/**
+ * @brief Fills the buffer with a tone plus noise around mid-scale.
+ */
+
+static void fill_tone(uint16_t *x, uint32_t count, double amplitude) {
+    for (uint32_t i = 0; i < count; i++) {
+        double v = ADC_MID + amplitude * sin(2 * M_PI * 1000.0 * i / MIC_SAMPLE_RATE_HZ) + (rand() % 9 - 4);
+        x[i] = (uint16_t)(v < 0 ? 0 : (v > 4095 ? 4095 : v));
+    }
+}
+
+static void test_kernels(void) {
+    // Chunk boundaries and extremes: the 32-bit partial sums must never wrap
+    static const uint32_t counts[] = { 0, 1, 255, 256, 511, 512, 513, 1024, 1537, BENCH_BLOCKS * MIC_BLOCK_SIZE };
+
+    for (uint8_t fill = 0; fill < 3; fill++) {
+        for (uint32_t i = 0; i < BENCH_BLOCKS * MIC_BLOCK_SIZE; i++) {
+            samples[i] = (fill == 0) ? 4095 : (fill == 1) ? 0 : (uint16_t)(rand() & 0xFFF);
+        }
+        for (uint8_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+            CHECK_EQ(audio_block_sum_squares(samples, counts[c], ADC_MID),
+                     reference_sum_squares(samples, counts[c], ADC_MID));
+        }
+    }
+
+    // The float reference agrees with the integer sum (relative to float precision)
+    fill_tone(samples, MIC_BLOCK_SIZE, 600.0);
+    double rms = sqrt((double)audio_block_sum_squares(samples, MIC_BLOCK_SIZE, ADC_MID) / MIC_BLOCK_SIZE);
+    CHECK(fabs(audio_block_rms(samples, MIC_BLOCK_SIZE, ADC_MID) - rms) < 1e-4 * rms);
+    CHECK(fabs(rms - 600.0 / sqrt(2.0)) < 5.0);
+}
+
+/**
+ * @brief Cost of the block kernels, per sample and as a share of the real-time budget.
+ */
+
+static void bench_kernels(void) {
+    uint64_t integer, floating;
+    const uint32_t count = BENCH_BLOCKS * MIC_BLOCK_SIZE;
+
+    fill_tone(samples, count, 600.0);
+
+    BENCH_BEST(integer, 50, {
+        for (uint32_t b = 0; b < BENCH_BLOCKS; b++) {
+            bench_sink += (uint32_t)audio_block_sum_squares(samples + b * MIC_BLOCK_SIZE, MIC_BLOCK_SIZE, ADC_MID);
+        }
+    });
+    BENCH_BEST(floating, 50, {
+        for (uint32_t b = 0; b < BENCH_BLOCKS; b++) {
+            bench_sink += (uint32_t)audio_block_rms(samples + b * MIC_BLOCK_SIZE, MIC_BLOCK_SIZE, ADC_MID);
+        }
+    });
+
+    printf("soma de quadrados inteira: %.2f %s/amostra, %.0f %s/bloco\n", (double)integer / count, BENCH_UNIT,
+           (double)integer / BENCH_BLOCKS, BENCH_UNIT);
+    printf("RMS em float:              %.2f %s/amostra, %.0f %s/bloco\n", (double)floating / count, BENCH_UNIT,
+           (double)floating / BENCH_BLOCKS, BENCH_UNIT);
+    printf("%.1f blocos/s a %u Hz\n", (double)MIC_SAMPLE_RATE_HZ / MIC_BLOCK_SIZE, MIC_SAMPLE_RATE_HZ);
+}
+
+int main(void) {
+    srand(7);
+    test_kernels();
+    bench_kernels();
+    return test_result("test_audio_dsp");
+}
@@ -0,0 +1,336 @@
+#define MQTT_PAYLOAD_CBOR 1     // Builds the CBOR encoder along with the JSON formatter
+#include "src/mqtt.c"           // The record formatters are static
+#include <stdlib.h>
+#include <time.h>
+#include "test_common.h"
+#include "fake_broker.h"
+#include "json_reference.h"
+
+#define RANDOM_RECORDS 5000     // Records of the round-trip check
+#define BENCH_RECORDS 1000      // Records formatted per benchmark run
+
+static const sensor_config_t configs[] = {
+    { .sensor_id = 1, .latitude_e6 = -3743987, .longitude_e6 = -38536267 },
+    { .sensor_id = 42, .latitude_e6 = 5000001, .longitude_e6 = -123 },
+    { .sensor_id = 200, .latitude_e6 = -90000000, .longitude_e6 = 180000000 },
+};
+
+/**
+ * @brief Reader of the reference decoder (RFC 8949, independent of src/cbor.c).
+ */
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool error;
+} cbor_reader_t;
+
+/**
+ * @brief Record as decoded from its CBOR map.
+ */
+
+typedef struct {
+    bool present[PUBLISH_KEY_BANDS + 1];
+    int64_t value[PUBLISH_KEY_BANDS + 1];
+    int64_t bands[1 + SPECTRUM_MAX_BANDS];  ///< First band number, then the band levels
+    uint32_t band_items;
+} decoded_record_t;
+
+static uint32_t random_state = 12345;
+
+static uint32_t random_next(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static void random_record(publish_record_t *record) {
+    static const uint32_t windows[] = { 60, 900, 3600, 24 * 60 * 60 };
+    int16_t *levels[] = { &record->mean_cdB, &record->min_cdB, &record->max_cdB, &record->leq_cdB, &record->l10_cdB,
+                          &record->l50_cdB, &record->l90_cdB, &record->l95_cdB, &record->twa_cdB, &record->lden_cdB };
+
+    memset(record, 0, sizeof(*record));
+    record->config = &configs[random_next() % count_of(configs)];
+    record->window_s = windows[random_next() % count_of(windows)];
+    for (uint8_t i = 0; i < count_of(levels); i++) {
+        *levels[i] = (random_next() % 4 == 0) ? (int16_t)random_next() : (int16_t)(3000 + random_next() % 9000);
+    }
+    record->dose_percent_c = (random_next() % 10 == 0) ? UINT32_MAX : random_next() % 500000;
+    if (random_next() % 3 == 0) {
+        record->band_count = (uint8_t)(1 + random_next() % SPECTRUM_MAX_BANDS);
+        record->first_band = (int8_t)-(int)(random_next() % 18);
+        for (uint8_t b = 0; b < record->band_count; b++) {
+            record->band_cdB[b] = (int16_t)(random_next() % 12000) - 1000;
+        }
+    }
+    record->time = (datetime_t){ .year = (int16_t)(2020 + random_next() % 80), .month = (int8_t)(1 + random_next() % 12),
+                                 .day = (int8_t)(1 + random_next() % 28), .hour = (int8_t)(random_next() % 24),
+                                 .min = (int8_t)(random_next() % 60), .sec = (int8_t)(random_next() % 60) };
+}
+
+/**
+ * @brief Reads the head of an item; only the shortest (preferred) forms are accepted.
+ */
+
+static bool read_head(cbor_reader_t *reader, uint8_t *major, uint64_t *value) {
+    if (reader->error || reader->p >= reader->end) {
+        reader->error = true;
+        return false;
+    }
+
+    uint8_t initial = *reader->p++;
+    uint8_t info = initial & 0x1F;
+    *major = initial >> 5;
+
+    if (info < 24) {
+        *value = info;
+        return true;
+    }
+    if (info > 27 || reader->end - reader->p < (1 << (info - 24))) {
+        reader->error = true;                   // Indefinite lengths, reserved values or truncated argument
+        return false;
+    }
+
+    uint8_t bytes = (uint8_t)(1 << (info - 24));
+    *value = 0;
+    for (uint8_t i = 0; i < bytes; i++) {
+        *value = *value << 8 | *reader->p++;
+    }
+    if (*value < ((bytes == 1) ? 24 : 1ULL << (4 * bytes))) {
+        reader->error = true;                   // Fits a shorter head
+        return false;
+    }
+    return true;
+}
+
+static int64_t read_int(cbor_reader_t *reader) {
+    uint8_t major;
+    uint64_t value;
+
+    if (!read_head(reader, &major, &value) || major > 1 || value > INT64_MAX) {
+        reader->error = true;
+        return 0;
+    }
+    return (major == 0) ? (int64_t)value : -1 - (int64_t)value;
+}
+
+/**
+ * @brief Decodes one record: a map with ascending integer keys of publish_key_t.
+ */
+
+static bool decode_record(cbor_reader_t *reader, decoded_record_t *decoded) {
+    uint8_t major;
+    uint64_t pairs, key, value;
+    int64_t previous = -1;
+
+    memset(decoded, 0, sizeof(*decoded));
+    if (!read_head(reader, &major, &pairs) || major != 5) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < pairs; i++) {
+        if (!read_head(reader, &major, &key) || major != 0 || (int64_t)key <= previous || key > PUBLISH_KEY_BANDS) {
+            return false;
+        }
+        previous = (int64_t)key;
+        decoded->present[key] = true;
+
+        if (key == PUBLISH_KEY_TIME) {
+            if (!read_head(reader, &major, &value) || major != 6 || value != CBOR_TAG_EPOCH) {
+                return false;
+            }
+        }
+        if (key == PUBLISH_KEY_BANDS) {
+            if (!read_head(reader, &major, &value) || major != 4 || value < 2 || value > 1 + SPECTRUM_MAX_BANDS) {
+                return false;
+            }
+            decoded->band_items = (uint32_t)value;
+            for (uint32_t b = 0; b < decoded->band_items; b++) {
+                decoded->bands[b] = read_int(reader);
+            }
+        } else {
+            decoded->value[key] = read_int(reader);
+        }
+    }
+    return !reader->error;
+}
+
+/**
+ * @brief Decodes a message: schema version, then an indefinite array of records.
+ *
+ * @return Number of records, or -1 if the message is malformed.
+ */
+
+static int decode_message(const uint8_t *message, size_t length, decoded_record_t *records, int max_records) {
+    cbor_reader_t reader = { message + 2, message + length, false };
+    int count = 0;
+
+    if (length < 3 || message[0] != PUBLISH_SCHEMA_VERSION || message[1] != CBOR_INDEFINITE_ARRAY) {
+        return -1;
+    }
+    while (reader.p < reader.end && *reader.p != CBOR_BREAK) {
+        if (count >= max_records || !decode_record(&reader, &records[count++])) {
+            return -1;
+        }
+    }
+    return (reader.p + 1 == reader.end) ? count : -1;   // The break ends the message
+}
+
+/**
+ * @brief Compares a decoded record with the record it was encoded from.
+ */
+
+static void check_record(const decoded_record_t *decoded, const publish_record_t *record) {
+    const int16_t levels[] = { record->mean_cdB, record->min_cdB, record->max_cdB, record->leq_cdB,
+                               record->l10_cdB, record->l50_cdB, record->l90_cdB, record->l95_cdB };
+    bool lden = record->window_s == 24 * 60 * 60;
+    struct tm time = { .tm_year = record->time.year - 1900, .tm_mon = record->time.month - 1, .tm_mday = record->time.day,
+                       .tm_hour = record->time.hour, .tm_min = record->time.min, .tm_sec = record->time.sec };
+
+    for (uint8_t key = PUBLISH_KEY_ID; key < PUBLISH_KEY_LDEN; key++) {
+        CHECK(decoded->present[key]);
+    }
+    CHECK_EQ(decoded->value[PUBLISH_KEY_ID], record->config->sensor_id);
+    CHECK_EQ(decoded->value[PUBLISH_KEY_TIME], (int64_t)timegm(&time));
+    CHECK_EQ(decoded->value[PUBLISH_KEY_WINDOW], record->window_s);
+    for (uint8_t i = 0; i < count_of(levels); i++) {
+        CHECK_EQ(decoded->value[PUBLISH_KEY_MEAN + i], levels[i]);
+    }
+    CHECK_EQ(decoded->value[PUBLISH_KEY_LATITUDE], record->config->latitude_e6);
+    CHECK_EQ(decoded->value[PUBLISH_KEY_LONGITUDE], record->config->longitude_e6);
+    CHECK_EQ(decoded->value[PUBLISH_KEY_DOSE], record->dose_percent_c);
+    CHECK_EQ(decoded->value[PUBLISH_KEY_TWA], record->twa_cdB);
+
+    CHECK_EQ(decoded->present[PUBLISH_KEY_LDEN], lden);
+    if (lden) {
+        CHECK_EQ(decoded->value[PUBLISH_KEY_LDEN], record->lden_cdB);
+    }
+
+    CHECK_EQ(decoded->present[PUBLISH_KEY_BANDS], record->band_count > 0);
+    if (record->band_count > 0) {
+        CHECK_EQ(decoded->band_items, 1u + record->band_count);
+        CHECK_EQ(decoded->bands[0], record->first_band);
+        for (uint8_t b = 0; b < record->band_count; b++) {
+            CHECK_EQ(decoded->bands[1 + b], record->band_cdB[b]);
+        }
+    }
+}
+
+/**
+ * @brief Random records decoded one by one and as a batch message, and the truncation.
+ */
+
+static void test_round_trip(void) {
+    static uint8_t message[MQTT_BATCH_MAX_BYTES];
+    static publish_record_t batch[MQTT_BATCH_MAX_RECORDS];
+    decoded_record_t decoded[MQTT_BATCH_MAX_RECORDS];
+    char payload[MQTT_PAYLOAD_SIZE], truncated[MQTT_PAYLOAD_SIZE];
+    size_t longest = 0;
+
+    for (uint32_t i = 0; i < RANDOM_RECORDS; i++) {
+        publish_record_t record;
+        random_record(&record);
+
+        size_t length = encode_payload_cbor(&record, payload, sizeof(payload));
+        cbor_reader_t reader = { (const uint8_t *)payload, (const uint8_t *)payload + length, false };
+        CHECK(decode_record(&reader, &decoded[0]));
+        CHECK(reader.p == reader.end);
+        check_record(&decoded[0], &record);
+        longest = (length > longest) ? length : longest;
+
+        // A short buffer gets the leading items that fit, never a partial one
+        size_t size = random_next() % length;
+        size_t cut = encode_payload_cbor(&record, truncated, size);
+        CHECK(cut <= size && memcmp(truncated, payload, cut) == 0);
+    }
+    printf("maior registro CBOR: %zu bytes (buffer de %d)\n", longest, MQTT_PAYLOAD_SIZE);
+
+    // A message of MQTT_BATCH_MAX_RECORDS records, framed as publish_batch_begin/finish do with MQTT_PAYLOAD_CBOR
+    for (uint32_t round = 0; round < 100; round++) {
+        size_t length = 2;
+        message[0] = PUBLISH_SCHEMA_VERSION;
+        message[1] = CBOR_INDEFINITE_ARRAY;
+        for (uint8_t n = 0; n < MQTT_BATCH_MAX_RECORDS; n++) {
+            random_record(&batch[n]);
+            batch[n].band_count = 0;            // Eight band records do not fit one message
+            length += encode_payload_cbor(&batch[n], (char *)message + length, sizeof(message) - length - 1);
+        }
+        message[length++] = CBOR_BREAK;
+
+        CHECK_EQ(decode_message(message, length, decoded, MQTT_BATCH_MAX_RECORDS), MQTT_BATCH_MAX_RECORDS);
+        for (uint8_t n = 0; n < MQTT_BATCH_MAX_RECORDS; n++) {
+            check_record(&decoded[n], &batch[n]);
+        }
+        CHECK_EQ(decode_message(message, length - 1, decoded, MQTT_BATCH_MAX_RECORDS), -1);   // No break
+    }
+
+    // Extremes of every field
+    publish_record_t record = { .config = &configs[2], .window_s = 24 * 60 * 60, .mean_cdB = INT16_MIN,
+                                .max_cdB = INT16_MAX, .min_cdB = -1, .leq_cdB = 23, .l10_cdB = 24, .l50_cdB = -24,
+                                .l90_cdB = -25, .l95_cdB = 256, .twa_cdB = -257, .lden_cdB = 65,
+                                .dose_percent_c = UINT32_MAX, .band_count = SPECTRUM_MAX_BANDS, .first_band = -17,
+                                .time = { .year = 2105, .month = 12, .day = 31, .hour = 23, .min = 59, .sec = 59 } };
+    for (uint8_t b = 0; b < SPECTRUM_MAX_BANDS; b++) {
+        record.band_cdB[b] = (int16_t)(b * 1000 - 15000);
+    }
+    size_t length = encode_payload_cbor(&record, payload, sizeof(payload));
+    cbor_reader_t reader = { (const uint8_t *)payload, (const uint8_t *)payload + length, false };
+    CHECK(decode_record(&reader, &decoded[0]));
+    check_record(&decoded[0], &record);
+}
+
+/**
+ * @brief Bytes and cost per record: snprintf JSON, integer JSON and CBOR.
+ */
+
+static void bench(void) {
+    static publish_record_t records[BENCH_RECORDS];
+    static char payload[MQTT_PAYLOAD_SIZE];
+
+    for (uint8_t bands = 0; bands < 2; bands++) {
+        uint64_t bytes[3] = { 0 }, cycles[3];
+
+        for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+            random_record(&records[i]);
+            records[i].window_s = 60;
+            records[i].band_count = bands ? SPECTRUM_MAX_BANDS : 0;
+            records[i].first_band = -17;
+            bytes[0] += reference_format_payload(&records[i], payload, sizeof(payload));
+            bytes[1] += format_payload(&records[i], payload, sizeof(payload));
+            bytes[2] += encode_payload_cbor(&records[i], payload, sizeof(payload));
+        }
+
+        BENCH_BEST(cycles[0], 10, {
+            for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+                bench_sink += (uint32_t)reference_format_payload(&records[i], payload, sizeof(payload));
+            }
+        });
+        BENCH_BEST(cycles[1], 10, {
+            for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+                bench_sink += (uint32_t)format_payload(&records[i], payload, sizeof(payload));
+            }
+        });
+        BENCH_BEST(cycles[2], 10, {
+            for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+                bench_sink += (uint32_t)encode_payload_cbor(&records[i], payload, sizeof(payload));
+            }
+        });
+
+        printf("registro %s: JSON snprintf %.0f bytes %.0f %s, JSON inteiro %.0f bytes %.0f %s, CBOR %.0f bytes %.0f %s\n",
+               bands ? "com 31 bandas" : "de 60 s",
+               (double)bytes[0] / BENCH_RECORDS, (double)cycles[0] / BENCH_RECORDS, BENCH_UNIT,
+               (double)bytes[1] / BENCH_RECORDS, (double)cycles[1] / BENCH_RECORDS, BENCH_UNIT,
+               (double)bytes[2] / BENCH_RECORDS, (double)cycles[2] / BENCH_RECORDS, BENCH_UNIT);
+        CHECK(bytes[2] * 2 < bytes[1]);
+    }
+}
+
+int main(void) {
+    fake_broker_reset();
+    mqtt_payload_init(configs, count_of(configs));
+
+    test_round_trip();
+    bench();
+    return test_result("test_cbor");
+}
@@ -0,0 +1,443 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test_common.h"
+#include "fake_lfs.h"
+#include "inc/checkpoint.h"
+#include "inc/flash.h"
+#include "inc/mqtt.h"
+#include "inc/rollup.h"
+#include "inc/noise_dose.h"
+
+#define SENSORS 2                   // Sensors of the checkpoint image
+#define PERIOD_LEVELS 3000          // Levels between two flash checkpoints (15 min at 300 ms)
+#define LEVEL_US 300000ULL
+#define PERIODS 400                 // Flash checkpoints of the simulation
+#define CODEC_ROUNDS 2000           // Random payloads of the codec test
+#define CODEC_WORDS 6000
+
+// Symbols of the publisher used by flash.c (the drain is not exercised here)
+publish_tracker_t publish_tracker;
+bool rtc_initialized;
+
+err_t mqtt_publish_batch(publish_batch_t *batch, const int *files) {
+    (void)batch;
+    (void)files;
+    return ERR_CONN;
+}
+
+/**
+ * @brief Aggregation state of one sensor, as checkpointed by main.c.
+ */
+
+typedef struct {
+    rollup_t rollup;
+    noise_dose_t dose;
+} sensor_state_t;
+
+#define IMAGE_WORDS (SENSORS * sizeof(sensor_state_t) / sizeof(uint32_t))
+
+static const char *const files[CHECKPOINT_SLOTS] = { CHECKPOINT_FILE_A, CHECKPOINT_FILE_B };
+static const noise_dose_params_t dose_params = { 8500, 300, 8000, 8 * 3600, 0, 2000000 };
+
+static sensor_state_t state[SENSORS];               // Live aggregation state
+static struct {
+    checkpoint_header_t header;
+    sensor_state_t sensors[SENSORS];
+} image;                                            // RAM image kept across soft resets
+static uint32_t flash_sequence;
+static uint32_t flash_crc;
+static bool rollup_pending;                         // Restored windows waiting for the local clock
+static bool synced = true;                          // The local clock is synchronized
+
+// What each flash copy must hold (the test model)
+static struct {
+    bool valid;
+    uint32_t sequence;
+    sensor_state_t sensors[SENSORS];
+} copies[CHECKPOINT_SLOTS];
+
+static uint64_t now_us;
+
+// Same step as the start of samples_task() of main.c
+
+static void resume_rollup(void) {
+    if (rollup_pending && synced) {
+        for (uint8_t s = 0; s < SENSORS; s++) {
+            state[s].rollup = image.sensors[s].rollup;
+        }
+        rollup_pending = false;
+    }
+}
+
+/**
+ * @brief Feeds one checkpoint period of levels to every sensor.
+ */
+
+static void advance(void) {
+    resume_rollup();
+    for (uint32_t i = 0; i < PERIOD_LEVELS; i++) {
+        now_us += LEVEL_US;
+        for (uint8_t s = 0; s < SENSORS; s++) {
+            int32_t level_cdB = 4500 + s * 1000 + rand() % 4000;
+            rollup_add(&state[s].rollup, now_us, level_cdB, NULL, NULL);
+            noise_dose_add(&state[s].dose, &dose_params, now_us, now_us, level_cdB);
+        }
+    }
+}
+
+// Same steps as capture_state(), checkpoint_flash_task() and restore_state() of main.c
+
+static void capture(void) {
+    for (uint8_t s = 0; s < SENSORS; s++) {
+        if (!rollup_pending) {
+            image.sensors[s].rollup = state[s].rollup;
+        }
+        image.sensors[s].dose = state[s].dose;
+    }
+    checkpoint_seal(&image.header, (const uint32_t *)image.sensors, IMAGE_WORDS);
+}
+
+static uint32_t save_flash(void) {
+    capture();
+    if (image.header.crc == flash_crc) {
+        return 0;
+    }
+
+    checkpoint_header_t header = image.header;
+    header.sequence = flash_sequence + 1;
+    uint32_t bytes = flash_save_checkpoint(files[header.sequence % CHECKPOINT_SLOTS], &header,
+                                           (const uint32_t *)image.sensors);
+    if (bytes == 0) {
+        return 0;
+    }
+
+    flash_sequence = header.sequence;
+    flash_crc = header.crc;
+    return bytes;
+}
+
+static int restore(void) {
+    checkpoint_header_t header;
+    int slot = flash_probe_checkpoint(files, &header, IMAGE_WORDS);
+    flash_sequence = (slot < 0) ? 0 : header.sequence;
+    flash_crc = (slot < 0) ? UINT32_MAX : header.crc;
+
+    if (!checkpoint_valid(&image.header, (const uint32_t *)image.sensors, IMAGE_WORDS)) {
+        slot = flash_load_checkpoint(files, &image.header, (uint32_t *)image.sensors, IMAGE_WORDS);
+        if (slot < 0) {
+            image.header = (checkpoint_header_t){ 0 };
+            memset(state, 0, sizeof(state));
+            rollup_pending = false;
+            return -1;
+        }
+        flash_sequence = image.header.sequence;
+        flash_crc = image.header.crc;
+    } else {
+        slot = CHECKPOINT_SLOTS;                    // RAM
+    }
+
+    for (uint8_t s = 0; s < SENSORS; s++) {
+        memset(&state[s].rollup, 0, sizeof(rollup_t));  // Cleared at boot, like micdata
+        state[s].dose = image.sensors[s].dose;
+        state[s].dose.last_us = 0;
+    }
+    rollup_pending = true;
+    return slot;
+}
+
+/**
+ * @brief Newest copy the model says is intact, or -1.
+ */
+
+static int newest_valid_copy(void) {
+    int newest = -1;
+
+    for (int slot = 0; slot < CHECKPOINT_SLOTS; slot++) {
+        if (copies[slot].valid && (newest < 0 || (int32_t)(copies[slot].sequence - copies[newest].sequence) > 0)) {
+            newest = slot;
+        }
+    }
+    return newest;
+}
+
+/**
+ * @brief Encoding round trip, truncation and damage on random payloads, and the A/B order.
+ */
+
+static uint8_t stream[2 * CODEC_WORDS * sizeof(uint32_t) + 64];
+static uint32_t stream_length, stream_position, stream_limit;
+
+static bool stream_write(void *ctx, const void *data, uint32_t size) {
+    (void)ctx;
+    if (stream_length + size > sizeof(stream)) {
+        return false;
+    }
+    memcpy(stream + stream_length, data, size);
+    stream_length += size;
+    return true;
+}
+
+static bool stream_read(void *ctx, void *data, uint32_t size) {
+    (void)ctx;
+    if (stream_position + size > stream_limit) {
+        return false;
+    }
+    memcpy(data, stream + stream_position, size);
+    stream_position += size;
+    return true;
+}
+
+static bool stream_decode(uint32_t limit, uint32_t *payload) {
+    checkpoint_header_t header;
+
+    stream_position = 0;
+    stream_limit = limit;
+    return checkpoint_read_header(&header, CODEC_WORDS, stream_read, NULL) &&
+           checkpoint_read_payload(&header, payload, stream_read, NULL);
+}
+
+static void test_codec(void) {
+    static uint32_t payload[CODEC_WORDS], decoded[CODEC_WORDS];
+    uint32_t accepted_damage = 0;
+
+    for (uint32_t round = 0; round < CODEC_ROUNDS; round++) {
+        uint32_t density = rand() % 4;          // Mostly empty to full histograms
+        for (uint32_t i = 0; i < CODEC_WORDS; i++) {
+            payload[i] = (rand() % 10 < (int)density) ? (uint32_t)rand() + 1 : 0;
+        }
+        if (round % 7 == 0) {
+            memset(payload, 0, sizeof(payload));
+        }
+
+        checkpoint_header_t header = { .sequence = round };
+        checkpoint_seal(&header, payload, CODEC_WORDS);
+        CHECK_EQ(header.sequence, round + 1);
+        stream_length = 0;
+        CHECK(checkpoint_write(&header, payload, stream_write, NULL));
+        CHECK_EQ(stream_length, sizeof(header) + header.encoded_words * sizeof(uint32_t));
+
+        CHECK(stream_decode(stream_length, decoded));
+        CHECK(memcmp(payload, decoded, sizeof(payload)) == 0);
+
+        // Cut short anywhere: rejected
+        CHECK(!stream_decode(rand() % stream_length, decoded));
+
+        // One bit flipped in the payload: rejected (a flip that decodes to the same payload is harmless)
+        uint32_t at = sizeof(header) + rand() % (stream_length - sizeof(header));
+        stream[at] ^= (uint8_t)(1u << (rand() % 8));
+        if (stream_decode(stream_length, decoded)) {
+            CHECK(memcmp(payload, decoded, sizeof(payload)) == 0);
+            accepted_damage++;
+        }
+    }
+    printf("codec: %d cargas, %u bits trocados inofensivos aceitos\n", CODEC_ROUNDS, accepted_damage);
+
+    // Newest first, across the wrap-around of the sequence; absent copies skipped
+    checkpoint_header_t headers[CHECKPOINT_SLOTS] = { { .sequence = 0xFFFFFFFFu }, { .sequence = 0 } };
+    bool present[CHECKPOINT_SLOTS] = { true, true };
+    uint8_t order[CHECKPOINT_SLOTS];
+    CHECK_EQ(checkpoint_order(headers, present, order), 2);
+    CHECK_EQ(order[0], 1);
+    CHECK_EQ(order[1], 0);
+    present[1] = false;
+    CHECK_EQ(checkpoint_order(headers, present, order), 1);
+    CHECK_EQ(order[0], 0);
+    present[0] = false;
+    CHECK_EQ(checkpoint_order(headers, present, order), 0);
+}
+
+/**
+ * @brief Flash checkpoints through flash.c on the simulated LittleFS, with power losses
+ *        during the writes, flash damage and soft resets, each followed by a restore.
+ *
+ * @param mode What a power loss leaves in the file being written.
+ */
+
+static void test_crashes(fake_lfs_crash_t mode) {
+    uint32_t crashes = 0, damaged = 0, soft_resets = 0, from_ram = 0, from_flash = 0, lost = 0;
+
+    fake_lfs_reset();
+    memset(state, 0, sizeof(state));
+    memset(&image, 0, sizeof(image));
+    memset(copies, 0, sizeof(copies));
+    now_us = 20000 * 86400000000ULL;
+    CHECK_EQ(restore(), -1);                        // First boot: nothing to restore
+
+    for (uint32_t period = 0; period < PERIODS; period++) {
+        advance();
+
+        uint32_t event = rand() % 8;
+        if (event == 0) {
+            fake_lfs_crash_after_writes(rand() % 40, mode);
+        }
+
+        uint32_t next_sequence = flash_sequence + 1;
+        uint8_t slot = next_sequence % CHECKPOINT_SLOTS;
+        if (save_flash() > 0) {
+            copies[slot].valid = true;
+            copies[slot].sequence = next_sequence;
+            memcpy(copies[slot].sensors, image.sensors, sizeof(image.sensors));
+        } else if (event == 0) {
+            crashes++;
+            if (mode == FAKE_LFS_CRASH_TORN) {
+                copies[slot].valid = false;
+            }
+        }
+        fake_lfs_power_on();                        // Disarms a crash that did not happen
+
+        if (event == 1 && newest_valid_copy() >= 0) {
+            // Flash damage in the payload of the newest copy (the header stays readable)
+            int newest = newest_valid_copy();
+            int32_t size = fake_lfs_size(files[newest]);
+            uint32_t header_bits = sizeof(checkpoint_header_t) * 8;
+            CHECK(fake_lfs_flip_bit(files[newest], header_bits + rand() % (size * 8 - header_bits)));
+            copies[newest].valid = false;
+            damaged++;
+        }
+
+        if (event == 2) {
+            // Soft reset: the RAM image is intact and more recent than any flash copy
+            advance();
+            capture();
+            sensor_state_t expected[SENSORS];
+            memcpy(expected, state, sizeof(state));
+            CHECK_EQ(restore(), CHECKPOINT_SLOTS);
+            resume_rollup();
+            for (uint8_t s = 0; s < SENSORS; s++) {
+                expected[s].dose.last_us = 0;
+            }
+            CHECK(memcmp(state, expected, sizeof(state)) == 0);
+            soft_resets++;
+            from_ram++;
+            continue;
+        }
+
+        if (event <= 1 || event == 3) {
+            // Power loss: the RAM image is gone (or garbage), the newest intact flash copy is restored
+            image.sensors[0].rollup.lden[0].count ^= 0x5A5A;
+            int expected = newest_valid_copy();
+            int slot_restored = restore();
+            CHECK_EQ(slot_restored, expected);
+            if (expected < 0) {
+                lost++;
+                continue;
+            }
+            from_flash++;
+            CHECK_EQ(image.header.sequence, copies[expected].sequence);
+            CHECK(memcmp(image.sensors, copies[expected].sensors, sizeof(image.sensors)) == 0);
+            for (uint8_t s = 0; s < SENSORS; s++) {
+                CHECK_EQ(state[s].dose.last_us, 0);
+                CHECK_EQ(state[s].dose.weighted_ms_q12, copies[expected].sensors[s].dose.weighted_ms_q12);
+            }
+        }
+    }
+
+    // A bad newest copy is replaced by the next write, so one copy always survives
+    CHECK_EQ(lost, 0);
+    printf("%s: %u quedas na escrita, %u copias danificadas, %u reinicios, %u da RAM, %u da flash, %u perdidos\n",
+           (mode == FAKE_LFS_CRASH_ATOMIC) ? "LittleFS" : "escrita rasgada", crashes, damaged, soft_resets,
+           from_ram, from_flash, lost);
+    CHECK(crashes > 10 && from_flash > 10 && from_ram > 10);
+}
+
+/**
+ * @brief Levels before the clock synchronization do not touch the restored windows.
+ *
+ * After a reset the local time is the time since boot until SNTP answers. Those levels go
+ * to windows of their own while the RAM checkpoints keep the restored ones; the first
+ * synchronized level continues the restored windows.
+ */
+
+static void test_unsynced_restore(void) {
+    static sensor_state_t restored[SENSORS];
+
+    fake_lfs_reset();
+    memset(state, 0, sizeof(state));
+    memset(&image, 0, sizeof(image));
+    rollup_pending = false;
+    synced = true;
+    now_us = 20000 * 86400000000ULL + 9 * 3600000000ULL;
+    advance();                                      // 15 min of levels
+    capture();
+    memcpy(restored, image.sensors, sizeof(restored));
+
+    // Watchdog reset: restored from RAM, the clock not synchronized yet
+    synced = false;
+    CHECK_EQ(restore(), CHECKPOINT_SLOTS);
+    resume_rollup();
+    for (uint64_t uptime_us = 2000000; uptime_us < 20000000; uptime_us += LEVEL_US) {
+        for (uint8_t s = 0; s < SENSORS; s++) {
+            rollup_add(&state[s].rollup, uptime_us, 6000, NULL, NULL);
+            noise_dose_add(&state[s].dose, &dose_params, uptime_us, uptime_us, 6000);
+        }
+        resume_rollup();
+        capture();                                  // RAM checkpoint of every second
+    }
+    for (uint8_t s = 0; s < SENSORS; s++) {
+        CHECK(memcmp(&image.sensors[s].rollup, &restored[s].rollup, sizeof(rollup_t)) == 0);
+        CHECK(image.sensors[s].dose.weighted_ms_q12 >= restored[s].dose.weighted_ms_q12);
+    }
+
+    // SNTP answers: the next level continues the restored windows
+    synced = true;
+    now_us += 25000000;
+    resume_rollup();
+    for (uint8_t s = 0; s < SENSORS; s++) {
+        uint32_t before = 0, after = 0;
+        rollup_add(&state[s].rollup, now_us, 6000, NULL, NULL);
+        for (uint8_t i = 0; i < ROLLUP_LEVELS; i++) {
+            before += restored[s].rollup.stats[i].energy.count;     // Every level of the day is in one open window
+            after += state[s].rollup.stats[i].energy.count;
+        }
+        CHECK_EQ(after, before + 1);
+        CHECK_EQ(state[s].rollup.start_us[ROLLUP_24H], restored[s].rollup.start_us[ROLLUP_24H]);
+    }
+    capture();
+    CHECK(memcmp(&image.sensors[0].rollup, &restored[0].rollup, sizeof(rollup_t)) != 0);
+}
+
+/**
+ * @brief Cost of the RAM and flash checkpoints and of the restore, and the flash copy size.
+ */
+
+static void bench(void) {
+    uint64_t ram_cycles, flash_cycles, restore_cycles;
+    uint32_t bytes = 0;
+
+    fake_lfs_reset();
+    memset(state, 0, sizeof(state));
+    memset(&image, 0, sizeof(image));
+    flash_sequence = 0;
+    flash_crc = UINT32_MAX;
+    now_us = 20000 * 86400000000ULL;
+    for (int i = 0; i < 16; i++) {
+        advance();                                  // Four hours of levels: realistic histograms
+    }
+
+    BENCH_BEST(ram_cycles, 20, capture());
+    BENCH_BEST(flash_cycles, 20, {
+        flash_crc = UINT32_MAX;                     // Written even if unchanged
+        bytes = save_flash();
+    });
+    BENCH_BEST(restore_cycles, 20, {
+        image.header.magic = 0;                     // Power loss: from flash
+        bench_sink += (uint32_t)restore();
+    });
+
+    printf("imagem %zu bytes, copia em flash %u bytes (%.1f%%), %.0f bytes/dia a cada %u s\n",
+           sizeof(image.sensors), bytes, 100.0 * bytes / sizeof(image.sensors),
+           86400000.0 / CHECKPOINT_FLASH_PERIOD_MS * bytes, CHECKPOINT_FLASH_PERIOD_MS / 1000);
+    printf("checkpoint RAM %.0f k%s, flash %.0f k%s (sem a gravacao), restauracao %.0f k%s\n",
+           ram_cycles / 1000.0, BENCH_UNIT, flash_cycles / 1000.0, BENCH_UNIT, restore_cycles / 1000.0, BENCH_UNIT);
+    CHECK(bytes > 0 && bytes < sizeof(image.sensors) / 2);
+}
+
+int main(void) {
+    srand(1);
+    test_codec();
+    test_crashes(FAKE_LFS_CRASH_ATOMIC);
+    test_crashes(FAKE_LFS_CRASH_TORN);
+    test_unsynced_restore();
+    bench();
+    return test_result("test_checkpoint");
+}
@@ -0,0 +1,67 @@
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+static int test_failures;   // Failed checks of the test
+
+#define CHECK(cond) do {                                                        \
+        if (!(cond)) {                                                          \
+            printf("%s:%d: falhou: %s\n", __FILE__, __LINE__, #cond);           \
+            test_failures++;                                                    \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) do {                                         \
+        long long actual_ = (long long)(actual), expected_ = (long long)(expected); \
+        if (actual_ != expected_) {                                             \
+            printf("%s:%d: falhou: %s == %lld (esperado %lld)\n",               \
+                   __FILE__, __LINE__, #actual, actual_, expected_);            \
+            test_failures++;                                                    \
+        }                                                                       \
+    } while (0)
+
+/**
+ * @brief Ends a test: prints the result and returns the exit code for CTest.
+ */
+
+static inline int test_result(const char *name) {
+    printf("%s: %s (%d falhas)\n", name, test_failures ? "FALHOU" : "ok", test_failures);
+    return test_failures ? 1 : 0;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "ciclos"     // Time stamp counter of the host
+
+static inline uint64_t bench_now(void) {
+    return __rdtsc();
+}
+#else
+#define BENCH_UNIT "ns"         // No cycle counter: monotonic clock
+
+static inline uint64_t bench_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+#endif
+
+static volatile uint32_t bench_sink;    // Results of the benchmarked code (kept by the optimizer)
+
+// Runs body repeats times and keeps the fastest run in best (BENCH_UNIT)
+#define BENCH_BEST(best, repeats, body) do {                                    \
+        (best) = UINT64_MAX;                                                    \
+        for (int run_ = 0; run_ < (repeats); run_++) {                          \
+            uint64_t start_ = bench_now();                                      \
+            body;                                                               \
+            uint64_t elapsed_ = bench_now() - start_;                           \
+            if (elapsed_ < (best)) {                                            \
+                (best) = elapsed_;                                              \
+            }                                                                   \
+        }                                                                       \
+    } while (0)
+
+#endif
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include "test_common.h"
+#include "inc/crc16.h"
+#include "inc/config.h"
+
+/**
+ * @brief Bit-by-bit Modbus CRC16 of the original firmware (modbus_crc16() of mic.c), the reference.
+ */
+
+static uint16_t crc16_bitwise(const uint8_t *buf, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t pos = 0; pos < len; pos++) {
+        crc ^= (uint16_t)buf[pos];
+        for (int i = 8; i != 0; i--) {
+            if ((crc & 0x0001) != 0) {
+                crc >>= 1;
+                crc ^= 0xA001;
+            } else
+                crc >>= 1;
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Benchmarks the three CRC paths on buffers of one size.
+ */
+
+static void bench_size(const uint8_t *buf, size_t len) {
+    const int rounds = 20000;
+    uint64_t bitwise, bytewise, sliced;
+
+    BENCH_BEST(bitwise, 5, for (int i = 0; i < rounds; i++) bench_sink += crc16_bitwise(buf, len));
+    BENCH_BEST(bytewise, 5, for (int i = 0; i < rounds; i++) {
+        uint16_t crc = CRC16_MODBUS_INIT;
+        for (size_t b = 0; b < len; b++) {
+            crc = crc16_modbus_update(crc, buf[b]);
+        }
+        bench_sink += crc;
+    });
+    BENCH_BEST(sliced, 5, for (int i = 0; i < rounds; i++) bench_sink += crc16_modbus(buf, len));
+
+    double bytes = (double)rounds * len;
+    printf("%4zu bytes: bit a bit %.2f, tabela %.2f, buffer (slice-by-4 = %d) %.2f %s/byte\n", len,
+           bitwise / bytes, bytewise / bytes, CRC16_SLICE_BY_4, sliced / bytes, BENCH_UNIT);
+}
+
+int main(void) {
+    static uint8_t buf[4096];
+    const uint8_t check[] = "123456789";
+    const uint8_t request[] = { 0x01, 0x03, 0x00, 0x00, 0x00, 0x01 };
+
+    srand(1);
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = (uint8_t)rand();
+    }
+
+    CHECK_EQ(crc16_modbus(check, 9), 0x4B37);           // CRC-16/MODBUS check value
+    CHECK_EQ(crc16_modbus(request, sizeof(request)), 0x0A84);
+    CHECK_EQ(crc16_modbus(buf, 0), CRC16_MODBUS_INIT);
+
+    // Every length and alignment against the original implementation
+    for (size_t offset = 0; offset < 4; offset++) {
+        for (size_t len = 0; len <= 300; len++) {
+            uint16_t expected = crc16_bitwise(buf + offset, len);
+            uint16_t incremental = CRC16_MODBUS_INIT;
+
+            for (size_t i = 0; i < len; i++) {
+                incremental = crc16_modbus_update(incremental, buf[offset + i]);
+            }
+
+            CHECK_EQ(crc16_modbus(buf + offset, len), expected);
+            CHECK_EQ(incremental, expected);
+            CHECK_EQ(crc16_modbus_update_buf(crc16_modbus_update_buf(CRC16_MODBUS_INIT, buf + offset, len / 3),
+                                             buf + offset + len / 3, len - len / 3), expected);
+        }
+    }
+
+    // A frame followed by its CRC (low byte first) leaves a zero remainder
+    uint16_t crc = crc16_modbus(buf, 100);
+    buf[100] = (uint8_t)(crc & 0xFF);
+    buf[101] = (uint8_t)(crc >> 8);
+    CHECK_EQ(crc16_modbus(buf, 102), 0);
+
+    bench_size(buf, 8);
+    bench_size(buf, 256);
+
+    return test_result("test_crc16");
+}
@@ -0,0 +1,187 @@
+#include <string.h>
+#include "test_common.h"
+#include "inc/event_detector.h"
+
+#define PERIOD_US 300000ULL                     // One level per sampling period
+#define THRESHOLD_CDB 8500
+#define HYSTERESIS_CDB 300
+#define RELEASE_CDB (THRESHOLD_CDB - HYSTERESIS_CDB)
+#define QUIET_CDB 6000
+
+/**
+ * @brief Alerts raised by the detector, with a copy of the last event of each kind.
+ */
+
+static struct {
+    uint32_t starts;
+    uint32_t ends;
+    event_t start;
+    event_t end;
+} alerts;
+
+static event_detector_t det;
+static uint64_t now_us;
+
+static void on_alert(event_kind_t kind, const event_t *event, void *arg) {
+    (void)arg;
+    if (kind == EVENT_START) {
+        alerts.starts++;
+        alerts.start = *event;
+    } else {
+        alerts.ends++;
+        alerts.end = *event;
+    }
+}
+
+/**
+ * @brief Starts a scenario: a new detector fed with quiet levels for a while.
+ */
+
+static void start(uint32_t min_duration_us) {
+    memset(&alerts, 0, sizeof(alerts));
+    event_detector_init(&det, THRESHOLD_CDB, HYSTERESIS_CDB, min_duration_us);
+    now_us = 5000000;
+}
+
+/**
+ * @brief Feeds the next level, one sampling period after the previous one.
+ */
+
+static void feed(int16_t level_cdB) {
+    measurement_t sample = { .timestamp_us = now_us, .level_cdB = level_cdB, .sensor = 3 };
+
+    event_detector_add(&det, &sample, on_alert, NULL);
+    now_us += PERIOD_US;
+}
+
+/**
+ * @brief Checks that samples holds count levels, one period apart, the last one at last_us.
+ */
+
+static void check_samples(const event_t *event, uint8_t count, uint64_t last_us) {
+    CHECK_EQ(event->sample_count, count);
+    for (uint8_t i = 0; i < event->sample_count; i++) {
+        CHECK_EQ(event->samples[i].timestamp_us, last_us - (uint64_t)(count - 1 - i) * PERIOD_US);
+        CHECK_EQ(event->samples[i].sensor, 3);
+    }
+}
+
+/**
+ * @brief A burst shorter than the minimum duration raises nothing.
+ */
+
+static void test_short_burst(void) {
+    start(2 * PERIOD_US);
+
+    for (uint8_t i = 0; i < 20; i++) {
+        feed(QUIET_CDB);
+    }
+    feed(9000);                                 // 0 and 300 ms above the threshold
+    feed(9500);
+    feed(RELEASE_CDB);                          // Below the threshold: the burst is over
+    CHECK_EQ(det.state, EVENT_IDLE);
+
+    feed(THRESHOLD_CDB);                        // A new burst starts its own duration
+    feed(THRESHOLD_CDB);
+    feed(QUIET_CDB);
+    CHECK_EQ(alerts.starts + alerts.ends, 0);
+}
+
+/**
+ * @brief The start alert comes on the level that reaches the minimum duration.
+ *
+ * It carries the EVENT_CAPTURE_SAMPLES levels up to the trigger, oldest first; the end
+ * alert waits for a level below threshold - hysteresis, a level in between keeps the
+ * event going.
+ */
+
+static void test_start_and_release(void) {
+    start(2 * PERIOD_US);
+
+    for (uint8_t i = 0; i < 30; i++) {
+        feed(QUIET_CDB + i);
+    }
+    uint64_t onset_us = now_us;
+    feed(THRESHOLD_CDB);
+    feed(9200);
+    CHECK_EQ(alerts.starts, 0);
+    uint64_t trigger_us = now_us;
+    feed(8800);                                 // 600 ms after the onset
+    CHECK_EQ(alerts.starts, 1);
+    CHECK_EQ(alerts.start.onset_us, onset_us);
+    CHECK_EQ(alerts.start.trigger_us, trigger_us);
+    CHECK_EQ(alerts.start.end_us, 0);
+    CHECK_EQ(alerts.start.threshold_cdB, THRESHOLD_CDB);
+    CHECK_EQ(alerts.start.peak_cdB, 9200);
+    check_samples(&alerts.start, EVENT_CAPTURE_SAMPLES, trigger_us);
+    CHECK_EQ(alerts.start.samples[EVENT_CAPTURE_SAMPLES - 1].level_cdB, 8800);
+    CHECK_EQ(alerts.start.samples[0].level_cdB, QUIET_CDB + 30 - (EVENT_CAPTURE_SAMPLES - 3));
+
+    // Between the release level and the threshold, and at the release level: still active
+    for (uint8_t i = 0; i < 2 * EVENT_CAPTURE_SAMPLES; i++) {
+        feed((i % 2) ? RELEASE_CDB : THRESHOLD_CDB - 1);
+    }
+    feed(9900);
+    CHECK_EQ(alerts.ends, 0);
+    CHECK_EQ(det.state, EVENT_ACTIVE);
+
+    uint64_t end_us = now_us;
+    feed(RELEASE_CDB - 1);                      // The levels after the trigger are already collected
+    CHECK_EQ(alerts.ends, 1);
+    CHECK_EQ(alerts.end.onset_us, onset_us);
+    CHECK_EQ(alerts.end.trigger_us, trigger_us);
+    CHECK_EQ(alerts.end.end_us, end_us);
+    CHECK_EQ(alerts.end.peak_cdB, 9900);
+    check_samples(&alerts.end, EVENT_CAPTURE_SAMPLES, trigger_us + EVENT_CAPTURE_SAMPLES * PERIOD_US);
+    CHECK_EQ(det.state, EVENT_IDLE);
+}
+
+/**
+ * @brief A short event ends once EVENT_CAPTURE_SAMPLES levels followed the trigger.
+ *
+ * With no minimum duration the first level at the threshold triggers at once. The level
+ * drops right after; the end alert still waits for the capture (4.8 s at 300 ms), and
+ * exceedances meanwhile belong to the ending event.
+ */
+
+static void test_post_trigger_capture(void) {
+    start(0);
+
+    feed(QUIET_CDB);
+    uint64_t trigger_us = now_us;
+    feed(THRESHOLD_CDB);
+    CHECK_EQ(alerts.starts, 1);
+    CHECK_EQ(alerts.start.onset_us, trigger_us);
+    CHECK_EQ(alerts.start.trigger_us, trigger_us);
+    check_samples(&alerts.start, 2, trigger_us);  // Only the levels since the init
+
+    uint64_t end_us = now_us;
+    feed(QUIET_CDB);
+    CHECK_EQ(det.state, EVENT_ENDING);
+    uint8_t collected = 1;
+    while (alerts.ends == 0 && collected < 2 * EVENT_CAPTURE_SAMPLES) {
+        feed((collected % 4 == 0) ? 9600 : QUIET_CDB);
+        collected++;
+    }
+    CHECK_EQ(collected, EVENT_CAPTURE_SAMPLES);
+    CHECK_EQ(alerts.starts, 1);                 // The exceedances while ending raised nothing
+    CHECK_EQ(alerts.end.end_us, end_us);
+    CHECK_EQ(alerts.end.peak_cdB, THRESHOLD_CDB);
+    check_samples(&alerts.end, EVENT_CAPTURE_SAMPLES, trigger_us + EVENT_CAPTURE_SAMPLES * PERIOD_US);
+    CHECK_EQ(alerts.end.samples[0].level_cdB, QUIET_CDB);
+
+    // The next exceedance is a new event
+    uint64_t next_us = now_us;
+    feed(9100);
+    CHECK_EQ(alerts.starts, 2);
+    CHECK_EQ(alerts.start.onset_us, next_us);
+    CHECK_EQ(alerts.start.peak_cdB, 9100);
+    check_samples(&alerts.start, EVENT_CAPTURE_SAMPLES, next_us);
+}
+
+int main(void) {
+    test_short_burst();
+    test_start_and_release();
+    test_post_trigger_capture();
+    return test_result("test_event_detector");
+}
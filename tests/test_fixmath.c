@@ -0,0 +1,106 @@
+#include <math.h>
+#include <stdlib.h>
+#include "test_common.h"
+#include "inc/fixmath.h"
+#include "inc/audio_dsp.h"
+#include "inc/config.h"
+
+#define BENCH_VALUES 4096
+
+/**
+ * @brief Random 64-bit value with a random magnitude (1 to 2^62).
+ */
+
+static uint64_t random_value(void) {
+    uint64_t x = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+    x >>= rand() % 62;
+    return x ? x : 1;
+}
+
+/**
+ * @brief Error of the integer dB pipeline against double precision.
+ */
+
+static void test_error(void) {
+    double worst_log2 = 0, worst_cdB = 0, worst_level = 0, worst_exp2 = 0;
+
+    for (uint32_t i = 0; i < 1000000; i++) {
+        uint64_t x = random_value();
+        double exact = log2((double)x);
+
+        double error = fabs(fix_log2_q16(x) / 65536.0 - exact);
+        if (error > worst_log2) worst_log2 = error;
+
+        // Conversion alone, on an exact Q16 input
+        int32_t q16 = (int32_t)lround(exact * 65536.0);
+        error = fabs(fix_log2_q16_to_cdB(q16) - 1000.0 * log10(2.0) * q16 / 65536.0);
+        if (error > worst_cdB) worst_cdB = error;
+
+        // Full pipeline: sum of squares of a block to a level
+        uint32_t count = 1 + rand() % 4096;
+        uint64_t sum = x >> 20;
+        if (sum < count) {
+            sum = count;
+        }
+        double level = 1000.0 * log10((double)sum / count) + MIC_DB_OFFSET * 100.0;
+        error = fabs(audio_sum_squares_to_cdB(sum, count) - level);
+        if (error > worst_level) worst_level = error;
+
+        // 2^x, relative error in cdB
+        int32_t exponent = rand() % (40 << 16);
+        if (exponent >= (24 << 16)) {     // Large enough for the rounding down to vanish
+            error = fabs(1000.0 * log10((double)fix_exp2_q16(exponent) / exp2(exponent / 65536.0)));
+            if (error > worst_exp2) worst_exp2 = error;
+        }
+    }
+
+    printf("erro maximo: log2 %.2e, log2->cdB %.3f cdB, nivel do bloco %.3f cdB, exp2 %.3f cdB\n",
+           worst_log2, worst_cdB, worst_level, worst_exp2);
+    CHECK(worst_log2 < 1e-4);
+    CHECK(worst_cdB < 0.51);        // Rounding to the nearest centi-dB
+    CHECK(worst_level < 5.0);       // 0.05 dB
+    CHECK(worst_exp2 < 5.0);
+
+    // Exact points and round trips
+    CHECK_EQ(fix_log2_q16(1), 0);
+    CHECK_EQ(fix_log2_q16(1ULL << 40), 40 << 16);
+    CHECK_EQ(fix_log2_q16_to_cdB(FIX_Q16_ONE), 301);
+    CHECK_EQ(fix_exp2_q16(10 << 16), 1024);
+    for (int32_t cdB = -12000; cdB <= 12000; cdB += 7) {
+        CHECK(abs(fix_log2_q16_to_cdB(fix_cdB_to_log2_q16(cdB)) - cdB) <= 1);
+    }
+}
+
+/**
+ * @brief Cost of one block level: integer pipeline against the float sqrt + log10 path.
+ */
+
+static void bench_level(void) {
+    static uint64_t sums[BENCH_VALUES];
+    uint64_t integer, floating;
+
+    for (uint32_t i = 0; i < BENCH_VALUES; i++) {
+        sums[i] = (uint64_t)MIC_BLOCK_SIZE * (1 + rand() % (2048 * 2048));
+    }
+
+    BENCH_BEST(integer, 50, {
+        for (uint32_t i = 0; i < BENCH_VALUES; i++) {
+            bench_sink += (uint32_t)audio_sum_squares_to_cdB(sums[i], MIC_BLOCK_SIZE);
+        }
+    });
+    BENCH_BEST(floating, 50, {
+        for (uint32_t i = 0; i < BENCH_VALUES; i++) {
+            bench_sink += (uint32_t)(100.0F * audio_rms_to_dB(sqrtf((float)sums[i] / MIC_BLOCK_SIZE)));
+        }
+    });
+
+    printf("nivel por bloco: inteiro %.1f %s, float (sqrtf + log10f) %.1f %s\n",
+           (double)integer / BENCH_VALUES, BENCH_UNIT, (double)floating / BENCH_VALUES, BENCH_UNIT);
+}
+
+int main(void) {
+    srand(8);
+    test_error();
+    bench_level();
+    return test_result("test_fixmath");
+}
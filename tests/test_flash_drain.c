@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test_common.h"
+#include "fake_broker.h"
+#include "fake_lfs.h"
+#include "inc/mqtt.h"
+#include "inc/flash.h"
+
+#define STEP_US 50000ULL                    // Tick of the simulation (MQTT_DRAIN_PERIOD_MS)
+#define ACK_LATENCY_US 200000ULL            // PUBACK latency of the broker
+#define MAX_FILES 200
+
+static const sensor_config_t config = { .sensor_id = 7 };
+static uint32_t received[MAX_FILES];        // Acknowledged copies of each saved file
+
+/**
+ * @brief Saves count files of size bytes, as the publisher spills them while offline.
+ *
+ * Each file is a JSON object carrying its number, padded to the size.
+ */
+
+static void save_files(uint32_t count, uint32_t size) {
+    char data[MQTT_PAYLOAD_SIZE];
+    char name[32];
+
+    for (uint32_t n = 0; n < count; n++) {
+        int length = snprintf(data, sizeof(data), "{\"file\":%u, \"pad\":\"", n);
+        memset(data + length, 'x', size - length - 2);
+        memcpy(data + size - 2, "\"}", 2);
+        snprintf(name, sizeof(name), "data_%u.json", n);
+        fake_lfs_create(name, data, size);
+    }
+}
+
+/**
+ * @brief Acknowledges the pending messages older than ACK_LATENCY_US.
+ */
+
+static void broker_ack(void) {
+    uint32_t ready = 0;
+
+    for (uint32_t i = 0; i < fake_broker_count(); i++) {
+        const fake_broker_message_t *message = fake_broker_message(i);
+        if (!message->pending) {
+            continue;
+        }
+        if (message->sent_us + ACK_LATENCY_US > fake_now_us) {
+            break;
+        }
+
+        char text[MQTT_BATCH_MAX_BYTES + 1];
+        memcpy(text, message->payload, message->length);
+        text[message->length] = '\0';
+        for (const char *p = strstr(text, "{\"file\":"); p; p = strstr(p + 1, "{\"file\":")) {
+            uint32_t file = (uint32_t)atoi(p + 8);
+            if (file < MAX_FILES) {
+                received[file]++;
+            }
+        }
+        ready++;
+    }
+    fake_broker_ack(ready);
+}
+
+/**
+ * @brief Drains count saved files of size bytes, at the task periods of main().
+ *
+ * @param live_us Period of the live records queued during the drain (0 = none).
+ */
+
+static void drain(const char *name, uint32_t count, uint32_t size, uint64_t live_us) {
+    fake_broker_reset();
+    fake_lfs_reset();
+    memset(received, 0, sizeof(received));
+    backlog_stats = (backlog_stats_t){ 0 };
+    save_files(count, size);
+
+    init_filesystem();
+    start_mqtt_client();
+
+    for (uint32_t step = 0; step < 2000 && (fake_lfs_count(".json") > 0 || publish_queue.count > 0); step++) {
+        fake_now_us += STEP_US;
+
+        if (live_us && fake_now_us % live_us == 0) {
+            micdata_t micdata = { .config = &config, .window_s = 60 };
+            publish_db_to_mqtt(&micdata);
+        }
+        if (fake_now_us % (PUBLISH_QUEUE_PERIOD_MS * 1000ULL) == 0) {
+            mqtt_publisher_service();
+        }
+        mqtt_backlog_service();
+        broker_ack();
+    }
+
+    // The files are resent whole; each message but the last one holds all the files it can
+    uint32_t per_message = (MQTT_BATCH_MAX_BYTES - 1) / (size + 1);  // '[' and ']', a comma between files
+    if (per_message > MQTT_BATCH_MAX_RECORDS) {
+        per_message = MQTT_BATCH_MAX_RECORDS;
+    }
+
+    uint32_t messages = 0, files = 0, partial = 0;
+    for (uint32_t i = 0; i < fake_broker_count(); i++) {
+        const fake_broker_message_t *message = fake_broker_message(i);
+        uint32_t carried = 0;
+
+        for (uint32_t b = 0; b + 8 <= message->length; b++) {
+            carried += memcmp(message->payload + b, "{\"file\":", 8) == 0;
+        }
+        if (carried == 0) {
+            continue;                       // Live records
+        }
+        messages++;
+        files += carried;
+        partial += carried < per_message && files < count;
+    }
+
+    uint32_t missing = 0, duplicated = 0;
+    for (uint32_t n = 0; n < count; n++) {
+        missing += received[n] == 0;
+        duplicated += received[n] > 1;
+    }
+
+    double seconds = backlog_stats.active_us / 1e6;
+    printf("%s: %u arquivos de %u bytes em %u mensagens (%u incompletas), %.1f arquivos/s",
+           name, count, size, messages, partial, seconds > 0 ? backlog_stats.files_acked / seconds : 0.0);
+    if (backlog_stats.live_records > 0) {
+        printf(", %u registros ao vivo com latencia media %u us (max %u us)", backlog_stats.live_records,
+               (uint32_t)(backlog_stats.live_latency_sum_us / backlog_stats.live_records), backlog_stats.live_latency_max_us);
+    }
+    printf("\n");
+
+    CHECK_EQ(partial, 0);
+    CHECK_EQ(files, count);
+    CHECK_EQ(missing, 0);
+    CHECK_EQ(duplicated, 0);
+    CHECK_EQ(fake_lfs_count(".json"), 0);
+    CHECK_EQ(backlog_stats.files_acked, count);
+    CHECK_EQ(fake_broker_unlocked, 0);
+}
+
+int main(void) {
+    drain("lote limitado por bytes", 43, 300, 0);
+    drain("lote limitado por registros", 45, 100, 0);
+    drain("arquivo unico", 1, 300, 0);
+    drain("com dados ao vivo", 120, 250, 1000000);
+    return test_result("test_flash_drain");
+}
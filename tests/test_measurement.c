@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include "test_common.h"
+#include "inc/measurement.h"
+#include "inc/noise_stats.h"
+
+#define BENCH_SAMPLES 4096      // Records per benchmark run
+#define BENCH_FORMATS 1024      // Levels formatted per benchmark run
+
+/**
+ * @brief Sample path before the fixed-point record: dB x 10 from the ring, float in micdata.
+ */
+
+typedef struct {
+    uint64_t timestamp_us;
+    uint16_t value;             // dB x 10
+    uint8_t sensor;
+    uint8_t status;
+    uint8_t flags;
+} old_record_t;
+
+typedef struct {
+    float dB;
+    uint64_t timestamp;
+    float average, maxdB, mindB, leq, l10, l50, l90, l95, lden;
+} old_micdata_t;
+
+typedef struct {
+    measurement_t last;
+    noise_stats_summary_t summary;
+    int32_t lden_cdB;
+} new_micdata_t;
+
+static old_record_t old_records[BENCH_SAMPLES];
+static measurement_t new_records[BENCH_SAMPLES];
+
+// Core 0 per sample: float division into micdata, then back to hundredths of dB for the rollup
+__attribute__((noinline)) static int32_t old_sample(old_micdata_t *m, const old_record_t *r) {
+    m->dB = r->value / 10.0F;
+    m->timestamp = r->timestamp_us;
+    return (int32_t)(m->dB * 100.0F + 0.5F);
+}
+
+__attribute__((noinline)) static int32_t new_sample(new_micdata_t *m, const measurement_t *r) {
+    m->last = *r;
+    return m->last.level_cdB;
+}
+
+// Every closed window: nine float divisions against a plain copy
+__attribute__((noinline)) static void old_window(old_micdata_t *m, const noise_stats_summary_t *s, int32_t lden_cdB) {
+    m->average = s->mean_cdB / 100.0F;
+    m->maxdB = s->max_cdB / 100.0F;
+    m->mindB = s->min_cdB / 100.0F;
+    m->leq = s->leq_cdB / 100.0F;
+    m->l10 = s->l10_cdB / 100.0F;
+    m->l50 = s->l50_cdB / 100.0F;
+    m->l90 = s->l90_cdB / 100.0F;
+    m->l95 = s->l95_cdB / 100.0F;
+    m->lden = lden_cdB / 100.0F;
+}
+
+__attribute__((noinline)) static void new_window(new_micdata_t *m, const noise_stats_summary_t *s, int32_t lden_cdB) {
+    m->summary = *s;
+    m->lden_cdB = lden_cdB;
+}
+
+/**
+ * @brief Layout of the record and exactness of the integer paths against the float ones.
+ */
+
+static void test_record(void) {
+    CHECK_EQ(sizeof(measurement_t), 12);
+    CHECK_EQ(alignof(measurement_t), 4);
+    CHECK_EQ(offsetof(measurement_t, level_cdB), 8);
+
+    // Modbus readings: the integer scaling gives the level the float path handed to the rollup
+    for (uint32_t value = 0; value <= 2000; value++) {
+        old_micdata_t old;
+        old_record_t record = { .value = (uint16_t)value };
+        CHECK_EQ(old_sample(&old, &record), (int32_t)value * 10);
+    }
+
+    // Coordinates: exact micro-degrees, rounded half away from zero
+    CHECK_EQ(MEASUREMENT_COORD_E6(-22.9068467), -22906847);
+    CHECK_EQ(MEASUREMENT_COORD_E6(-43.1728965), -43172897);
+    CHECK_EQ(MEASUREMENT_COORD_E6(0.0000005), 1);
+    CHECK_EQ(MEASUREMENT_COORD_E6(180.0), 180000000);
+}
+
+/**
+ * @brief measurement_format_fixed() against snprintf, including the truncation.
+ */
+
+static void test_format(void) {
+    static const int32_t values[] = { 0, 1, -1, 9, 10, 99, 100, -100, 12345, -12345, 15000, INT16_MAX, INT16_MIN,
+                                      INT32_MAX, INT32_MIN, -22906847, 180000000 };
+    char buffer[24], expected[24];
+
+    for (uint8_t decimals = 1; decimals <= 6; decimals++) {
+        uint32_t scale = 1;
+        for (uint8_t i = 0; i < decimals; i++) {
+            scale *= 10;
+        }
+        for (uint32_t i = 0; i < sizeof(values) / sizeof(values[0]) + 20000; i++) {
+            int32_t value = (i < sizeof(values) / sizeof(values[0])) ? values[i] : (int32_t)(rand() % 400000) - 200000;
+            uint32_t magnitude = (value < 0) ? (uint32_t)0 - (uint32_t)value : (uint32_t)value;
+            int length = snprintf(expected, sizeof(expected), "%s%lu.%0*lu", (value < 0) ? "-" : "",
+                                  (unsigned long)(magnitude / scale), decimals, (unsigned long)(magnitude % scale));
+
+            CHECK_EQ(measurement_format_fixed(buffer, sizeof(buffer), value, decimals), length);
+            CHECK(strcmp(buffer, expected) == 0);
+        }
+    }
+
+    // Levels: same text as the float printf it replaced
+    for (int32_t cdB = -2000; cdB <= 20000; cdB++) {
+        snprintf(expected, sizeof(expected), "%.2f", cdB / 100.0);
+        measurement_format_fixed(buffer, sizeof(buffer), cdB, 2);
+        CHECK(strcmp(buffer, expected) == 0);
+    }
+
+    // Truncated like snprintf: the length of the whole string, the buffer always terminated
+    for (size_t size = 0; size <= 8; size++) {
+        memset(buffer, 'x', sizeof(buffer));
+        int length = snprintf(expected, size, "%s", "-123.45");
+        CHECK_EQ(measurement_format_fixed(buffer, size, -12345, 2), length);
+        if (size > 0) {
+            CHECK(strcmp(buffer, expected) == 0);
+        } else {
+            CHECK_EQ(buffer[0], 'x');
+        }
+    }
+}
+
+/**
+ * @brief Per-sample, per-window and per-format cost of the float and fixed-point paths.
+ *
+ * The host has an FPU, so the float paths are much cheaper here than with the soft-float
+ * routines of the M0+; the gap measured here is a lower bound.
+ */
+
+static void bench(void) {
+    static old_micdata_t old;
+    static new_micdata_t new;
+    noise_stats_summary_t summary = { 0 };
+    uint64_t old_cycles, new_cycles;
+    char buffer[24];
+
+    for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+        uint16_t value = (uint16_t)(300 + rand() % 900);
+        old_records[i] = (old_record_t){ .timestamp_us = i * 300000ULL, .value = value, .sensor = (uint8_t)(i & 3) };
+        new_records[i] = (measurement_t){ .timestamp_us = i * 300000ULL, .level_cdB = (int16_t)(value * 10),
+                                          .sensor = (uint8_t)(i & 3) };
+    }
+
+    BENCH_BEST(old_cycles, 20, {
+        for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+            bench_sink += (uint32_t)old_sample(&old, &old_records[i]);
+        }
+    });
+    BENCH_BEST(new_cycles, 20, {
+        for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+            bench_sink += (uint32_t)new_sample(&new, &new_records[i]);
+        }
+    });
+    printf("amostra: float %.2f %s, ponto fixo %.2f %s (registro de %zu -> %zu bytes)\n",
+           (double)old_cycles / BENCH_SAMPLES, BENCH_UNIT, (double)new_cycles / BENCH_SAMPLES, BENCH_UNIT,
+           sizeof(old_record_t), sizeof(measurement_t));
+
+    BENCH_BEST(old_cycles, 20, {
+        for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+            summary.leq_cdB = new_records[i].level_cdB;
+            old_window(&old, &summary, summary.leq_cdB);
+        }
+    });
+    BENCH_BEST(new_cycles, 20, {
+        for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+            summary.leq_cdB = new_records[i].level_cdB;
+            new_window(&new, &summary, summary.leq_cdB);
+        }
+    });
+    bench_sink += (uint32_t)old.leq + (uint32_t)new.summary.leq_cdB;
+    printf("janela: float %.2f %s, ponto fixo %.2f %s\n",
+           (double)old_cycles / BENCH_SAMPLES, BENCH_UNIT, (double)new_cycles / BENCH_SAMPLES, BENCH_UNIT);
+
+    BENCH_BEST(old_cycles, 20, {
+        for (uint32_t i = 0; i < BENCH_FORMATS; i++) {
+            bench_sink += (uint32_t)snprintf(buffer, sizeof(buffer), "%.2f", new_records[i].level_cdB / 100.0F);
+        }
+    });
+    BENCH_BEST(new_cycles, 20, {
+        for (uint32_t i = 0; i < BENCH_FORMATS; i++) {
+            bench_sink += (uint32_t)measurement_format_fixed(buffer, sizeof(buffer), new_records[i].level_cdB, 2);
+        }
+    });
+    printf("formatacao: printf %%.2f %.0f %s, measurement_format_fixed %.0f %s\n",
+           (double)old_cycles / BENCH_FORMATS, BENCH_UNIT, (double)new_cycles / BENCH_FORMATS, BENCH_UNIT);
+}
+
+int main(void) {
+    test_record();
+    test_format();
+    bench();
+    return test_result("test_measurement");
+}
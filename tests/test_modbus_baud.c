@@ -0,0 +1,222 @@
+#include <string.h>
+#include "test_common.h"
+#include "inc/modbus_baud.h"
+#include "inc/crc16.h"
+
+#define SLAVES 3
+#define TURNAROUND_US 3000      // Time a slave takes to start answering
+
+/**
+ * @brief How an emulated SM7901 reacts to a write of its baud rate register.
+ */
+typedef enum {
+    SLAVE_APPLY_NOW,            ///< Echoes at the old rate, then switches
+    SLAVE_APPLY_ON_POWER_CYCLE, ///< Echoes and stores the code; the rate changes after a power cycle
+    SLAVE_REJECT                ///< Answers with an illegal data address exception
+} slave_mode_t;
+
+typedef struct {
+    uint8_t address;
+    uint16_t code;              // Baud rate code in use
+    uint16_t stored_code;       // Code applied at the next power cycle
+    slave_mode_t mode;
+    uint32_t max_baud;          // Above this rate the line is too noisy (CRC errors)
+    bool lose_echo;             // The echo of the next write is lost
+    bool dead;
+} slave_t;
+
+/**
+ * @brief Emulated RS-485 segment behind the blocking link.
+ */
+
+static struct {
+    slave_t slaves[SLAVES];
+    uint32_t baud_rate;         // Rate of the master UART
+    uint32_t transactions;
+} line;
+
+static const uint32_t rates[] = {2400, 4800, 9600, 19200, 38400, 57600, 115200, 1200};
+
+static uint16_t seal(uint8_t *frame, uint16_t length) {
+    uint16_t crc = crc16_modbus(frame, length);
+    frame[length] = crc & 0xFF;
+    frame[length + 1] = crc >> 8;
+    return length + 2;
+}
+
+/**
+ * @brief Answers one request; only the addressed slave running at the UART rate understands it.
+ */
+
+static bool link_transact(void *ctx, const uint8_t *request, uint16_t request_length,
+                          uint8_t *frame, uint16_t *frame_length, bool *crc_ok, uint32_t *latency_us) {
+    (void)ctx;
+    line.transactions++;
+
+    for (uint8_t i = 0; i < SLAVES; i++) {
+        slave_t *slave = &line.slaves[i];
+
+        if (slave->dead || slave->address != request[0] || rates[slave->code] != line.baud_rate) {
+            continue;
+        }
+
+        uint16_t length;
+        if (request[1] == MODBUS_FC_READ_HOLDING_REGISTERS) {
+            frame[0] = slave->address;
+            frame[1] = MODBUS_FC_READ_HOLDING_REGISTERS;
+            frame[2] = 2;
+            frame[3] = 0x02;
+            frame[4] = 0xA7;
+            length = seal(frame, 5);
+        } else if (slave->mode == SLAVE_REJECT) {
+            frame[0] = slave->address;
+            frame[1] = request[1] | MODBUS_FC_EXCEPTION_FLAG;
+            frame[2] = MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+            length = seal(frame, 3);
+        } else {
+            uint16_t reg = (request[2] << 8) | request[3];
+            CHECK_EQ(reg, SM7901_BAUD_REGISTER);
+            memcpy(frame, request, request_length);     // Echo
+            length = request_length;
+            slave->stored_code = (request[4] << 8) | request[5];
+            if (slave->mode == SLAVE_APPLY_NOW) {
+                slave->code = slave->stored_code;
+            }
+            if (slave->lose_echo) {
+                slave->lose_echo = false;
+                return false;
+            }
+        }
+
+        *frame_length = length;
+        *crc_ok = crc16_modbus(frame, length) == 0;
+        if (line.baud_rate > slave->max_baud) {
+            frame[length - 1] ^= 0x5A;
+            *crc_ok = false;
+        }
+        *latency_us = modbus_rtu_frame_time_us(request_length, line.baud_rate) + TURNAROUND_US
+                    + modbus_rtu_frame_time_us(length, line.baud_rate);
+        return true;
+    }
+
+    return false;
+}
+
+static void link_set_baud(void *ctx, uint32_t baud_rate) {
+    (void)ctx;
+    line.baud_rate = baud_rate;
+}
+
+static void power_cycle(void) {
+    for (uint8_t i = 0; i < SLAVES; i++) {
+        line.slaves[i].code = line.slaves[i].stored_code;
+    }
+}
+
+static void setup(slave_mode_t mode, uint32_t baud_rate) {
+    memset(&line, 0, sizeof(line));
+    for (uint8_t i = 0; i < SLAVES; i++) {
+        line.slaves[i].address = i + 1;
+        line.slaves[i].code = line.slaves[i].stored_code = sm7901_baud_code(baud_rate);
+        line.slaves[i].mode = mode;
+        line.slaves[i].max_baud = 115200;
+    }
+    line.baud_rate = 1200;
+}
+
+static modbus_baud_result_t negotiate(uint32_t target) {
+    static const modbus_link_t link = { link_transact, link_set_baud, NULL };
+    modbus_bus_device_cfg_t devices[SLAVES];
+
+    for (uint8_t i = 0; i < SLAVES; i++) {
+        devices[i] = (modbus_bus_device_cfg_t){ (uint8_t)(i + 1), 0x0000, 1 };
+    }
+    return modbus_baud_negotiate(&link, devices, SLAVES, 9600, target);
+}
+
+static void check_all_at(uint32_t baud_rate) {
+    for (uint8_t i = 0; i < SLAVES; i++) {
+        CHECK_EQ(rates[line.slaves[i].code], baud_rate);
+        CHECK_EQ(rates[line.slaves[i].stored_code], baud_rate);
+    }
+}
+
+int main(void) {
+    modbus_baud_result_t result;
+
+    CHECK_EQ(sm7901_baud_code(9600), 2);
+    CHECK_EQ(sm7901_baud_code(38400), 4);
+    CHECK_EQ(sm7901_baud_code(14400), -1);
+
+    // Sensors that switch right away: latency measured at both rates
+    setup(SLAVE_APPLY_NOW, 9600);
+    result = negotiate(38400);
+    CHECK(result.switched);
+    CHECK_EQ(result.baud_rate, 38400);
+    CHECK_EQ(line.baud_rate, 38400);
+    check_all_at(38400);
+    CHECK_EQ(result.before.count, SLAVES * MODBUS_BAUD_CHECK_READS);
+    CHECK_EQ(result.after.count, SLAVES * MODBUS_BAUD_CHECK_READS);
+    CHECK(modbus_latency_mean_us(&result.after) < modbus_latency_mean_us(&result.before));
+    printf("latencia da leitura: %lu us a 9600, %lu us a 38400\n",
+           (unsigned long)modbus_latency_mean_us(&result.before), (unsigned long)modbus_latency_mean_us(&result.after));
+
+    // Next boot: the sensors already run at the target rate
+    line.baud_rate = 1200;
+    result = negotiate(38400);
+    CHECK(result.switched);
+    CHECK_EQ(line.baud_rate, 38400);
+    CHECK_EQ(result.before.count, 0);
+    CHECK_EQ(result.after.count, SLAVES * MODBUS_BAUD_CHECK_READS);
+
+    // One sensor refuses the write: the others are restored and the bus stays at 9600
+    setup(SLAVE_APPLY_NOW, 9600);
+    line.slaves[1].mode = SLAVE_REJECT;
+    result = negotiate(38400);
+    CHECK(!result.switched);
+    CHECK_EQ(result.baud_rate, 9600);
+    CHECK_EQ(line.baud_rate, 9600);
+    check_all_at(9600);
+
+    // Write applied but its echo lost: that sensor is restored too
+    setup(SLAVE_APPLY_NOW, 9600);
+    line.slaves[1].lose_echo = true;
+    result = negotiate(38400);
+    CHECK(!result.switched);
+    CHECK_EQ(line.baud_rate, 9600);
+    check_all_at(9600);
+
+    // Sensors that apply the rate after a power cycle: the check fails, the old code is written back
+    setup(SLAVE_APPLY_ON_POWER_CYCLE, 9600);
+    result = negotiate(38400);
+    CHECK(!result.switched);
+    CHECK_EQ(line.baud_rate, 9600);
+    power_cycle();
+    check_all_at(9600);
+
+    // Line too noisy at the target rate: the sensors are moved back at 38400
+    setup(SLAVE_APPLY_NOW, 9600);
+    line.slaves[2].max_baud = 19200;
+    result = negotiate(38400);
+    CHECK(!result.switched);
+    CHECK_EQ(line.baud_rate, 9600);
+    check_all_at(9600);
+
+    // No sensor at either rate: nothing written, the UART returns to 9600
+    setup(SLAVE_APPLY_NOW, 9600);
+    for (uint8_t i = 0; i < SLAVES; i++) {
+        line.slaves[i].dead = true;
+    }
+    result = negotiate(38400);
+    CHECK(!result.switched);
+    CHECK_EQ(line.baud_rate, 9600);
+    check_all_at(9600);
+
+    // Unsupported target rate: nothing is sent
+    setup(SLAVE_APPLY_NOW, 9600);
+    result = negotiate(14400);
+    CHECK(!result.switched);
+    CHECK_EQ(line.transactions, 0);
+
+    return test_result("test_modbus_baud");
+}
@@ -0,0 +1,234 @@
+#include <string.h>
+#include "test_common.h"
+#include "inc/modbus_bus.h"
+#include "inc/crc16.h"
+
+#define SIM_STEP_US 20                 // Resolution of the virtual clock
+#define SIM_TURNAROUND_US 3000         // Time a slave takes to start answering after the request
+#define SIM_MAX_BYTES 512
+
+/**
+ * @brief RS-485 segment with emulated SM7901 slaves and the real RTU receiver on the master side.
+ */
+
+typedef struct {
+    uint32_t now_us;
+    uint32_t baud_rate;
+    bool alive[MODBUS_BUS_MAX_DEVICES];         // Slaves that answer
+    uint16_t value[MODBUS_BUS_MAX_DEVICES];     // Register value of the next answer of each slave
+    uint8_t wire[SIM_MAX_BYTES];                // Response bytes on their way to the master
+    uint32_t wire_us[SIM_MAX_BYTES];            // Arrival time of each byte
+    uint16_t wire_head, wire_count;
+    uint32_t bus_free_us;                       // End of the last frame on the wire
+    uint32_t collisions;                        // Requests sent while a frame was still on the wire
+    uint32_t wrong_values;                      // Samples whose registers do not match the answer
+    uint32_t samples[MODBUS_BUS_MAX_DEVICES];   // Valid samples of each slave
+    modbus_rtu_rx_t rx;
+    modbus_bus_t bus;
+} bus_sim_t;
+
+static bus_sim_t sim;
+
+static uint32_t char_us(void) {
+    return modbus_rtu_frame_time_us(1, sim.baud_rate);
+}
+
+/**
+ * @brief Transmit callback: the addressed slave answers t3.5 + turnaround after the request.
+ */
+
+static void sim_send(const uint8_t *frame, uint16_t length, void *arg) {
+    (void)arg;
+    if ((int32_t)(sim.bus_free_us - sim.now_us) > 0) {
+        sim.collisions++;
+    }
+
+    uint32_t request_end = sim.now_us + modbus_rtu_frame_time_us(length, sim.baud_rate);
+    sim.bus_free_us = request_end;
+
+    uint8_t slave = frame[0] - 1;   // Addresses 1..N
+    if (slave >= MODBUS_BUS_MAX_DEVICES || !sim.alive[slave]) {
+        return;
+    }
+
+    uint16_t registers = (frame[4] << 8) | frame[5];
+    uint8_t response[5 + 2 * MODBUS_BUS_MAX_REGISTERS];
+    uint16_t size = 0;
+
+    response[size++] = frame[0];
+    response[size++] = MODBUS_FC_READ_HOLDING_REGISTERS;
+    response[size++] = (uint8_t)(2 * registers);
+    for (uint16_t r = 0; r < registers; r++) {
+        response[size++] = (uint8_t)(sim.value[slave] >> 8);
+        response[size++] = (uint8_t)(sim.value[slave] + r);
+    }
+    uint16_t crc = crc16_modbus(response, size);
+    response[size++] = crc & 0xFF;
+    response[size++] = crc >> 8;
+
+    uint32_t start = request_end + sim.rx.t35_us + SIM_TURNAROUND_US;
+    for (uint16_t i = 0; i < size; i++) {
+        uint16_t slot = (sim.wire_head + sim.wire_count++) % SIM_MAX_BYTES;
+        sim.wire[slot] = response[i];
+        sim.wire_us[slot] = start + (i + 1) * char_us();
+    }
+    sim.bus_free_us = start + size * char_us();
+}
+
+static void sim_sample(uint8_t index, const modbus_bus_device_t *device, modbus_status_t status, void *arg) {
+    (void)arg;
+    if (status != MODBUS_STATUS_OK) {
+        return;
+    }
+    if (device->registers[0] != sim.value[index]) {
+        sim.wrong_values++;
+    }
+    sim.samples[index]++;
+    sim.value[index] += 7;  // Next answer carries a new level
+}
+
+static void sim_frame(const uint8_t *frame, uint16_t length, bool crc_ok, void *arg) {
+    (void)arg;
+    modbus_bus_on_frame(&sim.bus, frame, length, crc_ok, sim.now_us);
+}
+
+/**
+ * @brief Resets the segment with devices live slaves (addresses 1..devices, one register each).
+ */
+
+static void sim_setup(uint8_t devices, uint32_t baud_rate) {
+    modbus_bus_device_cfg_t table[MODBUS_BUS_MAX_DEVICES];
+
+    memset(&sim, 0, sizeof(sim));
+    sim.baud_rate = baud_rate;
+    for (uint8_t i = 0; i < devices; i++) {
+        table[i] = (modbus_bus_device_cfg_t){ (uint8_t)(i + 1), 0x0000, 1 };
+        sim.alive[i] = true;
+        sim.value[i] = (uint16_t)(500 + 100 * i);
+    }
+
+    modbus_rtu_rx_init(&sim.rx, baud_rate, sim_frame, NULL);
+    modbus_bus_init(&sim.bus, table, devices, MODBUS_RESPONSE_TIMEOUT_MS * 1000, sim_send, sim_sample, NULL, 0);
+}
+
+/**
+ * @brief Runs the bus for a simulated duration, one round per sampling period.
+ *
+ * @param max_round_us Updated with the longest round.
+ * @return Rounds that could not start because the previous one was still running.
+ */
+
+static uint32_t sim_advance(uint32_t period_us, uint32_t duration_us, uint32_t *max_round_us) {
+    uint32_t missed = 0;
+    uint32_t next_round = sim.now_us;
+    uint32_t round_start = 0;
+    uint32_t end = sim.now_us + duration_us;
+
+    while (sim.now_us < end) {
+        if (sim.now_us >= next_round) {
+            if (modbus_bus_start_round(&sim.bus, sim.now_us)) {
+                round_start = sim.now_us;
+            } else {
+                missed++;   // Sampling gap: the previous round overran the period
+            }
+            next_round += period_us;
+        }
+
+        while (sim.wire_count > 0 && sim.wire_us[sim.wire_head] <= sim.now_us) {
+            modbus_rtu_rx_feed(&sim.rx, sim.wire[sim.wire_head], sim.wire_us[sim.wire_head]);
+            sim.wire_head = (sim.wire_head + 1) % SIM_MAX_BYTES;
+            sim.wire_count--;
+        }
+        modbus_rtu_rx_poll(&sim.rx, sim.now_us);
+        modbus_bus_poll(&sim.bus, sim.now_us);
+
+        if (!modbus_bus_busy(&sim.bus) && round_start != 0) {
+            if (sim.now_us - round_start > *max_round_us) {
+                *max_round_us = sim.now_us - round_start;
+            }
+            round_start = 0;
+        }
+
+        sim.now_us += SIM_STEP_US;
+    }
+
+    return missed;
+}
+
+int main(void) {
+    const uint32_t period_us = SAMPLE_PERIOD_MS * 1000;
+    const uint32_t duration_us = 60 * 1000000;
+    const uint32_t rates[] = { 9600, 38400 };
+
+    // Achieved polls per second against the number of sensors, every sensor answering
+    for (uint8_t r = 0; r < 2; r++) {
+        for (uint8_t devices = 1; devices <= MODBUS_BUS_MAX_DEVICES; devices++) {
+            uint32_t max_round_us = 0;
+
+            sim_setup(devices, rates[r]);
+            uint32_t missed = sim_advance(period_us, duration_us, &max_round_us);
+            uint32_t rate = modbus_bus_take_poll_rate(&sim.bus, sim.now_us);
+
+            printf("%5lu baud, %u sensores: %lu.%02lu leituras/s, rodada max %lu us, %lu rodadas perdidas\n",
+                   (unsigned long)rates[r], devices, (unsigned long)(rate / 100), (unsigned long)(rate % 100),
+                   (unsigned long)max_round_us, (unsigned long)missed);
+
+            uint32_t rounds = duration_us / period_us;
+            CHECK_EQ(sim.collisions, 0);
+            CHECK_EQ(sim.wrong_values, 0);
+            if (max_round_us < period_us) {
+                // Round fits the period: no gap, every sensor sampled in every round
+                CHECK_EQ(missed, 0);
+                for (uint8_t i = 0; i < devices; i++) {
+                    CHECK(sim.samples[i] + 1 >= rounds);
+                    CHECK_EQ(sim.bus.devices[i].timeouts, 0);
+                }
+            }
+        }
+    }
+
+    // Bus capacity: rounds back to back (a new round as soon as the previous one ends)
+    for (uint8_t r = 0; r < 2; r++) {
+        uint32_t max_round_us = 0;
+
+        sim_setup(MODBUS_BUS_MAX_DEVICES, rates[r]);
+        sim_advance(SIM_STEP_US, 10 * 1000000, &max_round_us);
+        uint32_t rate = modbus_bus_take_poll_rate(&sim.bus, sim.now_us);
+
+        printf("%5lu baud, barramento saturado: %lu.%02lu leituras/s\n", (unsigned long)rates[r],
+               (unsigned long)(rate / 100), (unsigned long)(rate % 100));
+        CHECK_EQ(sim.collisions, 0);
+        CHECK_EQ(sim.wrong_values, 0);
+        CHECK_EQ(sim.rx.frames_bad_crc + sim.rx.frames_discarded, 0);
+    }
+
+    // The default table (up to MODBUS_BUS_MAX_DEVICES SM7901s at 9600 baud) fits the sampling period
+    uint32_t max_round_us = 0;
+    sim_setup(MODBUS_BUS_MAX_DEVICES, 9600);
+    CHECK_EQ(sim_advance(period_us, duration_us, &max_round_us), 0);
+    CHECK(max_round_us < period_us);
+
+    // A dead sensor times out MODBUS_BUS_OFFLINE_AFTER times, then is skipped for a while
+    sim_setup(4, 9600);
+    sim.alive[2] = false;
+    max_round_us = 0;
+    uint32_t missed = sim_advance(period_us, duration_us, &max_round_us);
+    const modbus_bus_device_t *dead = &sim.bus.devices[2];
+    uint32_t cycle = MODBUS_BUS_OFFLINE_AFTER + MODBUS_BUS_OFFLINE_RETRY_ROUNDS;
+
+    printf("sensor mudo: %lu requisicoes, %lu timeouts em %lu rodadas (%lu perdidas)\n", (unsigned long)dead->polls,
+           (unsigned long)dead->timeouts, (unsigned long)sim.bus.rounds, (unsigned long)missed);
+    CHECK_EQ(dead->responses, 0);
+    CHECK_EQ(dead->timeouts, dead->polls);
+    CHECK(dead->polls <= (sim.bus.rounds / cycle + 1) * MODBUS_BUS_OFFLINE_AFTER);
+    CHECK(missed <= (sim.bus.rounds / cycle + 1) * MODBUS_BUS_OFFLINE_AFTER);
+    for (uint8_t i = 0; i < 4; i++) {
+        if (i != 2) {
+            CHECK_EQ(sim.bus.devices[i].timeouts, 0);
+            CHECK_EQ(sim.samples[i], sim.bus.devices[i].responses);
+        }
+    }
+    CHECK_EQ(sim.wrong_values, 0);
+
+    return test_result("test_modbus_bus");
+}
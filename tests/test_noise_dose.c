@@ -0,0 +1,159 @@
+#include <math.h>
+#include <stdlib.h>
+#include "test_common.h"
+#include "inc/noise_dose.h"
+
+#define HOUR_US 3600000000ULL
+#define DAY_US (24 * HOUR_US)
+#define BOOT_US 1000000ULL                          // Time since boot of the first level
+#define LOCAL_START_US (20000 * DAY_US + 6 * HOUR_US)   // Profiles start at 06:00 local
+#define BENCH_LEVELS 100000                         // Levels per benchmark run
+
+static const noise_dose_params_t niosh = { 8500, 300, 8000, 8 * 3600, 0, 2000000 };
+static const noise_dose_params_t osha = { 9000, 500, 8000, 8 * 3600, 0, 2000000 };
+
+static double constant_85(double t) { (void)t; return 85.0; }
+static double constant_90(double t) { (void)t; return 90.0; }
+static double constant_100(double t) { (void)t; return 100.0; }
+
+// Slowly varying machine noise with a short impact every 37 s out of 185 s
+static double machine(double t) {
+    return 75.0 + 20.0 * fabs(sin(t / 500.0)) + (((int)(t / 37.0) % 5 == 0) ? 12.0 : 0.0);
+}
+
+// Office level, always below the threshold
+static double quiet(double t) {
+    return 70.0 + 5.0 * sin(t / 100.0);
+}
+
+/**
+ * @brief Feeds a profile to the dose and to an offline double-precision reference.
+ *
+ * @param expected_dose Known dose of the profile, in percent (< 0 if none).
+ */
+
+static void check_profile(const char *name, const noise_dose_params_t *params, double (*profile)(double),
+                          double hours, double period_s, double expected_dose) {
+    noise_dose_t dose = { 0 };
+    double reference = 0;
+    uint32_t levels = (uint32_t)(hours * 3600 / period_s);
+
+    for (uint32_t i = 0; i < levels; i++) {
+        double t = i * period_s;
+        int32_t level_cdB = (int32_t)lround(profile(t) * 100);
+        uint64_t offset_us = (uint64_t)llround(t * 1e6);
+
+        // Each level is held since the previous one; T(L) = criterion_s / 2^((L - criterion) / exchange)
+        if (i > 0 && level_cdB >= params->threshold_cdB) {
+            reference += period_s * pow(2.0, (double)(level_cdB - params->criterion_cdB) / params->exchange_cdB)
+                         / params->criterion_s;
+        }
+        noise_dose_add(&dose, params, BOOT_US + offset_us, LOCAL_START_US + offset_us, level_cdB);
+    }
+
+    double reference_percent = 100 * reference;
+    double percent = noise_dose_percent_c(&dose, params) / 100.0;
+    int32_t twa_cdB = noise_dose_twa_cdB(&dose, params);
+
+    if (reference > 0) {
+        double reference_twa = (params->criterion_cdB + params->exchange_cdB * log2(reference)) / 100.0;
+        printf("%-14s dose %9.3f%% (referencia %9.3f%%), TWA %6.2f dB (referencia %6.3f dB)\n",
+               name, percent, reference_percent, twa_cdB / 100.0, reference_twa);
+        CHECK(fabs(percent - reference_percent) <= 1e-4 * reference_percent + 0.01);   // Truncated to 0.01%
+        CHECK(fabs(twa_cdB / 100.0 - reference_twa) <= 0.02);
+    } else {
+        printf("%-14s dose %9.3f%%, abaixo do limiar\n", name, percent);
+        CHECK_EQ(noise_dose_percent_c(&dose, params), 0);
+        CHECK_EQ(twa_cdB, 0);
+    }
+    if (expected_dose >= 0) {
+        CHECK(fabs(reference_percent - expected_dose) <= 1e-4 * expected_dose);   // The reference itself (first level has no duration)
+    }
+    CHECK_EQ(dose.exposure_s, (uint32_t)((levels - 1) * period_s));
+}
+
+/**
+ * @brief Restart of the dose at the reset hour, restore after a reboot, gaps and saturation.
+ */
+
+static void test_edges(void) {
+    noise_dose_t dose = { 0 };
+
+    // One second at 90 dB on day 5; the next level on day 6 restarts the dose
+    noise_dose_add(&dose, &niosh, BOOT_US, 5 * DAY_US + 1, 9000);
+    noise_dose_add(&dose, &niosh, BOOT_US + 1000000, 5 * DAY_US + 1000001, 9000);
+    CHECK_EQ(dose.day, 5);
+    CHECK_EQ(dose.exposure_s, 1);
+    uint64_t one_second = dose.weighted_ms_q12;
+    CHECK(one_second > 0);
+
+    noise_dose_add(&dose, &niosh, BOOT_US + 2000000, 6 * DAY_US + 1, 9000);
+    CHECK_EQ(dose.day, 6);
+    CHECK_EQ(dose.exposure_s, 1);
+    CHECK_EQ(dose.weighted_ms_q12, one_second);
+
+    // Reboot: the saved dose is restored without last_us; a local time from before the
+    // clock synchronization (day 0) keeps it
+    noise_dose_t saved = dose;
+    saved.last_us = 0;
+    noise_dose_add(&saved, &niosh, 500000, 5000000, 9000);
+    CHECK_EQ(saved.day, 6);
+    CHECK_EQ(saved.weighted_ms_q12, one_second);               // First level after the reboot: no duration
+    noise_dose_add(&saved, &niosh, 1500000, 6000000, 9000);
+    CHECK_EQ(saved.weighted_ms_q12, 2 * one_second);
+    CHECK_EQ(saved.exposure_s, 2);
+
+    // An acquisition gap is credited max_gap_us only; time going back adds nothing
+    noise_dose_add(&saved, &niosh, 1500000 + 60000000, 6000000 + 60000000, 9000);
+    CHECK_EQ(saved.weighted_ms_q12, 4 * one_second);
+    noise_dose_add(&saved, &niosh, 1000000, 6000000 + 61000000, 9000);
+    CHECK_EQ(saved.weighted_ms_q12, 4 * one_second);
+
+    // Absurd levels saturate instead of wrapping (the TWA stays far above any real level)
+    noise_dose_t loud = { 0 };
+    for (uint32_t i = 0; i < 100000; i++) {
+        noise_dose_add(&loud, &niosh, BOOT_US + i * 2000000ULL, LOCAL_START_US + i * 2000000ULL, 30000);
+    }
+    CHECK_EQ(noise_dose_percent_c(&loud, &niosh), UINT32_MAX);
+    CHECK(noise_dose_twa_cdB(&loud, &niosh) > 16000);
+}
+
+/**
+ * @brief Cost of one level (constant, whatever the length of the exposure).
+ */
+
+static void bench(void) {
+    static int32_t levels[BENCH_LEVELS];
+    noise_dose_t dose = { 0 };
+    uint64_t best;
+
+    for (uint32_t i = 0; i < BENCH_LEVELS; i++) {
+        levels[i] = (int32_t)lround(machine(i * 0.3) * 100);
+    }
+    BENCH_BEST(best, 10, {
+        dose = (noise_dose_t){ 0 };
+        for (uint32_t i = 0; i < BENCH_LEVELS; i++) {
+            noise_dose_add(&dose, &niosh, BOOT_US + i * 300000ULL, LOCAL_START_US + i * 300000ULL, levels[i]);
+        }
+    });
+    bench_sink += noise_dose_percent_c(&dose, &niosh);
+    printf("noise_dose_add: %.1f %s/nivel, %zu bytes por sensor\n", (double)best / BENCH_LEVELS, BENCH_UNIT,
+           sizeof(noise_dose_t));
+}
+
+int main(void) {
+    // Textbook cases: 100% at the criterion for 8 h, doubling per exchange rate
+    check_profile("NIOSH 85 dB 8h", &niosh, constant_85, 8, 0.3, 100.0);
+    check_profile("NIOSH 90 dB 8h", &niosh, constant_90, 8, 0.3, 100.0 * pow(2.0, 5.0 / 3.0));
+    check_profile("NIOSH 100 dB 1h", &niosh, constant_100, 1, 0.3, 400.0);
+    check_profile("NIOSH maquina", &niosh, machine, 8, 0.3, -1);
+    check_profile("NIOSH escritorio", &niosh, quiet, 8, 0.3, -1);
+    check_profile("OSHA 90 dB 8h", &osha, constant_90, 8, 0.3, 100.0);
+    check_profile("OSHA 100 dB 4h", &osha, constant_100, 4, 0.3, 200.0);
+    check_profile("OSHA 85 dB 8h", &osha, constant_85, 8, 0.125, 50.0);
+    check_profile("OSHA maquina", &osha, machine, 8, 1.0, -1);
+
+    test_edges();
+    bench();
+    return test_result("test_noise_dose");
+}
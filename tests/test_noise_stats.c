@@ -0,0 +1,138 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_common.h"
+#include "inc/noise_stats.h"
+
+#define MAX_LEVELS 200000
+
+static noise_stats_t stats, first, second;
+static int32_t levels[MAX_LEVELS];
+
+static int compare_levels(const void *a, const void *b) {
+    return *(const int32_t *)a - *(const int32_t *)b;
+}
+
+/**
+ * @brief Random level: background noise with 10% of louder events.
+ */
+
+static int32_t random_level(void) {
+    return 3000 + rand() % 6000 + ((rand() % 10 == 0) ? 3000 : 0);
+}
+
+/**
+ * @brief Windows of random levels against the exact statistics of the sorted levels.
+ */
+
+static void test_against_reference(void) {
+    for (int t = 0; t < 20; t++) {
+        int n = 1 + rand() % MAX_LEVELS;
+        double energy = 0, sum = 0;
+        noise_stats_summary_t summary;
+
+        noise_stats_reset(&stats);
+        noise_stats_reset(&first);
+        noise_stats_reset(&second);
+        for (int i = 0; i < n; i++) {
+            levels[i] = random_level();
+            noise_stats_add(&stats, levels[i]);
+            noise_stats_add(i < n / 3 ? &first : &second, levels[i]);
+            energy += pow(10.0, levels[i] / 1000.0);
+            sum += levels[i];
+        }
+        noise_stats_summarize(&stats, &summary);
+        qsort(levels, n, sizeof(levels[0]), compare_levels);
+
+        CHECK_EQ(summary.count, n);
+        CHECK(fabs(summary.leq_cdB - 1000.0 * log10(energy / n)) <= 1.0);
+        CHECK(fabs(summary.mean_cdB - sum / n) <= 1.0);
+        CHECK_EQ(summary.min_cdB, levels[0]);
+        CHECK_EQ(summary.max_cdB, levels[n - 1]);
+
+        // Exceedance levels: within one histogram bin of the order statistics
+        CHECK(abs(summary.l10_cdB - levels[(int)(n * 0.90)]) <= NOISE_STATS_BIN_CDB);
+        CHECK(abs(summary.l50_cdB - levels[(int)(n * 0.50)]) <= NOISE_STATS_BIN_CDB);
+        CHECK(abs(summary.l90_cdB - levels[(int)(n * 0.10)]) <= NOISE_STATS_BIN_CDB);
+        CHECK(abs(summary.l95_cdB - levels[(int)(n * 0.05)]) <= NOISE_STATS_BIN_CDB);
+
+        // Merging two windows gives the window of all the levels
+        noise_stats_summary_t merged;
+        noise_stats_merge(&first, &second);
+        noise_stats_summarize(&first, &merged);
+        CHECK_EQ(merged.count, summary.count);
+        CHECK(abs(merged.leq_cdB - summary.leq_cdB) <= 1);
+        CHECK_EQ(merged.mean_cdB, summary.mean_cdB);
+        CHECK_EQ(merged.l10_cdB, summary.l10_cdB);
+        CHECK_EQ(merged.l90_cdB, summary.l90_cdB);
+        CHECK(memcmp(first.histogram, stats.histogram, sizeof(stats.histogram)) == 0);
+    }
+}
+
+static void test_edges(void) {
+    noise_stats_summary_t summary;
+
+    // Empty and single-level windows
+    noise_stats_reset(&stats);
+    CHECK_EQ(noise_stats_leq_cdB(&stats), 0);
+    noise_stats_add(&stats, 5000);
+    noise_stats_summarize(&stats, &summary);
+    CHECK_EQ(summary.leq_cdB, 5000);
+    CHECK(abs(summary.l50_cdB - 5000) <= NOISE_STATS_BIN_CDB);
+
+    // A long window at the top of the range: constant memory, no overflow
+    noise_stats_reset(&stats);
+    for (uint32_t i = 0; i < 100000000; i++) {
+        noise_stats_add(&stats, 14000);
+    }
+    CHECK(abs(noise_stats_leq_cdB(&stats) - 14000) <= 1);
+    CHECK_EQ(stats.energy.count, 100000000);
+
+    // Levels outside the histogram land in the edge bins
+    noise_stats_reset(&stats);
+    noise_stats_add(&stats, 500);
+    noise_stats_add(&stats, 16000);
+    CHECK_EQ(stats.histogram[0], 1);
+    CHECK_EQ(stats.histogram[NOISE_STATS_BINS - 1], 1);
+    noise_stats_summarize(&stats, &summary);
+    CHECK_EQ(summary.min_cdB, 500);
+    CHECK_EQ(summary.max_cdB, NOISE_STATS_MAX_LEVEL_CDB);  // Clamped to 150 dB
+}
+
+/**
+ * @brief Cost of adding a level and of closing a window.
+ */
+
+static void bench_stats(void) {
+    uint64_t add, summarize;
+    noise_stats_summary_t summary;
+
+    for (int i = 0; i < MAX_LEVELS; i++) {
+        levels[i] = random_level();
+    }
+
+    BENCH_BEST(add, 10, {
+        noise_stats_reset(&stats);
+        for (int i = 0; i < MAX_LEVELS; i++) {
+            noise_stats_add(&stats, levels[i]);
+        }
+    });
+    BENCH_BEST(summarize, 10, {
+        for (int i = 0; i < 100; i++) {
+            noise_stats_summarize(&stats, &summary);
+            bench_sink += (uint32_t)summary.l90_cdB;
+        }
+    });
+
+    printf("noise_stats_add: %.1f %s/nivel, noise_stats_summarize: %.0f %s (%u classes), %u bytes por janela\n",
+           (double)add / MAX_LEVELS, BENCH_UNIT, (double)summarize / 100, BENCH_UNIT, NOISE_STATS_BINS,
+           (unsigned)sizeof(noise_stats_t));
+}
+
+int main(void) {
+    srand(11);
+    test_against_reference();
+    test_edges();
+    bench_stats();
+    return test_result("test_noise_stats");
+}
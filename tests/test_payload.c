@@ -0,0 +1,163 @@
+#include "src/mqtt.c"           // The record formatters are static
+#include <stdlib.h>
+#include <time.h>
+#include "test_common.h"
+#include "fake_broker.h"
+#include "json_reference.h"
+
+#define RANDOM_RECORDS 20000    // Records of the comparison with the old formatter
+#define BENCH_RECORDS 1000      // Records formatted per benchmark run
+
+static const sensor_config_t configs[] = {
+    { .sensor_id = 1, .latitude_e6 = -3743987, .longitude_e6 = -38536267 },
+    { .sensor_id = 42, .latitude_e6 = 5000001, .longitude_e6 = -123 },
+    { .sensor_id = 200, .latitude_e6 = -90000000, .longitude_e6 = 180000000 },
+};
+
+static uint32_t random_state = 54321;
+
+static uint32_t random_next(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+/**
+ * @brief Random record closed between first_hour and last_hour (UTC).
+ */
+
+static void random_record(publish_record_t *record, uint8_t first_hour, uint8_t last_hour) {
+    static const uint32_t windows[] = { 60, 900, 3600, 24 * 60 * 60 };
+    int16_t *levels[] = { &record->mean_cdB, &record->min_cdB, &record->max_cdB, &record->leq_cdB, &record->l10_cdB,
+                          &record->l50_cdB, &record->l90_cdB, &record->l95_cdB, &record->twa_cdB, &record->lden_cdB };
+
+    memset(record, 0, sizeof(*record));
+    record->config = &configs[random_next() % count_of(configs)];
+    record->window_s = windows[random_next() % count_of(windows)];
+    for (uint8_t i = 0; i < count_of(levels); i++) {
+        *levels[i] = (random_next() % 4 == 0) ? (int16_t)random_next() : (int16_t)(3000 + random_next() % 9000);
+    }
+    record->dose_percent_c = (random_next() % 10 == 0) ? UINT32_MAX : random_next() % 500000;
+    if (random_next() % 3 == 0) {
+        record->band_count = (uint8_t)(1 + random_next() % SPECTRUM_MAX_BANDS);
+        record->first_band = (int8_t)-(int)(random_next() % 18);
+        for (uint8_t b = 0; b < record->band_count; b++) {
+            record->band_cdB[b] = (int16_t)(random_next() % 12000) - 1000;
+        }
+    }
+    record->time = (datetime_t){ .year = (int16_t)(2020 + random_next() % 80), .month = (int8_t)(1 + random_next() % 12),
+                                 .day = (int8_t)(1 + random_next() % 28),
+                                 .hour = (int8_t)(first_hour + random_next() % (last_hour - first_hour + 1)),
+                                 .min = (int8_t)(random_next() % 60), .sec = (int8_t)(random_next() % 60) };
+}
+
+/**
+ * @brief Same payload as the old formatter, whole and truncated.
+ *
+ * Records closed from 03:00 UTC on: before, the old timestamp was wrong (see test_timestamp).
+ */
+
+static void test_identical(void) {
+    char payload[MQTT_PAYLOAD_SIZE], expected[MQTT_PAYLOAD_SIZE];
+
+    for (uint32_t i = 0; i < RANDOM_RECORDS; i++) {
+        publish_record_t record;
+        random_record(&record, GMT_M_3, 23);
+
+        size_t size = (i % 2) ? sizeof(payload) : 1 + random_next() % 400;
+        memset(payload, 'x', sizeof(payload));
+        size_t length = format_payload(&record, payload, size);
+        CHECK_EQ(length, reference_format_payload(&record, expected, size));
+        CHECK(strcmp(payload, expected) == 0);
+        CHECK_EQ(strlen(payload), length);
+    }
+
+    // A sensor without a slot rendered at boot gets its static fields rendered on the fly
+    sensor_config_t extra = { .sensor_id = 99, .latitude_e6 = 1, .longitude_e6 = -1 };
+    publish_record_t record;
+    random_record(&record, GMT_M_3, 23);
+    record.config = &extra;
+    format_payload(&record, payload, sizeof(payload));
+    reference_format_payload(&record, expected, sizeof(expected));
+    CHECK(strcmp(payload, expected) == 0);
+}
+
+/**
+ * @brief The timestamp is the local time (GMT_M_3) with the date rolled back past midnight.
+ */
+
+static void test_timestamp(void) {
+    char timestamp[32], expected[32];
+
+    for (uint32_t i = 0; i < 2000; i++) {
+        publish_record_t record;
+        random_record(&record, 0, 23);
+
+        struct tm time = { .tm_year = record.time.year - 1900, .tm_mon = record.time.month - 1,
+                           .tm_mday = record.time.day, .tm_hour = record.time.hour, .tm_min = record.time.min,
+                           .tm_sec = record.time.sec };
+        time_t local_seconds = timegm(&time) - GMT_M_3 * 3600;
+        strftime(expected, sizeof(expected), "%Y-%m-%d %H:%M:%S", gmtime(&local_seconds));
+
+        memset(timestamp, 'x', sizeof(timestamp));
+        CHECK_EQ(format_timestamp(&record.time, timestamp), 19);
+        CHECK(strcmp(timestamp, expected) == 0);            // Terminated right after the seconds
+
+        if (record.time.hour < GMT_M_3) {                   // The old formatter printed a negative hour
+            reference_format_timestamp(&record.time, expected, sizeof(expected));
+            CHECK(strcmp(timestamp, expected) != 0);
+        }
+    }
+
+    // An RTC that was never set is printed as read
+    datetime_t unset = { .year = 1970, .month = 1, .day = 1, .hour = 0 };
+    format_timestamp(&unset, timestamp);
+    CHECK(strcmp(timestamp, "1970-01-01 00:00:00") == 0);
+}
+
+/**
+ * @brief Cost per payload of the old and new formatters.
+ */
+
+static void bench(void) {
+    static publish_record_t records[BENCH_RECORDS];
+    static char payload[MQTT_PAYLOAD_SIZE];
+
+    for (uint8_t bands = 0; bands < 2; bands++) {
+        uint64_t old_cycles, new_cycles;
+
+        for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+            random_record(&records[i], 0, 23);
+            records[i].window_s = 60;
+            records[i].band_count = bands ? SPECTRUM_MAX_BANDS : 0;
+            records[i].first_band = -17;
+        }
+
+        BENCH_BEST(old_cycles, 10, {
+            for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+                bench_sink += (uint32_t)reference_format_payload(&records[i], payload, sizeof(payload));
+            }
+        });
+        BENCH_BEST(new_cycles, 10, {
+            for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+                bench_sink += (uint32_t)format_payload(&records[i], payload, sizeof(payload));
+            }
+        });
+
+        printf("payload %s: snprintf %.0f %s, prefixo e digitos inteiros %.0f %s\n",
+               bands ? "com 31 bandas" : "de 60 s", (double)old_cycles / BENCH_RECORDS, BENCH_UNIT,
+               (double)new_cycles / BENCH_RECORDS, BENCH_UNIT);
+        CHECK(new_cycles < old_cycles);
+    }
+}
+
+int main(void) {
+    fake_broker_reset();
+    mqtt_payload_init(configs, count_of(configs));
+
+    test_identical();
+    test_timestamp();
+    bench();
+    return test_result("test_payload");
+}
@@ -0,0 +1,248 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_common.h"
+#include "fake_broker.h"
+#include "fake_lfs.h"
+#include "inc/mqtt.h"
+#include "inc/flash.h"
+
+#define STEP_US 50000ULL                    // Tick of the simulation (MQTT_DRAIN_PERIOD_MS)
+#define MAX_RECORDS 400                     // Records of one scenario (identified by their mean level)
+#define FIRST_ID 1000                       // Mean level of the first record (10.00 dB)
+
+static const sensor_config_t config = { .sensor_id = 7, .latitude_e6 = -3743987, .longitude_e6 = -38536267 };
+static uint32_t delivered[MAX_RECORDS];     // PUBACKs received by each record
+static uint32_t produced;                   // Records queued by the scenario
+static uint32_t checked_messages;           // Messages already checked by the broker
+
+/**
+ * @brief Starts a scenario: empty broker and filesystem, the client started.
+ */
+
+static void start(bool online) {
+    fake_broker_reset();
+    fake_lfs_reset();
+    fake_broker_online = online;
+    memset(delivered, 0, sizeof(delivered));
+    produced = 0;
+    checked_messages = 0;
+    backlog_stats = (backlog_stats_t){ 0 };
+    publish_batch_stats = (publish_batch_stats_t){ 0 };
+
+    init_filesystem();
+    start_mqtt_client();
+}
+
+/**
+ * @brief Queues the next record of the scenario (a closed 60 s window).
+ */
+
+static void produce(void) {
+    micdata_t micdata = { .config = &config, .window_s = 60 };
+
+    micdata.summary.mean_cdB = (int32_t)(FIRST_ID + produced++);
+    publish_db_to_mqtt(&micdata);
+}
+
+/**
+ * @brief Counts a PUBACK for every record carried by a message.
+ */
+
+static void deliver(const fake_broker_message_t *message) {
+    char text[MQTT_BATCH_MAX_BYTES + 1];
+    const char *key = "\"avgdB\":\"";
+
+    memcpy(text, message->payload, message->length);
+    text[message->length] = '\0';
+
+    for (const char *p = strstr(text, key); p; p = strstr(p + 1, key)) {
+        long id = lround(strtod(p + strlen(key), NULL) * 100) - FIRST_ID;
+        CHECK(id >= 0 && id < (long)produced);
+        if (id >= 0 && id < MAX_RECORDS) {
+            delivered[id]++;
+        }
+    }
+}
+
+/**
+ * @brief Acknowledges, in order, the pending messages older than latency_us.
+ */
+
+static void broker_ack(uint64_t latency_us) {
+    uint32_t ready = 0;
+
+    for (uint32_t i = 0; i < fake_broker_count(); i++) {
+        const fake_broker_message_t *message = fake_broker_message(i);
+        if (!message->pending) {
+            continue;
+        }
+        if (message->sent_us + latency_us > fake_now_us) {
+            break;
+        }
+        deliver(message);
+        ready++;
+    }
+    fake_broker_ack(ready);
+}
+
+/**
+ * @brief Runs the MQTT tasks for a while, at the periods of main().
+ *
+ * @param us Duration to simulate.
+ * @param record_us Period of the produced records (0 = none).
+ * @param latency_us PUBACK latency of the broker (0 = the broker does not answer).
+ */
+
+static void run(uint64_t us, uint64_t record_us, uint64_t latency_us) {
+    for (uint64_t end = fake_now_us + us; fake_now_us < end;) {
+        fake_now_us += STEP_US;
+
+        if (record_us && fake_now_us % record_us == 0 && produced < MAX_RECORDS) {
+            produce();
+        }
+        if (fake_now_us % (PUBLISH_QUEUE_PERIOD_MS * 1000ULL) == 0) {
+            mqtt_publisher_service();
+        }
+        mqtt_backlog_service();
+        if (fake_now_us % (MQTT_CHECK_PERIOD_MS * 1000ULL) == 0) {
+            check_mqtt_connection();
+        }
+        if (latency_us) {
+            broker_ack(latency_us);
+        }
+
+        // The window bounds what the broker sees in flight, and lwIP is only called under its lock
+        CHECK(publish_tracker.count <= MQTT_INFLIGHT_WINDOW);
+        CHECK(fake_broker_pending() <= MQTT_REQ_MAX_IN_FLIGHT);
+        for (; checked_messages < fake_broker_count(); checked_messages++) {
+            CHECK(fake_broker_message(checked_messages)->length <= MQTT_BATCH_MAX_BYTES);
+        }
+    }
+    CHECK_EQ(fake_broker_unlocked, 0);
+}
+
+/**
+ * @brief Checks that every record produced was acknowledged exactly once.
+ */
+
+static void check_delivered(const char *name) {
+    uint32_t missing = 0, duplicated = 0;
+
+    for (uint32_t i = 0; i < produced; i++) {
+        missing += delivered[i] == 0;
+        duplicated += delivered[i] > 1;
+    }
+    printf("%s: %u registros, %u mensagens, %u perdidos, %u duplicados, profundidade maxima %u, "
+           "latencia do PUBACK %u us (max %u us), %u falhas, %u reenvios\n",
+           name, produced, fake_broker_count(), missing, duplicated, publish_tracker.max_depth,
+           publish_tracker_ack_latency_mean_us(&publish_tracker), publish_tracker.ack_latency_max_us,
+           publish_tracker.failed, publish_tracker.retries);
+    CHECK_EQ(missing, 0);
+    CHECK_EQ(duplicated, 0);
+}
+
+/**
+ * @brief Live records: released on PUBACK only, batched, within the window.
+ */
+
+static void test_live(void) {
+    start(true);
+
+    // Nothing leaves the queue before its PUBACK
+    for (uint8_t i = 0; i < 4; i++) {
+        produce();
+    }
+    run(MQTT_BATCH_LINGER_MS * 1000ULL + 200000, 0, 0);
+    CHECK_EQ(fake_broker_count(), 1);
+    CHECK_EQ(publish_queue.count, 4);
+    CHECK_EQ(publish_queue.in_flight, 4);
+    CHECK_EQ(publish_tracker.count, 1);
+
+    broker_ack(0);
+    run(200000, 0, 0);
+    CHECK_EQ(publish_queue.count, 0);
+    CHECK_EQ(publish_queue.sent, 4);
+    CHECK_EQ(publish_tracker.count, 0);
+    CHECK_EQ(publish_tracker.acked, 1);
+
+    // Steady flow with a slow broker
+    run(60000000, 200000, 300000);
+    run(5000000, 0, 300000);
+    check_delivered("fluxo ao vivo");
+    CHECK_EQ(publish_queue.count, 0);
+    CHECK_EQ(publish_queue.sent, produced);
+    CHECK_EQ(publish_queue.dropped + publish_queue.spilled, 0);
+    CHECK_EQ(publish_tracker.acked, fake_broker_count());
+    CHECK(publish_tracker.max_depth >= 1 && publish_tracker.max_depth <= MQTT_INFLIGHT_WINDOW);
+    CHECK(publish_tracker_ack_latency_mean_us(&publish_tracker) >= 300000);
+    CHECK(publish_tracker_ack_latency_mean_us(&publish_tracker) <= 300000 + PUBLISH_QUEUE_PERIOD_MS * 1000);   // Released by the publisher task
+    CHECK(publish_batch_stats.max_records > 1);
+}
+
+/**
+ * @brief Messages without PUBACK (timeout) or lost with the connection are sent again.
+ */
+
+static void test_lost_messages(void) {
+    start(true);
+
+    run(3000000, 500000, 0);                // The broker does not answer
+    uint32_t pending = fake_broker_pending();
+    CHECK(pending > 0);
+    CHECK_EQ(publish_queue.sent, 0);
+
+    fake_broker_timeout(pending);
+    run(1000000, 0, 0);
+    CHECK_EQ(publish_tracker.failed, pending);
+    CHECK(publish_tracker.retries > 0);
+    CHECK(fake_broker_pending() > 0);       // The records went out again
+
+    fake_broker_disconnect();               // Their PUBACKs never come
+    run(3000000, 500000, 0);
+    CHECK(publish_tracker.failed > pending);
+
+    run(20000000, 500000, 250000);          // The connection comes back
+    run(5000000, 0, 250000);
+    check_delivered("falhas");
+    CHECK_EQ(publish_queue.count, 0);
+    CHECK_EQ(publish_queue.dropped, 0);
+    CHECK_EQ(publish_queue.sent + publish_queue.spilled, produced);
+    CHECK_EQ(fake_lfs_count(".json"), 0);
+}
+
+/**
+ * @brief Saved data: each file is deleted on the PUBACK of its message, not when it is sent.
+ */
+
+static void test_flash(void) {
+    start(false);
+
+    run(8000000, 200000, 0);                // Offline: the records go to flash
+    CHECK_EQ(publish_queue.spilled, produced);
+    CHECK_EQ(fake_lfs_count(".json"), produced);
+    CHECK_EQ(fake_broker_count(), 0);
+
+    fake_broker_online = true;
+    run(2000000, 0, 0);                     // Reconnected: the drain sends, the broker does not answer
+    CHECK(backlog_stats.files_sent > 0);
+    CHECK_EQ(backlog_stats.files_acked, 0);
+    CHECK_EQ(fake_lfs_count(".json"), produced);
+    CHECK(publish_tracker_in_flight(&publish_tracker, PUBLISH_SOURCE_FLASH) <= MQTT_INFLIGHT_WINDOW - 1);
+
+    fake_broker_disconnect();               // Lost with the connection: the files stay
+    run(500000, 0, 0);
+    CHECK_EQ(fake_lfs_count(".json"), produced);
+
+    run(20000000, 0, 300000);
+    check_delivered("dados salvos");
+    CHECK_EQ(fake_lfs_count(".json"), 0);
+    CHECK_EQ(backlog_stats.files_acked, produced);
+}
+
+int main(void) {
+    test_live();
+    test_lost_messages();
+    test_flash();
+    return test_result("test_publish_tracker");
+}
@@ -0,0 +1,182 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_common.h"
+#include "inc/rollup.h"
+
+#define DAYS 3
+#define STEP_US 300000ULL                       // One level per sampling period
+#define HOUR_US 3600000000ULL
+#define DAY_US (24 * HOUR_US)
+#define GAP_START_US (DAY_US + 13 * HOUR_US + 40 * 60000000ULL)   // No data from 13:40 to 15:50 on the second day
+#define GAP_END_US (DAY_US + 15 * HOUR_US + 50 * 60000000ULL)
+
+/**
+ * @brief Brute-force windows over the raw levels, compared with the cascade on every close.
+ */
+
+static struct {
+    noise_stats_t windows[ROLLUP_LEVELS];       // Raw levels of the current window of each level
+    uint64_t start_us[ROLLUP_LEVELS];
+    double period_energy[LDEN_PERIODS];         // Linear energy of each Lden period of the day
+    uint32_t period_count[LDEN_PERIODS];
+    uint32_t closes[ROLLUP_LEVELS];
+    double worst_lden;
+} brute;
+
+static rollup_t rollup;
+
+static int32_t random_level(uint64_t local_us) {
+    uint8_t hour = (local_us / HOUR_US) % 24;
+    int32_t base = (hour >= 7 && hour < 19) ? 6000 : (hour >= 19 && hour < 23) ? 5000 : 4000;
+    return base + rand() % 1500 + ((rand() % 50 == 0) ? 3000 : 0);
+}
+
+static double reference_lden_cdB(void) {
+    static const double hours[LDEN_PERIODS] = { 12, 4, 8 };
+    static const double penalty_cdB[LDEN_PERIODS] = { 0, 500, 1000 };
+    double sum = 0, weight = 0;
+
+    for (uint8_t p = 0; p < LDEN_PERIODS; p++) {
+        if (brute.period_count[p]) {
+            double leq = 1000.0 * log10(brute.period_energy[p] / brute.period_count[p]);
+            sum += hours[p] * pow(10.0, (leq + penalty_cdB[p]) / 1000.0);
+            weight += hours[p];
+        }
+    }
+    return 1000.0 * log10(sum / weight);
+}
+
+static void on_close(uint8_t level, const noise_stats_t *stats, uint64_t start_us, int32_t lden_cdB, void *arg) {
+    const noise_stats_t *expected = &brute.windows[level];
+    noise_stats_summary_t cascaded, direct;
+    (void)arg;
+
+    brute.closes[level]++;
+    CHECK_EQ(start_us, brute.start_us[level]);
+    CHECK_EQ(stats->energy.count, expected->energy.count);
+    CHECK_EQ(stats->sum_cdB, expected->sum_cdB);
+    CHECK_EQ(stats->min_cdB, expected->min_cdB);
+    CHECK_EQ(stats->max_cdB, expected->max_cdB);
+    CHECK(memcmp(stats->histogram, expected->histogram, sizeof(stats->histogram)) == 0);
+
+    noise_stats_summarize(stats, &cascaded);
+    noise_stats_summarize(expected, &direct);
+    CHECK(abs(cascaded.leq_cdB - direct.leq_cdB) <= 1);
+    CHECK_EQ(cascaded.l10_cdB, direct.l10_cdB);
+    CHECK_EQ(cascaded.l50_cdB, direct.l50_cdB);
+    CHECK_EQ(cascaded.l90_cdB, direct.l90_cdB);
+    CHECK_EQ(cascaded.l95_cdB, direct.l95_cdB);
+
+    if (level == ROLLUP_24H) {
+        double error = fabs(lden_cdB - reference_lden_cdB());
+        CHECK(error <= 1.0);
+        if (error > brute.worst_lden) brute.worst_lden = error;
+        memset(brute.period_energy, 0, sizeof(brute.period_energy));
+        memset(brute.period_count, 0, sizeof(brute.period_count));
+    } else {
+        CHECK_EQ(lden_cdB, 0);
+    }
+}
+
+/**
+ * @brief Windows closed around a clock step, per level.
+ */
+
+static uint32_t step_closes[ROLLUP_LEVELS];
+static uint32_t step_levels;                    // Levels carried by the closed 1 min windows
+
+static void on_step_close(uint8_t level, const noise_stats_t *stats, uint64_t start_us, int32_t lden_cdB, void *arg) {
+    (void)start_us;
+    (void)lden_cdB;
+    (void)arg;
+    step_closes[level]++;
+    if (level == ROLLUP_1MIN) {
+        step_levels += stats->energy.count;
+    }
+}
+
+/**
+ * @brief First clock synchronization: the time since boot jumps to the date.
+ *
+ * The windows open before the jump hold a few seconds of levels; they restart without
+ * being reported, instead of closing every level (a 24 h window of seconds).
+ */
+
+static void test_clock_step(void) {
+    static rollup_t stepped;
+    const uint64_t synced = 20000 * DAY_US + 14 * HOUR_US + 7 * 60000000ULL;
+
+    for (uint64_t t = 2000000; t < 12000000; t += STEP_US) {       // Sampling from 2 s after boot
+        rollup_add(&stepped, t, 6000, on_step_close, NULL);
+    }
+    CHECK_EQ(step_closes[ROLLUP_1MIN], 0);
+    uint32_t seconds = step_closes[ROLLUP_1S];
+
+    rollup_add(&stepped, synced, 6000, on_step_close, NULL);
+    CHECK_EQ(step_closes[ROLLUP_1S], seconds);
+    for (uint8_t i = ROLLUP_1MIN; i < ROLLUP_LEVELS; i++) {
+        CHECK_EQ(step_closes[i], 0);
+        CHECK_EQ(stepped.start_us[i] % ((uint64_t)rollup_level_seconds(i) * 1000000), 0);
+    }
+
+    // The next minute closes with the levels of the new clock only
+    for (uint64_t t = synced + STEP_US; t <= synced + 60000000; t += STEP_US) {
+        rollup_add(&stepped, t, 6000, on_step_close, NULL);
+    }
+    CHECK_EQ(step_closes[ROLLUP_1MIN], 1);
+    CHECK_EQ(step_levels, 60000000 / STEP_US);
+    CHECK_EQ(step_closes[ROLLUP_15MIN] + step_closes[ROLLUP_1H] + step_closes[ROLLUP_24H], 0);
+
+    // A gap shorter than a day still closes the windows it moves past
+    rollup_add(&stepped, synced + 2 * HOUR_US, 6000, on_step_close, NULL);
+    CHECK_EQ(step_closes[ROLLUP_15MIN], 1);
+    CHECK_EQ(step_closes[ROLLUP_1H], 1);
+    CHECK_EQ(step_closes[ROLLUP_24H], 0);
+}
+
+int main(void) {
+    const uint64_t day0 = 20000 * DAY_US;      // Local midnight of the first day
+    const uint64_t first = day0 + 5 * HOUR_US + 123456789;     // Start in the middle of every window
+
+    srand(12);
+    for (uint64_t t = first; t < day0 + DAYS * DAY_US; t += STEP_US) {
+        if (t - day0 >= GAP_START_US && t - day0 < GAP_END_US) {
+            continue;
+        }
+
+        int32_t level = random_level(t);
+        rollup_add(&rollup, t, level, on_close, NULL);
+
+        // Same level, straight into one raw window per level
+        for (uint8_t i = 0; i < ROLLUP_LEVELS; i++) {
+            uint64_t length = (uint64_t)rollup_level_seconds(i) * 1000000;
+            if (t - t % length != brute.start_us[i]) {
+                noise_stats_reset(&brute.windows[i]);
+                brute.start_us[i] = t - t % length;
+            }
+            noise_stats_add(&brute.windows[i], level);
+        }
+        lden_period_t period = rollup_lden_period((t / HOUR_US) % 24);
+        brute.period_energy[period] += pow(10.0, level / 1000.0);
+        brute.period_count[period]++;
+    }
+
+    printf("janelas fechadas: %lu de 1 s, %lu de 1 min, %lu de 15 min, %lu de 1 h, %lu de 24 h (Lden max %.0f cdB de erro)\n",
+           (unsigned long)brute.closes[0], (unsigned long)brute.closes[1], (unsigned long)brute.closes[2],
+           (unsigned long)brute.closes[3], (unsigned long)brute.closes[4], brute.worst_lden);
+
+    // Every window with data was closed once (the current ones are still open)
+    CHECK_EQ(brute.closes[ROLLUP_24H], DAYS - 1);
+    CHECK_EQ(brute.closes[ROLLUP_1H], DAYS * 24 - 5 - 1 - 1);  // Before the start, the empty 14:00 hour, the open hour
+    CHECK_EQ(brute.closes[ROLLUP_15MIN], DAYS * 96 - 20 - 8 - 1);
+
+    CHECK_EQ(rollup_lden_period(6), LDEN_NIGHT);
+    CHECK_EQ(rollup_lden_period(7), LDEN_DAY);
+    CHECK_EQ(rollup_lden_period(19), LDEN_EVENING);
+    CHECK_EQ(rollup_lden_period(23), LDEN_NIGHT);
+
+    test_clock_step();
+
+    return test_result("test_rollup");
+}
@@ -0,0 +1,138 @@
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include "test_common.h"
+#include "inc/sample_ring.h"
+
+#define RECORDS 3000000u
+
+static sample_ring_t ring;
+static volatile int producer_done;
+
+/**
+ * @brief Record number i, with every field derived from i so a torn copy is detected.
+ */
+
+static measurement_t make_record(uint32_t i) {
+    measurement_t record = {
+        .timestamp_us = ((uint64_t)i << 20) | (i & 0xFFFFF),
+        .level_cdB = (int16_t)(i * 7),
+        .sensor = (uint8_t)(i * 13),
+        .flags = (uint8_t)(i >> 3),
+    };
+    return record;
+}
+
+static bool record_valid(const measurement_t *record, uint32_t *number) {
+    uint32_t i = (uint32_t)(record->timestamp_us >> 20);
+    measurement_t expected = make_record(i);
+
+    *number = i;
+    return record->timestamp_us == expected.timestamp_us && record->level_cdB == expected.level_cdB
+        && record->sensor == expected.sensor && record->flags == expected.flags;
+}
+
+/**
+ * @brief Core 1: pushes every record; with retry, waits for room instead of dropping.
+ */
+
+static void *producer(void *arg) {
+    bool retry = arg != NULL;
+
+    for (uint32_t i = 0; i < RECORDS; i++) {
+        measurement_t record = make_record(i);
+        while (!sample_ring_push(&ring, &record) && retry) {
+            sched_yield();
+        }
+        if ((i & 1023) == 0) {
+            sched_yield();  // Let the consumer fall behind now and then
+        }
+    }
+    producer_done = 1;
+    return NULL;
+}
+
+static struct {
+    uint32_t popped;
+    uint32_t torn;          // Records whose fields do not match
+    uint32_t out_of_order;  // Records not after the previous one
+    uint32_t gaps;          // Records skipped (dropped on overflow)
+    int64_t last;           // Number of the last record taken
+} consumed;
+
+/**
+ * @brief Core 0: pops until the producer is done and the ring is empty.
+ */
+
+static void *consumer(void *arg) {
+    int64_t previous = -1;
+    measurement_t record;
+    (void)arg;
+
+    for (;;) {
+        if (sample_ring_pop(&ring, &record)) {
+            uint32_t number;
+            consumed.popped++;
+            if (!record_valid(&record, &number)) {
+                consumed.torn++;
+            } else if ((int64_t)number <= previous) {
+                consumed.out_of_order++;
+            } else {
+                consumed.gaps += (uint32_t)(number - previous - 1);
+                previous = number;
+            }
+        } else if (producer_done && ring.head == ring.tail) {
+            break;
+        } else {
+            sched_yield();
+        }
+    }
+    consumed.last = previous;
+    return NULL;
+}
+
+static void run(bool retry) {
+    pthread_t core0, core1;
+
+    memset(&ring, 0, sizeof(ring));
+    memset(&consumed, 0, sizeof(consumed));
+    producer_done = 0;
+    pthread_create(&core0, NULL, consumer, NULL);
+    pthread_create(&core1, NULL, producer, retry ? &ring : NULL);
+    pthread_join(core1, NULL);
+    pthread_join(core0, NULL);
+
+    printf("%s: %lu retirados, %lu descartados (cheio), nivel max %lu de %u\n", retry ? "com espera" : "sem espera",
+           (unsigned long)consumed.popped, (unsigned long)ring.overflows, (unsigned long)ring.high_water, SAMPLE_RING_SIZE);
+    CHECK_EQ(consumed.torn, 0);
+    CHECK_EQ(consumed.out_of_order, 0);
+    CHECK(ring.high_water <= SAMPLE_RING_SIZE);
+}
+
+int main(void) {
+    measurement_t record = make_record(1);
+
+    // Single thread: full and empty ring
+    for (uint32_t i = 0; i < SAMPLE_RING_SIZE; i++) {
+        CHECK(sample_ring_push(&ring, &record));
+    }
+    CHECK(!sample_ring_push(&ring, &record));
+    CHECK_EQ(ring.overflows, 1);
+    CHECK_EQ(ring.high_water, SAMPLE_RING_SIZE);
+    for (uint32_t i = 0; i < SAMPLE_RING_SIZE; i++) {
+        CHECK(sample_ring_pop(&ring, &record));
+    }
+    CHECK(!sample_ring_pop(&ring, &record));
+
+    // Two threads, producer waiting for room: nothing lost
+    run(true);
+    CHECK_EQ(consumed.popped, RECORDS);
+    CHECK_EQ(consumed.gaps, 0);
+
+    // Two threads, producer never waiting (as on core 1): drops are counted, never torn
+    run(false);
+    CHECK_EQ(consumed.popped + ring.overflows, RECORDS);
+    CHECK_EQ(consumed.gaps + (RECORDS - 1 - consumed.last), ring.overflows);
+
+    return test_result("test_sample_ring");
+}
@@ -0,0 +1,195 @@
+#include <string.h>
+#include "test_common.h"
+#include "inc/scheduler.h"
+
+#define SIM_PASSES 20000        // Scheduler passes of the simulation (about 4 s of virtual time)
+#define POLL_RUNTIME_US 10      // Sampling check
+#define MID_RUNTIME_US 100      // Short housekeeping task
+#define SLOW_RUNTIME_US 250     // Usual runtime of the long housekeeping task
+#define SLOW_STALL_US 1700      // Runtime of every SLOW_STALL_EVERY-th run (e.g. a Wi-Fi reconnect)
+#define SLOW_STALL_EVERY 7
+
+/**
+ * @brief Virtual clock: only the task bodies and the idle jumps make time pass.
+ */
+
+static uint64_t now_us;
+
+static uint64_t virtual_clock(void) {
+    return now_us;
+}
+
+enum { TASK_POLL, TASK_MID, TASK_SLOW };
+
+static struct {
+    int last;                   // Previous task run (-1 = none)
+    uint32_t adjacent;          // Two housekeeping tasks without a sampling check between them
+    uint32_t slow_runs;
+    uint32_t slow_stalls;
+    int periodic[4];            // First housekeeping tasks run (priority check)
+    uint64_t periodic_us[4];    // and their start times
+    uint32_t periodic_count;
+} sim;
+
+static void record(int task) {
+    if (task != TASK_POLL && sim.last != TASK_POLL && sim.last != -1) {
+        sim.adjacent++;
+    }
+    if (task != TASK_POLL && sim.periodic_count < 4) {
+        sim.periodic[sim.periodic_count] = task;
+        sim.periodic_us[sim.periodic_count++] = now_us;
+    }
+    sim.last = task;
+}
+
+static void poll_task(void *arg) {
+    (void)arg;
+    record(TASK_POLL);
+    now_us += POLL_RUNTIME_US;
+}
+
+static void mid_task(void *arg) {
+    (void)arg;
+    record(TASK_MID);
+    now_us += MID_RUNTIME_US;
+}
+
+static void slow_task(void *arg) {
+    (void)arg;
+    record(TASK_SLOW);
+    sim.slow_runs++;
+    if (sim.slow_runs % SLOW_STALL_EVERY == 0) {
+        sim.slow_stalls++;
+        now_us += SLOW_STALL_US;
+    } else {
+        now_us += SLOW_RUNTIME_US;
+    }
+}
+
+/**
+ * @brief Main loop of a core: passes until nothing periodic is due, then sleeps to the next release.
+ */
+
+static void run_loop(scheduler_t *sched, uint32_t passes) {
+    for (uint32_t i = 0; i < passes; i++) {
+        uint32_t guard = 0;
+        while (scheduler_run_once(sched)) {
+            if (++guard > 1000) {
+                CHECK(!"o escalonador nao fica ocioso");
+                return;
+            }
+        }
+        uint64_t next = scheduler_next_release_us(sched);
+        if (next > now_us) {
+            now_us = next;
+        }
+    }
+}
+
+/**
+ * @brief Sampling plus two housekeeping tasks, the slow one stalling now and then.
+ */
+
+static void test_mixed_load(void) {
+    scheduler_t sched;
+
+    memset(&sim, 0, sizeof(sim));
+    sim.last = -1;
+    now_us = 0;
+    scheduler_init(&sched, virtual_clock);
+
+    // Added out of priority order: the table must be sorted
+    CHECK(scheduler_add(&sched, "slow", slow_task, NULL, 1000, 1000, 3));
+    CHECK(scheduler_add(&sched, "poll", poll_task, NULL, 0, 0, 0));
+    CHECK(scheduler_add(&sched, "mid", mid_task, NULL, 500, 500, 2));
+    CHECK(strcmp(sched.tasks[0].name, "poll") == 0);
+    CHECK(strcmp(sched.tasks[1].name, "mid") == 0);
+    CHECK(strcmp(sched.tasks[2].name, "slow") == 0);
+    CHECK_EQ(scheduler_next_release_us(&sched), 500);
+
+    run_loop(&sched, SIM_PASSES);
+
+    const scheduler_task_t *poll = &sched.tasks[0], *mid = &sched.tasks[1], *slow = &sched.tasks[2];
+    for (uint8_t i = 0; i < sched.task_count; i++) {
+        const scheduler_task_t *t = &sched.tasks[i];
+        printf("%-4s: %u execucoes, %u estouros, %u saltos, maior duracao %u us, maior atraso %u us\n",
+               t->name, t->runs, t->overruns, t->skipped, t->max_runtime_us, t->max_lateness_us);
+    }
+
+    // Sampling is checked between every two housekeeping tasks
+    CHECK_EQ(sim.adjacent, 0);
+
+    // Both released at 1000 us: the more urgent one runs first, after a sampling check each
+    CHECK_EQ(sim.periodic[0], TASK_MID);
+    CHECK_EQ(sim.periodic_us[0], 500 + POLL_RUNTIME_US);
+    CHECK_EQ(sim.periodic[1], TASK_MID);
+    CHECK_EQ(sim.periodic_us[1], 1000 + POLL_RUNTIME_US);
+    CHECK_EQ(sim.periodic[2], TASK_SLOW);
+    CHECK_EQ(sim.periodic_us[2], 1000 + 2 * POLL_RUNTIME_US + MID_RUNTIME_US);
+
+    // Statistics match what the task bodies did
+    CHECK_EQ(slow->runs, sim.slow_runs);
+    CHECK_EQ(slow->max_runtime_us, SLOW_STALL_US);
+    CHECK_EQ(mid->max_runtime_us, MID_RUNTIME_US);
+    CHECK_EQ(poll->max_runtime_us, POLL_RUNTIME_US);
+    CHECK_EQ(poll->overruns, 0);                        // No deadline on the polled task
+    CHECK_EQ(slow->total_runtime_us,
+             (uint64_t)sim.slow_stalls * SLOW_STALL_US + (uint64_t)(sim.slow_runs - sim.slow_stalls) * SLOW_RUNTIME_US);
+
+    // Every stall overruns the deadline of the slow task and makes its next run late too,
+    // but never by a whole period; the short task loses the releases that fall in the stall
+    CHECK(slow->overruns >= sim.slow_stalls);
+    CHECK_EQ(slow->skipped, 0);
+    CHECK(mid->skipped >= sim.slow_stalls);
+
+    // Every release is either run or counted as skipped, none is run twice
+    uint64_t mid_released = now_us / 500, slow_released = now_us / 1000;
+    CHECK(mid->runs + mid->skipped <= mid_released && mid->runs + mid->skipped + 1 >= mid_released);
+    CHECK(slow->runs + slow->skipped <= slow_released && slow->runs + slow->skipped + 1 >= slow_released);
+
+    // A release waits at most for one stall and the tasks run before it in the pass
+    CHECK(mid->max_lateness_us <= SLOW_STALL_US + POLL_RUNTIME_US);
+    CHECK(slow->max_lateness_us <= SLOW_STALL_US + MID_RUNTIME_US + 2 * POLL_RUNTIME_US);
+
+    scheduler_reset_stats(&sched);
+    for (uint8_t i = 0; i < sched.task_count; i++) {
+        const scheduler_task_t *t = &sched.tasks[i];
+        CHECK_EQ(t->runs + t->overruns + t->skipped + t->max_runtime_us + t->max_lateness_us, 0);
+        CHECK_EQ(t->total_runtime_us, 0);
+        CHECK(t->period_us == 0 || t->release_us >= now_us);   // Releases are kept
+    }
+}
+
+/**
+ * @brief A polled task with a runtime deadline, and a full task table.
+ */
+
+static void test_polled_deadline(void) {
+    scheduler_t sched;
+
+    memset(&sim, 0, sizeof(sim));
+    sim.last = -1;
+    now_us = 0;
+    scheduler_init(&sched, virtual_clock);
+
+    CHECK(scheduler_add(&sched, "poll", poll_task, NULL, 0, POLL_RUNTIME_US - 1, 0));
+    CHECK_EQ(scheduler_next_release_us(&sched), UINT64_MAX);   // Nothing periodic
+
+    CHECK(!scheduler_run_once(&sched));                         // Only polled tasks ran
+    CHECK(!scheduler_run_once(&sched));
+    CHECK_EQ(sched.tasks[0].runs, 2);
+    CHECK_EQ(sched.tasks[0].overruns, 2);
+    CHECK_EQ(now_us, 2 * POLL_RUNTIME_US);
+
+    for (uint8_t i = 1; i < SCHEDULER_MAX_TASKS; i++) {
+        CHECK(scheduler_add(&sched, "mid", mid_task, NULL, 500, 0, 2));
+    }
+    CHECK(!scheduler_add(&sched, "extra", mid_task, NULL, 500, 0, 2));
+    CHECK_EQ(sched.task_count, SCHEDULER_MAX_TASKS);
+}
+
+int main(void) {
+    test_mixed_load();
+    test_polled_deadline();
+    return test_result("test_scheduler");
+}
@@ -0,0 +1,127 @@
+#include <math.h>
+#include <stdlib.h>
+#include "test_common.h"
+#include "inc/spectrum.h"
+#include "inc/config.h"
+
+#define ADC_MID 2048
+#define FRAMES 20
+#define TARGET_CLOCK_HZ 125000000       // RP2040 system clock
+#define TARGET_CYCLES_1024 160000       // Estimated cost of a 1024-point frame on the Cortex-M0+ (see spectrum_add_frame())
+
+static spectrum_t spectrum;
+static uint16_t frame[SPECTRUM_MAX_FFT];
+
+/**
+ * @brief Analyzes a tone and returns the broadband level of the input in centi-dB.
+ */
+
+static double analyze_tone(uint32_t sample_rate, double hz, double amplitude, int32_t *levels) {
+    uint64_t energy[SPECTRUM_MAX_BANDS] = { 0 };
+    double sum_squares = 0;
+    uint16_t n = spectrum.fft_size;
+
+    for (uint32_t f = 0; f < FRAMES; f++) {
+        for (uint16_t i = 0; i < n; i++) {
+            frame[i] = (uint16_t)(ADC_MID + lround(amplitude * sin(2 * M_PI * hz * (i + f * n) / sample_rate)));
+            double v = (double)frame[i] - ADC_MID;
+            sum_squares += v * v;
+        }
+        spectrum_add_frame(&spectrum, frame, ADC_MID, energy);
+    }
+
+    spectrum_levels_cdB(&spectrum, energy, FRAMES, levels);
+    return 1000.0 * log10(sum_squares / ((double)FRAMES * n)) + MIC_DB_OFFSET * 100.0;
+}
+
+static void test_tones(uint32_t sample_rate) {
+    static const uint16_t tones[] = { 100, 250, 1000, 4000, 6300, 12500 };
+    int32_t levels[SPECTRUM_MAX_BANDS];
+
+    spectrum_init(&spectrum, 1024, sample_rate);
+    for (uint8_t t = 0; t < sizeof(tones) / sizeof(tones[0]); t++) {
+        if (tones[t] > 0.4 * sample_rate) {
+            break;
+        }
+        if (tones[t] < spectrum_band_nominal_hz(spectrum.first_band + 1)) {
+            continue;   // Lowest band: its leakage below the first band is not counted
+        }
+
+        double broadband = analyze_tone(sample_rate, tones[t], 1000.0, levels);
+        uint8_t peak = 0;
+        double total = 0;
+        for (uint8_t b = 0; b < spectrum.band_count; b++) {
+            if (levels[b] > levels[peak]) peak = b;
+            total += pow(10.0, levels[b] / 1000.0);
+        }
+
+        printf("%5lu Hz, tom de %u Hz: banda %u Hz %+.2f dB, soma das bandas %+.2f dB\n", (unsigned long)sample_rate,
+               tones[t], spectrum_band_nominal_hz(spectrum.first_band + peak), (levels[peak] - broadband) / 100.0,
+               (1000.0 * log10(total) - broadband) / 100.0);
+
+        // All the energy in the band of the tone, none lost or created
+        CHECK_EQ(spectrum_band_nominal_hz(spectrum.first_band + peak), tones[t]);
+        CHECK(fabs(levels[peak] - broadband) < 50.0);
+        CHECK(fabs(1000.0 * log10(total) - broadband) < 20.0);
+    }
+
+    // Block floating point keeps the resolution of a quiet tone (3 counts)
+    double broadband = analyze_tone(sample_rate, 1000.0, 3.0, levels);
+    CHECK(fabs(levels[-spectrum.first_band] - broadband) < 100.0);
+}
+
+/**
+ * @brief Frames and ADC blocks per second on the host, and the target budget.
+ */
+
+static void bench_frames(void) {
+    static const uint16_t sizes[] = { 256, 1024 };
+    uint64_t energy[SPECTRUM_MAX_BANDS] = { 0 };
+
+    for (uint16_t i = 0; i < SPECTRUM_MAX_FFT; i++) {
+        frame[i] = (uint16_t)(ADC_MID + rand() % 801 - 400);
+    }
+
+    for (uint8_t s = 0; s < 2; s++) {
+        uint64_t best;
+        const int frames = 200;
+        uint32_t n = sizes[s];
+
+        spectrum_init(&spectrum, n, 48000);
+        BENCH_BEST(best, 10, {
+            for (int f = 0; f < frames; f++) {
+                spectrum_add_frame(&spectrum, frame, ADC_MID, energy);
+            }
+        });
+        bench_sink += (uint32_t)energy[0];
+
+        // Wall clock throughput
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int f = 0; f < 20 * frames; f++) {
+            spectrum_add_frame(&spectrum, frame, ADC_MID, energy);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+        double frames_per_s = 20 * frames / seconds;
+
+        printf("FFT %4lu: %.0f %s/quadro (%.1f/amostra), %.0f quadros/s = %.0f blocos de %u amostras/s no host\n",
+               (unsigned long)n, (double)best / frames, BENCH_UNIT, (double)best / frames / n, frames_per_s,
+               frames_per_s * n / MIC_BLOCK_SIZE, MIC_BLOCK_SIZE);
+    }
+
+    // Target: one frame per MIC_FFT_SIZE samples, the cost scaling as N log N
+    double target_cycles = TARGET_CYCLES_1024 * (MIC_FFT_SIZE * log2(MIC_FFT_SIZE)) / (1024 * 10);
+    for (uint32_t rate = 16000; rate <= 48000; rate += 32000) {
+        printf("alvo (estimativa): FFT %u a %lu Hz = %.1f%% de um nucleo a 125 MHz\n", MIC_FFT_SIZE, (unsigned long)rate,
+               100.0 * target_cycles * rate / MIC_FFT_SIZE / TARGET_CLOCK_HZ);
+    }
+}
+
+int main(void) {
+    srand(10);
+    test_tones(16000);
+    test_tones(48000);
+    bench_frames();
+    return test_result("test_spectrum");
+}
@@ -0,0 +1,129 @@
+#include <math.h>
+#include <stdbool.h>
+#include "test_common.h"
+#include "inc/weighting.h"
+#include "inc/config.h"
+
+#define ADC_MID 2048
+#define TONE_AMPLITUDE 2000         // Near full scale, so the -70 dB point stays above the noise floor
+
+/**
+ * @brief IEC 61672-1 frequency weightings (Table 3) and class 1 tolerance limits.
+ */
+
+static const struct {
+    double hz;
+    double a_dB, c_dB;
+    double upper, lower;            // Class 1 acceptance limits
+} iec_table[] = {
+    {    10.0, -70.4, -14.3, 3.0, -INFINITY },
+    {    20.0, -50.5,  -6.2, 2.0,  -2.0 },
+    {    31.5, -39.4,  -3.0, 1.5,  -1.5 },
+    {    63.0, -26.2,  -0.8, 1.0,  -1.0 },
+    {   125.0, -16.1,  -0.2, 1.0,  -1.0 },
+    {   250.0,  -8.6,   0.0, 1.0,  -1.0 },
+    {   500.0,  -3.2,   0.0, 1.0,  -1.0 },
+    {  1000.0,   0.0,   0.0, 0.7,  -0.7 },
+    {  2000.0,   1.2,  -0.2, 1.0,  -1.0 },
+    {  4000.0,   1.0,  -0.8, 1.0,  -1.0 },
+    {  5000.0,   0.5,  -1.3, 1.5,  -1.5 },
+    {  6300.0,  -0.1,  -2.0, 1.5,  -2.0 },
+    {  8000.0,  -1.1,  -3.0, 1.5,  -2.5 },
+    { 10000.0,  -2.5,  -4.4, 2.0,  -3.0 },
+    { 12500.0,  -4.3,  -6.2, 2.0,  -5.0 },
+    { 16000.0,  -6.6,  -8.5, 2.5, -16.0 },
+};
+
+/**
+ * @brief Analog weighting curve (IEC 61672-1, Annex E), normalized to 0 dB at 1 kHz.
+ */
+
+static double analog_dB(weighting_t type, double hz) {
+    const double f1 = 20.598997, f2 = 107.65265, f3 = 737.86223, f4 = 12194.217;
+    double level = 0;
+
+    for (int ref = 0; ref < 2; ref++) {
+        double f = ref ? 1000.0 : hz;
+        double f_2 = f * f;
+        double c = f4 * f4 * f_2 / ((f_2 + f1 * f1) * (f_2 + f4 * f4));
+        double gain = (type == WEIGHTING_A) ? c * f_2 / sqrt((f_2 + f2 * f2) * (f_2 + f3 * f3)) : c;
+        level += (ref ? -20.0 : 20.0) * log10(gain);
+    }
+    return level;
+}
+
+/**
+ * @brief Measures the gain of the fixed-point filter for a tone (one second, after one second of settling).
+ */
+
+static double measure_dB(weighting_t type, uint32_t sample_rate, double hz) {
+    static uint16_t tone[2 * 48000];
+    weighting_filter_t filter;
+    double reference = 0;
+
+    for (uint32_t i = 0; i < 2 * sample_rate; i++) {
+        tone[i] = (uint16_t)(ADC_MID + lround(TONE_AMPLITUDE * sin(2 * M_PI * hz * i / sample_rate)));
+    }
+    for (uint32_t i = sample_rate; i < 2 * sample_rate; i++) {
+        double v = (double)tone[i] - ADC_MID;
+        reference += v * v;
+    }
+
+    weighting_init(&filter, type, sample_rate);
+    weighting_block_sum_squares(&filter, tone, sample_rate, ADC_MID);
+    uint64_t weighted = weighting_block_sum_squares(&filter, tone + sample_rate, sample_rate, ADC_MID);
+    return 10.0 * log10((double)weighted / reference);
+}
+
+int main(void) {
+    static const uint32_t rates[] = { 16000, 24000, 32000, 44100, 48000 };
+    const weighting_t types[] = { WEIGHTING_A, WEIGHTING_C };
+
+    for (uint8_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        uint32_t fs = rates[r];
+        bool matched = fs >= 2.25 * 12194.217;
+        // Documented accuracy against the analog curve (see weighting_init())
+        double band_hz = matched ? 0.4 * fs : 0.25 * fs;
+        double bound_dB = matched ? 0.3 : 0.25;
+
+        for (uint8_t t = 0; t < 2; t++) {
+            double worst = 0;
+
+            printf("%5lu Hz %s:", (unsigned long)fs, weighting_name(types[t]));
+            for (uint8_t k = 0; k < sizeof(iec_table) / sizeof(iec_table[0]); k++) {
+                double hz = iec_table[k].hz;
+                if (hz > 0.45 * fs) {
+                    break;
+                }
+
+                double measured = measure_dB(types[t], fs, hz);
+                double nominal = (types[t] == WEIGHTING_A) ? iec_table[k].a_dB : iec_table[k].c_dB;
+                printf(" %g:%+.2f", hz, measured - nominal);
+
+                if (hz <= band_hz) {
+                    // Class 1 tolerances of the standard
+                    CHECK(measured - nominal <= iec_table[k].upper);
+                    CHECK(measured - nominal >= iec_table[k].lower);
+
+                    // The analog curve itself, above the noise floor of the -70 dB point
+                    if (hz >= 20.0) {
+                        double error = fabs(measured - analog_dB(types[t], hz));
+                        CHECK(error < bound_dB);
+                        if (error > worst) worst = error;
+                    }
+                }
+            }
+            printf(" (erro max %.2f dB ate %.0f Hz)\n", worst, band_hz);
+        }
+    }
+
+    // 48 kHz: within 0.05 dB up to 12.5 kHz
+    for (uint8_t k = 0; k < sizeof(iec_table) / sizeof(iec_table[0]); k++) {
+        if (iec_table[k].hz >= 20.0 && iec_table[k].hz <= 12500.0) {
+            CHECK(fabs(measure_dB(WEIGHTING_A, 48000, iec_table[k].hz) - analog_dB(WEIGHTING_A, iec_table[k].hz)) < 0.05);
+            CHECK(fabs(measure_dB(WEIGHTING_C, 48000, iec_table[k].hz) - analog_dB(WEIGHTING_C, iec_table[k].hz)) < 0.05);
+        }
+    }
+
+    return test_result("test_weighting");
+}